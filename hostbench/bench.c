@@ -0,0 +1,724 @@
+/*
+ * hostbench/bench.c
+ * Host-side benchmarks for rEFInd
+ *
+ * Builds a set of GPT disk images and ESP/boot directory trees in a work
+ * directory, starts rEFInd on them through the mock firmware in mockefi.c,
+ * and times the parts of start-up that matter most on real hardware: icon
+ * decoding, alpha compositing, menu painting, config parsing, and the
+ * volume and boot loader scans. The numbers are for comparing one build of
+ * rEFInd with another on the same host; the firmware, disks and display
+ * are all simulated, so they say nothing about absolute boot times.
+ *
+ * Usage: refind-bench [-d disks] [-n iterations] [-t topdir] [-w workdir] [-k]
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "efi.h"
+#include "efilib.h"
+#include "global.h"
+#include "config.h"
+#include "lib.h"
+#include "menu.h"
+#include "libegint.h"
+#include "mockefi.h"
+#include "hostbench.h"
+
+#ifndef HOSTBENCH_TOPDIR
+#define HOSTBENCH_TOPDIR    ".."
+#endif
+
+#define BENCH_SCREEN_WIDTH  (1024)
+#define BENCH_SCREEN_HEIGHT (768)
+
+#define BLOCK_SIZE          (512)
+#define PART_FIRST_LBA      (2048)
+#define PART_BLOCKS         (2048)
+#define PART_COUNT          (3)
+#define DISK_BLOCKS         (PART_FIRST_LBA + PART_COUNT * PART_BLOCKS + 2048)
+#define GPT_ENTRY_COUNT     (128)
+#define GPT_ENTRY_SIZE      (128)
+
+#define SELF_PATH           L"\\EFI\\refind\\refind_x64.efi"
+
+static EFI_GUID EspType   = { 0xc12a7328, 0xf81f, 0x11d2, { 0xba, 0x4b, 0x00, 0xa0, 0xc9, 0x3e, 0xc9, 0x3b } };
+static EFI_GUID LinuxType = { 0x0fc63daf, 0x8483, 0x4772, { 0x8e, 0x79, 0x3d, 0x69, 0xd8, 0x47, 0x7d, 0xe4 } };
+static EFI_GUID SwapType  = { 0x0657fd6d, 0xa4ab, 0x43c4, { 0x84, 0xe5, 0x09, 0x33, 0xc8, 0x4b, 0x4f, 0x4f } };
+
+static CHAR8    *TopDir = HOSTBENCH_TOPDIR;
+static CHAR8    *WorkDir = NULL;
+static UINTN    Iterations = 20;
+static UINTN    DiskCount = 4;
+
+//
+// helpers
+//
+
+static UINT64 NowNs(VOID)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (UINT64) Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+static VOID Fail(IN CONST CHAR8 *What)
+{
+    perror(What);
+    exit(1);
+}
+
+// Prints one result line: the mean time per operation, and a note.
+static VOID Report(IN CONST CHAR8 *Name, IN UINTN Count, IN UINT64 Ns, IN CONST CHAR8 *Note)
+{
+    printf("%-34s %7lu %12.1f us   %s\n", Name, Count, (Count > 0) ? Ns / 1000.0 / Count : 0.0, Note);
+}
+
+static CHAR8 * HostPath(IN CONST CHAR8 *Format, ...)
+{
+    CHAR8   *Path;
+    va_list Args;
+
+    va_start(Args, Format);
+    if (vasprintf(&Path, Format, Args) < 0)
+        Fail("vasprintf");
+    va_end(Args);
+    return Path;
+}
+
+static VOID MakeDirs(IN CONST CHAR8 *Path)
+{
+    CHAR8 *Copy, *p;
+
+    Copy = strdup(Path);
+    for (p = Copy + 1; *p; p++) {
+        if (*p == '/') {
+            *p = 0;
+            mkdir(Copy, 0755);
+            *p = '/';
+        }
+    }
+    if (mkdir(Copy, 0755) != 0 && access(Copy, F_OK) != 0)
+        Fail(Copy);
+    free(Copy);
+}
+
+// Writes a file of Size bytes, creating its directory as needed.
+static VOID WriteHostFile(IN CONST CHAR8 *Path, IN CONST VOID *Data, IN UINTN Size)
+{
+    CHAR8   *Dir;
+    FILE    *File;
+
+    Dir = strdup(Path);
+    *strrchr(Dir, '/') = 0;
+    MakeDirs(Dir);
+    free(Dir);
+    File = fopen(Path, "wb");
+    if (File == NULL)
+        Fail(Path);
+    if (Size > 0 && fwrite(Data, Size, 1, File) != 1)
+        Fail(Path);
+    fclose(File);
+}
+
+// Writes a stand-in for an EFI binary or kernel: a PE header signature
+// followed by Size - 2 bytes of padding.
+static VOID WriteDummyBinary(IN CONST CHAR8 *Path, IN UINTN Size)
+{
+    UINT8 *Data;
+
+    Data = calloc(1, Size);
+    Data[0] = 'M';
+    Data[1] = 'Z';
+    WriteHostFile(Path, Data, Size);
+    free(Data);
+}
+
+static BOOLEAN ReadHostFile(IN CONST CHAR8 *Path, OUT UINT8 **Data, OUT UINTN *Size)
+{
+    FILE *File;
+    long Length;
+
+    File = fopen(Path, "rb");
+    if (File == NULL)
+        return FALSE;
+    fseek(File, 0, SEEK_END);
+    Length = ftell(File);
+    fseek(File, 0, SEEK_SET);
+    *Data = malloc(Length > 0 ? Length : 1);
+    *Size = fread(*Data, 1, Length, File);
+    fclose(File);
+    return (*Size == (UINTN) Length);
+}
+
+static int RemoveEntry(const char *Path, const struct stat *Info, int Flag, struct FTW *Ftw)
+{
+    return remove(Path);
+}
+
+static EFI_GUID MakeGuid(IN UINT32 Disk, IN UINT32 Partition)
+{
+    EFI_GUID Guid = { 0x5ec7b000, 0x1234, 0x4abc, { 0x80, 0x00, 0, 0, 0, 0, 0, 0 } };
+
+    Guid.Data1 += Disk * 16 + Partition;
+    Guid.Data4[7] = (UINT8) Partition;
+    Guid.Data4[6] = (UINT8) Disk;
+    return Guid;
+}
+
+//
+// test disks
+//
+
+// the ESP and /boot contents of each disk
+static CONST CHAR8 *EspFiles[] = {
+    "EFI/BOOT/BOOTX64.EFI",
+    "EFI/ubuntu/shimx64.efi", "EFI/ubuntu/grubx64.efi", "EFI/ubuntu/mmx64.efi", "EFI/ubuntu/grub.cfg",
+    "EFI/fedora/shimx64.efi", "EFI/fedora/grubx64.efi", "EFI/fedora/fonts/unicode.pf2",
+    "EFI/Microsoft/Boot/bootmgfw.efi", "EFI/Microsoft/Boot/bootmgr.efi", "EFI/Microsoft/Boot/BCD",
+    "EFI/Microsoft/Boot/memtest.efi", "EFI/Microsoft/Recovery/BCD",
+    "EFI/tools/shellx64.efi",
+    NULL
+};
+
+static CONST CHAR8 *Locales[] = {
+    "cs-CZ", "da-DK", "de-DE", "el-GR", "en-GB", "en-US", "es-ES", "fi-FI", "fr-FR", "hu-HU",
+    "it-IT", "ja-JP", "ko-KR", "nb-NO", "nl-NL", "pl-PL", "pt-BR", "pt-PT", "ru-RU", "sv-SE",
+    NULL
+};
+
+static CONST CHAR8 *KernelVersions[] = {
+    "6.8.0-31-generic", "6.8.0-35-generic", "6.8.0-40-generic", "6.5.0-44-generic", NULL
+};
+
+static CONST CHAR8 *ConfigExtra =
+    "\n"
+    "# added by refind-bench\n"
+    "scanfor internal,manual\n"
+    "scan_all_linux_kernels true\n"
+    "also_scan_dirs boot,EFI/extra\n"
+    "showtools shell,about,reboot,exit\n"
+    "menuentry \"Bench Linux\" {\n"
+    "    volume boot\n"
+    "    loader /vmlinuz-6.8.0-40-generic\n"
+    "    initrd /initrd.img-6.8.0-40-generic\n"
+    "    options \"root=/dev/sda2 ro quiet splash\"\n"
+    "    submenuentry \"Recovery\" {\n"
+    "        add_options \"single\"\n"
+    "    }\n"
+    "}\n";
+
+static VOID BuildEsp(IN CONST CHAR8 *Root, IN BOOLEAN HasRefind)
+{
+    UINT8   *Sample;
+    UINTN   i, SampleSize;
+    CHAR8   *Path, *Config;
+
+    for (i = 0; EspFiles[i] != NULL; i++) {
+        Path = HostPath("%s/%s", Root, EspFiles[i]);
+        WriteDummyBinary(Path, 4096);
+        free(Path);
+    }
+    for (i = 0; Locales[i] != NULL; i++) {
+        Path = HostPath("%s/EFI/Microsoft/Boot/%s/bootmgfw.efi.mui", Root, Locales[i]);
+        WriteDummyBinary(Path, 1024);
+        free(Path);
+    }
+    if (!HasRefind)
+        return;
+
+    Path = HostPath("%s/EFI/refind/refind_x64.efi", Root);
+    WriteDummyBinary(Path, 4096);
+    free(Path);
+
+    // the sample config (for its size and comments), plus some settings
+    Path = HostPath("%s/refind.conf-sample", TopDir);
+    if (!ReadHostFile(Path, &Sample, &SampleSize))
+        Fail(Path);
+    free(Path);
+    Config = HostPath("%.*s%s", (int) SampleSize, Sample, ConfigExtra);
+    Path = HostPath("%s/EFI/refind/refind.conf", Root);
+    WriteHostFile(Path, Config, strlen(Config));
+    free(Path);
+    free(Config);
+    free(Sample);
+
+    Path = HostPath("%s/EFI/refind/icons", Root);
+    Config = HostPath("%s/icons", TopDir);
+    if (Config[0] != '/') {
+        free(Config);
+        Config = HostPath("%s/%s/icons", getcwd(NULL, 0), TopDir);
+    }
+    if (symlink(Config, Path) != 0)
+        Fail(Path);
+    free(Config);
+    free(Path);
+}
+
+static VOID BuildBoot(IN CONST CHAR8 *Root)
+{
+    UINTN i;
+    CHAR8 *Path;
+
+    for (i = 0; KernelVersions[i] != NULL; i++) {
+        Path = HostPath("%s/vmlinuz-%s", Root, KernelVersions[i]);
+        WriteDummyBinary(Path, 8192);
+        free(Path);
+        Path = HostPath("%s/initrd.img-%s", Root, KernelVersions[i]);
+        WriteDummyBinary(Path, 4096);
+        free(Path);
+        Path = HostPath("%s/config-%s", Root, KernelVersions[i]);
+        WriteDummyBinary(Path, 512);
+        free(Path);
+        Path = HostPath("%s/System.map-%s", Root, KernelVersions[i]);
+        WriteDummyBinary(Path, 512);
+        free(Path);
+    }
+    Path = HostPath("%s/grub/grub.cfg", Root);
+    WriteDummyBinary(Path, 512);
+    free(Path);
+}
+
+static VOID SetGptName(OUT UINT8 *Entry, IN CONST CHAR8 *Name)
+{
+    UINTN i;
+
+    for (i = 0; Name[i] != 0 && i < 36; i++)
+        Entry[56 + i * 2] = (UINT8) Name[i];
+}
+
+// Writes a disk image with a protective MBR, a GPT listing PART_COUNT
+// partitions, and a FAT-style boot sector at the start of each partition.
+static VOID BuildDiskImage(IN CONST CHAR8 *Path, IN UINT32 Disk)
+{
+    static CONST CHAR8 *Names[PART_COUNT] = { "EFI System Partition", "Linux boot", "Linux swap" };
+    EFI_GUID    *Types[PART_COUNT] = { &EspType, &LinuxType, &SwapType };
+    EFI_GUID    Guid;
+    UINT8       Sector[BLOCK_SIZE], Entries[GPT_ENTRY_COUNT * GPT_ENTRY_SIZE], *Entry;
+    UINT32      Crc;
+    UINT64      Value;
+    UINTN       i;
+    int         Fd;
+
+    Fd = open(Path, O_CREAT | O_TRUNC | O_RDWR, 0644);
+    if (Fd < 0 || ftruncate(Fd, (off_t) DISK_BLOCKS * BLOCK_SIZE) != 0)
+        Fail(Path);
+
+    // protective MBR
+    memset(Sector, 0, sizeof(Sector));
+    Sector[446 + 4] = 0xee;
+    Sector[446 + 8] = 1;
+    Value = DISK_BLOCKS - 1;
+    memcpy(Sector + 446 + 12, &Value, 4);
+    Sector[510] = 0x55;
+    Sector[511] = 0xaa;
+    pwrite(Fd, Sector, BLOCK_SIZE, 0);
+
+    // partition entries
+    memset(Entries, 0, sizeof(Entries));
+    for (i = 0; i < PART_COUNT; i++) {
+        Entry = Entries + i * GPT_ENTRY_SIZE;
+        Guid = MakeGuid(Disk, (UINT32) i + 1);
+        memcpy(Entry, Types[i], sizeof(EFI_GUID));
+        memcpy(Entry + 16, &Guid, sizeof(EFI_GUID));
+        Value = PART_FIRST_LBA + i * PART_BLOCKS;
+        memcpy(Entry + 32, &Value, 8);
+        Value += PART_BLOCKS - 1;
+        memcpy(Entry + 40, &Value, 8);
+        SetGptName(Entry, Names[i]);
+    }
+    pwrite(Fd, Entries, sizeof(Entries), 2 * BLOCK_SIZE);
+
+    // GPT header
+    memset(Sector, 0, sizeof(Sector));
+    memcpy(Sector, "EFI PART", 8);
+    Sector[10] = 1;                                     // revision 1.0
+    Sector[12] = 92;                                    // header size
+    Value = 1;                      memcpy(Sector + 24, &Value, 8);
+    Value = DISK_BLOCKS - 1;        memcpy(Sector + 32, &Value, 8);
+    Value = 34;                     memcpy(Sector + 40, &Value, 8);
+    Value = DISK_BLOCKS - 34;       memcpy(Sector + 48, &Value, 8);
+    Guid = MakeGuid(Disk, 0);
+    memcpy(Sector + 56, &Guid, sizeof(EFI_GUID));
+    Value = 2;                      memcpy(Sector + 72, &Value, 8);
+    Crc = GPT_ENTRY_COUNT;          memcpy(Sector + 80, &Crc, 4);
+    Crc = GPT_ENTRY_SIZE;           memcpy(Sector + 84, &Crc, 4);
+    uefi_call_wrapper(BS->CalculateCrc32, 3, Entries, sizeof(Entries), &Crc);
+    memcpy(Sector + 88, &Crc, 4);
+    uefi_call_wrapper(BS->CalculateCrc32, 3, Sector, 92, &Crc);
+    memcpy(Sector + 16, &Crc, 4);
+    pwrite(Fd, Sector, BLOCK_SIZE, BLOCK_SIZE);
+
+    // partition boot sectors
+    memset(Sector, 0, sizeof(Sector));
+    Sector[0] = 0xeb;
+    Sector[1] = 0x58;
+    Sector[2] = 0x90;
+    memcpy(Sector + 3, "MSWIN4.1", 8);
+    Sector[510] = 0x55;
+    Sector[511] = 0xaa;
+    for (i = 0; i < PART_COUNT; i++)
+        pwrite(Fd, Sector, BLOCK_SIZE, (off_t) (PART_FIRST_LBA + i * PART_BLOCKS) * BLOCK_SIZE);
+    close(Fd);
+}
+
+// Builds the test disks and attaches them to the mock firmware; returns the
+// handle of the first disk's ESP, which rEFInd is started from.
+static EFI_HANDLE BuildDisks(VOID)
+{
+    EFI_HANDLE  Disk, Esp, SelfDevice = NULL;
+    EFI_GUID    Guid;
+    CHAR8       *Image, *EspRoot, *BootRoot;
+    UINT32      d;
+
+    for (d = 0; d < DiskCount; d++) {
+        Image = HostPath("%s/disk%u.img", WorkDir, d);
+        EspRoot = HostPath("%s/disk%u/esp", WorkDir, d);
+        BootRoot = HostPath("%s/disk%u/boot", WorkDir, d);
+        BuildDiskImage(Image, d);
+        BuildEsp(EspRoot, d == 0);
+        BuildBoot(BootRoot);
+
+        Disk = MockAddDisk(Image, BLOCK_SIZE, (UINT16) d);
+        Guid = MakeGuid(d, 1);
+        Esp = MockAddPartition(Disk, 1, PART_FIRST_LBA, PART_BLOCKS, &EspType, &Guid, EspRoot, L"ESP");
+        Guid = MakeGuid(d, 2);
+        MockAddPartition(Disk, 2, PART_FIRST_LBA + PART_BLOCKS, PART_BLOCKS, &LinuxType, &Guid, BootRoot, L"boot");
+        Guid = MakeGuid(d, 3);
+        MockAddPartition(Disk, 3, PART_FIRST_LBA + 2 * PART_BLOCKS, PART_BLOCKS, &SwapType, &Guid, NULL, NULL);
+        if (d == 0)
+            SelfDevice = Esp;
+        free(Image);
+        free(EspRoot);
+        free(BootRoot);
+    }
+    return SelfDevice;
+}
+
+//
+// benchmarks
+//
+
+// Decodes an icon at the largest size that it has, as rEFInd asks for
+// 128-pixel OS icons, 48-pixel tool icons and 32-pixel volume badges.
+static EG_IMAGE * DecodeIcon(IN UINT8 *Data, IN UINTN Size, IN UINTN WantAlpha)
+{
+    static CONST UINTN IconSizes[] = { 128, 48, 32 };
+    EG_IMAGE    *Image = NULL;
+    UINTN       i;
+
+    for (i = 0; i < sizeof(IconSizes) / sizeof(IconSizes[0]) && Image == NULL; i++)
+        Image = egDecodeICNS(Data, Size, IconSizes[i], WantAlpha);
+    return Image;
+}
+
+static VOID BenchIcons(VOID)
+{
+    struct dirent   *Entry;
+    DIR             *Dir;
+    UINT8           *Data[64], *BmpData;
+    UINTN           Size[64], BmpSize, IconCount = 0, i, n, Decoded = 0;
+    CHAR8           *Path, Note[128];
+    EG_IMAGE        *Image, *Sample = NULL;
+    UINT64          Start;
+
+    Path = HostPath("%s/icons", TopDir);
+    Dir = opendir(Path);
+    if (Dir == NULL)
+        Fail(Path);
+    while ((Entry = readdir(Dir)) != NULL && IconCount < 64) {
+        if (strlen(Entry->d_name) < 5 || strcmp(Entry->d_name + strlen(Entry->d_name) - 5, ".icns") != 0)
+            continue;
+        free(Path);
+        Path = HostPath("%s/icons/%s", TopDir, Entry->d_name);
+        if (ReadHostFile(Path, &Data[IconCount], &Size[IconCount]))
+            IconCount++;
+    }
+    closedir(Dir);
+    free(Path);
+
+    Start = NowNs();
+    for (n = 0; n < Iterations; n++) {
+        for (i = 0; i < IconCount; i++) {
+            Image = DecodeIcon(Data[i], Size[i], EG_ALPHA_PREMULTIPLIED);
+            if (Image != NULL) {
+                Decoded++;
+                egFreeImage(Image);
+            }
+        }
+    }
+    sprintf(Note, "%lu icons, %lu decoded", IconCount, Decoded / (Iterations > 0 ? Iterations : 1));
+    Report("decode .icns (per icon)", Iterations * IconCount, NowNs() - Start, Note);
+
+    // BMP, via an icon re-encoded
+    for (i = 0; i < IconCount && Sample == NULL; i++)
+        Sample = egDecodeICNS(Data[i], Size[i], 128, EG_ALPHA_NONE);
+    if (Sample != NULL) {
+        egEncodeBMP(Sample, &BmpData, &BmpSize);
+        Start = NowNs();
+        for (n = 0; n < Iterations * 10; n++) {
+            Image = egDecodeImage(BmpData, BmpSize, L"BMP", EG_ALPHA_NONE);
+            egFreeImage(Image);
+        }
+        sprintf(Note, "%lux%lu", Sample->Width, Sample->Height);
+        Report("decode .bmp", Iterations * 10, NowNs() - Start, Note);
+        FreePool(BmpData);
+        egFreeImage(Sample);
+    }
+
+    for (i = 0; i < IconCount; i++)
+        free(Data[i]);
+}
+
+static VOID BenchCompose(VOID)
+{
+    static CONST struct {
+        CONST CHAR8 *Name;
+        BOOLEAN     Premultiplied;
+    } Modes[] = {
+        { "compose 128x128, straight", FALSE },
+        { "compose 128x128, premultiplied", TRUE }
+    };
+    EG_PIXEL    Background = { 0x40, 0x30, 0x20, 0xff }, Color = { 0x20, 0x80, 0xe0, 0 };
+    EG_IMAGE    *Screen, *Top;
+    UINTN       m, n, x, y, Count = Iterations * 50;
+    CHAR8       Note[128];
+    UINT64      Start, Ns;
+
+    Screen = egCreateFilledImage(BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT, FALSE, &Background);
+    for (m = 0; m < sizeof(Modes) / sizeof(Modes[0]); m++) {
+        // a disc with a soft edge, so every alpha value occurs
+        Top = egCreateImage(128, 128, TRUE);
+        for (y = 0; y < 128; y++) {
+            for (x = 0; x < 128; x++) {
+                INTN dx = (INTN) x - 64, dy = (INTN) y - 64, d2 = dx * dx + dy * dy;
+                Color.a = (d2 < 48 * 48) ? 255 : (d2 > 64 * 64) ? 0 : (UINT8) (255 * (64 * 64 - d2) / (64 * 64 - 48 * 48));
+                Top->PixelData[y * 128 + x] = Color;
+            }
+        }
+        if (Modes[m].Premultiplied)
+            egPremultiplyImage(Top);
+
+        Start = NowNs();
+        for (n = 0; n < Count; n++)
+            egComposeImage(Screen, Top, (n * 37) % (BENCH_SCREEN_WIDTH - 128), (n * 53) % (BENCH_SCREEN_HEIGHT - 128));
+        Ns = NowNs() - Start;
+        sprintf(Note, "%.1f Mpixel/s", (Ns > 0) ? (double) Count * 128 * 128 * 1000.0 / Ns : 0.0);
+        Report(Modes[m].Name, Count, Ns, Note);
+        egFreeImage(Top);
+    }
+    egFreeImage(Screen);
+}
+
+static VOID BenchMenu(VOID)
+{
+    EG_SCREEN_STATS Before, After;
+    MENU_KEY_STATS  KeyStats;
+    MOCK_STATS      Mock;
+    UINT64          Start, TicksPerMs = TimestampTicksPerMs();
+    UINTN           n, Keys = Iterations * 4;
+    CHAR8           Note[192];
+
+    // the first paint, and loading of the tiles' icons
+    MockResetStats();
+    Start = NowNs();
+    HostBenchRunMainMenu();
+    MockGetStats(&Mock);
+    sprintf(Note, "%lu Blt calls, %lu pixels", (UINTN) Mock.BltCount, (UINTN) Mock.BltPixelCount);
+    Report("main menu, first paint", 1, NowNs() - Start, Note);
+
+    // moving the selection
+    for (n = 0; n < Keys; n++)
+        MockPushKey((n / 8) % 2 ? SCAN_LEFT : SCAN_RIGHT, 0);
+    MockResetStats();
+    egGetScreenStats(&Before);
+    Start = NowNs();
+    HostBenchRunMainMenu();
+    MockGetStats(&Mock);
+    egGetScreenStats(&After);
+    GetMenuKeyStats(&KeyStats);
+    sprintf(Note, "%.1f Blt calls, %.0f pixels per key",
+            (double) Mock.BltCount / Keys, (double) Mock.BltPixelCount / Keys);
+    Report("main menu, arrow key", Keys, NowNs() - Start, Note);
+    if (After.FrameCount > Before.FrameCount)
+        printf("    frames: %lu presented, %.1f Blt calls and %.0f pixels per frame\n",
+               After.FrameCount - Before.FrameCount,
+               (double) (After.TotalBltCount - Before.TotalBltCount) / (After.FrameCount - Before.FrameCount),
+               (double) (After.TotalPixelCount - Before.TotalPixelCount) / (After.FrameCount - Before.FrameCount));
+    if (KeyStats.KeyCount > 0 && TicksPerMs > 0)
+        printf("    key latency: %lu keys, mean %.1f us, max %.1f us\n", KeyStats.KeyCount,
+               (double) KeyStats.TotalLatency * 1000.0 / TicksPerMs / KeyStats.KeyCount,
+               (double) KeyStats.MaxLatency * 1000.0 / TicksPerMs);
+}
+
+static VOID BenchConfig(VOID)
+{
+    struct timespec Times[2];
+    UINTN           n;
+    CHAR8           *Path;
+    UINT64          Start;
+
+    Start = NowNs();
+    for (n = 0; n < Iterations; n++)
+        ReadConfig();
+    Report("ReadConfig, unchanged", Iterations, NowNs() - Start, "size and time checked only");
+
+    // a new modification time every round, so the file is parsed every time
+    Path = HostPath("%s/disk0/esp/EFI/refind/refind.conf", WorkDir);
+    clock_gettime(CLOCK_REALTIME, &Times[0]);
+    Times[1] = Times[0];
+    Start = NowNs();
+    for (n = 0; n < Iterations; n++) {
+        Times[1].tv_sec += 1;
+        utimensat(AT_FDCWD, Path, Times, 0);
+        ReadConfig();
+    }
+    Report("ReadConfig, changed", Iterations, NowNs() - Start, "read and parsed");
+    free(Path);
+}
+
+static VOID BenchScans(VOID)
+{
+    SECTOR_CACHE_STATS  SectorStats;
+    DIR_CACHE_STATS     DirStats;
+    MOCK_STATS          Mock;
+    UINTN               n, Entries = 0;
+    CHAR8               Note[192];
+    UINT64              Start, Ns;
+
+    MockResetStats();
+    Start = NowNs();
+    for (n = 0; n < Iterations; n++)
+        ScanVolumes();
+    Ns = NowNs() - Start;
+    MockGetStats(&Mock);
+    GetSectorCacheStats(&SectorStats);
+    sprintf(Note, "%lu volumes; %.1f block reads, %.1f file opens per scan", VolumesCount,
+            (double) Mock.BlockReadCount / Iterations, (double) Mock.FileOpenCount / Iterations);
+    Report("ScanVolumes", Iterations, Ns, Note);
+    printf("    sector cache since start-up: %lu hits, %lu misses\n", SectorStats.Hits, SectorStats.Misses);
+
+    MockResetStats();
+    Start = NowNs();
+    for (n = 0; n < Iterations; n++)
+        Entries = HostBenchScanEfiFiles();
+    Ns = NowNs() - Start;
+    MockGetStats(&Mock);
+    GetDirCacheStats(&DirStats);
+    sprintf(Note, "%lu entries; %.1f file opens, %.1f directory reads per scan", Entries,
+            (double) Mock.FileOpenCount / Iterations, (double) Mock.DirReadCount / Iterations);
+    Report("ScanEfiFiles, all volumes", Iterations, Ns, Note);
+    printf("    directory cache since start-up: %lu hits, %lu misses\n", DirStats.Hits, DirStats.Misses);
+
+    GlobalConfig.ScanCache = FALSE;
+    MockResetStats();
+    Start = NowNs();
+    for (n = 0; n < Iterations; n++)
+        Entries = HostBenchScanForBootloaders(TRUE);
+    Ns = NowNs() - Start;
+    MockGetStats(&Mock);
+    sprintf(Note, "%lu entries; %.1f file opens per scan", Entries, (double) Mock.FileOpenCount / Iterations);
+    Report("full scan, no scan cache", Iterations, Ns, Note);
+
+    GlobalConfig.ScanCache = TRUE;
+    HostBenchScanForBootloaders(FALSE);     // writes the cache
+    MockResetStats();
+    Start = NowNs();
+    for (n = 0; n < Iterations; n++)
+        Entries = HostBenchScanForBootloaders(TRUE);
+    Ns = NowNs() - Start;
+    MockGetStats(&Mock);
+    sprintf(Note, "%lu entries; %.1f file opens per scan", Entries, (double) Mock.FileOpenCount / Iterations);
+    Report("full scan, scan cache", Iterations, Ns, Note);
+    GlobalConfig.ScanCache = FALSE;
+}
+
+//
+// main
+//
+
+static VOID Usage(IN CONST CHAR8 *Name)
+{
+    fprintf(stderr, "Usage: %s [-d disks] [-n iterations] [-t topdir] [-w workdir] [-k]\n"
+                    "  -d  number of simulated disks (default %lu)\n"
+                    "  -n  iterations per benchmark (default %lu)\n"
+                    "  -t  rEFInd source tree, for icons and refind.conf-sample (default %s)\n"
+                    "  -w  work directory for the disk images (default: a new one in /tmp)\n"
+                    "  -k  keep the work directory\n", Name, DiskCount, Iterations, TopDir);
+    exit(1);
+}
+
+int main(int argc, char *argv[])
+{
+    EFI_SYSTEM_TABLE    *SystemTable;
+    EFI_HANDLE          ImageHandle;
+    EFI_STATUS          Status;
+    BOOLEAN             KeepWorkDir = FALSE;
+    CHAR8               Template[] = "/tmp/refind-bench.XXXXXX";
+    UINT64              Start;
+    int                 Option;
+
+    while ((Option = getopt(argc, argv, "d:n:t:w:kh")) != -1) {
+        switch (Option) {
+            case 'd': DiskCount = strtoul(optarg, NULL, 10); break;
+            case 'n': Iterations = strtoul(optarg, NULL, 10); break;
+            case 't': TopDir = optarg; break;
+            case 'w': WorkDir = optarg; break;
+            case 'k': KeepWorkDir = TRUE; break;
+            default:  Usage(argv[0]);
+        }
+    }
+    if (DiskCount < 1 || Iterations < 1)
+        Usage(argv[0]);
+    if (WorkDir == NULL) {
+        WorkDir = mkdtemp(Template);
+        if (WorkDir == NULL)
+            Fail("mkdtemp");
+    } else {
+        MakeDirs(WorkDir);
+    }
+
+    SystemTable = MockInit(BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT);
+    InitializeLib(NULL, SystemTable);
+    ImageHandle = MockAddImage(BuildDisks(), SELF_PATH);
+
+    printf("rEFInd host benchmarks: %lu disks, %lu iterations, screen %dx%d\n\n",
+           DiskCount, Iterations, BENCH_SCREEN_WIDTH, BENCH_SCREEN_HEIGHT);
+    printf("%-34s %7s %15s   %s\n", "benchmark", "count", "mean", "notes");
+
+    Start = NowNs();
+    Status = HostBenchStartup(ImageHandle, SystemTable);
+    if (EFI_ERROR(Status)) {
+        fprintf(stderr, "rEFInd start-up failed (status %lx)\n", Status);
+        return 1;
+    }
+    Report("start-up to config read", 1, NowNs() - Start, "InitScreen, InitRefitLib, ReadConfig");
+    Start = NowNs();
+    HostBenchScanForBootloaders(TRUE);
+    Report("first scan", 1, NowNs() - Start, "cold icon and directory caches");
+
+    BenchIcons();
+    BenchCompose();
+    BenchMenu();
+    BenchConfig();
+    BenchScans();
+
+    if (KeepWorkDir)
+        printf("\nwork directory: %s\n", WorkDir);
+    else
+        nftw(WorkDir, RemoveEntry, 16, FTW_DEPTH | FTW_PHYS);
+    return 0;
+}
+
+/* EOF */
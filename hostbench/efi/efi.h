@@ -0,0 +1,744 @@
+/*
+ * hostbench/efi/efi.h
+ * Stand-in for GNU-EFI's <efi.h>, for building rEFInd as a host program
+ *
+ * Only the types, protocols and constants that rEFInd and libeg use are
+ * defined, with the same layouts and calling signatures as GNU-EFI's;
+ * EFIAPI is empty, since everything is built with the host's native
+ * calling convention. The protocols are implemented by mockefi.c.
+ */
+
+#ifndef __HOSTBENCH_EFI_H__
+#define __HOSTBENCH_EFI_H__
+
+//
+// base types
+//
+
+typedef unsigned char       UINT8;
+typedef signed char         INT8;
+typedef unsigned short      UINT16;
+typedef short               INT16;
+typedef unsigned int        UINT32;
+typedef int                 INT32;
+typedef unsigned long long  UINT64;
+typedef long long           INT64;
+typedef unsigned long       UINTN;
+typedef long                INTN;
+
+typedef char                CHAR8;
+typedef UINT16              CHAR16;     // needs -fshort-wchar, as with GNU-EFI
+typedef UINT8               BOOLEAN;
+typedef void                VOID;
+
+typedef UINTN               EFI_STATUS;
+typedef VOID                *EFI_HANDLE;
+typedef VOID                *EFI_EVENT;
+typedef UINT64              EFI_LBA;
+typedef UINTN               EFI_TPL;
+
+#define IN
+#define OUT
+#define OPTIONAL
+#define EFIAPI
+#define CONST               const
+
+#define TRUE                ((BOOLEAN) 1)
+#define FALSE               ((BOOLEAN) 0)
+#ifndef NULL
+#define NULL                ((VOID *) 0)
+#endif
+
+#define uefi_call_wrapper(func, va_num, ...)    ((func)(__VA_ARGS__))
+
+//
+// status codes
+//
+
+#define EFI_ERROR_MASK          (0x8000000000000000ULL)
+#define EFIERR(a)               (EFI_ERROR_MASK | (a))
+#define EFI_ERROR(a)            (((INTN) (a)) < 0)
+
+#define EFI_SUCCESS             0
+#define EFI_WARN_DELETE_FAILURE 2
+#define EFI_LOAD_ERROR          EFIERR(1)
+#define EFI_INVALID_PARAMETER   EFIERR(2)
+#define EFI_UNSUPPORTED         EFIERR(3)
+#define EFI_BAD_BUFFER_SIZE     EFIERR(4)
+#define EFI_BUFFER_TOO_SMALL    EFIERR(5)
+#define EFI_NOT_READY           EFIERR(6)
+#define EFI_DEVICE_ERROR        EFIERR(7)
+#define EFI_WRITE_PROTECTED     EFIERR(8)
+#define EFI_OUT_OF_RESOURCES    EFIERR(9)
+#define EFI_VOLUME_CORRUPTED    EFIERR(10)
+#define EFI_VOLUME_FULL         EFIERR(11)
+#define EFI_NO_MEDIA            EFIERR(12)
+#define EFI_MEDIA_CHANGED       EFIERR(13)
+#define EFI_NOT_FOUND           EFIERR(14)
+#define EFI_ACCESS_DENIED       EFIERR(15)
+#define EFI_NOT_STARTED         EFIERR(19)
+#define EFI_ALREADY_STARTED     EFIERR(20)
+#define EFI_ABORTED             EFIERR(21)
+#define EFI_TIMEOUT             EFIERR(18)
+#define EFI_CRC_ERROR           EFIERR(27)
+
+//
+// GUIDs and times
+//
+
+typedef struct {
+    UINT32                  Data1;
+    UINT16                  Data2;
+    UINT16                  Data3;
+    UINT8                   Data4[8];
+} EFI_GUID;
+
+typedef struct {
+    UINT16                  Year;
+    UINT8                   Month;
+    UINT8                   Day;
+    UINT8                   Hour;
+    UINT8                   Minute;
+    UINT8                   Second;
+    UINT8                   Pad1;
+    UINT32                  Nanosecond;
+    INT16                   TimeZone;
+    UINT8                   Daylight;
+    UINT8                   Pad2;
+} EFI_TIME;
+
+//
+// device paths
+//
+
+typedef struct _EFI_DEVICE_PATH {
+    UINT8                   Type;
+    UINT8                   SubType;
+    UINT8                   Length[2];
+} EFI_DEVICE_PATH;
+
+#define HARDWARE_DEVICE_PATH            0x01
+#define HW_PCI_DP                       0x01
+#define HW_MEMMAP_DP                    0x03
+#define ACPI_DEVICE_PATH                0x02
+#define MESSAGING_DEVICE_PATH           0x03
+#define MSG_ATAPI_DP                    0x01
+#define MSG_SCSI_DP                     0x02
+#define MSG_FIBRECHANNEL_DP             0x03
+#define MSG_1394_DP                     0x04
+#define MSG_USB_DP                      0x05
+#define MSG_USB_CLASS_DP                0x0f
+#define MSG_SATA_DP                     0x12
+#define MEDIA_DEVICE_PATH               0x04
+#define MEDIA_HARDDRIVE_DP              0x01
+#define MEDIA_CDROM_DP                  0x02
+#define MEDIA_VENDOR_DP                 0x03
+#define MEDIA_FILEPATH_DP               0x04
+#define END_DEVICE_PATH_TYPE            0x7f
+#define END_ENTIRE_DEVICE_PATH_SUBTYPE  0xff
+#define END_INSTANCE_DEVICE_PATH_SUBTYPE 0x01
+
+#define DevicePathType(a)           ((a)->Type & 0x7f)
+#define DevicePathSubType(a)        ((a)->SubType)
+#define DevicePathNodeLength(a)     ((UINTN) ((a)->Length[0] | ((a)->Length[1] << 8)))
+#define NextDevicePathNode(a)       ((EFI_DEVICE_PATH *) (((UINT8 *) (a)) + DevicePathNodeLength(a)))
+#define IsDevicePathEndType(a)      (DevicePathType(a) == END_DEVICE_PATH_TYPE)
+#define IsDevicePathEnd(a)          (IsDevicePathEndType(a) && DevicePathSubType(a) == END_ENTIRE_DEVICE_PATH_SUBTYPE)
+#define SetDevicePathNodeLength(a, l) { (a)->Length[0] = (UINT8) (l); (a)->Length[1] = (UINT8) ((l) >> 8); }
+#define SetDevicePathEndNode(a) { \
+    (a)->Type = END_DEVICE_PATH_TYPE; \
+    (a)->SubType = END_ENTIRE_DEVICE_PATH_SUBTYPE; \
+    (a)->Length[0] = sizeof(EFI_DEVICE_PATH); \
+    (a)->Length[1] = 0; \
+}
+
+typedef struct {
+    EFI_DEVICE_PATH         Header;
+    UINT8                   Function;
+    UINT8                   Device;
+} PCI_DEVICE_PATH;
+
+typedef struct {
+    EFI_DEVICE_PATH         Header;
+    UINT16                  HBAPortNumber;
+    UINT16                  PortMultiplierPortNumber;
+    UINT16                  Lun;
+} SATA_DEVICE_PATH;
+
+typedef struct {
+    EFI_DEVICE_PATH         Header;
+    UINT8                   ParentPortNumber;
+    UINT8                   InterfaceNumber;
+} USB_DEVICE_PATH;
+
+typedef struct {
+    EFI_DEVICE_PATH         Header;
+    UINT32                  PartitionNumber;
+    UINT64                  PartitionStart;
+    UINT64                  PartitionSize;
+    UINT8                   Signature[16];
+    UINT8                   MBRType;
+    UINT8                   SignatureType;
+} __attribute__((packed)) HARDDRIVE_DEVICE_PATH;
+
+#define MBR_TYPE_PCAT                           0x01
+#define MBR_TYPE_EFI_PARTITION_TABLE_HEADER     0x02
+#define SIGNATURE_TYPE_MBR                      0x01
+#define SIGNATURE_TYPE_GUID                     0x02
+
+typedef struct {
+    EFI_DEVICE_PATH         Header;
+    CHAR16                  PathName[1];
+} FILEPATH_DEVICE_PATH;
+
+#define SIZE_OF_FILEPATH_DEVICE_PATH    (sizeof(EFI_DEVICE_PATH))
+
+#define DEVICE_PATH_PROTOCOL \
+    { 0x09576e91, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } }
+
+//
+// files
+//
+
+#define EFI_FILE_MODE_READ      0x0000000000000001ULL
+#define EFI_FILE_MODE_WRITE     0x0000000000000002ULL
+#define EFI_FILE_MODE_CREATE    0x8000000000000000ULL
+
+#define EFI_FILE_READ_ONLY      0x0000000000000001ULL
+#define EFI_FILE_HIDDEN         0x0000000000000002ULL
+#define EFI_FILE_SYSTEM         0x0000000000000004ULL
+#define EFI_FILE_RESERVED       0x0000000000000008ULL
+#define EFI_FILE_DIRECTORY      0x0000000000000010ULL
+#define EFI_FILE_ARCHIVE        0x0000000000000020ULL
+#define EFI_FILE_VALID_ATTR     0x0000000000000037ULL
+
+#define EFI_FILE_INFO_ID \
+    { 0x09576e92, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } }
+
+typedef struct {
+    UINT64                  Size;
+    UINT64                  FileSize;
+    UINT64                  PhysicalSize;
+    EFI_TIME                CreateTime;
+    EFI_TIME                LastAccessTime;
+    EFI_TIME                ModificationTime;
+    UINT64                  Attribute;
+    CHAR16                  FileName[1];
+} EFI_FILE_INFO;
+
+#define SIZE_OF_EFI_FILE_INFO   ((UINTN) &((EFI_FILE_INFO *) 0)->FileName)
+
+#define EFI_FILE_SYSTEM_INFO_ID \
+    { 0x09576e93, 0x6d3f, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } }
+
+typedef struct {
+    UINT64                  Size;
+    BOOLEAN                 ReadOnly;
+    UINT64                  VolumeSize;
+    UINT64                  FreeSpace;
+    UINT32                  BlockSize;
+    CHAR16                  VolumeLabel[1];
+} EFI_FILE_SYSTEM_INFO;
+
+#define SIZE_OF_EFI_FILE_SYSTEM_INFO    ((UINTN) &((EFI_FILE_SYSTEM_INFO *) 0)->VolumeLabel)
+
+struct _EFI_FILE_HANDLE;
+
+typedef EFI_STATUS (EFIAPI *EFI_FILE_OPEN)(IN struct _EFI_FILE_HANDLE *File, OUT struct _EFI_FILE_HANDLE **NewHandle,
+                                           IN CHAR16 *FileName, IN UINT64 OpenMode, IN UINT64 Attributes);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_CLOSE)(IN struct _EFI_FILE_HANDLE *File);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_DELETE)(IN struct _EFI_FILE_HANDLE *File);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_READ)(IN struct _EFI_FILE_HANDLE *File, IN OUT UINTN *BufferSize, OUT VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_WRITE)(IN struct _EFI_FILE_HANDLE *File, IN OUT UINTN *BufferSize, IN VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_GET_POSITION)(IN struct _EFI_FILE_HANDLE *File, OUT UINT64 *Position);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_SET_POSITION)(IN struct _EFI_FILE_HANDLE *File, IN UINT64 Position);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_GET_INFO)(IN struct _EFI_FILE_HANDLE *File, IN EFI_GUID *InformationType,
+                                               IN OUT UINTN *BufferSize, OUT VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_SET_INFO)(IN struct _EFI_FILE_HANDLE *File, IN EFI_GUID *InformationType,
+                                               IN UINTN BufferSize, IN VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_FILE_FLUSH)(IN struct _EFI_FILE_HANDLE *File);
+
+typedef struct _EFI_FILE_HANDLE {
+    UINT64                  Revision;
+    EFI_FILE_OPEN           Open;
+    EFI_FILE_CLOSE          Close;
+    EFI_FILE_DELETE         Delete;
+    EFI_FILE_READ           Read;
+    EFI_FILE_WRITE          Write;
+    EFI_FILE_GET_POSITION   GetPosition;
+    EFI_FILE_SET_POSITION   SetPosition;
+    EFI_FILE_GET_INFO       GetInfo;
+    EFI_FILE_SET_INFO       SetInfo;
+    EFI_FILE_FLUSH          Flush;
+} EFI_FILE, *EFI_FILE_HANDLE;
+
+#define SIMPLE_FILE_SYSTEM_PROTOCOL \
+    { 0x964e5b22, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } }
+
+struct _EFI_FILE_IO_INTERFACE;
+
+typedef EFI_STATUS (EFIAPI *EFI_VOLUME_OPEN)(IN struct _EFI_FILE_IO_INTERFACE *This, OUT EFI_FILE_HANDLE *Root);
+
+typedef struct _EFI_FILE_IO_INTERFACE {
+    UINT64                  Revision;
+    EFI_VOLUME_OPEN         OpenVolume;
+} EFI_FILE_IO_INTERFACE;
+
+//
+// block devices
+//
+
+#define BLOCK_IO_PROTOCOL \
+    { 0x964e5b21, 0x6459, 0x11d2, { 0x8e, 0x39, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } }
+
+typedef struct {
+    UINT32                  MediaId;
+    BOOLEAN                 RemovableMedia;
+    BOOLEAN                 MediaPresent;
+    BOOLEAN                 LogicalPartition;
+    BOOLEAN                 ReadOnly;
+    BOOLEAN                 WriteCaching;
+    UINT32                  BlockSize;
+    UINT32                  IoAlign;
+    EFI_LBA                 LastBlock;
+} EFI_BLOCK_IO_MEDIA;
+
+struct _EFI_BLOCK_IO;
+
+typedef EFI_STATUS (EFIAPI *EFI_BLOCK_RESET)(IN struct _EFI_BLOCK_IO *This, IN BOOLEAN ExtendedVerification);
+typedef EFI_STATUS (EFIAPI *EFI_BLOCK_READ)(IN struct _EFI_BLOCK_IO *This, IN UINT32 MediaId, IN EFI_LBA LBA,
+                                            IN UINTN BufferSize, OUT VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_BLOCK_WRITE)(IN struct _EFI_BLOCK_IO *This, IN UINT32 MediaId, IN EFI_LBA LBA,
+                                             IN UINTN BufferSize, IN VOID *Buffer);
+typedef EFI_STATUS (EFIAPI *EFI_BLOCK_FLUSH)(IN struct _EFI_BLOCK_IO *This);
+
+typedef struct _EFI_BLOCK_IO {
+    UINT64                  Revision;
+    EFI_BLOCK_IO_MEDIA      *Media;
+    EFI_BLOCK_RESET         Reset;
+    EFI_BLOCK_READ          ReadBlocks;
+    EFI_BLOCK_WRITE         WriteBlocks;
+    EFI_BLOCK_FLUSH         FlushBlocks;
+} EFI_BLOCK_IO;
+
+//
+// loaded images
+//
+
+#define LOADED_IMAGE_PROTOCOL \
+    { 0x5b1b31a1, 0x9562, 0x11d2, { 0x8e, 0x3f, 0x00, 0xa0, 0xc9, 0x69, 0x72, 0x3b } }
+
+typedef enum {
+    EfiReservedMemoryType,
+    EfiLoaderCode,
+    EfiLoaderData,
+    EfiBootServicesCode,
+    EfiBootServicesData,
+    EfiRuntimeServicesCode,
+    EfiRuntimeServicesData,
+    EfiConventionalMemory,
+    EfiMaxMemoryType
+} EFI_MEMORY_TYPE;
+
+typedef struct {
+    UINT32                  Revision;
+    EFI_HANDLE              ParentHandle;
+    struct _EFI_SYSTEM_TABLE *SystemTable;
+    EFI_HANDLE              DeviceHandle;
+    EFI_DEVICE_PATH         *FilePath;
+    VOID                    *Reserved;
+    UINT32                  LoadOptionsSize;
+    VOID                    *LoadOptions;
+    VOID                    *ImageBase;
+    UINT64                  ImageSize;
+    EFI_MEMORY_TYPE         ImageCodeType;
+    EFI_MEMORY_TYPE         ImageDataType;
+    EFI_STATUS              (EFIAPI *Unload)(IN EFI_HANDLE ImageHandle);
+} EFI_LOADED_IMAGE;
+
+//
+// console
+//
+
+typedef struct {
+    UINT16                  ScanCode;
+    CHAR16                  UnicodeChar;
+} EFI_INPUT_KEY;
+
+#define SCAN_NULL               0x0000
+#define SCAN_UP                 0x0001
+#define SCAN_DOWN               0x0002
+#define SCAN_RIGHT              0x0003
+#define SCAN_LEFT               0x0004
+#define SCAN_HOME               0x0005
+#define SCAN_END                0x0006
+#define SCAN_INSERT             0x0007
+#define SCAN_DELETE             0x0008
+#define SCAN_PAGE_UP            0x0009
+#define SCAN_PAGE_DOWN          0x000a
+#define SCAN_F1                 0x000b
+#define SCAN_F2                 0x000c
+#define SCAN_F3                 0x000d
+#define SCAN_F4                 0x000e
+#define SCAN_F5                 0x000f
+#define SCAN_F6                 0x0010
+#define SCAN_F7                 0x0011
+#define SCAN_F8                 0x0012
+#define SCAN_F9                 0x0013
+#define SCAN_F10                0x0014
+#define SCAN_F11                0x0015
+#define SCAN_F12                0x0016
+#define SCAN_ESC                0x0017
+
+#define CHAR_NULL               0x0000
+#define CHAR_BACKSPACE          0x0008
+#define CHAR_TAB                0x0009
+#define CHAR_LINEFEED           0x000a
+#define CHAR_CARRIAGE_RETURN    0x000d
+
+#define ARROW_LEFT              0x2190
+#define ARROW_UP                0x2191
+#define ARROW_RIGHT             0x2192
+#define ARROW_DOWN              0x2193
+
+struct _SIMPLE_INPUT_INTERFACE;
+
+typedef EFI_STATUS (EFIAPI *EFI_INPUT_RESET)(IN struct _SIMPLE_INPUT_INTERFACE *This, IN BOOLEAN ExtendedVerification);
+typedef EFI_STATUS (EFIAPI *EFI_INPUT_READ_KEY)(IN struct _SIMPLE_INPUT_INTERFACE *This, OUT EFI_INPUT_KEY *Key);
+
+typedef struct _SIMPLE_INPUT_INTERFACE {
+    EFI_INPUT_RESET         Reset;
+    EFI_INPUT_READ_KEY      ReadKeyStroke;
+    EFI_EVENT               WaitForKey;
+} SIMPLE_INPUT_INTERFACE;
+
+#define EFI_BLACK               0x00
+#define EFI_BLUE                0x01
+#define EFI_GREEN               0x02
+#define EFI_CYAN                0x03
+#define EFI_RED                 0x04
+#define EFI_MAGENTA             0x05
+#define EFI_BROWN               0x06
+#define EFI_LIGHTGRAY           0x07
+#define EFI_DARKGRAY            0x08
+#define EFI_LIGHTBLUE           0x09
+#define EFI_LIGHTGREEN          0x0a
+#define EFI_LIGHTCYAN           0x0b
+#define EFI_LIGHTRED            0x0c
+#define EFI_LIGHTMAGENTA        0x0d
+#define EFI_YELLOW              0x0e
+#define EFI_WHITE               0x0f
+#define EFI_BACKGROUND_BLACK    0x00
+#define EFI_BACKGROUND_BLUE     0x10
+#define EFI_BACKGROUND_GREEN    0x20
+#define EFI_BACKGROUND_CYAN     0x30
+#define EFI_BACKGROUND_RED      0x40
+#define EFI_BACKGROUND_MAGENTA  0x50
+#define EFI_BACKGROUND_BROWN    0x60
+#define EFI_BACKGROUND_LIGHTGRAY 0x70
+
+typedef struct {
+    INT32                   MaxMode;
+    INT32                   Mode;
+    INT32                   Attribute;
+    INT32                   CursorColumn;
+    INT32                   CursorRow;
+    BOOLEAN                 CursorVisible;
+} SIMPLE_TEXT_OUTPUT_MODE;
+
+struct _SIMPLE_TEXT_OUTPUT_INTERFACE;
+
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_RESET)(IN struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN BOOLEAN ExtendedVerification);
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_OUTPUT_STRING)(IN struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN CHAR16 *String);
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_TEST_STRING)(IN struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN CHAR16 *String);
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_QUERY_MODE)(IN struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN UINTN ModeNumber,
+                                                 OUT UINTN *Columns, OUT UINTN *Rows);
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_SET_MODE)(IN struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN UINTN ModeNumber);
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_SET_ATTRIBUTE)(IN struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN UINTN Attribute);
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_CLEAR_SCREEN)(IN struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This);
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_SET_CURSOR_POSITION)(IN struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This,
+                                                          IN UINTN Column, IN UINTN Row);
+typedef EFI_STATUS (EFIAPI *EFI_TEXT_ENABLE_CURSOR)(IN struct _SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN BOOLEAN Enable);
+
+typedef struct _SIMPLE_TEXT_OUTPUT_INTERFACE {
+    EFI_TEXT_RESET                  Reset;
+    EFI_TEXT_OUTPUT_STRING          OutputString;
+    EFI_TEXT_TEST_STRING            TestString;
+    EFI_TEXT_QUERY_MODE             QueryMode;
+    EFI_TEXT_SET_MODE               SetMode;
+    EFI_TEXT_SET_ATTRIBUTE          SetAttribute;
+    EFI_TEXT_CLEAR_SCREEN           ClearScreen;
+    EFI_TEXT_SET_CURSOR_POSITION    SetCursorPosition;
+    EFI_TEXT_ENABLE_CURSOR          EnableCursor;
+    SIMPLE_TEXT_OUTPUT_MODE         *Mode;
+} SIMPLE_TEXT_OUTPUT_INTERFACE;
+
+//
+// graphics output
+//
+
+#define EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID \
+    { 0x9042a9de, 0x23dc, 0x4a38, { 0x96, 0xfb, 0x7a, 0xde, 0xd0, 0x80, 0x51, 0x6a } }
+
+typedef enum {
+    PixelRedGreenBlueReserved8BitPerColor,
+    PixelBlueGreenRedReserved8BitPerColor,
+    PixelBitMask,
+    PixelBltOnly,
+    PixelFormatMax
+} EFI_GRAPHICS_PIXEL_FORMAT;
+
+typedef struct {
+    UINT32                  RedMask;
+    UINT32                  GreenMask;
+    UINT32                  BlueMask;
+    UINT32                  ReservedMask;
+} EFI_PIXEL_BITMASK;
+
+typedef struct {
+    UINT32                      Version;
+    UINT32                      HorizontalResolution;
+    UINT32                      VerticalResolution;
+    EFI_GRAPHICS_PIXEL_FORMAT   PixelFormat;
+    EFI_PIXEL_BITMASK           PixelInformation;
+    UINT32                      PixelsPerScanLine;
+} EFI_GRAPHICS_OUTPUT_MODE_INFORMATION;
+
+typedef struct {
+    UINT32                                  MaxMode;
+    UINT32                                  Mode;
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION    *Info;
+    UINTN                                   SizeOfInfo;
+    UINT64                                  FrameBufferBase;
+    UINTN                                   FrameBufferSize;
+} EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE;
+
+typedef struct {
+    UINT8                   Blue;
+    UINT8                   Green;
+    UINT8                   Red;
+    UINT8                   Reserved;
+} EFI_GRAPHICS_OUTPUT_BLT_PIXEL;
+
+typedef enum {
+    EfiBltVideoFill,
+    EfiBltVideoToBltBuffer,
+    EfiBltBufferToVideo,
+    EfiBltVideoToVideo,
+    EfiGraphicsOutputBltOperationMax
+} EFI_GRAPHICS_OUTPUT_BLT_OPERATION;
+
+struct _EFI_GRAPHICS_OUTPUT_PROTOCOL;
+
+typedef EFI_STATUS (EFIAPI *EFI_GRAPHICS_OUTPUT_PROTOCOL_QUERY_MODE)(IN struct _EFI_GRAPHICS_OUTPUT_PROTOCOL *This,
+                                                                     IN UINT32 ModeNumber, OUT UINTN *SizeOfInfo,
+                                                                     OUT EFI_GRAPHICS_OUTPUT_MODE_INFORMATION **Info);
+typedef EFI_STATUS (EFIAPI *EFI_GRAPHICS_OUTPUT_PROTOCOL_SET_MODE)(IN struct _EFI_GRAPHICS_OUTPUT_PROTOCOL *This,
+                                                                   IN UINT32 ModeNumber);
+typedef EFI_STATUS (EFIAPI *EFI_GRAPHICS_OUTPUT_PROTOCOL_BLT)(IN struct _EFI_GRAPHICS_OUTPUT_PROTOCOL *This,
+                                                              IN OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer OPTIONAL,
+                                                              IN EFI_GRAPHICS_OUTPUT_BLT_OPERATION BltOperation,
+                                                              IN UINTN SourceX, IN UINTN SourceY,
+                                                              IN UINTN DestinationX, IN UINTN DestinationY,
+                                                              IN UINTN Width, IN UINTN Height,
+                                                              IN UINTN Delta OPTIONAL);
+
+typedef struct _EFI_GRAPHICS_OUTPUT_PROTOCOL {
+    EFI_GRAPHICS_OUTPUT_PROTOCOL_QUERY_MODE QueryMode;
+    EFI_GRAPHICS_OUTPUT_PROTOCOL_SET_MODE   SetMode;
+    EFI_GRAPHICS_OUTPUT_PROTOCOL_BLT        Blt;
+    EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE       *Mode;
+} EFI_GRAPHICS_OUTPUT_PROTOCOL;
+
+//
+// boot services
+//
+
+typedef enum {
+    AllHandles,
+    ByRegisterNotify,
+    ByProtocol
+} EFI_LOCATE_SEARCH_TYPE;
+
+typedef enum {
+    TimerCancel,
+    TimerPeriodic,
+    TimerRelative,
+    TimerTypeMax
+} EFI_TIMER_DELAY;
+
+typedef enum {
+    EfiResetCold,
+    EfiResetWarm,
+    EfiResetShutdown
+} EFI_RESET_TYPE;
+
+#define EVT_TIMER                   0x80000000
+#define EVT_RUNTIME                 0x40000000
+#define EVT_NOTIFY_WAIT             0x00000100
+#define EVT_NOTIFY_SIGNAL           0x00000200
+
+#define TPL_APPLICATION             4
+#define TPL_CALLBACK                8
+#define TPL_NOTIFY                  16
+#define TPL_HIGH_LEVEL              31
+
+#define EFI_OPEN_PROTOCOL_BY_HANDLE_PROTOCOL    0x00000001
+#define EFI_OPEN_PROTOCOL_GET_PROTOCOL          0x00000002
+#define EFI_OPEN_PROTOCOL_TEST_PROTOCOL         0x00000004
+#define EFI_OPEN_PROTOCOL_BY_CHILD_CONTROLLER   0x00000008
+#define EFI_OPEN_PROTOCOL_BY_DRIVER             0x00000010
+#define EFI_OPEN_PROTOCOL_EXCLUSIVE             0x00000020
+
+typedef struct {
+    EFI_HANDLE              AgentHandle;
+    EFI_HANDLE              ControllerHandle;
+    UINT32                  Attributes;
+    UINT32                  OpenCount;
+} EFI_OPEN_PROTOCOL_INFORMATION_ENTRY;
+
+typedef VOID (EFIAPI *EFI_EVENT_NOTIFY)(IN EFI_EVENT Event, IN VOID *Context);
+
+typedef struct {
+    UINT64                  Signature;
+    UINT32                  Revision;
+    UINT32                  HeaderSize;
+    UINT32                  CRC32;
+    UINT32                  Reserved;
+} EFI_TABLE_HEADER;
+
+typedef struct {
+    EFI_TABLE_HEADER        Hdr;
+
+    VOID                    *RaiseTPL;
+    VOID                    *RestoreTPL;
+    VOID                    *AllocatePages;
+    VOID                    *FreePages;
+    VOID                    *GetMemoryMap;
+    EFI_STATUS              (EFIAPI *AllocatePool)(IN EFI_MEMORY_TYPE PoolType, IN UINTN Size, OUT VOID **Buffer);
+    EFI_STATUS              (EFIAPI *FreePool)(IN VOID *Buffer);
+
+    EFI_STATUS              (EFIAPI *CreateEvent)(IN UINT32 Type, IN EFI_TPL NotifyTpl, IN EFI_EVENT_NOTIFY NotifyFunction,
+                                                  IN VOID *NotifyContext, OUT EFI_EVENT *Event);
+    EFI_STATUS              (EFIAPI *SetTimer)(IN EFI_EVENT Event, IN EFI_TIMER_DELAY Type, IN UINT64 TriggerTime);
+    EFI_STATUS              (EFIAPI *WaitForEvent)(IN UINTN NumberOfEvents, IN EFI_EVENT *Event, OUT UINTN *Index);
+    EFI_STATUS              (EFIAPI *SignalEvent)(IN EFI_EVENT Event);
+    EFI_STATUS              (EFIAPI *CloseEvent)(IN EFI_EVENT Event);
+    EFI_STATUS              (EFIAPI *CheckEvent)(IN EFI_EVENT Event);
+
+    VOID                    *InstallProtocolInterface;
+    VOID                    *ReinstallProtocolInterface;
+    VOID                    *UninstallProtocolInterface;
+    EFI_STATUS              (EFIAPI *HandleProtocol)(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol, OUT VOID **Interface);
+    VOID                    *Reserved;
+    VOID                    *RegisterProtocolNotify;
+    EFI_STATUS              (EFIAPI *LocateHandle)(IN EFI_LOCATE_SEARCH_TYPE SearchType, IN EFI_GUID *Protocol OPTIONAL,
+                                                   IN VOID *SearchKey OPTIONAL, IN OUT UINTN *BufferSize,
+                                                   OUT EFI_HANDLE *Buffer);
+    EFI_STATUS              (EFIAPI *LocateDevicePath)(IN EFI_GUID *Protocol, IN OUT EFI_DEVICE_PATH **DevicePath,
+                                                       OUT EFI_HANDLE *Device);
+    VOID                    *InstallConfigurationTable;
+
+    EFI_STATUS              (EFIAPI *LoadImage)(IN BOOLEAN BootPolicy, IN EFI_HANDLE ParentImageHandle,
+                                                IN EFI_DEVICE_PATH *FilePath, IN VOID *SourceBuffer OPTIONAL,
+                                                IN UINTN SourceSize, OUT EFI_HANDLE *ImageHandle);
+    EFI_STATUS              (EFIAPI *StartImage)(IN EFI_HANDLE ImageHandle, OUT UINTN *ExitDataSize,
+                                                 OUT CHAR16 **ExitData OPTIONAL);
+    EFI_STATUS              (EFIAPI *Exit)(IN EFI_HANDLE ImageHandle, IN EFI_STATUS ExitStatus, IN UINTN ExitDataSize,
+                                           IN CHAR16 *ExitData OPTIONAL);
+    EFI_STATUS              (EFIAPI *UnloadImage)(IN EFI_HANDLE ImageHandle);
+    VOID                    *ExitBootServices;
+
+    VOID                    *GetNextMonotonicCount;
+    EFI_STATUS              (EFIAPI *Stall)(IN UINTN Microseconds);
+    EFI_STATUS              (EFIAPI *SetWatchdogTimer)(IN UINTN Timeout, IN UINT64 WatchdogCode, IN UINTN DataSize,
+                                                       IN CHAR16 *WatchdogData OPTIONAL);
+
+    EFI_STATUS              (EFIAPI *ConnectController)(IN EFI_HANDLE ControllerHandle, IN EFI_HANDLE *DriverImageHandle OPTIONAL,
+                                                        IN EFI_DEVICE_PATH *RemainingDevicePath OPTIONAL,
+                                                        IN BOOLEAN Recursive);
+    VOID                    *DisconnectController;
+
+    VOID                    *OpenProtocol;
+    VOID                    *CloseProtocol;
+    EFI_STATUS              (EFIAPI *OpenProtocolInformation)(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol,
+                                                              OUT EFI_OPEN_PROTOCOL_INFORMATION_ENTRY **EntryBuffer,
+                                                              OUT UINTN *EntryCount);
+
+    EFI_STATUS              (EFIAPI *ProtocolsPerHandle)(IN EFI_HANDLE Handle, OUT EFI_GUID ***ProtocolBuffer,
+                                                         OUT UINTN *ProtocolBufferCount);
+    EFI_STATUS              (EFIAPI *LocateHandleBuffer)(IN EFI_LOCATE_SEARCH_TYPE SearchType, IN EFI_GUID *Protocol OPTIONAL,
+                                                         IN VOID *SearchKey OPTIONAL, IN OUT UINTN *NoHandles,
+                                                         OUT EFI_HANDLE **Buffer);
+    EFI_STATUS              (EFIAPI *LocateProtocol)(IN EFI_GUID *Protocol, IN VOID *Registration OPTIONAL,
+                                                     OUT VOID **Interface);
+    VOID                    *InstallMultipleProtocolInterfaces;
+    VOID                    *UninstallMultipleProtocolInterfaces;
+
+    EFI_STATUS              (EFIAPI *CalculateCrc32)(IN VOID *Data, IN UINTN DataSize, OUT UINT32 *Crc32);
+
+    VOID                    *CopyMem;
+    VOID                    *SetMem;
+    VOID                    *CreateEventEx;
+} EFI_BOOT_SERVICES;
+
+//
+// runtime services
+//
+
+#define EFI_VARIABLE_NON_VOLATILE           0x00000001
+#define EFI_VARIABLE_BOOTSERVICE_ACCESS     0x00000002
+#define EFI_VARIABLE_RUNTIME_ACCESS         0x00000004
+
+typedef struct {
+    EFI_TABLE_HEADER        Hdr;
+
+    EFI_STATUS              (EFIAPI *GetTime)(OUT EFI_TIME *Time, OUT VOID *Capabilities OPTIONAL);
+    VOID                    *SetTime;
+    VOID                    *GetWakeupTime;
+    VOID                    *SetWakeupTime;
+
+    VOID                    *SetVirtualAddressMap;
+    VOID                    *ConvertPointer;
+
+    EFI_STATUS              (EFIAPI *GetVariable)(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid,
+                                                  OUT UINT32 *Attributes OPTIONAL, IN OUT UINTN *DataSize,
+                                                  OUT VOID *Data);
+    VOID                    *GetNextVariableName;
+    EFI_STATUS              (EFIAPI *SetVariable)(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid,
+                                                  IN UINT32 Attributes, IN UINTN DataSize, IN VOID *Data);
+
+    VOID                    *GetNextHighMonotonicCount;
+    VOID                    (EFIAPI *ResetSystem)(IN EFI_RESET_TYPE ResetType, IN EFI_STATUS ResetStatus,
+                                                  IN UINTN DataSize, IN CHAR16 *ResetData OPTIONAL);
+} EFI_RUNTIME_SERVICES;
+
+//
+// system table
+//
+
+typedef struct _EFI_SYSTEM_TABLE {
+    EFI_TABLE_HEADER                Hdr;
+
+    CHAR16                          *FirmwareVendor;
+    UINT32                          FirmwareRevision;
+
+    EFI_HANDLE                      ConsoleInHandle;
+    SIMPLE_INPUT_INTERFACE          *ConIn;
+
+    EFI_HANDLE                      ConsoleOutHandle;
+    SIMPLE_TEXT_OUTPUT_INTERFACE    *ConOut;
+
+    EFI_HANDLE                      StandardErrorHandle;
+    SIMPLE_TEXT_OUTPUT_INTERFACE    *StdErr;
+
+    EFI_RUNTIME_SERVICES            *RuntimeServices;
+    EFI_BOOT_SERVICES               *BootServices;
+
+    UINTN                           NumberOfTableEntries;
+    VOID                            *ConfigurationTable;
+} EFI_SYSTEM_TABLE;
+
+#endif /* __HOSTBENCH_EFI_H__ */
+
+/* EOF */
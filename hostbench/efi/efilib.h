@@ -0,0 +1,105 @@
+/*
+ * hostbench/efi/efilib.h
+ * Stand-in for GNU-EFI's <efilib.h>, for building rEFInd as a host program
+ *
+ * Declares the GNU-EFI library functions that rEFInd and libeg call, with
+ * GNU-EFI's signatures and semantics; they're implemented by efilib.c.
+ */
+
+#ifndef __HOSTBENCH_EFILIB_H__
+#define __HOSTBENCH_EFILIB_H__
+
+#include "efi.h"
+
+//
+// globals
+//
+
+extern EFI_SYSTEM_TABLE         *ST;
+extern EFI_BOOT_SERVICES        *BS;
+extern EFI_RUNTIME_SERVICES     *RT;
+
+extern EFI_GUID                 DevicePathProtocol;
+extern EFI_GUID                 LoadedImageProtocol;
+extern EFI_GUID                 BlockIoProtocol;
+extern EFI_GUID                 FileSystemProtocol;
+extern EFI_GUID                 GenericFileInfo;
+extern EFI_GUID                 FileSystemInfo;
+
+extern EFI_DEVICE_PATH          EndDevicePath[];
+
+VOID InitializeLib(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable);
+
+//
+// memory
+//
+
+VOID * AllocatePool(IN UINTN Size);
+VOID * AllocateZeroPool(IN UINTN Size);
+VOID * ReallocatePool(IN VOID *OldPool, IN UINTN OldSize, IN UINTN NewSize);
+VOID FreePool(IN VOID *p);
+
+VOID CopyMem(IN VOID *Dest, IN CONST VOID *Src, IN UINTN len);
+VOID SetMem(IN VOID *Buffer, IN UINTN Size, IN UINT8 Value);
+VOID ZeroMem(IN VOID *Buffer, IN UINTN Size);
+INTN CompareMem(IN CONST VOID *Dest, IN CONST VOID *Src, IN UINTN len);
+
+//
+// strings
+//
+
+UINTN StrLen(IN CONST CHAR16 *s1);
+UINTN StrSize(IN CONST CHAR16 *s1);
+INTN StrCmp(IN CONST CHAR16 *s1, IN CONST CHAR16 *s2);
+INTN StrnCmp(IN CONST CHAR16 *s1, IN CONST CHAR16 *s2, IN UINTN len);
+INTN StriCmp(IN CONST CHAR16 *s1, IN CONST CHAR16 *s2);
+VOID StrCpy(IN CHAR16 *Dest, IN CONST CHAR16 *Src);
+VOID StrCat(IN CHAR16 *Dest, IN CONST CHAR16 *Src);
+VOID StrLwr(IN OUT CHAR16 *Str);
+VOID StrUpr(IN OUT CHAR16 *Str);
+CHAR16 * StrDuplicate(IN CONST CHAR16 *Src);
+UINTN strlena(IN CONST CHAR8 *s1);
+UINTN Atoi(IN CONST CHAR16 *str);
+UINTN xtoi(IN CONST CHAR16 *str);
+
+UINT64 MultU64x32(IN UINT64 Multiplicand, IN UINTN Multiplier);
+UINT64 DivU64x32(IN UINT64 Dividend, IN UINTN Divisor, OUT UINTN *Remainder OPTIONAL);
+
+INTN CompareGuid(IN EFI_GUID *Guid1, IN EFI_GUID *Guid2);
+VOID GuidToString(OUT CHAR16 *Buffer, IN EFI_GUID *Guid);
+VOID StatusToString(OUT CHAR16 *Buffer, IN EFI_STATUS Status);
+
+//
+// formatted output
+//
+
+UINTN SPrint(OUT CHAR16 *Str, IN UINTN StrSize, IN CONST CHAR16 *fmt, ...);
+CHAR16 * PoolPrint(IN CONST CHAR16 *fmt, ...);
+UINTN Print(IN CONST CHAR16 *fmt, ...);
+VOID DumpHex(IN UINTN Indent, IN UINTN Offset, IN UINTN DataSize, IN VOID *UserData);
+
+//
+// device paths
+//
+
+EFI_DEVICE_PATH * DevicePathFromHandle(IN EFI_HANDLE Handle);
+UINTN DevicePathSize(IN EFI_DEVICE_PATH *DevPath);
+EFI_DEVICE_PATH * DuplicateDevicePath(IN EFI_DEVICE_PATH *DevPath);
+EFI_DEVICE_PATH * AppendDevicePath(IN EFI_DEVICE_PATH *Src1, IN EFI_DEVICE_PATH *Src2);
+EFI_DEVICE_PATH * FileDevicePath(IN EFI_HANDLE Device OPTIONAL, IN CHAR16 *FileName);
+CHAR16 * DevicePathToStr(IN EFI_DEVICE_PATH *DevPath);
+
+//
+// protocols and files
+//
+
+EFI_STATUS LibLocateHandle(IN EFI_LOCATE_SEARCH_TYPE SearchType, IN EFI_GUID *Protocol OPTIONAL,
+                           IN VOID *SearchKey OPTIONAL, IN OUT UINTN *NoHandles, OUT EFI_HANDLE **Buffer);
+EFI_STATUS LibLocateProtocol(IN EFI_GUID *ProtocolGuid, OUT VOID **Interface);
+EFI_FILE_HANDLE LibOpenRoot(IN EFI_HANDLE DeviceHandle);
+EFI_FILE_INFO * LibFileInfo(IN EFI_FILE_HANDLE FHand);
+EFI_FILE_SYSTEM_INFO * LibFileSystemInfo(IN EFI_FILE_HANDLE FHand);
+
+#endif /* __HOSTBENCH_EFILIB_H__ */
+
+/* EOF */
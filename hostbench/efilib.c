@@ -0,0 +1,753 @@
+/*
+ * hostbench/efilib.c
+ * GNU-EFI library functions for the host build
+ *
+ * These follow GNU-EFI's behaviour where rEFInd depends on it (SPrint()
+ * takes a buffer size in bytes, CompareGuid() returns 0 for a match, Print()
+ * goes through ST->ConOut, LibOpenRoot() goes through the simple file system
+ * protocol, and so on), so that code runs here the way it does in firmware.
+ * Memory comes from the C library's malloc().
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "efi.h"
+#include "efilib.h"
+
+EFI_SYSTEM_TABLE        *ST = NULL;
+EFI_BOOT_SERVICES       *BS = NULL;
+EFI_RUNTIME_SERVICES    *RT = NULL;
+
+EFI_GUID DevicePathProtocol   = DEVICE_PATH_PROTOCOL;
+EFI_GUID LoadedImageProtocol  = LOADED_IMAGE_PROTOCOL;
+EFI_GUID BlockIoProtocol      = BLOCK_IO_PROTOCOL;
+EFI_GUID FileSystemProtocol   = SIMPLE_FILE_SYSTEM_PROTOCOL;
+EFI_GUID GenericFileInfo      = EFI_FILE_INFO_ID;
+EFI_GUID FileSystemInfo       = EFI_FILE_SYSTEM_INFO_ID;
+
+EFI_DEVICE_PATH EndDevicePath[] = {
+    { END_DEVICE_PATH_TYPE, END_ENTIRE_DEVICE_PATH_SUBTYPE, { sizeof(EFI_DEVICE_PATH), 0 } }
+};
+
+VOID InitializeLib(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
+{
+    ST = SystemTable;
+    BS = SystemTable->BootServices;
+    RT = SystemTable->RuntimeServices;
+}
+
+//
+// memory
+//
+
+VOID * AllocatePool(IN UINTN Size)
+{
+    return malloc(Size ? Size : 1);
+}
+
+VOID * AllocateZeroPool(IN UINTN Size)
+{
+    return calloc(1, Size ? Size : 1);
+}
+
+VOID * ReallocatePool(IN VOID *OldPool, IN UINTN OldSize, IN UINTN NewSize)
+{
+    VOID *NewPool;
+
+    NewPool = AllocatePool(NewSize);
+    if (NewPool != NULL && OldPool != NULL)
+        CopyMem(NewPool, OldPool, (OldSize < NewSize) ? OldSize : NewSize);
+    if (OldPool != NULL)
+        FreePool(OldPool);
+    return NewPool;
+}
+
+VOID FreePool(IN VOID *p)
+{
+    free(p);
+}
+
+VOID CopyMem(IN VOID *Dest, IN CONST VOID *Src, IN UINTN len)
+{
+    memmove(Dest, Src, len);
+}
+
+VOID SetMem(IN VOID *Buffer, IN UINTN Size, IN UINT8 Value)
+{
+    memset(Buffer, Value, Size);
+}
+
+VOID ZeroMem(IN VOID *Buffer, IN UINTN Size)
+{
+    memset(Buffer, 0, Size);
+}
+
+INTN CompareMem(IN CONST VOID *Dest, IN CONST VOID *Src, IN UINTN len)
+{
+    return memcmp(Dest, Src, len);
+}
+
+//
+// strings
+//
+
+static CHAR16 UpcaseChar(IN CHAR16 c)
+{
+    return (c >= L'a' && c <= L'z') ? (c - (L'a' - L'A')) : c;
+}
+
+UINTN StrLen(IN CONST CHAR16 *s1)
+{
+    UINTN len;
+
+    for (len = 0; s1[len]; len++)
+        ;
+    return len;
+}
+
+UINTN StrSize(IN CONST CHAR16 *s1)
+{
+    return (StrLen(s1) + 1) * sizeof(CHAR16);
+}
+
+INTN StrCmp(IN CONST CHAR16 *s1, IN CONST CHAR16 *s2)
+{
+    while (*s1 && *s1 == *s2) {
+        s1++;
+        s2++;
+    }
+    return *s1 - *s2;
+}
+
+INTN StrnCmp(IN CONST CHAR16 *s1, IN CONST CHAR16 *s2, IN UINTN len)
+{
+    while (len > 0 && *s1 && *s1 == *s2) {
+        s1++;
+        s2++;
+        len--;
+    }
+    return (len > 0) ? *s1 - *s2 : 0;
+}
+
+// rEFInd compares unlabelled volumes' NULL VolName with labels; firmware
+// reads zeroes at address 0, so NULL compares as an empty string here.
+INTN StriCmp(IN CONST CHAR16 *s1, IN CONST CHAR16 *s2)
+{
+    if (s1 == NULL)
+        s1 = L"";
+    if (s2 == NULL)
+        s2 = L"";
+    while (*s1 && UpcaseChar(*s1) == UpcaseChar(*s2)) {
+        s1++;
+        s2++;
+    }
+    return UpcaseChar(*s1) - UpcaseChar(*s2);
+}
+
+VOID StrCpy(IN CHAR16 *Dest, IN CONST CHAR16 *Src)
+{
+    while ((*Dest++ = *Src++) != 0)
+        ;
+}
+
+VOID StrCat(IN CHAR16 *Dest, IN CONST CHAR16 *Src)
+{
+    StrCpy(Dest + StrLen(Dest), Src);
+}
+
+VOID StrLwr(IN OUT CHAR16 *Str)
+{
+    for (; *Str; Str++) {
+        if (*Str >= L'A' && *Str <= L'Z')
+            *Str += L'a' - L'A';
+    }
+}
+
+VOID StrUpr(IN OUT CHAR16 *Str)
+{
+    for (; *Str; Str++)
+        *Str = UpcaseChar(*Str);
+}
+
+CHAR16 * StrDuplicate(IN CONST CHAR16 *Src)
+{
+    CHAR16 *Dest;
+    UINTN  Size;
+
+    Size = StrSize(Src);
+    Dest = AllocatePool(Size);
+    if (Dest != NULL)
+        CopyMem(Dest, Src, Size);
+    return Dest;
+}
+
+UINTN strlena(IN CONST CHAR8 *s1)
+{
+    return strlen(s1);
+}
+
+UINTN Atoi(IN CONST CHAR16 *str)
+{
+    UINTN Value = 0;
+
+    while (*str == L' ')
+        str++;
+    while (*str >= L'0' && *str <= L'9')
+        Value = Value * 10 + (*str++ - L'0');
+    return Value;
+}
+
+UINTN xtoi(IN CONST CHAR16 *str)
+{
+    UINTN  Value = 0;
+    CHAR16 c;
+
+    while (*str == L' ')
+        str++;
+    for (;; str++) {
+        c = UpcaseChar(*str);
+        if (c >= L'0' && c <= L'9')
+            Value = (Value << 4) | (c - L'0');
+        else if (c >= L'A' && c <= L'F')
+            Value = (Value << 4) | (c - L'A' + 10);
+        else
+            break;
+    }
+    return Value;
+}
+
+UINT64 MultU64x32(IN UINT64 Multiplicand, IN UINTN Multiplier)
+{
+    return Multiplicand * Multiplier;
+}
+
+UINT64 DivU64x32(IN UINT64 Dividend, IN UINTN Divisor, OUT UINTN *Remainder OPTIONAL)
+{
+    if (Remainder != NULL)
+        *Remainder = Dividend % Divisor;
+    return Dividend / Divisor;
+}
+
+INTN CompareGuid(IN EFI_GUID *Guid1, IN EFI_GUID *Guid2)
+{
+    return (CompareMem(Guid1, Guid2, sizeof(EFI_GUID)) == 0) ? 0 : 1;
+}
+
+VOID GuidToString(OUT CHAR16 *Buffer, IN EFI_GUID *Guid)
+{
+    SPrint(Buffer, 0, L"%g", Guid);
+}
+
+static struct {
+    EFI_STATUS  Status;
+    CHAR16      *Text;
+} StatusText[] = {
+    { EFI_SUCCESS,              L"Success" },
+    { EFI_LOAD_ERROR,           L"Load Error" },
+    { EFI_INVALID_PARAMETER,    L"Invalid Parameter" },
+    { EFI_UNSUPPORTED,          L"Unsupported" },
+    { EFI_BAD_BUFFER_SIZE,      L"Bad Buffer Size" },
+    { EFI_BUFFER_TOO_SMALL,     L"Buffer Too Small" },
+    { EFI_NOT_READY,            L"Not Ready" },
+    { EFI_DEVICE_ERROR,         L"Device Error" },
+    { EFI_WRITE_PROTECTED,      L"Write Protected" },
+    { EFI_OUT_OF_RESOURCES,     L"Out of Resources" },
+    { EFI_VOLUME_CORRUPTED,     L"Volume Corrupt" },
+    { EFI_VOLUME_FULL,          L"Volume Full" },
+    { EFI_NO_MEDIA,             L"No Media" },
+    { EFI_MEDIA_CHANGED,        L"Media changed" },
+    { EFI_NOT_FOUND,            L"Not Found" },
+    { EFI_ACCESS_DENIED,        L"Access Denied" },
+    { EFI_TIMEOUT,              L"Time out" },
+    { EFI_NOT_STARTED,          L"Not started" },
+    { EFI_ALREADY_STARTED,      L"Already started" },
+    { EFI_ABORTED,              L"Aborted" },
+    { EFI_CRC_ERROR,            L"CRC Error" }
+};
+
+VOID StatusToString(OUT CHAR16 *Buffer, IN EFI_STATUS Status)
+{
+    UINTN i;
+
+    for (i = 0; i < sizeof(StatusText) / sizeof(StatusText[0]); i++) {
+        if (StatusText[i].Status == Status) {
+            StrCpy(Buffer, StatusText[i].Text);
+            return;
+        }
+    }
+    SPrint(Buffer, 0, L"%X", Status);
+}
+
+//
+// formatted output
+//
+
+// output of the formatter, grown as needed
+typedef struct {
+    CHAR16      *Buffer;
+    UINTN       Length;
+    UINTN       Size;       // in characters
+} FORMAT_OUTPUT;
+
+static VOID FormatPutChar(IN OUT FORMAT_OUTPUT *Out, IN CHAR16 c)
+{
+    if (Out->Length + 1 >= Out->Size) {
+        Out->Size = (Out->Size == 0) ? 128 : Out->Size * 2;
+        Out->Buffer = ReallocatePool(Out->Buffer, Out->Length * sizeof(CHAR16), Out->Size * sizeof(CHAR16));
+    }
+    Out->Buffer[Out->Length++] = c;
+    Out->Buffer[Out->Length] = 0;
+}
+
+// Puts Length characters of Text (CHAR16 if Wide, else CHAR8), padded to Width.
+static VOID FormatPutField(IN OUT FORMAT_OUTPUT *Out, IN CONST VOID *Text, IN UINTN Length, IN BOOLEAN Wide,
+                           IN UINTN Width, IN BOOLEAN LeftJustify, IN CHAR16 Pad)
+{
+    UINTN i;
+
+    if (!LeftJustify) {
+        for (i = Length; i < Width; i++)
+            FormatPutChar(Out, Pad);
+    }
+    for (i = 0; i < Length; i++)
+        FormatPutChar(Out, Wide ? ((CONST CHAR16 *) Text)[i] : (CHAR16) (UINT8) ((CONST CHAR8 *) Text)[i]);
+    if (LeftJustify) {
+        for (i = Length; i < Width; i++)
+            FormatPutChar(Out, L' ');
+    }
+}
+
+static VOID FormatNumber(IN OUT FORMAT_OUTPUT *Out, IN UINT64 Value, IN BOOLEAN Negative, IN UINTN Base,
+                         IN BOOLEAN Upper, IN UINTN Width, IN BOOLEAN LeftJustify, IN CHAR16 Pad)
+{
+    CHAR16 Digits[24];
+    CHAR16 Text[26];
+    UINTN  Count = 0, Length = 0;
+
+    do {
+        Digits[Count++] = (Upper ? L"0123456789ABCDEF" : L"0123456789abcdef")[Value % Base];
+        Value /= Base;
+    } while (Value != 0);
+
+    if (Negative) {
+        if (Pad == L'0') {
+            FormatPutChar(Out, L'-');
+            if (Width > 0)
+                Width--;
+        } else {
+            Text[Length++] = L'-';
+        }
+    }
+    while (Count > 0)
+        Text[Length++] = Digits[--Count];
+    FormatPutField(Out, Text, Length, TRUE, Width, LeftJustify, Pad);
+}
+
+// Formats as GNU-EFI's Print() does: %s is a CHAR16 string and %a a CHAR8
+// one, %d and %x take 32-bit values unless given as %ld and %lx, %r is an
+// EFI_STATUS, %g an EFI_GUID pointer and %t an EFI_TIME pointer. The
+// attribute changes (%N, %H, %E, %B, %V) are accepted and ignored.
+static VOID FormatString(IN OUT FORMAT_OUTPUT *Out, IN CONST CHAR16 *fmt, IN va_list args)
+{
+    CHAR16      Text[64], *String, Pad;
+    CHAR8       *AsciiString;
+    EFI_GUID    *Guid;
+    EFI_TIME    *Time;
+    BOOLEAN     LeftJustify, Long;
+    UINTN       Width, Precision, Length;
+    INT64       Signed;
+
+    for (; *fmt; fmt++) {
+        if (*fmt != L'%') {
+            FormatPutChar(Out, *fmt);
+            continue;
+        }
+
+        LeftJustify = FALSE;
+        Long = FALSE;
+        Pad = L' ';
+        Width = 0;
+        Precision = (UINTN) -1;
+        for (fmt++; ; fmt++) {
+            if (*fmt == L'-')
+                LeftJustify = TRUE;
+            else if (*fmt == L'0' && Width == 0)
+                Pad = L'0';
+            else if (*fmt == L',')
+                ;
+            else
+                break;
+        }
+        if (*fmt == L'*') {
+            Width = va_arg(args, UINTN);
+            fmt++;
+        } else {
+            while (*fmt >= L'0' && *fmt <= L'9')
+                Width = Width * 10 + (*fmt++ - L'0');
+        }
+        if (*fmt == L'.') {
+            Precision = 0;
+            for (fmt++; *fmt >= L'0' && *fmt <= L'9'; fmt++)
+                Precision = Precision * 10 + (*fmt - L'0');
+        }
+        if (*fmt == L'l') {
+            Long = TRUE;
+            fmt++;
+        }
+
+        switch (*fmt) {
+            case L's':
+                String = va_arg(args, CHAR16 *);
+                if (String == NULL)
+                    String = L"(null)";
+                Length = StrLen(String);
+                if (Length > Precision)
+                    Length = Precision;
+                FormatPutField(Out, String, Length, TRUE, Width, LeftJustify, L' ');
+                break;
+            case L'a':
+                AsciiString = va_arg(args, CHAR8 *);
+                if (AsciiString == NULL)
+                    AsciiString = "(null)";
+                Length = strlen(AsciiString);
+                if (Length > Precision)
+                    Length = Precision;
+                FormatPutField(Out, AsciiString, Length, FALSE, Width, LeftJustify, L' ');
+                break;
+            case L'c':
+                Text[0] = (CHAR16) va_arg(args, UINTN);
+                FormatPutField(Out, Text, 1, TRUE, Width, LeftJustify, L' ');
+                break;
+            case L'd':
+                Signed = Long ? va_arg(args, INT64) : (INT64) va_arg(args, INT32);
+                FormatNumber(Out, (Signed < 0) ? (UINT64) -Signed : (UINT64) Signed, Signed < 0, 10,
+                             FALSE, Width, LeftJustify, Pad);
+                break;
+            case L'u':
+                FormatNumber(Out, Long ? va_arg(args, UINT64) : va_arg(args, UINT32), FALSE, 10,
+                             FALSE, Width, LeftJustify, Pad);
+                break;
+            case L'x':
+            case L'X':
+                FormatNumber(Out, Long ? va_arg(args, UINT64) : va_arg(args, UINT32), FALSE, 16,
+                             *fmt == L'X', Width, LeftJustify, Pad);
+                break;
+            case L'p':
+                FormatNumber(Out, (UINTN) va_arg(args, VOID *), FALSE, 16, TRUE, Width, LeftJustify, Pad);
+                break;
+            case L'r':
+                StatusToString(Text, va_arg(args, EFI_STATUS));
+                FormatPutField(Out, Text, StrLen(Text), TRUE, Width, LeftJustify, L' ');
+                break;
+            case L'g':
+                Guid = va_arg(args, EFI_GUID *);
+                SPrint(Text, sizeof(Text), L"%08x-%04x-%04x-%02x%02x-%02x%02x%02x%02x%02x%02x",
+                       Guid->Data1, Guid->Data2, Guid->Data3, Guid->Data4[0], Guid->Data4[1],
+                       Guid->Data4[2], Guid->Data4[3], Guid->Data4[4], Guid->Data4[5],
+                       Guid->Data4[6], Guid->Data4[7]);
+                FormatPutField(Out, Text, StrLen(Text), TRUE, Width, LeftJustify, L' ');
+                break;
+            case L't':
+                Time = va_arg(args, EFI_TIME *);
+                SPrint(Text, sizeof(Text), L"%02d/%02d/%04d  %02d:%02d",
+                       Time->Month, Time->Day, Time->Year, Time->Hour, Time->Minute);
+                FormatPutField(Out, Text, StrLen(Text), TRUE, Width, LeftJustify, L' ');
+                break;
+            case L'N': case L'H': case L'E': case L'B': case L'V':
+                break;
+            case 0:
+                return;
+            default:
+                FormatPutChar(Out, *fmt);
+                break;
+        }
+    }
+}
+
+static CHAR16 * FormatToPool(IN CONST CHAR16 *fmt, IN va_list args)
+{
+    FORMAT_OUTPUT Out = { NULL, 0, 0 };
+
+    FormatString(&Out, fmt, args);
+    if (Out.Buffer == NULL)
+        Out.Buffer = AllocateZeroPool(sizeof(CHAR16));
+    return Out.Buffer;
+}
+
+// As in GNU-EFI, StrSize is the size of Str in bytes; 0 means unlimited.
+UINTN SPrint(OUT CHAR16 *Str, IN UINTN StrSize, IN CONST CHAR16 *fmt, ...)
+{
+    va_list args;
+    CHAR16  *Text;
+    UINTN   Length;
+
+    va_start(args, fmt);
+    Text = FormatToPool(fmt, args);
+    va_end(args);
+
+    Length = StrLen(Text);
+    if (StrSize != 0 && Length > StrSize / sizeof(CHAR16) - 1)
+        Length = StrSize / sizeof(CHAR16) - 1;
+    CopyMem(Str, Text, Length * sizeof(CHAR16));
+    Str[Length] = 0;
+    FreePool(Text);
+    return Length;
+}
+
+CHAR16 * PoolPrint(IN CONST CHAR16 *fmt, ...)
+{
+    va_list args;
+    CHAR16  *Text;
+
+    va_start(args, fmt);
+    Text = FormatToPool(fmt, args);
+    va_end(args);
+    return Text;
+}
+
+UINTN Print(IN CONST CHAR16 *fmt, ...)
+{
+    va_list args;
+    CHAR16  *Text;
+    UINTN   Length;
+
+    va_start(args, fmt);
+    Text = FormatToPool(fmt, args);
+    va_end(args);
+
+    Length = StrLen(Text);
+    if (ST != NULL && ST->ConOut != NULL)
+        uefi_call_wrapper(ST->ConOut->OutputString, 2, ST->ConOut, Text);
+    FreePool(Text);
+    return Length;
+}
+
+VOID DumpHex(IN UINTN Indent, IN UINTN Offset, IN UINTN DataSize, IN VOID *UserData)
+{
+    UINT8 *Data = UserData;
+    UINTN i, j;
+
+    for (i = 0; i < DataSize; i += 16) {
+        Print(L"%*a%08x:", Indent, "", Offset + i);
+        for (j = i; j < i + 16 && j < DataSize; j++)
+            Print(L" %02x", Data[j]);
+        Print(L"\n");
+    }
+}
+
+//
+// device paths
+//
+
+EFI_DEVICE_PATH * DevicePathFromHandle(IN EFI_HANDLE Handle)
+{
+    EFI_DEVICE_PATH *DevicePath;
+    EFI_STATUS      Status;
+
+    Status = uefi_call_wrapper(BS->HandleProtocol, 3, Handle, &DevicePathProtocol, (VOID **) &DevicePath);
+    return EFI_ERROR(Status) ? NULL : DevicePath;
+}
+
+UINTN DevicePathSize(IN EFI_DEVICE_PATH *DevPath)
+{
+    EFI_DEVICE_PATH *Start = DevPath;
+
+    while (!IsDevicePathEnd(DevPath))
+        DevPath = NextDevicePathNode(DevPath);
+    return ((UINT8 *) DevPath - (UINT8 *) Start) + sizeof(EFI_DEVICE_PATH);
+}
+
+EFI_DEVICE_PATH * DuplicateDevicePath(IN EFI_DEVICE_PATH *DevPath)
+{
+    EFI_DEVICE_PATH *NewDevPath;
+    UINTN           Size;
+
+    if (DevPath == NULL)
+        return NULL;
+    Size = DevicePathSize(DevPath);
+    NewDevPath = AllocatePool(Size);
+    if (NewDevPath != NULL)
+        CopyMem(NewDevPath, DevPath, Size);
+    return NewDevPath;
+}
+
+EFI_DEVICE_PATH * AppendDevicePath(IN EFI_DEVICE_PATH *Src1, IN EFI_DEVICE_PATH *Src2)
+{
+    EFI_DEVICE_PATH *NewDevPath;
+    UINTN           Size1, Size2;
+
+    if (Src1 == NULL)
+        return DuplicateDevicePath(Src2 != NULL ? Src2 : EndDevicePath);
+    if (Src2 == NULL)
+        return DuplicateDevicePath(Src1);
+    Size1 = DevicePathSize(Src1) - sizeof(EFI_DEVICE_PATH);
+    Size2 = DevicePathSize(Src2);
+    NewDevPath = AllocatePool(Size1 + Size2);
+    if (NewDevPath != NULL) {
+        CopyMem(NewDevPath, Src1, Size1);
+        CopyMem((UINT8 *) NewDevPath + Size1, Src2, Size2);
+    }
+    return NewDevPath;
+}
+
+EFI_DEVICE_PATH * FileDevicePath(IN EFI_HANDLE Device OPTIONAL, IN CHAR16 *FileName)
+{
+    FILEPATH_DEVICE_PATH    *FilePath;
+    EFI_DEVICE_PATH         *DevicePath, *End;
+    UINTN                   Size;
+
+    Size = SIZE_OF_FILEPATH_DEVICE_PATH + StrSize(FileName);
+    FilePath = AllocateZeroPool(Size + sizeof(EFI_DEVICE_PATH));
+    if (FilePath == NULL)
+        return NULL;
+    FilePath->Header.Type = MEDIA_DEVICE_PATH;
+    FilePath->Header.SubType = MEDIA_FILEPATH_DP;
+    SetDevicePathNodeLength(&FilePath->Header, Size);
+    CopyMem(FilePath->PathName, FileName, StrSize(FileName));
+    End = NextDevicePathNode(&FilePath->Header);
+    SetDevicePathEndNode(End);
+
+    if (Device == NULL)
+        return (EFI_DEVICE_PATH *) FilePath;
+    DevicePath = AppendDevicePath(DevicePathFromHandle(Device), (EFI_DEVICE_PATH *) FilePath);
+    FreePool(FilePath);
+    return DevicePath;
+}
+
+CHAR16 * DevicePathToStr(IN EFI_DEVICE_PATH *DevPath)
+{
+    CHAR16                  *Text = NULL, *Node;
+    HARDDRIVE_DEVICE_PATH   *Hd;
+    UINT8                   *Data;
+
+    for (; !IsDevicePathEnd(DevPath); DevPath = NextDevicePathNode(DevPath)) {
+        Data = (UINT8 *) DevPath + sizeof(EFI_DEVICE_PATH);
+        switch (DevicePathType(DevPath) << 8 | DevicePathSubType(DevPath)) {
+            case HARDWARE_DEVICE_PATH << 8 | HW_PCI_DP:
+                Node = PoolPrint(L"Pci(%x|%x)", Data[1], Data[0]);
+                break;
+            case MESSAGING_DEVICE_PATH << 8 | MSG_SATA_DP:
+                Node = PoolPrint(L"Sata(%x,%x,%x)", ((SATA_DEVICE_PATH *) DevPath)->HBAPortNumber,
+                                 ((SATA_DEVICE_PATH *) DevPath)->PortMultiplierPortNumber,
+                                 ((SATA_DEVICE_PATH *) DevPath)->Lun);
+                break;
+            case MESSAGING_DEVICE_PATH << 8 | MSG_USB_DP:
+                Node = PoolPrint(L"Usb(%x,%x)", Data[0], Data[1]);
+                break;
+            case MEDIA_DEVICE_PATH << 8 | MEDIA_HARDDRIVE_DP:
+                Hd = (HARDDRIVE_DEVICE_PATH *) DevPath;
+                if (Hd->SignatureType == SIGNATURE_TYPE_GUID)
+                    Node = PoolPrint(L"HD(Part%d,Sig%g)", Hd->PartitionNumber, (EFI_GUID *) Hd->Signature);
+                else
+                    Node = PoolPrint(L"HD(Part%d,Sig%08x)", Hd->PartitionNumber, *(UINT32 *) Hd->Signature);
+                break;
+            case MEDIA_DEVICE_PATH << 8 | MEDIA_FILEPATH_DP:
+                Node = StrDuplicate(((FILEPATH_DEVICE_PATH *) DevPath)->PathName);
+                break;
+            default:
+                Node = PoolPrint(L"?(%d,%d)", DevicePathType(DevPath), DevicePathSubType(DevPath));
+                break;
+        }
+        if (Text == NULL) {
+            Text = Node;
+        } else {
+            Text = ReallocatePool(Text, StrSize(Text), StrSize(Text) + StrSize(Node));
+            StrCat(Text, L"/");
+            StrCat(Text, Node);
+            FreePool(Node);
+        }
+    }
+    return (Text != NULL) ? Text : StrDuplicate(L"");
+}
+
+//
+// protocols and files
+//
+
+EFI_STATUS LibLocateHandle(IN EFI_LOCATE_SEARCH_TYPE SearchType, IN EFI_GUID *Protocol OPTIONAL,
+                           IN VOID *SearchKey OPTIONAL, IN OUT UINTN *NoHandles, OUT EFI_HANDLE **Buffer)
+{
+    EFI_STATUS  Status;
+    UINTN       BufferSize = 16 * sizeof(EFI_HANDLE);
+
+    *NoHandles = 0;
+    for (;;) {
+        *Buffer = AllocatePool(BufferSize);
+        if (*Buffer == NULL)
+            return EFI_OUT_OF_RESOURCES;
+        Status = uefi_call_wrapper(BS->LocateHandle, 5, SearchType, Protocol, SearchKey, &BufferSize, *Buffer);
+        if (Status != EFI_BUFFER_TOO_SMALL)
+            break;
+        FreePool(*Buffer);
+    }
+    if (EFI_ERROR(Status)) {
+        FreePool(*Buffer);
+        *Buffer = NULL;
+        return Status;
+    }
+    *NoHandles = BufferSize / sizeof(EFI_HANDLE);
+    return Status;
+}
+
+EFI_STATUS LibLocateProtocol(IN EFI_GUID *ProtocolGuid, OUT VOID **Interface)
+{
+    EFI_STATUS  Status;
+    EFI_HANDLE  *Handles;
+    UINTN       HandleCount, i;
+
+    *Interface = NULL;
+    Status = LibLocateHandle(ByProtocol, ProtocolGuid, NULL, &HandleCount, &Handles);
+    if (EFI_ERROR(Status))
+        return Status;
+    Status = EFI_NOT_FOUND;
+    for (i = 0; i < HandleCount && EFI_ERROR(Status); i++)
+        Status = uefi_call_wrapper(BS->HandleProtocol, 3, Handles[i], ProtocolGuid, Interface);
+    FreePool(Handles);
+    return Status;
+}
+
+EFI_FILE_HANDLE LibOpenRoot(IN EFI_HANDLE DeviceHandle)
+{
+    EFI_FILE_IO_INTERFACE   *Volume;
+    EFI_FILE_HANDLE         Root;
+    EFI_STATUS              Status;
+
+    Status = uefi_call_wrapper(BS->HandleProtocol, 3, DeviceHandle, &FileSystemProtocol, (VOID **) &Volume);
+    if (!EFI_ERROR(Status))
+        Status = uefi_call_wrapper(Volume->OpenVolume, 2, Volume, &Root);
+    return EFI_ERROR(Status) ? NULL : Root;
+}
+
+// Gets information of type InfoType into a buffer of the size it needs.
+static VOID * GetFileInfoOfType(IN EFI_FILE_HANDLE FHand, IN EFI_GUID *InfoType, IN UINTN InitialSize)
+{
+    EFI_STATUS  Status;
+    VOID        *Buffer;
+    UINTN       BufferSize = InitialSize;
+
+    for (;;) {
+        Buffer = AllocatePool(BufferSize);
+        if (Buffer == NULL)
+            return NULL;
+        Status = uefi_call_wrapper(FHand->GetInfo, 4, FHand, InfoType, &BufferSize, Buffer);
+        if (Status == EFI_SUCCESS)
+            return Buffer;
+        FreePool(Buffer);
+        if (Status != EFI_BUFFER_TOO_SMALL)
+            return NULL;
+    }
+}
+
+EFI_FILE_INFO * LibFileInfo(IN EFI_FILE_HANDLE FHand)
+{
+    return GetFileInfoOfType(FHand, &GenericFileInfo, SIZE_OF_EFI_FILE_INFO + 200);
+}
+
+EFI_FILE_SYSTEM_INFO * LibFileSystemInfo(IN EFI_FILE_HANDLE FHand)
+{
+    return GetFileInfoOfType(FHand, &FileSystemInfo, SIZE_OF_EFI_FILE_SYSTEM_INFO + 200);
+}
+
+/* EOF */
@@ -0,0 +1,18 @@
+/*
+ * hostbench/hostbench.h
+ * Entry points into rEFInd for the host benchmarks
+ */
+
+#ifndef __HOSTBENCH_HOSTBENCH_H__
+#define __HOSTBENCH_HOSTBENCH_H__
+
+#include "efi.h"
+
+EFI_STATUS HostBenchStartup(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable);
+UINTN HostBenchScanForBootloaders(IN BOOLEAN ReuseCache);
+UINTN HostBenchScanEfiFiles(VOID);
+UINTN HostBenchRunMainMenu(VOID);
+
+#endif /* __HOSTBENCH_HOSTBENCH_H__ */
+
+/* EOF */
@@ -0,0 +1,1436 @@
+/*
+ * hostbench/mockefi.c
+ * Mock firmware for running rEFInd as a host program
+ *
+ * Everything here is single-threaded and kept deliberately simple; where
+ * behaviour matters to rEFInd (device path matching in LocateDevicePath(),
+ * EFI_BUFFER_TOO_SMALL from directory reads, FAT's case-insensitive names
+ * and its "." and ".." entries) it follows what real firmware does.
+ */
+
+#define _GNU_SOURCE
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "efi.h"
+#include "efilib.h"
+#include "mockefi.h"
+
+#define MOCK_MAX_HANDLES        (256)
+#define MOCK_MAX_PROTOCOLS      (8)
+#define MOCK_KEY_QUEUE_SIZE     (256)
+
+static EFI_GUID GraphicsOutputGuid = EFI_GRAPHICS_OUTPUT_PROTOCOL_GUID;
+static EFI_GUID EspTypeGuid = { 0xc12a7328, 0xf81f, 0x11d2, { 0xba, 0x4b, 0x00, 0xa0, 0xc9, 0x3e, 0xc9, 0x3b } };
+
+static EFI_SYSTEM_TABLE     MockSystemTable;
+static EFI_BOOT_SERVICES    MockBootServices;
+static EFI_RUNTIME_SERVICES MockRuntimeServices;
+static MOCK_STATS           Stats;
+
+//
+// handle database
+//
+
+typedef struct {
+    EFI_GUID        Guid;
+    VOID            *Interface;
+} MOCK_PROTOCOL;
+
+typedef struct {
+    UINTN           ProtocolCount;
+    MOCK_PROTOCOL   Protocols[MOCK_MAX_PROTOCOLS];
+} MOCK_HANDLE;
+
+static MOCK_HANDLE  *HandleList[MOCK_MAX_HANDLES];
+static UINTN        HandleCount = 0;
+
+static EFI_HANDLE NewHandle(VOID)
+{
+    MOCK_HANDLE *Handle;
+
+    if (HandleCount >= MOCK_MAX_HANDLES) {
+        fprintf(stderr, "mockefi: out of handles\n");
+        exit(1);
+    }
+    Handle = AllocateZeroPool(sizeof(MOCK_HANDLE));
+    HandleList[HandleCount++] = Handle;
+    return (EFI_HANDLE) Handle;
+}
+
+static VOID InstallProtocol(IN EFI_HANDLE Handle, IN EFI_GUID *Guid, IN VOID *Interface)
+{
+    MOCK_HANDLE *MockHandle = (MOCK_HANDLE *) Handle;
+
+    if (MockHandle->ProtocolCount >= MOCK_MAX_PROTOCOLS) {
+        fprintf(stderr, "mockefi: too many protocols on one handle\n");
+        exit(1);
+    }
+    MockHandle->Protocols[MockHandle->ProtocolCount].Guid = *Guid;
+    MockHandle->Protocols[MockHandle->ProtocolCount].Interface = Interface;
+    MockHandle->ProtocolCount++;
+}
+
+static MOCK_PROTOCOL * FindProtocol(IN EFI_HANDLE Handle, IN EFI_GUID *Guid)
+{
+    MOCK_HANDLE *MockHandle = (MOCK_HANDLE *) Handle;
+    UINTN       i;
+
+    for (i = 0; i < HandleCount; i++) {
+        if (HandleList[i] == MockHandle)
+            break;
+    }
+    if (i == HandleCount)
+        return NULL;
+    for (i = 0; i < MockHandle->ProtocolCount; i++) {
+        if (CompareGuid(&MockHandle->Protocols[i].Guid, Guid) == 0)
+            return &MockHandle->Protocols[i];
+    }
+    return NULL;
+}
+
+static EFI_STATUS EFIAPI MockHandleProtocol(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol, OUT VOID **Interface)
+{
+    MOCK_PROTOCOL *Found;
+
+    if (Handle == NULL || Protocol == NULL || Interface == NULL)
+        return EFI_INVALID_PARAMETER;
+    Found = FindProtocol(Handle, Protocol);
+    if (Found == NULL)
+        return EFI_UNSUPPORTED;
+    *Interface = Found->Interface;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockLocateHandle(IN EFI_LOCATE_SEARCH_TYPE SearchType, IN EFI_GUID *Protocol OPTIONAL,
+                                          IN VOID *SearchKey OPTIONAL, IN OUT UINTN *BufferSize,
+                                          OUT EFI_HANDLE *Buffer)
+{
+    UINTN i, Count = 0;
+
+    if (SearchType != AllHandles && (SearchType != ByProtocol || Protocol == NULL))
+        return EFI_INVALID_PARAMETER;
+    for (i = 0; i < HandleCount; i++) {
+        if (SearchType == ByProtocol && FindProtocol(HandleList[i], Protocol) == NULL)
+            continue;
+        if ((Count + 1) * sizeof(EFI_HANDLE) <= *BufferSize)
+            Buffer[Count] = HandleList[i];
+        Count++;
+    }
+    if (Count == 0)
+        return EFI_NOT_FOUND;
+    if (Count * sizeof(EFI_HANDLE) > *BufferSize) {
+        *BufferSize = Count * sizeof(EFI_HANDLE);
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    *BufferSize = Count * sizeof(EFI_HANDLE);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockLocateHandleBuffer(IN EFI_LOCATE_SEARCH_TYPE SearchType, IN EFI_GUID *Protocol OPTIONAL,
+                                                IN VOID *SearchKey OPTIONAL, IN OUT UINTN *NoHandles,
+                                                OUT EFI_HANDLE **Buffer)
+{
+    EFI_STATUS  Status;
+    UINTN       BufferSize = HandleCount * sizeof(EFI_HANDLE);
+
+    *NoHandles = 0;
+    *Buffer = AllocatePool(BufferSize);
+    Status = MockLocateHandle(SearchType, Protocol, SearchKey, &BufferSize, *Buffer);
+    if (EFI_ERROR(Status)) {
+        FreePool(*Buffer);
+        *Buffer = NULL;
+        return Status;
+    }
+    *NoHandles = BufferSize / sizeof(EFI_HANDLE);
+    return EFI_SUCCESS;
+}
+
+// Finds the handle with Protocol whose device path is the longest leading
+// part of *DevicePath, and moves *DevicePath past that part.
+static EFI_STATUS EFIAPI MockLocateDevicePath(IN EFI_GUID *Protocol, IN OUT EFI_DEVICE_PATH **DevicePath,
+                                              OUT EFI_HANDLE *Device)
+{
+    EFI_DEVICE_PATH *HandlePath, *Node;
+    UINTN           i, Size, BestSize = 0, PathSize;
+    EFI_HANDLE      Best = NULL;
+
+    if (Protocol == NULL || DevicePath == NULL || *DevicePath == NULL)
+        return EFI_INVALID_PARAMETER;
+    PathSize = DevicePathSize(*DevicePath) - sizeof(EFI_DEVICE_PATH);
+    for (i = 0; i < HandleCount; i++) {
+        if (FindProtocol(HandleList[i], Protocol) == NULL)
+            continue;
+        HandlePath = DevicePathFromHandle(HandleList[i]);
+        if (HandlePath == NULL)
+            continue;
+        Size = DevicePathSize(HandlePath) - sizeof(EFI_DEVICE_PATH);
+        if (Size > PathSize || Size < BestSize || CompareMem(HandlePath, *DevicePath, Size) != 0)
+            continue;
+        // the match has to end on a node boundary
+        if (Size < PathSize && Size > 0) {
+            Node = *DevicePath;
+            while ((UINT8 *) Node < (UINT8 *) *DevicePath + Size)
+                Node = NextDevicePathNode(Node);
+            if ((UINT8 *) Node != (UINT8 *) *DevicePath + Size)
+                continue;
+        }
+        Best = HandleList[i];
+        BestSize = Size;
+    }
+    if (Best == NULL)
+        return EFI_NOT_FOUND;
+    *Device = Best;
+    *DevicePath = (EFI_DEVICE_PATH *) ((UINT8 *) *DevicePath + BestSize);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockLocateProtocol(IN EFI_GUID *Protocol, IN VOID *Registration OPTIONAL,
+                                            OUT VOID **Interface)
+{
+    MOCK_PROTOCOL   *Found;
+    UINTN           i;
+
+    for (i = 0; i < HandleCount; i++) {
+        Found = FindProtocol(HandleList[i], Protocol);
+        if (Found != NULL) {
+            *Interface = Found->Interface;
+            return EFI_SUCCESS;
+        }
+    }
+    return EFI_NOT_FOUND;
+}
+
+static EFI_STATUS EFIAPI MockProtocolsPerHandle(IN EFI_HANDLE Handle, OUT EFI_GUID ***ProtocolBuffer,
+                                                OUT UINTN *ProtocolBufferCount)
+{
+    MOCK_HANDLE *MockHandle = (MOCK_HANDLE *) Handle;
+    UINTN       i;
+
+    *ProtocolBuffer = AllocatePool(MockHandle->ProtocolCount * sizeof(EFI_GUID *));
+    for (i = 0; i < MockHandle->ProtocolCount; i++)
+        (*ProtocolBuffer)[i] = &MockHandle->Protocols[i].Guid;
+    *ProtocolBufferCount = MockHandle->ProtocolCount;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockOpenProtocolInformation(IN EFI_HANDLE Handle, IN EFI_GUID *Protocol,
+                                                     OUT EFI_OPEN_PROTOCOL_INFORMATION_ENTRY **EntryBuffer,
+                                                     OUT UINTN *EntryCount)
+{
+    // nothing has any protocol open
+    *EntryBuffer = AllocatePool(sizeof(EFI_OPEN_PROTOCOL_INFORMATION_ENTRY));
+    *EntryCount = 0;
+    return (FindProtocol(Handle, Protocol) != NULL) ? EFI_SUCCESS : EFI_NOT_FOUND;
+}
+
+static EFI_STATUS EFIAPI MockConnectController(IN EFI_HANDLE ControllerHandle, IN EFI_HANDLE *DriverImageHandle OPTIONAL,
+                                               IN EFI_DEVICE_PATH *RemainingDevicePath OPTIONAL, IN BOOLEAN Recursive)
+{
+    return EFI_NOT_FOUND;     // there are no drivers
+}
+
+//
+// memory and miscellaneous boot services
+//
+
+static EFI_STATUS EFIAPI MockAllocatePool(IN EFI_MEMORY_TYPE PoolType, IN UINTN Size, OUT VOID **Buffer)
+{
+    *Buffer = AllocatePool(Size);
+    return (*Buffer != NULL) ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+static EFI_STATUS EFIAPI MockFreePool(IN VOID *Buffer)
+{
+    FreePool(Buffer);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockStall(IN UINTN Microseconds)
+{
+    struct timespec Delay;
+
+    Delay.tv_sec = Microseconds / 1000000;
+    Delay.tv_nsec = (Microseconds % 1000000) * 1000;
+    nanosleep(&Delay, NULL);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockSetWatchdogTimer(IN UINTN Timeout, IN UINT64 WatchdogCode, IN UINTN DataSize,
+                                              IN CHAR16 *WatchdogData OPTIONAL)
+{
+    return EFI_SUCCESS;
+}
+
+static UINT32 Crc32Table[256];
+
+static EFI_STATUS EFIAPI MockCalculateCrc32(IN VOID *Data, IN UINTN DataSize, OUT UINT32 *Crc32)
+{
+    UINT8   *Bytes = Data;
+    UINT32  Crc, c;
+    UINTN   i, j;
+
+    if (Crc32Table[1] == 0) {
+        for (i = 0; i < 256; i++) {
+            c = (UINT32) i;
+            for (j = 0; j < 8; j++)
+                c = (c & 1) ? (c >> 1) ^ 0xedb88320 : (c >> 1);
+            Crc32Table[i] = c;
+        }
+    }
+    Crc = 0xffffffff;
+    for (i = 0; i < DataSize; i++)
+        Crc = Crc32Table[(Crc ^ Bytes[i]) & 0xff] ^ (Crc >> 8);
+    *Crc32 = Crc ^ 0xffffffff;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockLoadImage(IN BOOLEAN BootPolicy, IN EFI_HANDLE ParentImageHandle,
+                                       IN EFI_DEVICE_PATH *FilePath, IN VOID *SourceBuffer OPTIONAL,
+                                       IN UINTN SourceSize, OUT EFI_HANDLE *ImageHandle)
+{
+    return EFI_UNSUPPORTED;   // nothing can be started on the host
+}
+
+static EFI_STATUS EFIAPI MockStartImage(IN EFI_HANDLE ImageHandle, OUT UINTN *ExitDataSize, OUT CHAR16 **ExitData OPTIONAL)
+{
+    return EFI_UNSUPPORTED;
+}
+
+static EFI_STATUS EFIAPI MockExit(IN EFI_HANDLE ImageHandle, IN EFI_STATUS ExitStatus, IN UINTN ExitDataSize,
+                                  IN CHAR16 *ExitData OPTIONAL)
+{
+    exit(EFI_ERROR(ExitStatus) ? 1 : 0);
+}
+
+static EFI_STATUS EFIAPI MockUnloadImage(IN EFI_HANDLE ImageHandle)
+{
+    return EFI_UNSUPPORTED;
+}
+
+//
+// events and timers
+//
+
+typedef struct {
+    BOOLEAN     IsKeyEvent;
+    UINT64      Period;     // in ns; 0 for a one-shot timer
+    UINT64      DueTime;    // in ns on the monotonic clock; 0 if not set
+    BOOLEAN     Signaled;
+} MOCK_EVENT;
+
+static MOCK_EVENT       KeyEvent = { TRUE, 0, 0, FALSE };
+static EFI_INPUT_KEY    KeyQueue[MOCK_KEY_QUEUE_SIZE];
+static UINTN            KeyQueueStart = 0, KeyQueueCount = 0;
+
+static UINT64 NowNs(VOID)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_MONOTONIC, &Now);
+    return (UINT64) Now.tv_sec * 1000000000ULL + Now.tv_nsec;
+}
+
+// Returns TRUE, and resets the event, if it's signaled.
+static BOOLEAN TakeEvent(IN MOCK_EVENT *Event)
+{
+    UINT64 Now;
+
+    if (Event->IsKeyEvent)
+        return (KeyQueueCount > 0);
+    Now = NowNs();
+    if (Event->DueTime != 0 && Now >= Event->DueTime) {
+        Event->Signaled = TRUE;
+        if (Event->Period != 0) {
+            while (Event->DueTime <= Now)
+                Event->DueTime += Event->Period;
+        } else {
+            Event->DueTime = 0;
+        }
+    }
+    if (Event->Signaled) {
+        Event->Signaled = FALSE;
+        return TRUE;
+    }
+    return FALSE;
+}
+
+static EFI_STATUS EFIAPI MockCreateEvent(IN UINT32 Type, IN EFI_TPL NotifyTpl, IN EFI_EVENT_NOTIFY NotifyFunction,
+                                         IN VOID *NotifyContext, OUT EFI_EVENT *Event)
+{
+    *Event = AllocateZeroPool(sizeof(MOCK_EVENT));
+    return (*Event != NULL) ? EFI_SUCCESS : EFI_OUT_OF_RESOURCES;
+}
+
+static EFI_STATUS EFIAPI MockSetTimer(IN EFI_EVENT Event, IN EFI_TIMER_DELAY Type, IN UINT64 TriggerTime)
+{
+    MOCK_EVENT *MockEvent = Event;
+
+    switch (Type) {
+        case TimerCancel:
+            MockEvent->DueTime = 0;
+            break;
+        case TimerPeriodic:
+            MockEvent->Period = (TriggerTime != 0) ? TriggerTime * 100 : 1;
+            MockEvent->DueTime = NowNs() + MockEvent->Period;
+            break;
+        case TimerRelative:
+            MockEvent->Period = 0;
+            MockEvent->DueTime = NowNs() + TriggerTime * 100;
+            break;
+        default:
+            return EFI_INVALID_PARAMETER;
+    }
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockWaitForEvent(IN UINTN NumberOfEvents, IN EFI_EVENT *Event, OUT UINTN *Index)
+{
+    MOCK_EVENT  *MockEvent;
+    UINT64      Next, Now;
+    UINTN       i;
+
+    for (;;) {
+        Next = 0;
+        for (i = 0; i < NumberOfEvents; i++) {
+            MockEvent = Event[i];
+            if (TakeEvent(MockEvent)) {
+                *Index = i;
+                return EFI_SUCCESS;
+            }
+            if (MockEvent->DueTime != 0 && (Next == 0 || MockEvent->DueTime < Next))
+                Next = MockEvent->DueTime;
+        }
+
+        // the script has run out of keys, so Escape out of whatever is waiting
+        for (i = 0; i < NumberOfEvents; i++) {
+            if (((MOCK_EVENT *) Event[i])->IsKeyEvent) {
+                MockPushKey(SCAN_ESC, 0);
+                *Index = i;
+                return EFI_SUCCESS;
+            }
+        }
+
+        if (Next == 0)
+            return EFI_UNSUPPORTED;   // would wait forever
+        Now = NowNs();
+        if (Next > Now)
+            MockStall((Next - Now + 999) / 1000);
+    }
+}
+
+static EFI_STATUS EFIAPI MockSignalEvent(IN EFI_EVENT Event)
+{
+    ((MOCK_EVENT *) Event)->Signaled = TRUE;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockCloseEvent(IN EFI_EVENT Event)
+{
+    if (Event != &KeyEvent)
+        FreePool(Event);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockCheckEvent(IN EFI_EVENT Event)
+{
+    return TakeEvent(Event) ? EFI_SUCCESS : EFI_NOT_READY;
+}
+
+//
+// runtime services
+//
+
+static VOID TimeFromHost(IN time_t Seconds, IN long Nanoseconds, OUT EFI_TIME *Time)
+{
+    struct tm Tm;
+
+    gmtime_r(&Seconds, &Tm);
+    ZeroMem(Time, sizeof(EFI_TIME));
+    Time->Year = Tm.tm_year + 1900;
+    Time->Month = Tm.tm_mon + 1;
+    Time->Day = Tm.tm_mday;
+    Time->Hour = Tm.tm_hour;
+    Time->Minute = Tm.tm_min;
+    Time->Second = Tm.tm_sec;
+    Time->Nanosecond = (UINT32) Nanoseconds;
+    Time->TimeZone = 0x07ff;    // EFI_UNSPECIFIED_TIMEZONE
+}
+
+static EFI_STATUS EFIAPI MockGetTime(OUT EFI_TIME *Time, OUT VOID *Capabilities OPTIONAL)
+{
+    struct timespec Now;
+
+    clock_gettime(CLOCK_REALTIME, &Now);
+    TimeFromHost(Now.tv_sec, Now.tv_nsec, Time);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockGetVariable(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid, OUT UINT32 *Attributes OPTIONAL,
+                                         IN OUT UINTN *DataSize, OUT VOID *Data)
+{
+    return EFI_NOT_FOUND;
+}
+
+static EFI_STATUS EFIAPI MockSetVariable(IN CHAR16 *VariableName, IN EFI_GUID *VendorGuid, IN UINT32 Attributes,
+                                         IN UINTN DataSize, IN VOID *Data)
+{
+    return EFI_SUCCESS;
+}
+
+static VOID EFIAPI MockResetSystem(IN EFI_RESET_TYPE ResetType, IN EFI_STATUS ResetStatus, IN UINTN DataSize,
+                                   IN CHAR16 *ResetData OPTIONAL)
+{
+    exit(0);
+}
+
+//
+// console
+//
+
+static BOOLEAN EchoConsole = FALSE;
+
+VOID MockPushKey(IN UINT16 ScanCode, IN CHAR16 UnicodeChar)
+{
+    if (KeyQueueCount >= MOCK_KEY_QUEUE_SIZE)
+        return;
+    KeyQueue[(KeyQueueStart + KeyQueueCount) % MOCK_KEY_QUEUE_SIZE].ScanCode = ScanCode;
+    KeyQueue[(KeyQueueStart + KeyQueueCount) % MOCK_KEY_QUEUE_SIZE].UnicodeChar = UnicodeChar;
+    KeyQueueCount++;
+}
+
+static EFI_STATUS EFIAPI MockInputReset(IN SIMPLE_INPUT_INTERFACE *This, IN BOOLEAN ExtendedVerification)
+{
+    KeyQueueCount = 0;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockReadKeyStroke(IN SIMPLE_INPUT_INTERFACE *This, OUT EFI_INPUT_KEY *Key)
+{
+    if (KeyQueueCount == 0)
+        return EFI_NOT_READY;
+    *Key = KeyQueue[KeyQueueStart];
+    KeyQueueStart = (KeyQueueStart + 1) % MOCK_KEY_QUEUE_SIZE;
+    KeyQueueCount--;
+    return EFI_SUCCESS;
+}
+
+static SIMPLE_INPUT_INTERFACE MockConIn = { MockInputReset, MockReadKeyStroke, &KeyEvent };
+
+static SIMPLE_TEXT_OUTPUT_MODE MockConOutMode = { 1, 0, EFI_LIGHTGRAY, 0, 0, FALSE };
+
+static EFI_STATUS EFIAPI MockTextReset(IN SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN BOOLEAN ExtendedVerification)
+{
+    return EFI_SUCCESS;
+}
+
+// Console output is thrown away unless HOSTBENCH_CONSOLE is set, in which
+// case it goes to stderr.
+static EFI_STATUS EFIAPI MockOutputString(IN SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN CHAR16 *String)
+{
+    if (EchoConsole) {
+        for (; *String; String++) {
+            if (*String != L'\r')
+                fputc((*String < 0x80) ? (int) *String : '?', stderr);
+        }
+    }
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockTestString(IN SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN CHAR16 *String)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockTextQueryMode(IN SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN UINTN ModeNumber,
+                                           OUT UINTN *Columns, OUT UINTN *Rows)
+{
+    if (ModeNumber != 0)
+        return EFI_UNSUPPORTED;
+    *Columns = 80;
+    *Rows = 25;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockTextSetMode(IN SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN UINTN ModeNumber)
+{
+    return (ModeNumber == 0) ? EFI_SUCCESS : EFI_UNSUPPORTED;
+}
+
+static EFI_STATUS EFIAPI MockSetAttribute(IN SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN UINTN Attribute)
+{
+    MockConOutMode.Attribute = (INT32) Attribute;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockClearScreen(IN SIMPLE_TEXT_OUTPUT_INTERFACE *This)
+{
+    MockConOutMode.CursorColumn = MockConOutMode.CursorRow = 0;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockSetCursorPosition(IN SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN UINTN Column, IN UINTN Row)
+{
+    MockConOutMode.CursorColumn = (INT32) Column;
+    MockConOutMode.CursorRow = (INT32) Row;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockEnableCursor(IN SIMPLE_TEXT_OUTPUT_INTERFACE *This, IN BOOLEAN Enable)
+{
+    MockConOutMode.CursorVisible = Enable;
+    return EFI_SUCCESS;
+}
+
+static SIMPLE_TEXT_OUTPUT_INTERFACE MockConOut = {
+    MockTextReset, MockOutputString, MockTestString, MockTextQueryMode, MockTextSetMode,
+    MockSetAttribute, MockClearScreen, MockSetCursorPosition, MockEnableCursor, &MockConOutMode
+};
+
+//
+// graphics output
+//
+
+#define GOP_MAX_MODES   (4)
+
+static EFI_GRAPHICS_OUTPUT_MODE_INFORMATION GopModeInfo[GOP_MAX_MODES];
+static EFI_GRAPHICS_OUTPUT_PROTOCOL_MODE    GopMode;
+static EFI_GRAPHICS_OUTPUT_BLT_PIXEL        *FrameBuffer = NULL;
+
+static EFI_STATUS EFIAPI MockGopQueryMode(IN EFI_GRAPHICS_OUTPUT_PROTOCOL *This, IN UINT32 ModeNumber,
+                                          OUT UINTN *SizeOfInfo, OUT EFI_GRAPHICS_OUTPUT_MODE_INFORMATION **Info)
+{
+    if (ModeNumber >= GopMode.MaxMode)
+        return EFI_INVALID_PARAMETER;
+    *SizeOfInfo = sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
+    *Info = &GopModeInfo[ModeNumber];
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockGopSetMode(IN EFI_GRAPHICS_OUTPUT_PROTOCOL *This, IN UINT32 ModeNumber)
+{
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info;
+
+    if (ModeNumber >= GopMode.MaxMode)
+        return EFI_UNSUPPORTED;
+    Info = &GopModeInfo[ModeNumber];
+    if (FrameBuffer != NULL)
+        FreePool(FrameBuffer);
+    GopMode.FrameBufferSize = (UINTN) Info->PixelsPerScanLine * Info->VerticalResolution *
+                              sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+    FrameBuffer = AllocateZeroPool(GopMode.FrameBufferSize);
+    GopMode.Mode = ModeNumber;
+    GopMode.Info = Info;
+    GopMode.SizeOfInfo = sizeof(EFI_GRAPHICS_OUTPUT_MODE_INFORMATION);
+    GopMode.FrameBufferBase = (UINTN) FrameBuffer;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockGopBlt(IN EFI_GRAPHICS_OUTPUT_PROTOCOL *This, IN OUT EFI_GRAPHICS_OUTPUT_BLT_PIXEL *BltBuffer OPTIONAL,
+                                    IN EFI_GRAPHICS_OUTPUT_BLT_OPERATION BltOperation,
+                                    IN UINTN SourceX, IN UINTN SourceY, IN UINTN DestinationX, IN UINTN DestinationY,
+                                    IN UINTN Width, IN UINTN Height, IN UINTN Delta OPTIONAL)
+{
+    UINTN                           ScreenWidth = GopMode.Info->HorizontalResolution;
+    UINTN                           ScreenHeight = GopMode.Info->VerticalResolution;
+    UINTN                           Stride = GopMode.Info->PixelsPerScanLine;
+    UINTN                           x, y, Row;
+    EFI_GRAPHICS_OUTPUT_BLT_PIXEL   *Dest;
+
+    if (Width == 0 || Height == 0)
+        return EFI_INVALID_PARAMETER;
+    if (Delta == 0)
+        Delta = Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL);
+
+    switch (BltOperation) {
+        case EfiBltVideoFill:
+            if (DestinationX + Width > ScreenWidth || DestinationY + Height > ScreenHeight)
+                return EFI_INVALID_PARAMETER;
+            for (y = 0; y < Height; y++) {
+                Dest = FrameBuffer + (DestinationY + y) * Stride + DestinationX;
+                for (x = 0; x < Width; x++)
+                    Dest[x] = *BltBuffer;
+            }
+            break;
+        case EfiBltVideoToBltBuffer:
+            if (SourceX + Width > ScreenWidth || SourceY + Height > ScreenHeight)
+                return EFI_INVALID_PARAMETER;
+            for (y = 0; y < Height; y++)
+                CopyMem((UINT8 *) BltBuffer + (DestinationY + y) * Delta + DestinationX * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL),
+                        FrameBuffer + (SourceY + y) * Stride + SourceX, Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+            break;
+        case EfiBltBufferToVideo:
+            if (DestinationX + Width > ScreenWidth || DestinationY + Height > ScreenHeight)
+                return EFI_INVALID_PARAMETER;
+            for (y = 0; y < Height; y++)
+                CopyMem(FrameBuffer + (DestinationY + y) * Stride + DestinationX,
+                        (UINT8 *) BltBuffer + (SourceY + y) * Delta + SourceX * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL),
+                        Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+            break;
+        case EfiBltVideoToVideo:
+            if (SourceX + Width > ScreenWidth || SourceY + Height > ScreenHeight ||
+                DestinationX + Width > ScreenWidth || DestinationY + Height > ScreenHeight)
+                return EFI_INVALID_PARAMETER;
+            // copy rows in the order that's safe when the areas overlap
+            for (y = 0; y < Height; y++) {
+                Row = (DestinationY > SourceY) ? Height - 1 - y : y;
+                CopyMem(FrameBuffer + (DestinationY + Row) * Stride + DestinationX,
+                        FrameBuffer + (SourceY + Row) * Stride + SourceX,
+                        Width * sizeof(EFI_GRAPHICS_OUTPUT_BLT_PIXEL));
+            }
+            break;
+        default:
+            return EFI_INVALID_PARAMETER;
+    }
+
+    Stats.BltCount++;
+    Stats.BltPixelCount += Width * Height;
+    return EFI_SUCCESS;
+}
+
+static EFI_GRAPHICS_OUTPUT_PROTOCOL MockGop = { MockGopQueryMode, MockGopSetMode, MockGopBlt, &GopMode };
+
+static VOID AddGopMode(IN UINT32 Width, IN UINT32 Height)
+{
+    EFI_GRAPHICS_OUTPUT_MODE_INFORMATION *Info;
+    UINTN i;
+
+    for (i = 0; i < GopMode.MaxMode; i++) {
+        if (GopModeInfo[i].HorizontalResolution == Width && GopModeInfo[i].VerticalResolution == Height)
+            return;
+    }
+    if (GopMode.MaxMode >= GOP_MAX_MODES)
+        return;
+    Info = &GopModeInfo[GopMode.MaxMode++];
+    Info->Version = 0;
+    Info->HorizontalResolution = Width;
+    Info->VerticalResolution = Height;
+    Info->PixelFormat = PixelBlueGreenRedReserved8BitPerColor;
+    Info->PixelsPerScanLine = Width;
+}
+
+//
+// files
+//
+
+typedef struct {
+    EFI_FILE_IO_INTERFACE   FileIo;         // must be first
+    CHAR8                   *RootPath;
+    CHAR16                  *Label;
+} MOCK_VOLUME;
+
+typedef struct {
+    EFI_FILE                File;           // must be first
+    MOCK_VOLUME             *Volume;
+    CHAR8                   *HostPath;
+    BOOLEAN                 IsDirectory;
+    BOOLEAN                 Writable;
+    int                     Fd;             // files only
+    DIR                     *Dir;           // directories only, opened on the first read
+    CHAR8                   *PendingName;   // directory entry that didn't fit the caller's buffer
+    UINT64                  Position;
+} MOCK_FILE;
+
+static EFI_FILE FileTemplate;
+
+// Converts a UCS-2 name to UTF-8, in a buffer from malloc().
+static CHAR8 * NameToHost(IN CONST CHAR16 *Name, IN UINTN Length)
+{
+    CHAR8   *HostName, *p;
+    UINTN   i;
+
+    HostName = p = malloc(Length * 3 + 1);
+    for (i = 0; i < Length; i++) {
+        if (Name[i] < 0x80) {
+            *p++ = (CHAR8) Name[i];
+        } else if (Name[i] < 0x800) {
+            *p++ = (CHAR8) (0xc0 | (Name[i] >> 6));
+            *p++ = (CHAR8) (0x80 | (Name[i] & 0x3f));
+        } else {
+            *p++ = (CHAR8) (0xe0 | (Name[i] >> 12));
+            *p++ = (CHAR8) (0x80 | ((Name[i] >> 6) & 0x3f));
+            *p++ = (CHAR8) (0x80 | (Name[i] & 0x3f));
+        }
+    }
+    *p = 0;
+    return HostName;
+}
+
+// Converts a UTF-8 name to UCS-2, in a pool buffer. Characters outside the
+// BMP become '?'.
+static CHAR16 * NameFromHost(IN CONST CHAR8 *HostName)
+{
+    CONST UINT8 *p = (CONST UINT8 *) HostName;
+    CHAR16      *Name;
+    UINTN       Length = 0;
+
+    Name = AllocatePool((strlen(HostName) + 1) * sizeof(CHAR16));
+    while (*p) {
+        if (p[0] < 0x80) {
+            Name[Length++] = *p++;
+        } else if ((p[0] & 0xe0) == 0xc0 && p[1] != 0) {
+            Name[Length++] = ((p[0] & 0x1f) << 6) | (p[1] & 0x3f);
+            p += 2;
+        } else if ((p[0] & 0xf0) == 0xe0 && p[1] != 0 && p[2] != 0) {
+            Name[Length++] = ((p[0] & 0x0f) << 12) | ((p[1] & 0x3f) << 6) | (p[2] & 0x3f);
+            p += 3;
+        } else {
+            Name[Length++] = L'?';
+            for (p++; (*p & 0xc0) == 0x80; p++)
+                ;
+        }
+    }
+    Name[Length] = 0;
+    return Name;
+}
+
+static CHAR8 * JoinHostPath(IN CONST CHAR8 *DirPath, IN CONST CHAR8 *Name)
+{
+    CHAR8 *Path;
+
+    Path = malloc(strlen(DirPath) + strlen(Name) + 2);
+    sprintf(Path, "%s/%s", DirPath, Name);
+    return Path;
+}
+
+// Returns the host path of the entry of directory DirPath called Name,
+// matched without regard to case as on FAT, or NULL if there isn't one.
+static CHAR8 * FindHostEntry(IN CONST CHAR8 *DirPath, IN CONST CHAR8 *Name)
+{
+    struct stat     Info;
+    struct dirent   *Entry;
+    DIR             *Dir;
+    CHAR8           *Path;
+
+    Path = JoinHostPath(DirPath, Name);
+    if (stat(Path, &Info) == 0)
+        return Path;
+    free(Path);
+
+    Path = NULL;
+    Dir = opendir(DirPath);
+    if (Dir == NULL)
+        return NULL;
+    while (Path == NULL && (Entry = readdir(Dir)) != NULL) {
+        if (strcasecmp(Entry->d_name, Name) == 0)
+            Path = JoinHostPath(DirPath, Entry->d_name);
+    }
+    closedir(Dir);
+    return Path;
+}
+
+static CONST CHAR8 * HostBaseName(IN CONST CHAR8 *Path)
+{
+    CONST CHAR8 *Slash = strrchr(Path, '/');
+
+    return (Slash != NULL) ? Slash + 1 : Path;
+}
+
+// Builds the EFI_FILE_INFO for host file HostPath, named Name (a UTF-8 string).
+static EFI_FILE_INFO * MakeFileInfo(IN CONST CHAR8 *HostPath, IN CONST CHAR8 *Name)
+{
+    struct stat     HostInfo;
+    EFI_FILE_INFO   *Info;
+    CHAR16          *Name16;
+
+    if (stat(HostPath, &HostInfo) != 0)
+        return NULL;
+    Name16 = NameFromHost(Name);
+    Info = AllocateZeroPool(SIZE_OF_EFI_FILE_INFO + StrSize(Name16));
+    Info->Size = SIZE_OF_EFI_FILE_INFO + StrSize(Name16);
+    if (S_ISDIR(HostInfo.st_mode)) {
+        Info->Attribute = EFI_FILE_DIRECTORY;
+    } else {
+        Info->FileSize = HostInfo.st_size;
+        Info->PhysicalSize = (HostInfo.st_size + 4095) & ~4095ULL;
+    }
+    TimeFromHost(HostInfo.st_ctim.tv_sec, HostInfo.st_ctim.tv_nsec, &Info->CreateTime);
+    TimeFromHost(HostInfo.st_atim.tv_sec, HostInfo.st_atim.tv_nsec, &Info->LastAccessTime);
+    TimeFromHost(HostInfo.st_mtim.tv_sec, HostInfo.st_mtim.tv_nsec, &Info->ModificationTime);
+    CopyMem(Info->FileName, Name16, StrSize(Name16));
+    FreePool(Name16);
+    return Info;
+}
+
+static EFI_STATUS NewMockFile(IN MOCK_VOLUME *Volume, IN CHAR8 *HostPath, IN UINT64 OpenMode, OUT MOCK_FILE **NewFile)
+{
+    struct stat HostInfo;
+    MOCK_FILE   *File;
+
+    if (stat(HostPath, &HostInfo) != 0) {
+        free(HostPath);
+        return EFI_NOT_FOUND;
+    }
+    File = AllocateZeroPool(sizeof(MOCK_FILE));
+    File->File = FileTemplate;
+    File->Volume = Volume;
+    File->HostPath = HostPath;
+    File->IsDirectory = S_ISDIR(HostInfo.st_mode);
+    File->Writable = (OpenMode & EFI_FILE_MODE_WRITE) != 0;
+    File->Fd = -1;
+    if (!File->IsDirectory) {
+        File->Fd = open(HostPath, File->Writable ? O_RDWR : O_RDONLY);
+        if (File->Fd < 0) {
+            free(HostPath);
+            FreePool(File);
+            return EFI_ACCESS_DENIED;
+        }
+    }
+    *NewFile = File;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFileOpen(IN EFI_FILE *This, OUT EFI_FILE **NewHandle, IN CHAR16 *FileName,
+                                      IN UINT64 OpenMode, IN UINT64 Attributes)
+{
+    MOCK_FILE   *File = (MOCK_FILE *) This, *NewFile;
+    MOCK_VOLUME *Volume = File->Volume;
+    CHAR8       *Path, *Component, *Next;
+    CHAR16      *End;
+    UINTN       RootLength = strlen(Volume->RootPath);
+    EFI_STATUS  Status;
+    int         Fd;
+
+    Stats.FileOpenCount++;
+    if (FileName == NULL || NewHandle == NULL)
+        return EFI_INVALID_PARAMETER;
+    if (FileName[0] == L'\\') {
+        Path = strdup(Volume->RootPath);
+    } else {
+        if (!File->IsDirectory)
+            return EFI_NOT_FOUND;
+        Path = strdup(File->HostPath);
+    }
+
+    while (*FileName) {
+        while (*FileName == L'\\')
+            FileName++;
+        for (End = FileName; *End && *End != L'\\'; End++)
+            ;
+        if (End == FileName)
+            break;
+        Component = NameToHost(FileName, End - FileName);
+        FileName = End;
+
+        if (strcmp(Component, ".") == 0) {
+            free(Component);
+            continue;
+        }
+        if (strcmp(Component, "..") == 0) {
+            if (strlen(Path) > RootLength)
+                *strrchr(Path, '/') = 0;
+            free(Component);
+            continue;
+        }
+
+        Next = FindHostEntry(Path, Component);
+        if (Next == NULL && *FileName == 0 && (OpenMode & EFI_FILE_MODE_CREATE)) {
+            Next = JoinHostPath(Path, Component);
+            if (Attributes & EFI_FILE_DIRECTORY) {
+                mkdir(Next, 0755);
+            } else {
+                Fd = open(Next, O_CREAT | O_RDWR, 0644);
+                if (Fd >= 0)
+                    close(Fd);
+            }
+        }
+        free(Component);
+        free(Path);
+        if (Next == NULL)
+            return EFI_NOT_FOUND;
+        Path = Next;
+    }
+
+    Status = NewMockFile(Volume, Path, OpenMode, &NewFile);
+    if (!EFI_ERROR(Status))
+        *NewHandle = &NewFile->File;
+    return Status;
+}
+
+static EFI_STATUS EFIAPI MockFileClose(IN EFI_FILE *This)
+{
+    MOCK_FILE *File = (MOCK_FILE *) This;
+
+    if (File->Fd >= 0)
+        close(File->Fd);
+    if (File->Dir != NULL)
+        closedir(File->Dir);
+    free(File->PendingName);
+    free(File->HostPath);
+    FreePool(File);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFileDelete(IN EFI_FILE *This)
+{
+    MOCK_FILE   *File = (MOCK_FILE *) This;
+    int         Result;
+
+    Result = File->IsDirectory ? rmdir(File->HostPath) : unlink(File->HostPath);
+    MockFileClose(This);
+    return (Result == 0) ? EFI_SUCCESS : EFI_WARN_DELETE_FAILURE;
+}
+
+// Reads the next directory entry, FAT-style: subdirectories start with "."
+// and ".." entries, and an entry that doesn't fit gets EFI_BUFFER_TOO_SMALL
+// and is returned again on the next call.
+static EFI_STATUS ReadDirectory(IN MOCK_FILE *File, IN OUT UINTN *BufferSize, OUT VOID *Buffer)
+{
+    struct dirent   *Entry;
+    EFI_FILE_INFO   *Info;
+    CHAR8           *EntryPath;
+    BOOLEAN         IsRoot;
+
+    Stats.DirReadCount++;
+    if (File->Dir == NULL) {
+        File->Dir = opendir(File->HostPath);
+        if (File->Dir == NULL)
+            return EFI_DEVICE_ERROR;
+    }
+    IsRoot = (strcmp(File->HostPath, File->Volume->RootPath) == 0);
+    while (File->PendingName == NULL) {
+        Entry = readdir(File->Dir);
+        if (Entry == NULL) {
+            *BufferSize = 0;
+            return EFI_SUCCESS;
+        }
+        if (IsRoot && (strcmp(Entry->d_name, ".") == 0 || strcmp(Entry->d_name, "..") == 0))
+            continue;
+        File->PendingName = strdup(Entry->d_name);
+    }
+
+    EntryPath = JoinHostPath(File->HostPath, File->PendingName);
+    Info = MakeFileInfo(EntryPath, File->PendingName);
+    free(EntryPath);
+    if (Info == NULL) {
+        // vanished, or a dangling link: skip it
+        free(File->PendingName);
+        File->PendingName = NULL;
+        return ReadDirectory(File, BufferSize, Buffer);
+    }
+    if (*BufferSize < Info->Size) {
+        *BufferSize = Info->Size;
+        FreePool(Info);
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    *BufferSize = Info->Size;
+    CopyMem(Buffer, Info, Info->Size);
+    FreePool(Info);
+    free(File->PendingName);
+    File->PendingName = NULL;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFileRead(IN EFI_FILE *This, IN OUT UINTN *BufferSize, OUT VOID *Buffer)
+{
+    MOCK_FILE   *File = (MOCK_FILE *) This;
+    ssize_t     Count;
+
+    if (File->IsDirectory)
+        return ReadDirectory(File, BufferSize, Buffer);
+    Stats.FileReadCount++;
+    Count = pread(File->Fd, Buffer, *BufferSize, File->Position);
+    if (Count < 0)
+        return EFI_DEVICE_ERROR;
+    *BufferSize = Count;
+    File->Position += Count;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFileWrite(IN EFI_FILE *This, IN OUT UINTN *BufferSize, IN VOID *Buffer)
+{
+    MOCK_FILE   *File = (MOCK_FILE *) This;
+    ssize_t     Count;
+
+    if (File->IsDirectory)
+        return EFI_UNSUPPORTED;
+    if (!File->Writable)
+        return EFI_ACCESS_DENIED;
+    Count = pwrite(File->Fd, Buffer, *BufferSize, File->Position);
+    if (Count < 0)
+        return EFI_DEVICE_ERROR;
+    *BufferSize = Count;
+    File->Position += Count;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFileGetPosition(IN EFI_FILE *This, OUT UINT64 *Position)
+{
+    MOCK_FILE *File = (MOCK_FILE *) This;
+
+    if (File->IsDirectory)
+        return EFI_UNSUPPORTED;
+    *Position = File->Position;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFileSetPosition(IN EFI_FILE *This, IN UINT64 Position)
+{
+    MOCK_FILE   *File = (MOCK_FILE *) This;
+    struct stat HostInfo;
+
+    if (File->IsDirectory) {
+        if (Position != 0)
+            return EFI_UNSUPPORTED;
+        if (File->Dir != NULL)
+            rewinddir(File->Dir);
+        free(File->PendingName);
+        File->PendingName = NULL;
+        return EFI_SUCCESS;
+    }
+    if (Position == 0xffffffffffffffffULL) {
+        if (fstat(File->Fd, &HostInfo) != 0)
+            return EFI_DEVICE_ERROR;
+        Position = HostInfo.st_size;
+    }
+    File->Position = Position;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFileGetInfo(IN EFI_FILE *This, IN EFI_GUID *InformationType,
+                                         IN OUT UINTN *BufferSize, OUT VOID *Buffer)
+{
+    MOCK_FILE               *File = (MOCK_FILE *) This;
+    EFI_FILE_SYSTEM_INFO    *FsInfo;
+    VOID                    *Info;
+    UINTN                   Size;
+    BOOLEAN                 IsRoot;
+
+    if (CompareGuid(InformationType, &GenericFileInfo) == 0) {
+        IsRoot = (strcmp(File->HostPath, File->Volume->RootPath) == 0);
+        Info = MakeFileInfo(File->HostPath, IsRoot ? "" : HostBaseName(File->HostPath));
+        if (Info == NULL)
+            return EFI_DEVICE_ERROR;
+        Size = ((EFI_FILE_INFO *) Info)->Size;
+    } else if (CompareGuid(InformationType, &FileSystemInfo) == 0) {
+        Size = SIZE_OF_EFI_FILE_SYSTEM_INFO + StrSize(File->Volume->Label);
+        Info = FsInfo = AllocateZeroPool(Size);
+        FsInfo->Size = Size;
+        FsInfo->VolumeSize = 512ULL * 1024 * 1024;
+        FsInfo->FreeSpace = 256ULL * 1024 * 1024;
+        FsInfo->BlockSize = 512;
+        CopyMem(FsInfo->VolumeLabel, File->Volume->Label, StrSize(File->Volume->Label));
+    } else {
+        return EFI_UNSUPPORTED;
+    }
+
+    if (*BufferSize < Size) {
+        *BufferSize = Size;
+        FreePool(Info);
+        return EFI_BUFFER_TOO_SMALL;
+    }
+    *BufferSize = Size;
+    CopyMem(Buffer, Info, Size);
+    FreePool(Info);
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFileSetInfo(IN EFI_FILE *This, IN EFI_GUID *InformationType,
+                                         IN UINTN BufferSize, IN VOID *Buffer)
+{
+    MOCK_FILE *File = (MOCK_FILE *) This;
+
+    if (CompareGuid(InformationType, &GenericFileInfo) != 0)
+        return EFI_UNSUPPORTED;
+    if (File->IsDirectory)
+        return EFI_SUCCESS;
+    if (!File->Writable)
+        return EFI_ACCESS_DENIED;
+    if (ftruncate(File->Fd, ((EFI_FILE_INFO *) Buffer)->FileSize) != 0)
+        return EFI_DEVICE_ERROR;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFileFlush(IN EFI_FILE *This)
+{
+    return EFI_SUCCESS;
+}
+
+static EFI_FILE FileTemplate = {
+    0x00010000, MockFileOpen, MockFileClose, MockFileDelete, MockFileRead, MockFileWrite,
+    MockFileGetPosition, MockFileSetPosition, MockFileGetInfo, MockFileSetInfo, MockFileFlush
+};
+
+static EFI_STATUS EFIAPI MockOpenVolume(IN EFI_FILE_IO_INTERFACE *This, OUT EFI_FILE_HANDLE *Root)
+{
+    MOCK_VOLUME *Volume = (MOCK_VOLUME *) This;
+    MOCK_FILE   *File;
+    EFI_STATUS  Status;
+
+    Status = NewMockFile(Volume, strdup(Volume->RootPath), EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, &File);
+    if (!EFI_ERROR(Status))
+        *Root = &File->File;
+    return Status;
+}
+
+//
+// block devices
+//
+
+typedef struct {
+    EFI_BLOCK_IO            BlockIo;        // must be first
+    EFI_BLOCK_IO_MEDIA      Media;
+    int                     Fd;
+    UINT64                  Offset;         // of block 0 in the image, in bytes
+} MOCK_BLOCK_DEVICE;
+
+static EFI_STATUS EFIAPI MockBlockReset(IN EFI_BLOCK_IO *This, IN BOOLEAN ExtendedVerification)
+{
+    return EFI_SUCCESS;
+}
+
+// Checks a Block I/O request, returning its offset in the image in *Offset.
+static EFI_STATUS CheckBlockRequest(IN EFI_BLOCK_IO *This, IN UINT32 MediaId, IN EFI_LBA Lba, IN UINTN BufferSize,
+                                    OUT UINT64 *Offset)
+{
+    MOCK_BLOCK_DEVICE *Device = (MOCK_BLOCK_DEVICE *) This;
+
+    if (MediaId != Device->Media.MediaId)
+        return EFI_MEDIA_CHANGED;
+    if (BufferSize % Device->Media.BlockSize != 0)
+        return EFI_BAD_BUFFER_SIZE;
+    if (Lba > Device->Media.LastBlock || (BufferSize / Device->Media.BlockSize) > Device->Media.LastBlock + 1 - Lba)
+        return EFI_INVALID_PARAMETER;
+    *Offset = Device->Offset + Lba * Device->Media.BlockSize;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockReadBlocks(IN EFI_BLOCK_IO *This, IN UINT32 MediaId, IN EFI_LBA Lba,
+                                        IN UINTN BufferSize, OUT VOID *Buffer)
+{
+    EFI_STATUS  Status;
+    UINT64      Offset;
+
+    Status = CheckBlockRequest(This, MediaId, Lba, BufferSize, &Offset);
+    if (EFI_ERROR(Status))
+        return Status;
+    Stats.BlockReadCount++;
+    Stats.BlockReadBytes += BufferSize;
+    if (pread(((MOCK_BLOCK_DEVICE *) This)->Fd, Buffer, BufferSize, Offset) != (ssize_t) BufferSize)
+        return EFI_DEVICE_ERROR;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockWriteBlocks(IN EFI_BLOCK_IO *This, IN UINT32 MediaId, IN EFI_LBA Lba,
+                                         IN UINTN BufferSize, IN VOID *Buffer)
+{
+    EFI_STATUS  Status;
+    UINT64      Offset;
+
+    Status = CheckBlockRequest(This, MediaId, Lba, BufferSize, &Offset);
+    if (EFI_ERROR(Status))
+        return Status;
+    if (pwrite(((MOCK_BLOCK_DEVICE *) This)->Fd, Buffer, BufferSize, Offset) != (ssize_t) BufferSize)
+        return EFI_DEVICE_ERROR;
+    return EFI_SUCCESS;
+}
+
+static EFI_STATUS EFIAPI MockFlushBlocks(IN EFI_BLOCK_IO *This)
+{
+    return EFI_SUCCESS;
+}
+
+static MOCK_BLOCK_DEVICE * NewBlockDevice(IN int Fd, IN UINT64 Offset, IN UINT32 BlockSize, IN UINT64 BlockCount,
+                                          IN BOOLEAN LogicalPartition)
+{
+    MOCK_BLOCK_DEVICE *Device;
+
+    Device = AllocateZeroPool(sizeof(MOCK_BLOCK_DEVICE));
+    Device->BlockIo.Revision = 0x00010000;
+    Device->BlockIo.Media = &Device->Media;
+    Device->BlockIo.Reset = MockBlockReset;
+    Device->BlockIo.ReadBlocks = MockReadBlocks;
+    Device->BlockIo.WriteBlocks = MockWriteBlocks;
+    Device->BlockIo.FlushBlocks = MockFlushBlocks;
+    Device->Media.MediaId = 1;
+    Device->Media.MediaPresent = TRUE;
+    Device->Media.LogicalPartition = LogicalPartition;
+    Device->Media.BlockSize = BlockSize;
+    Device->Media.LastBlock = BlockCount - 1;
+    Device->Fd = Fd;
+    Device->Offset = Offset;
+    return Device;
+}
+
+EFI_HANDLE MockAddDisk(IN CHAR8 *ImagePath, IN UINT32 BlockSize, IN UINT16 Port)
+{
+    EFI_HANDLE          Handle;
+    MOCK_BLOCK_DEVICE   *Device;
+    PCI_DEVICE_PATH     *Pci;
+    SATA_DEVICE_PATH    *Sata;
+    struct stat         HostInfo;
+    int                 Fd;
+
+    Fd = open(ImagePath, O_RDWR);
+    if (Fd < 0 || fstat(Fd, &HostInfo) != 0) {
+        perror(ImagePath);
+        exit(1);
+    }
+    Device = NewBlockDevice(Fd, 0, BlockSize, HostInfo.st_size / BlockSize, FALSE);
+
+    // PciRoot's SATA controller, then the port
+    Pci = AllocateZeroPool(sizeof(PCI_DEVICE_PATH) + sizeof(SATA_DEVICE_PATH) + sizeof(EFI_DEVICE_PATH));
+    Pci->Header.Type = HARDWARE_DEVICE_PATH;
+    Pci->Header.SubType = HW_PCI_DP;
+    SetDevicePathNodeLength(&Pci->Header, sizeof(PCI_DEVICE_PATH));
+    Pci->Device = 0x1f;
+    Pci->Function = 2;
+    Sata = (SATA_DEVICE_PATH *) (Pci + 1);
+    Sata->Header.Type = MESSAGING_DEVICE_PATH;
+    Sata->Header.SubType = MSG_SATA_DP;
+    SetDevicePathNodeLength(&Sata->Header, sizeof(SATA_DEVICE_PATH));
+    Sata->HBAPortNumber = Port;
+    Sata->PortMultiplierPortNumber = 0xffff;
+    SetDevicePathEndNode((EFI_DEVICE_PATH *) (Sata + 1));
+
+    Handle = NewHandle();
+    InstallProtocol(Handle, &DevicePathProtocol, Pci);
+    InstallProtocol(Handle, &BlockIoProtocol, &Device->BlockIo);
+    return Handle;
+}
+
+EFI_HANDLE MockAddPartition(IN EFI_HANDLE Disk, IN UINT32 Number, IN EFI_LBA StartLba, IN UINT64 BlockCount,
+                            IN EFI_GUID *TypeGuid, IN EFI_GUID *UniqueGuid,
+                            IN CHAR8 *RootPath OPTIONAL, IN CHAR16 *Label OPTIONAL)
+{
+    EFI_HANDLE              Handle;
+    EFI_BLOCK_IO            *DiskBlockIo = NULL;
+    EFI_DEVICE_PATH         *DiskPath, *Path;
+    HARDDRIVE_DEVICE_PATH   *Hd;
+    MOCK_BLOCK_DEVICE       *DiskDevice, *Device;
+    MOCK_VOLUME             *Volume;
+    UINTN                   DiskPathSize;
+
+    MockHandleProtocol(Disk, &BlockIoProtocol, (VOID **) &DiskBlockIo);
+    DiskDevice = (MOCK_BLOCK_DEVICE *) DiskBlockIo;
+    Device = NewBlockDevice(DiskDevice->Fd, DiskDevice->Offset + StartLba * DiskDevice->Media.BlockSize,
+                            DiskDevice->Media.BlockSize, BlockCount, TRUE);
+
+    // the disk's path, then the partition
+    DiskPath = DevicePathFromHandle(Disk);
+    DiskPathSize = DevicePathSize(DiskPath) - sizeof(EFI_DEVICE_PATH);
+    Path = AllocateZeroPool(DiskPathSize + sizeof(HARDDRIVE_DEVICE_PATH) + sizeof(EFI_DEVICE_PATH));
+    CopyMem(Path, DiskPath, DiskPathSize);
+    Hd = (HARDDRIVE_DEVICE_PATH *) ((UINT8 *) Path + DiskPathSize);
+    Hd->Header.Type = MEDIA_DEVICE_PATH;
+    Hd->Header.SubType = MEDIA_HARDDRIVE_DP;
+    SetDevicePathNodeLength(&Hd->Header, sizeof(HARDDRIVE_DEVICE_PATH));
+    Hd->PartitionNumber = Number;
+    Hd->PartitionStart = StartLba;
+    Hd->PartitionSize = BlockCount;
+    CopyMem(Hd->Signature, UniqueGuid, sizeof(EFI_GUID));
+    Hd->MBRType = MBR_TYPE_EFI_PARTITION_TABLE_HEADER;
+    Hd->SignatureType = SIGNATURE_TYPE_GUID;
+    SetDevicePathEndNode((EFI_DEVICE_PATH *) (Hd + 1));
+
+    Handle = NewHandle();
+    InstallProtocol(Handle, &DevicePathProtocol, Path);
+    InstallProtocol(Handle, &BlockIoProtocol, &Device->BlockIo);
+    if (RootPath != NULL) {
+        Volume = AllocateZeroPool(sizeof(MOCK_VOLUME));
+        Volume->FileIo.Revision = 0x00010000;
+        Volume->FileIo.OpenVolume = MockOpenVolume;
+        Volume->RootPath = strdup(RootPath);
+        Volume->Label = StrDuplicate((Label != NULL) ? Label : L"");
+        InstallProtocol(Handle, &FileSystemProtocol, &Volume->FileIo);
+    }
+    // as the firmware's partition driver does, mark the ESP by its type
+    if (CompareGuid(TypeGuid, &EspTypeGuid) == 0)
+        InstallProtocol(Handle, &EspTypeGuid, NULL);
+    return Handle;
+}
+
+EFI_HANDLE MockAddImage(IN EFI_HANDLE Device, IN CHAR16 *FilePath)
+{
+    EFI_HANDLE          Handle;
+    EFI_LOADED_IMAGE    *LoadedImage;
+
+    LoadedImage = AllocateZeroPool(sizeof(EFI_LOADED_IMAGE));
+    LoadedImage->Revision = 0x1000;
+    LoadedImage->SystemTable = &MockSystemTable;
+    LoadedImage->DeviceHandle = Device;
+    LoadedImage->FilePath = FileDevicePath(NULL, FilePath);
+    LoadedImage->ImageCodeType = EfiLoaderCode;
+    LoadedImage->ImageDataType = EfiLoaderData;
+
+    Handle = NewHandle();
+    InstallProtocol(Handle, &LoadedImageProtocol, LoadedImage);
+    return Handle;
+}
+
+//
+// set-up and statistics
+//
+
+EFI_SYSTEM_TABLE * MockInit(IN UINTN ScreenWidth, IN UINTN ScreenHeight)
+{
+    EFI_BOOT_SERVICES *BootServices = &MockBootServices;
+
+    EchoConsole = (getenv("HOSTBENCH_CONSOLE") != NULL);
+
+    BootServices->AllocatePool = MockAllocatePool;
+    BootServices->FreePool = MockFreePool;
+    BootServices->CreateEvent = MockCreateEvent;
+    BootServices->SetTimer = MockSetTimer;
+    BootServices->WaitForEvent = MockWaitForEvent;
+    BootServices->SignalEvent = MockSignalEvent;
+    BootServices->CloseEvent = MockCloseEvent;
+    BootServices->CheckEvent = MockCheckEvent;
+    BootServices->HandleProtocol = MockHandleProtocol;
+    BootServices->LocateHandle = MockLocateHandle;
+    BootServices->LocateDevicePath = MockLocateDevicePath;
+    BootServices->LoadImage = MockLoadImage;
+    BootServices->StartImage = MockStartImage;
+    BootServices->Exit = MockExit;
+    BootServices->UnloadImage = MockUnloadImage;
+    BootServices->Stall = MockStall;
+    BootServices->SetWatchdogTimer = MockSetWatchdogTimer;
+    BootServices->ConnectController = MockConnectController;
+    BootServices->OpenProtocolInformation = MockOpenProtocolInformation;
+    BootServices->ProtocolsPerHandle = MockProtocolsPerHandle;
+    BootServices->LocateHandleBuffer = MockLocateHandleBuffer;
+    BootServices->LocateProtocol = MockLocateProtocol;
+    BootServices->CalculateCrc32 = MockCalculateCrc32;
+
+    MockRuntimeServices.GetTime = MockGetTime;
+    MockRuntimeServices.GetVariable = MockGetVariable;
+    MockRuntimeServices.SetVariable = MockSetVariable;
+    MockRuntimeServices.ResetSystem = MockResetSystem;
+
+    MockSystemTable.Hdr.Revision = (2 << 16) | 31;     // UEFI 2.3.1
+    MockSystemTable.FirmwareVendor = L"rEFInd host bench";
+    MockSystemTable.FirmwareRevision = 0x00010000;
+    MockSystemTable.ConIn = &MockConIn;
+    MockSystemTable.ConOut = &MockConOut;
+    MockSystemTable.StdErr = &MockConOut;
+    MockSystemTable.BootServices = BootServices;
+    MockSystemTable.RuntimeServices = &MockRuntimeServices;
+
+    // the display: the requested mode, plus a couple of common ones
+    AddGopMode((UINT32) ScreenWidth, (UINT32) ScreenHeight);
+    AddGopMode(1024, 768);
+    AddGopMode(800, 600);
+    MockGopSetMode(&MockGop, 0);
+    InstallProtocol(NewHandle(), &GraphicsOutputGuid, &MockGop);
+
+    return &MockSystemTable;
+}
+
+VOID MockGetStats(OUT MOCK_STATS *StatsOut)
+{
+    *StatsOut = Stats;
+}
+
+VOID MockResetStats(VOID)
+{
+    ZeroMem(&Stats, sizeof(Stats));
+}
+
+/* EOF */
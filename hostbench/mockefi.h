@@ -0,0 +1,53 @@
+/*
+ * hostbench/mockefi.h
+ * Mock firmware for running rEFInd as a host program
+ *
+ * The mock provides the boot and runtime services, console, Graphics Output
+ * Protocol and handle database that rEFInd uses. Disks are image files,
+ * exposed through the Block I/O protocol; each partition on them can be
+ * backed by a host directory, exposed through the simple file system
+ * protocol as a FAT-like (case-insensitive) volume.
+ */
+
+#ifndef __HOSTBENCH_MOCKEFI_H__
+#define __HOSTBENCH_MOCKEFI_H__
+
+#include "efi.h"
+
+// I/O done through the mock since the last MockResetStats()
+typedef struct {
+    UINT64      BltCount;           // GOP Blt() calls
+    UINT64      BltPixelCount;      // pixels moved by them
+    UINT64      BlockReadCount;     // Block I/O ReadBlocks() calls
+    UINT64      BlockReadBytes;
+    UINT64      FileOpenCount;      // EFI_FILE Open() calls, including failed ones
+    UINT64      FileReadCount;      // EFI_FILE Read() calls on files
+    UINT64      DirReadCount;       // EFI_FILE Read() calls on directories
+} MOCK_STATS;
+
+// Sets up the system table, with a ScreenWidth x ScreenHeight GOP display.
+EFI_SYSTEM_TABLE * MockInit(IN UINTN ScreenWidth, IN UINTN ScreenHeight);
+
+// Adds a SATA disk backed by the image file at ImagePath; returns its handle.
+EFI_HANDLE MockAddDisk(IN CHAR8 *ImagePath, IN UINT32 BlockSize, IN UINT16 Port);
+
+// Adds GPT partition Number of Disk, BlockCount blocks from StartLba. If
+// RootPath is given, the partition has a file system with the contents of
+// that host directory and the volume label Label.
+EFI_HANDLE MockAddPartition(IN EFI_HANDLE Disk, IN UINT32 Number, IN EFI_LBA StartLba, IN UINT64 BlockCount,
+                            IN EFI_GUID *TypeGuid, IN EFI_GUID *UniqueGuid,
+                            IN CHAR8 *RootPath OPTIONAL, IN CHAR16 *Label OPTIONAL);
+
+// Adds a loaded image, as if FilePath had been started from Device.
+EFI_HANDLE MockAddImage(IN EFI_HANDLE Device, IN CHAR16 *FilePath);
+
+// Queues a key stroke. When the queue is empty, waiting for a key gets an
+// Escape, so nothing waits forever.
+VOID MockPushKey(IN UINT16 ScanCode, IN CHAR16 UnicodeChar);
+
+VOID MockGetStats(OUT MOCK_STATS *Stats);
+VOID MockResetStats(VOID);
+
+#endif /* __HOSTBENCH_MOCKEFI_H__ */
+
+/* EOF */
@@ -0,0 +1,84 @@
+/*
+ * hostbench/refind_main.c
+ * rEFInd's main.c, with entry points for the host benchmarks
+ *
+ * The start-up and scanning code in main.c is static, so it's compiled
+ * here as part of this file, and the functions below expose the pieces
+ * the benchmarks time. efi_main() itself is compiled but never called.
+ */
+
+#include "../refind/main.c"
+
+#include "hostbench.h"
+
+// Does what efi_main() does before it scans for boot loaders.
+EFI_STATUS HostBenchStartup(IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
+{
+    EFI_STATUS Status;
+
+    InitializeLib(ImageHandle, SystemTable);
+    StartTimestamp = ReadTimestampCounter();
+    TimelineStart(StartTimestamp);
+    CalibrateTimestampCounter();
+    InitScreen();
+    Status = InitRefitLib(ImageHandle);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    CopyMem(GlobalConfig.ScanFor, "ieo       ", NUM_SCAN_OPTIONS);
+    ReadConfig();
+    MainMenu.TimeoutSeconds = 0;    // the benchmarks drive the menu with keys
+    SetupScreen();
+    return EFI_SUCCESS;
+}
+
+// Empties the main menu, as efi_main() does before a rescan.
+static VOID HostBenchClearMainMenu(VOID)
+{
+    UINTN i;
+
+    for (i = 0; i < MainMenu.EntryCount; i++)
+        FreeMenuEntryTiles(MainMenu.Entries[i]);
+    FreeList((VOID ***) &(MainMenu.Entries), &MainMenu.EntryCount);
+    MainMenu.Entries = NULL;
+    MainMenu.EntryCount = 0;
+}
+
+// Scans for boot loaders and tools from scratch, as a rescan from the menu
+// does; returns the number of main menu entries.
+UINTN HostBenchScanForBootloaders(IN BOOLEAN ReuseCache)
+{
+    HostBenchClearMainMenu();
+    ScanForBootloaders(ReuseCache);
+    ScanForTools();
+    return MainMenu.EntryCount;
+}
+
+// Runs ScanEfiFiles() on every volume found by the last scan, with cold
+// directory and initrd caches and without the scan cache; returns the
+// number of main menu entries that it added.
+UINTN HostBenchScanEfiFiles(VOID)
+{
+    BOOLEAN ScanCache = GlobalConfig.ScanCache;
+    UINTN   i;
+
+    HostBenchClearMainMenu();
+    FlushDirCache();
+    FreeInitrdIndexes();
+    GlobalConfig.ScanCache = FALSE;
+    ScanCacheBegin(L"", FALSE);
+    GlobalConfig.ScanCache = ScanCache;
+    for (i = 0; i < VolumesCount; i++)
+        ScanEfiFiles(Volumes[i]);
+    return MainMenu.EntryCount;
+}
+
+// Runs the main menu until it exits; the caller queues the keys.
+UINTN HostBenchRunMainMenu(VOID)
+{
+    REFIT_MENU_ENTRY *ChosenEntry;
+
+    return RunMainMenu(&MainMenu, NULL, &ChosenEntry);
+}
+
+/* EOF */
@@ -0,0 +1,82 @@
+/*
+ * include/iconpack.h
+ * Layout of the icons.pak icon theme pack
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * An icon pack holds every icon of a theme directory in one file, so that
+ * rEFInd can read them all with a single file open instead of one (slow,
+ * firmware-driven) open per icon. It's built on the host by mkiconpack
+ * from the .icns files in icons/ and is read by refind/icns.c. This header
+ * is shared by both, so it only describes the byte layout; all fields are
+ * little-endian 32-bit values, read byte by byte.
+ *
+ * Header (ICONPACK_HEADER_SIZE bytes):
+ *   Magic         ICONPACK_MAGIC ("rIPK")
+ *   Version       ICONPACK_VERSION
+ *   EntryCount    number of entries
+ *   BucketCount   number of hash buckets; a power of two
+ *   BucketOffset  file offset of the bucket table
+ *   EntryOffset   file offset of the entry table
+ *
+ * Bucket table: BucketCount values, each the index + 1 of the first entry
+ * in that bucket's chain, or 0 for an empty bucket.
+ *
+ * Entry table: EntryCount entries of ICONPACK_ENTRY_SIZE bytes:
+ *   Hash          iconpack hash of the name
+ *   Next          index + 1 of the next entry in the chain, or 0
+ *   NameOffset    file offset of the name: lowercase ASCII, NUL-terminated,
+ *                 the icon's file name within the theme ("os_linux.icns")
+ *   PixelSize     width and height of the (square) icon
+ *   Flags         ICONPACK_FLAG_* values
+ *   DataOffset    file offset of the compressed pixel data
+ *   DataLength    length of the compressed pixel data
+ *   Reserved      0
+ *
+ * The same name appears once per pixel size. Pixel data is a run-length
+ * encoded stream of PixelSize * PixelSize BGRA pixels: a control byte
+ * below 0x80 is followed by (control + 1) literal pixels, and a control
+ * byte of 0x80 or more by one pixel that repeats (control - 0x7e) times.
+ *
+ * The hash is 32-bit FNV-1a over the name, with ASCII letters folded to
+ * lowercase.
+ */
+
+#ifndef __ICONPACK_H_
+#define __ICONPACK_H_
+
+#define ICONPACK_FILE_NAME          "icons.pak"
+
+#define ICONPACK_MAGIC              "rIPK"
+#define ICONPACK_VERSION            (1)
+
+#define ICONPACK_HEADER_SIZE        (24)
+#define ICONPACK_ENTRY_SIZE         (32)
+
+#define ICONPACK_FLAG_PREMULTIPLIED (0x01)
+
+#define ICONPACK_HASH_INIT          (2166136261U)
+#define ICONPACK_HASH_PRIME         (16777619U)
+
+#define ICONPACK_MAX_LITERAL        (128)
+#define ICONPACK_MAX_REPEAT         (129)
+
+#endif
+
+/* EOF */
@@ -1,37 +1,97 @@
 #ifndef __REFIT_CALL_WRAPPER_H__
 #define __REFIT_CALL_WRAPPER_H__
 
+// Set to 1 (or build with -DREFIT_CALL_STATS=1) to count the firmware calls
+// made through these wrappers, with their time and the bytes they transfer;
+// see refind/callstats.c. With this set, some arguments are evaluated twice,
+// so they mustn't have side effects.
+#ifndef REFIT_CALL_STATS
+#define REFIT_CALL_STATS (0)
+#endif
+
 #ifdef EFIX64
-# define refit_call1_wrapper(f, a1) \
+# define refit_raw_call1(f, a1) \
   uefi_call_wrapper(f, 1, (UINT64)(a1))
-# define refit_call2_wrapper(f, a1, a2) \
+# define refit_raw_call2(f, a1, a2) \
   uefi_call_wrapper(f, 2, (UINT64)(a1), (UINT64)(a2))
-# define refit_call3_wrapper(f, a1, a2, a3) \
+# define refit_raw_call3(f, a1, a2, a3) \
   uefi_call_wrapper(f, 3, (UINT64)(a1), (UINT64)(a2), (UINT64)(a3))
-# define refit_call4_wrapper(f, a1, a2, a3, a4) \
+# define refit_raw_call4(f, a1, a2, a3, a4) \
   uefi_call_wrapper(f, 4, (UINT64)(a1), (UINT64)(a2), (UINT64)(a3), (UINT64)(a4))
-# define refit_call5_wrapper(f, a1, a2, a3, a4, a5) \
+# define refit_raw_call5(f, a1, a2, a3, a4, a5) \
   uefi_call_wrapper(f, 5, (UINT64)(a1), (UINT64)(a2), (UINT64)(a3), (UINT64)(a4), (UINT64)(a5))
-# define refit_call6_wrapper(f, a1, a2, a3, a4, a5, a6) \
+# define refit_raw_call6(f, a1, a2, a3, a4, a5, a6) \
   uefi_call_wrapper(f, 6, (UINT64)(a1), (UINT64)(a2), (UINT64)(a3), (UINT64)(a4), (UINT64)(a5), (UINT64)(a6))
-# define refit_call10_wrapper(f, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10) \
+# define refit_raw_call10(f, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10) \
   uefi_call_wrapper(f, 10, (UINT64)(a1), (UINT64)(a2), (UINT64)(a3), (UINT64)(a4), (UINT64)(a5), (UINT64)(a6), (UINT64)(a7), (UINT64)(a8), (UINT64)(a9), (UINT64)(a10))
 #else
-# define refit_call1_wrapper(f, a1) \
+# define refit_raw_call1(f, a1) \
   uefi_call_wrapper(f, 1, a1)
-# define refit_call2_wrapper(f, a1, a2) \
+# define refit_raw_call2(f, a1, a2) \
   uefi_call_wrapper(f, 2, a1, a2)
-# define refit_call3_wrapper(f, a1, a2, a3) \
+# define refit_raw_call3(f, a1, a2, a3) \
   uefi_call_wrapper(f, 3, a1, a2, a3)
-# define refit_call4_wrapper(f, a1, a2, a3, a4) \
+# define refit_raw_call4(f, a1, a2, a3, a4) \
   uefi_call_wrapper(f, 4, a1, a2, a3, a4)
-# define refit_call5_wrapper(f, a1, a2, a3, a4, a5) \
+# define refit_raw_call5(f, a1, a2, a3, a4, a5) \
   uefi_call_wrapper(f, 5, a1, a2, a3, a4, a5)
-# define refit_call6_wrapper(f, a1, a2, a3, a4, a5, a6) \
+# define refit_raw_call6(f, a1, a2, a3, a4, a5, a6) \
   uefi_call_wrapper(f, 6, a1, a2, a3, a4, a5, a6)
-# define refit_call10_wrapper(f, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10) \
+# define refit_raw_call10(f, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10) \
   uefi_call_wrapper(f, 10, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10)
 #endif
 
-#endif /* !__REFIT_CALL_WRAPPER_H__ */
+// For services that return VOID (such as RT->ResetSystem). On IA32 these
+// are direct calls with no result, so they can't go through the counting
+// wrappers below; they aren't counted.
+#define refit_call4_void_wrapper(f, a1, a2, a3, a4) \
+  refit_raw_call4(f, a1, a2, a3, a4)
+
+#if REFIT_CALL_STATS > 0
+
+UINT64 RefitCallBegin(VOID);
+VOID RefitCallEnd(IN CHAR8 *Call, IN UINTN ArgCount, IN UINT64 Start, IN UINT64 SizeArg);
 
+// SizeArg is the argument that gives the amount of data the call transfers,
+// for the methods that RefitCallEnd() knows about.
+# define refit_counted_call(f, n, SizeArg, Call) \
+  ({ UINT64 RefitCallStart_ = RefitCallBegin(); \
+     EFI_STATUS RefitCallStatus_ = (Call); \
+     RefitCallEnd((CHAR8 *) #f, n, RefitCallStart_, (UINT64) (UINTN) (SizeArg)); \
+     RefitCallStatus_; })
+
+# define refit_call1_wrapper(f, a1) \
+  refit_counted_call(f, 1, 0, refit_raw_call1(f, a1))
+# define refit_call2_wrapper(f, a1, a2) \
+  refit_counted_call(f, 2, 0, refit_raw_call2(f, a1, a2))
+# define refit_call3_wrapper(f, a1, a2, a3) \
+  refit_counted_call(f, 3, a2, refit_raw_call3(f, a1, a2, a3))
+# define refit_call4_wrapper(f, a1, a2, a3, a4) \
+  refit_counted_call(f, 4, 0, refit_raw_call4(f, a1, a2, a3, a4))
+# define refit_call5_wrapper(f, a1, a2, a3, a4, a5) \
+  refit_counted_call(f, 5, a4, refit_raw_call5(f, a1, a2, a3, a4, a5))
+# define refit_call6_wrapper(f, a1, a2, a3, a4, a5, a6) \
+  refit_counted_call(f, 6, a5, refit_raw_call6(f, a1, a2, a3, a4, a5, a6))
+# define refit_call10_wrapper(f, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10) \
+  refit_counted_call(f, 10, (a8) * (a9), refit_raw_call10(f, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10))
+
+#else
+
+# define refit_call1_wrapper(f, a1) \
+  refit_raw_call1(f, a1)
+# define refit_call2_wrapper(f, a1, a2) \
+  refit_raw_call2(f, a1, a2)
+# define refit_call3_wrapper(f, a1, a2, a3) \
+  refit_raw_call3(f, a1, a2, a3)
+# define refit_call4_wrapper(f, a1, a2, a3, a4) \
+  refit_raw_call4(f, a1, a2, a3, a4)
+# define refit_call5_wrapper(f, a1, a2, a3, a4, a5) \
+  refit_raw_call5(f, a1, a2, a3, a4, a5)
+# define refit_call6_wrapper(f, a1, a2, a3, a4, a5, a6) \
+  refit_raw_call6(f, a1, a2, a3, a4, a5, a6)
+# define refit_call10_wrapper(f, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10) \
+  refit_raw_call10(f, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10)
+
+#endif
+
+#endif /* !__REFIT_CALL_WRAPPER_H__ */
@@ -0,0 +1,459 @@
+/*
+ * libeg/compose.c
+ * Alpha compositing kernels
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * Distributed under the terms of the GNU General Public License (GPL)
+ * version 3 (GPLv3), a copy of which must be distributed with this source
+ * code or binaries made from it.
+ *
+ */
+
+//
+// egRawCompose() blends a straight-alpha image onto an opaque one. Every
+// icon, badge and font glyph passes through it, so in addition to the
+// portable per-pixel loop there are SSE2 and AVX2 kernels for x86-64 and
+// a NEON kernel for AArch64. All of them compute, for each colour channel,
+//
+//    Temp = Comp * (255 - Alpha) + Top * Alpha + 0x80
+//    Comp = (Temp + (Temp >> 8)) >> 8
+//
+// Every intermediate value fits in 16 bits, so the vector kernels work on
+// 16-bit lanes and produce results that are bit-identical to the scalar
+// loop. The alpha byte of the composited pixels is left untouched. Pixels
+// left over at the end of a row are handled by the scalar loop.
+//
+// egRawComposePremultiplied() is the same "over" operator for a top image
+// whose colour channels have already been multiplied by its alpha (see
+// egPremultiplyImage()). That leaves a single multiply-add per channel:
+//
+//    Temp = Comp * (255 - Alpha) + 0x80
+//    Comp = Top + ((Temp + (Temp >> 8)) >> 8)
+//
+
+#include "libegint.h"
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#include <emmintrin.h>
+#include <immintrin.h>
+#elif defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+typedef VOID (*EG_COMPOSE_FUNC)(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                                IN UINTN Width, IN UINTN Height,
+                                IN UINTN CompLineOffset, IN UINTN TopLineOffset);
+
+static EG_COMPOSE_FUNC egComposeKernel = NULL;
+static EG_COMPOSE_FUNC egComposePremultipliedKernel = NULL;
+
+//
+// Portable kernel
+//
+
+static VOID egComposeRow(IN OUT EG_PIXEL *CompPtr, IN EG_PIXEL *TopPtr, IN UINTN Width)
+{
+    UINTN       x;
+    UINTN       Alpha;
+    UINTN       RevAlpha;
+    UINTN       Temp;
+
+    for (x = 0; x < Width; x++) {
+        Alpha = TopPtr->a;
+        RevAlpha = 255 - Alpha;
+        Temp = (UINTN)CompPtr->b * RevAlpha + (UINTN)TopPtr->b * Alpha + 0x80;
+        CompPtr->b = (Temp + (Temp >> 8)) >> 8;
+        Temp = (UINTN)CompPtr->g * RevAlpha + (UINTN)TopPtr->g * Alpha + 0x80;
+        CompPtr->g = (Temp + (Temp >> 8)) >> 8;
+        Temp = (UINTN)CompPtr->r * RevAlpha + (UINTN)TopPtr->r * Alpha + 0x80;
+        CompPtr->r = (Temp + (Temp >> 8)) >> 8;
+        TopPtr++, CompPtr++;
+    }
+}
+
+static VOID egComposeScalar(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                            IN UINTN Width, IN UINTN Height,
+                            IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    UINTN       y;
+
+    for (y = 0; y < Height; y++) {
+        egComposeRow(CompBasePtr, TopBasePtr, Width);
+        TopBasePtr += TopLineOffset;
+        CompBasePtr += CompLineOffset;
+    }
+}
+
+static VOID egComposePremultipliedRow(IN OUT EG_PIXEL *CompPtr, IN EG_PIXEL *TopPtr, IN UINTN Width)
+{
+    UINTN       x;
+    UINTN       RevAlpha;
+    UINTN       Temp;
+
+    for (x = 0; x < Width; x++) {
+        RevAlpha = 255 - TopPtr->a;
+        Temp = (UINTN)CompPtr->b * RevAlpha + 0x80;
+        CompPtr->b = TopPtr->b + ((Temp + (Temp >> 8)) >> 8);
+        Temp = (UINTN)CompPtr->g * RevAlpha + 0x80;
+        CompPtr->g = TopPtr->g + ((Temp + (Temp >> 8)) >> 8);
+        Temp = (UINTN)CompPtr->r * RevAlpha + 0x80;
+        CompPtr->r = TopPtr->r + ((Temp + (Temp >> 8)) >> 8);
+        TopPtr++, CompPtr++;
+    }
+}
+
+static VOID egComposePremultipliedScalar(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                                         IN UINTN Width, IN UINTN Height,
+                                         IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    UINTN       y;
+
+    for (y = 0; y < Height; y++) {
+        egComposePremultipliedRow(CompBasePtr, TopBasePtr, Width);
+        TopBasePtr += TopLineOffset;
+        CompBasePtr += CompLineOffset;
+    }
+}
+
+#if defined(__x86_64__)
+
+//
+// x86-64 kernels
+//
+
+// Blends the two pixels held in the low 16-bit lanes of Comp/Top; the
+// alpha lanes are computed too but discarded by the caller.
+static inline __m128i egBlend2SSE2(__m128i Comp, __m128i Top)
+{
+    __m128i Alpha, RevAlpha, Temp;
+
+    Alpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(Top, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    RevAlpha = _mm_xor_si128(Alpha, _mm_set1_epi16(0x00ff));
+    Temp = _mm_add_epi16(_mm_mullo_epi16(Comp, RevAlpha), _mm_mullo_epi16(Top, Alpha));
+    Temp = _mm_add_epi16(Temp, _mm_set1_epi16(0x80));
+    return _mm_srli_epi16(_mm_add_epi16(Temp, _mm_srli_epi16(Temp, 8)), 8);
+}
+
+static VOID egComposeSSE2(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                          IN UINTN Width, IN UINTN Height,
+                          IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    UINTN       x, y;
+    __m128i     Zero, AlphaMask, Comp, Top, Lo, Hi;
+
+    Zero = _mm_setzero_si128();
+    AlphaMask = _mm_set1_epi32((int)0xff000000);
+    for (y = 0; y < Height; y++) {
+        for (x = 0; x + 4 <= Width; x += 4) {
+            Comp = _mm_loadu_si128((__m128i *)(CompBasePtr + x));
+            Top = _mm_loadu_si128((__m128i *)(TopBasePtr + x));
+            Lo = egBlend2SSE2(_mm_unpacklo_epi8(Comp, Zero), _mm_unpacklo_epi8(Top, Zero));
+            Hi = egBlend2SSE2(_mm_unpackhi_epi8(Comp, Zero), _mm_unpackhi_epi8(Top, Zero));
+            Lo = _mm_packus_epi16(Lo, Hi);
+            Comp = _mm_or_si128(_mm_andnot_si128(AlphaMask, Lo), _mm_and_si128(AlphaMask, Comp));
+            _mm_storeu_si128((__m128i *)(CompBasePtr + x), Comp);
+        }
+        egComposeRow(CompBasePtr + x, TopBasePtr + x, Width - x);
+        TopBasePtr += TopLineOffset;
+        CompBasePtr += CompLineOffset;
+    }
+}
+
+static inline __m128i egBlendPremultiplied2SSE2(__m128i Comp, __m128i Top)
+{
+    __m128i RevAlpha, Temp;
+
+    RevAlpha = _mm_shufflehi_epi16(_mm_shufflelo_epi16(Top, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    RevAlpha = _mm_xor_si128(RevAlpha, _mm_set1_epi16(0x00ff));
+    Temp = _mm_add_epi16(_mm_mullo_epi16(Comp, RevAlpha), _mm_set1_epi16(0x80));
+    return _mm_add_epi16(Top, _mm_srli_epi16(_mm_add_epi16(Temp, _mm_srli_epi16(Temp, 8)), 8));
+}
+
+static VOID egComposePremultipliedSSE2(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                                       IN UINTN Width, IN UINTN Height,
+                                       IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    UINTN       x, y;
+    __m128i     Zero, AlphaMask, Comp, Top, Lo, Hi;
+
+    Zero = _mm_setzero_si128();
+    AlphaMask = _mm_set1_epi32((int)0xff000000);
+    for (y = 0; y < Height; y++) {
+        for (x = 0; x + 4 <= Width; x += 4) {
+            Comp = _mm_loadu_si128((__m128i *)(CompBasePtr + x));
+            Top = _mm_loadu_si128((__m128i *)(TopBasePtr + x));
+            Lo = egBlendPremultiplied2SSE2(_mm_unpacklo_epi8(Comp, Zero), _mm_unpacklo_epi8(Top, Zero));
+            Hi = egBlendPremultiplied2SSE2(_mm_unpackhi_epi8(Comp, Zero), _mm_unpackhi_epi8(Top, Zero));
+            Lo = _mm_packus_epi16(Lo, Hi);
+            Comp = _mm_or_si128(_mm_andnot_si128(AlphaMask, Lo), _mm_and_si128(AlphaMask, Comp));
+            _mm_storeu_si128((__m128i *)(CompBasePtr + x), Comp);
+        }
+        egComposePremultipliedRow(CompBasePtr + x, TopBasePtr + x, Width - x);
+        TopBasePtr += TopLineOffset;
+        CompBasePtr += CompLineOffset;
+    }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i egBlend2AVX2(__m256i Comp, __m256i Top)
+{
+    __m256i Alpha, RevAlpha, Temp;
+
+    Alpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(Top, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    RevAlpha = _mm256_xor_si256(Alpha, _mm256_set1_epi16(0x00ff));
+    Temp = _mm256_add_epi16(_mm256_mullo_epi16(Comp, RevAlpha), _mm256_mullo_epi16(Top, Alpha));
+    Temp = _mm256_add_epi16(Temp, _mm256_set1_epi16(0x80));
+    return _mm256_srli_epi16(_mm256_add_epi16(Temp, _mm256_srli_epi16(Temp, 8)), 8);
+}
+
+// The AVX2 unpack and pack instructions work within 128-bit lanes, so the
+// pixel order survives the unpack/blend/pack round trip unchanged.
+__attribute__((target("avx2")))
+static VOID egComposeAVX2(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                          IN UINTN Width, IN UINTN Height,
+                          IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    UINTN       x, y;
+    __m256i     Zero, AlphaMask, Comp, Top, Lo, Hi;
+
+    Zero = _mm256_setzero_si256();
+    AlphaMask = _mm256_set1_epi32((int)0xff000000);
+    for (y = 0; y < Height; y++) {
+        for (x = 0; x + 8 <= Width; x += 8) {
+            Comp = _mm256_loadu_si256((__m256i *)(CompBasePtr + x));
+            Top = _mm256_loadu_si256((__m256i *)(TopBasePtr + x));
+            Lo = egBlend2AVX2(_mm256_unpacklo_epi8(Comp, Zero), _mm256_unpacklo_epi8(Top, Zero));
+            Hi = egBlend2AVX2(_mm256_unpackhi_epi8(Comp, Zero), _mm256_unpackhi_epi8(Top, Zero));
+            Lo = _mm256_packus_epi16(Lo, Hi);
+            Comp = _mm256_or_si256(_mm256_andnot_si256(AlphaMask, Lo), _mm256_and_si256(AlphaMask, Comp));
+            _mm256_storeu_si256((__m256i *)(CompBasePtr + x), Comp);
+        }
+        egComposeRow(CompBasePtr + x, TopBasePtr + x, Width - x);
+        TopBasePtr += TopLineOffset;
+        CompBasePtr += CompLineOffset;
+    }
+    _mm256_zeroupper();
+}
+
+__attribute__((target("avx2")))
+static inline __m256i egBlendPremultiplied2AVX2(__m256i Comp, __m256i Top)
+{
+    __m256i RevAlpha, Temp;
+
+    RevAlpha = _mm256_shufflehi_epi16(_mm256_shufflelo_epi16(Top, _MM_SHUFFLE(3, 3, 3, 3)), _MM_SHUFFLE(3, 3, 3, 3));
+    RevAlpha = _mm256_xor_si256(RevAlpha, _mm256_set1_epi16(0x00ff));
+    Temp = _mm256_add_epi16(_mm256_mullo_epi16(Comp, RevAlpha), _mm256_set1_epi16(0x80));
+    return _mm256_add_epi16(Top, _mm256_srli_epi16(_mm256_add_epi16(Temp, _mm256_srli_epi16(Temp, 8)), 8));
+}
+
+__attribute__((target("avx2")))
+static VOID egComposePremultipliedAVX2(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                                       IN UINTN Width, IN UINTN Height,
+                                       IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    UINTN       x, y;
+    __m256i     Zero, AlphaMask, Comp, Top, Lo, Hi;
+
+    Zero = _mm256_setzero_si256();
+    AlphaMask = _mm256_set1_epi32((int)0xff000000);
+    for (y = 0; y < Height; y++) {
+        for (x = 0; x + 8 <= Width; x += 8) {
+            Comp = _mm256_loadu_si256((__m256i *)(CompBasePtr + x));
+            Top = _mm256_loadu_si256((__m256i *)(TopBasePtr + x));
+            Lo = egBlendPremultiplied2AVX2(_mm256_unpacklo_epi8(Comp, Zero), _mm256_unpacklo_epi8(Top, Zero));
+            Hi = egBlendPremultiplied2AVX2(_mm256_unpackhi_epi8(Comp, Zero), _mm256_unpackhi_epi8(Top, Zero));
+            Lo = _mm256_packus_epi16(Lo, Hi);
+            Comp = _mm256_or_si256(_mm256_andnot_si256(AlphaMask, Lo), _mm256_and_si256(AlphaMask, Comp));
+            _mm256_storeu_si256((__m256i *)(CompBasePtr + x), Comp);
+        }
+        egComposePremultipliedRow(CompBasePtr + x, TopBasePtr + x, Width - x);
+        TopBasePtr += TopLineOffset;
+        CompBasePtr += CompLineOffset;
+    }
+    _mm256_zeroupper();
+}
+
+// AVX2 is only usable if the CPU has it *and* the firmware has enabled the
+// YMM register state via XCR0; many firmwares never set CR4.OSXSAVE.
+static BOOLEAN egCpuHasAVX2(VOID)
+{
+    UINT32      Eax, Ebx, Ecx, Edx;
+    UINT32      XcrLo, XcrHi;
+
+    if (__get_cpuid_max(0, NULL) < 7)
+        return FALSE;
+    __cpuid(1, Eax, Ebx, Ecx, Edx);
+    if ((Ecx & bit_OSXSAVE) == 0 || (Ecx & bit_AVX) == 0)
+        return FALSE;
+    __asm__ __volatile__ ("xgetbv" : "=a" (XcrLo), "=d" (XcrHi) : "c" (0));
+    if ((XcrLo & 0x06) != 0x06)
+        return FALSE;
+    __cpuid_count(7, 0, Eax, Ebx, Ecx, Edx);
+    return (Ebx & bit_AVX2) ? TRUE : FALSE;
+}
+
+#elif defined(__aarch64__)
+
+//
+// AArch64 kernel
+//
+
+static VOID egComposeNEON(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                          IN UINTN Width, IN UINTN Height,
+                          IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    UINTN       x, y, i;
+    uint8x8x4_t Comp, Top;
+    uint8x8_t   RevAlpha;
+    uint16x8_t  Temp, Round;
+
+    Round = vdupq_n_u16(0x80);
+    for (y = 0; y < Height; y++) {
+        for (x = 0; x + 8 <= Width; x += 8) {
+            Comp = vld4_u8((UINT8 *)(CompBasePtr + x));
+            Top = vld4_u8((UINT8 *)(TopBasePtr + x));
+            RevAlpha = vmvn_u8(Top.val[3]);
+            for (i = 0; i < 3; i++) {
+                Temp = vmlal_u8(vmull_u8(Comp.val[i], RevAlpha), Top.val[i], Top.val[3]);
+                Temp = vaddq_u16(Temp, Round);
+                Comp.val[i] = vshrn_n_u16(vsraq_n_u16(Temp, Temp, 8), 8);
+            }
+            vst4_u8((UINT8 *)(CompBasePtr + x), Comp);
+        }
+        egComposeRow(CompBasePtr + x, TopBasePtr + x, Width - x);
+        TopBasePtr += TopLineOffset;
+        CompBasePtr += CompLineOffset;
+    }
+}
+
+static VOID egComposePremultipliedNEON(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                                       IN UINTN Width, IN UINTN Height,
+                                       IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    UINTN       x, y, i;
+    uint8x8x4_t Comp, Top;
+    uint8x8_t   RevAlpha;
+    uint16x8_t  Temp, Round;
+
+    Round = vdupq_n_u16(0x80);
+    for (y = 0; y < Height; y++) {
+        for (x = 0; x + 8 <= Width; x += 8) {
+            Comp = vld4_u8((UINT8 *)(CompBasePtr + x));
+            Top = vld4_u8((UINT8 *)(TopBasePtr + x));
+            RevAlpha = vmvn_u8(Top.val[3]);
+            for (i = 0; i < 3; i++) {
+                Temp = vaddq_u16(vmull_u8(Comp.val[i], RevAlpha), Round);
+                Comp.val[i] = vadd_u8(Top.val[i], vshrn_n_u16(vsraq_n_u16(Temp, Temp, 8), 8));
+            }
+            vst4_u8((UINT8 *)(CompBasePtr + x), Comp);
+        }
+        egComposePremultipliedRow(CompBasePtr + x, TopBasePtr + x, Width - x);
+        TopBasePtr += TopLineOffset;
+        CompBasePtr += CompLineOffset;
+    }
+}
+
+#endif
+
+//
+// Kernel selection
+//
+
+// size of the block used to check the vector kernels; the odd width makes
+// sure that their scalar tails are checked too
+#define COMPOSE_CHECK_WIDTH     (37)
+#define COMPOSE_CHECK_HEIGHT    (2)
+#define COMPOSE_CHECK_PIXELS    (COMPOSE_CHECK_WIDTH * COMPOSE_CHECK_HEIGHT)
+
+// Returns TRUE if Kernel gives exactly the same result as Reference on a
+// block of pseudo-random pixels, including fully transparent and fully
+// opaque ones. For the premultiplied kernels, the top pixels' colour
+// channels are kept within their alpha, as premultiplication guarantees.
+static BOOLEAN egComposeKernelMatches(IN EG_COMPOSE_FUNC Kernel, IN EG_COMPOSE_FUNC Reference,
+                                      IN BOOLEAN Premultiplied)
+{
+    EG_PIXEL    Top[COMPOSE_CHECK_PIXELS];
+    EG_PIXEL    Expected[COMPOSE_CHECK_PIXELS];
+    EG_PIXEL    Actual[COMPOSE_CHECK_PIXELS];
+    UINT8       *Bytes;
+    UINT32      Seed = 0x2545F491;
+    UINTN       i;
+
+    Bytes = (UINT8 *)Expected;
+    for (i = 0; i < sizeof(Expected); i++) {
+        Seed = Seed * 1103515245 + 12345;
+        Bytes[i] = (UINT8)(Seed >> 16);
+    }
+    Bytes = (UINT8 *)Top;
+    for (i = 0; i < sizeof(Top); i++) {
+        Seed = Seed * 1103515245 + 12345;
+        Bytes[i] = (UINT8)(Seed >> 16);
+    }
+    Top[0].a = 0;
+    Top[1].a = 255;
+    if (Premultiplied) {
+        for (i = 0; i < COMPOSE_CHECK_PIXELS; i++) {
+            Top[i].b = (UINT8)(Top[i].b % (Top[i].a + 1));
+            Top[i].g = (UINT8)(Top[i].g % (Top[i].a + 1));
+            Top[i].r = (UINT8)(Top[i].r % (Top[i].a + 1));
+        }
+    }
+    CopyMem(Actual, Expected, sizeof(Actual));
+
+    Reference(Expected, Top, COMPOSE_CHECK_WIDTH, COMPOSE_CHECK_HEIGHT, COMPOSE_CHECK_WIDTH, COMPOSE_CHECK_WIDTH);
+    Kernel(Actual, Top, COMPOSE_CHECK_WIDTH, COMPOSE_CHECK_HEIGHT, COMPOSE_CHECK_WIDTH, COMPOSE_CHECK_WIDTH);
+    return (CompareMem(Expected, Actual, sizeof(Actual)) == 0);
+}
+
+// Picks the fastest compositing kernel the CPU supports. Called from
+// egInitScreen(), and lazily by egRawCompose() should anything compose
+// before that. A vector kernel that doesn't match the portable loop on a
+// test block is not used, so a broken kernel (or CPU feature detection)
+// can't corrupt the display.
+VOID egInitCompose(VOID)
+{
+    egComposeKernel = egComposeScalar;
+    egComposePremultipliedKernel = egComposePremultipliedScalar;
+#if defined(__x86_64__)
+    if (egCpuHasAVX2()) {
+        egComposeKernel = egComposeAVX2;
+        egComposePremultipliedKernel = egComposePremultipliedAVX2;
+    } else {
+        // SSE2 is part of the x86-64 baseline
+        egComposeKernel = egComposeSSE2;
+        egComposePremultipliedKernel = egComposePremultipliedSSE2;
+    }
+#elif defined(__aarch64__)
+    egComposeKernel = egComposeNEON;
+    egComposePremultipliedKernel = egComposePremultipliedNEON;
+#endif
+
+    if (egComposeKernel != egComposeScalar &&
+        !egComposeKernelMatches(egComposeKernel, egComposeScalar, FALSE))
+        egComposeKernel = egComposeScalar;
+    if (egComposePremultipliedKernel != egComposePremultipliedScalar &&
+        !egComposeKernelMatches(egComposePremultipliedKernel, egComposePremultipliedScalar, TRUE))
+        egComposePremultipliedKernel = egComposePremultipliedScalar;
+}
+
+VOID egRawCompose(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                  IN UINTN Width, IN UINTN Height,
+                  IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    if (egComposeKernel == NULL)
+        egInitCompose();
+    egComposeKernel(CompBasePtr, TopBasePtr, Width, Height, CompLineOffset, TopLineOffset);
+}
+
+VOID egRawComposePremultiplied(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
+                               IN UINTN Width, IN UINTN Height,
+                               IN UINTN CompLineOffset, IN UINTN TopLineOffset)
+{
+    if (egComposePremultipliedKernel == NULL)
+        egInitCompose();
+    egComposePremultipliedKernel(CompBasePtr, TopBasePtr, Width, Height, CompLineOffset, TopLineOffset);
+}
+
+/* EOF */
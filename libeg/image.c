@@ -61,6 +61,8 @@ EG_IMAGE * egCreateImage(IN UINTN Width, IN UINTN Height, IN BOOLEAN HasAlpha)
     NewImage->Width = Width;
     NewImage->Height = Height;
     NewImage->HasAlpha = HasAlpha;
+    NewImage->Premultiplied = FALSE;
+    NewImage->ReadOnly = FALSE;
     return NewImage;
 }
 
@@ -85,18 +87,38 @@ EG_IMAGE * egCopyImage(IN EG_IMAGE *Image)
         return NULL;
 
     CopyMem(NewImage->PixelData, Image->PixelData, Image->Width * Image->Height * sizeof(EG_PIXEL));
+    NewImage->Premultiplied = Image->Premultiplied;
     return NewImage;
 }
 
 VOID egFreeImage(IN EG_IMAGE *Image)
 {
     if (Image != NULL) {
-        if (Image->PixelData != NULL)
+        if (Image->PixelData != NULL && !Image->ReadOnly)
             FreePool(Image->PixelData);
         FreePool(Image);
     }
 }
 
+// Read-only images (such as the pre-expanded embedded ones) share their
+// pixels with constant data. Anything that modifies an image's pixels must
+// call this first; it gives the image its own copy of the pixels if needed.
+EFI_STATUS egMakeImageWritable(IN OUT EG_IMAGE *Image)
+{
+    EG_PIXEL        *PixelData;
+
+    if (!Image->ReadOnly)
+        return EFI_SUCCESS;
+
+    PixelData = (EG_PIXEL *) AllocatePool(Image->Width * Image->Height * sizeof(EG_PIXEL));
+    if (PixelData == NULL)
+        return EFI_OUT_OF_RESOURCES;
+    CopyMem(PixelData, Image->PixelData, Image->Width * Image->Height * sizeof(EG_PIXEL));
+    Image->PixelData = PixelData;
+    Image->ReadOnly = FALSE;
+    return EFI_SUCCESS;
+}
+
 //
 // Basic file operations
 //
@@ -206,7 +228,7 @@ static CHAR16 * egFindExtension(IN CHAR16 *FileName)
 }
 
 static EG_IMAGE * egDecodeAny(IN UINT8 *FileData, IN UINTN FileDataLength,
-                              IN CHAR16 *Format, IN UINTN IconSize, IN BOOLEAN WantAlpha)
+                              IN CHAR16 *Format, IN UINTN IconSize, IN UINTN WantAlpha)
 {
    EG_IMAGE        *NewImage = NULL;
 
@@ -224,7 +246,7 @@ static EG_IMAGE * egDecodeAny(IN UINT8 *FileData, IN UINTN FileDataLength,
    return NewImage;
 }
 
-EG_IMAGE * egLoadImage(IN EFI_FILE* BaseDir, IN CHAR16 *FileName, IN BOOLEAN WantAlpha)
+EG_IMAGE * egLoadImage(IN EFI_FILE* BaseDir, IN CHAR16 *FileName, IN UINTN WantAlpha)
 {
     EFI_STATUS      Status;
     UINT8           *FileData;
@@ -274,32 +296,82 @@ EG_IMAGE * egLoadIcon(IN EFI_FILE* BaseDir, IN CHAR16 *Path, IN UINTN IconSize)
            return NULL;
     }
 
-    // decode it
-    NewImage = egDecodeAny(FileData, FileDataLength, egFindExtension(Path), IconSize, TRUE);
+    // decode it; icons are composited far more often than they're loaded,
+    // so store them premultiplied
+    NewImage = egDecodeAny(FileData, FileDataLength, egFindExtension(Path), IconSize, EG_ALPHA_PREMULTIPLIED);
     FreePool(FileData);
 
     return NewImage;
 } // EG_IMAGE *egLoadIcon()
 
-EG_IMAGE * egDecodeImage(IN UINT8 *FileData, IN UINTN FileDataLength, IN CHAR16 *Format, IN BOOLEAN WantAlpha)
+EG_IMAGE * egDecodeImage(IN UINT8 *FileData, IN UINTN FileDataLength, IN CHAR16 *Format, IN UINTN WantAlpha)
 {
     return egDecodeAny(FileData, FileDataLength, Format, 128, WantAlpha);
 }
 
-EG_IMAGE * egPrepareEmbeddedImage(IN EG_EMBEDDED_IMAGE *EmbeddedImage, IN BOOLEAN WantAlpha)
+// Wraps a pre-expanded (EG_EICOMPMODE_BGRA) embedded image. If it's
+// stored in the form that was asked for, the result is a read-only view of
+// the embedded pixels; otherwise a converted copy is made. Premultiplied
+// images are handed out as such even when straight alpha was asked for,
+// since egComposeImage() handles both.
+static EG_IMAGE * egPrepareExpandedImage(IN EG_EMBEDDED_IMAGE *EmbeddedImage, IN UINTN WantAlpha)
+{
+    EG_IMAGE            *NewImage;
+    UINTN               PixelCount;
+    BOOLEAN             StoredAlpha;
+
+    PixelCount = EmbeddedImage->Width * EmbeddedImage->Height;
+    if (EmbeddedImage->DataLength < PixelCount * sizeof(EG_PIXEL))
+        return NULL;
+    StoredAlpha = (EmbeddedImage->PixelMode != EG_EIPIXELMODE_COLOR);
+
+    NewImage = (EG_IMAGE *) AllocatePool(sizeof(EG_IMAGE));
+    if (NewImage == NULL)
+        return NULL;
+    NewImage->Width = EmbeddedImage->Width;
+    NewImage->Height = EmbeddedImage->Height;
+    NewImage->HasAlpha = StoredAlpha;
+    NewImage->Premultiplied = (EmbeddedImage->PixelMode == EG_EIPIXELMODE_COLOR_PREMULTIPLIED);
+    NewImage->ReadOnly = TRUE;
+    NewImage->PixelData = (EG_PIXEL *)EmbeddedImage->Data;   // drop const
+
+    if ((WantAlpha != EG_ALPHA_NONE) == StoredAlpha &&
+        !(WantAlpha == EG_ALPHA_PREMULTIPLIED && !NewImage->Premultiplied))
+        return NewImage;
+
+    // the stored form doesn't fit; convert a private copy
+    if (egMakeImageWritable(NewImage) != EFI_SUCCESS) {
+        egFreeImage(NewImage);
+        return NULL;
+    }
+    if (WantAlpha == EG_ALPHA_NONE || !StoredAlpha) {
+        egSetPlane(PLPTR(NewImage, a), WantAlpha ? 255 : 0, PixelCount);
+        NewImage->HasAlpha = (WantAlpha != EG_ALPHA_NONE);
+        NewImage->Premultiplied = FALSE;
+    }
+    if (WantAlpha == EG_ALPHA_PREMULTIPLIED)
+        egPremultiplyImage(NewImage);
+    return NewImage;
+}
+
+EG_IMAGE * egPrepareEmbeddedImage(IN EG_EMBEDDED_IMAGE *EmbeddedImage, IN UINTN WantAlpha)
 {
     EG_IMAGE            *NewImage;
     UINT8               *CompData;
     UINTN               CompLen;
     UINTN               PixelCount;
 
+    // pre-expanded images need no decoding
+    if (EmbeddedImage->CompressMode == EG_EICOMPMODE_BGRA)
+        return egPrepareExpandedImage(EmbeddedImage, WantAlpha);
+
     // sanity check
-    if (EmbeddedImage->PixelMode > EG_MAX_EIPIXELMODE ||
+    if (EmbeddedImage->PixelMode > EG_EIPIXELMODE_ALPHA ||
         (EmbeddedImage->CompressMode != EG_EICOMPMODE_NONE && EmbeddedImage->CompressMode != EG_EICOMPMODE_RLE))
         return NULL;
 
     // allocate image structure and pixel buffer
-    NewImage = egCreateImage(EmbeddedImage->Width, EmbeddedImage->Height, WantAlpha);
+    NewImage = egCreateImage(EmbeddedImage->Width, EmbeddedImage->Height, WantAlpha != EG_ALPHA_NONE);
     if (NewImage == NULL)
         return NULL;
 
@@ -364,6 +436,9 @@ EG_IMAGE * egPrepareEmbeddedImage(IN EG_EMBEDDED_IMAGE *EmbeddedImage, IN BOOLEA
         egSetPlane(PLPTR(NewImage, a), WantAlpha ? 255 : 0, PixelCount);
     }
 
+    if (WantAlpha == EG_ALPHA_PREMULTIPLIED)
+        egPremultiplyImage(NewImage);
+
     return NewImage;
 }
 
@@ -394,6 +469,9 @@ VOID egFillImage(IN OUT EG_IMAGE *CompImage, IN EG_PIXEL *Color)
     EG_PIXEL    FillColor;
     EG_PIXEL    *PixelPtr;
     
+    if (egMakeImageWritable(CompImage) != EFI_SUCCESS)
+        return;
+
     FillColor = *Color;
     if (!CompImage->HasAlpha)
         FillColor.a = 0;
@@ -415,7 +493,7 @@ VOID egFillImageArea(IN OUT EG_IMAGE *CompImage,
     
     egRestrictImageArea(CompImage, AreaPosX, AreaPosY, &AreaWidth, &AreaHeight);
     
-    if (AreaWidth > 0) {
+    if (AreaWidth > 0 && egMakeImageWritable(CompImage) == EFI_SUCCESS) {
         FillColor = *Color;
         if (!CompImage->HasAlpha)
             FillColor.a = 0;
@@ -449,40 +527,6 @@ VOID egRawCopy(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
     }
 }
 
-VOID egRawCompose(IN OUT EG_PIXEL *CompBasePtr, IN EG_PIXEL *TopBasePtr,
-                  IN UINTN Width, IN UINTN Height,
-                  IN UINTN CompLineOffset, IN UINTN TopLineOffset)
-{
-    UINTN       x, y;
-    EG_PIXEL    *TopPtr, *CompPtr;
-    UINTN       Alpha;
-    UINTN       RevAlpha;
-    UINTN       Temp;
-    
-    for (y = 0; y < Height; y++) {
-        TopPtr = TopBasePtr;
-        CompPtr = CompBasePtr;
-        for (x = 0; x < Width; x++) {
-            Alpha = TopPtr->a;
-            RevAlpha = 255 - Alpha;
-            Temp = (UINTN)CompPtr->b * RevAlpha + (UINTN)TopPtr->b * Alpha + 0x80;
-            CompPtr->b = (Temp + (Temp >> 8)) >> 8;
-            Temp = (UINTN)CompPtr->g * RevAlpha + (UINTN)TopPtr->g * Alpha + 0x80;
-            CompPtr->g = (Temp + (Temp >> 8)) >> 8;
-            Temp = (UINTN)CompPtr->r * RevAlpha + (UINTN)TopPtr->r * Alpha + 0x80;
-            CompPtr->r = (Temp + (Temp >> 8)) >> 8;
-            /*
-            CompPtr->b = ((UINTN)CompPtr->b * RevAlpha + (UINTN)TopPtr->b * Alpha) / 255;
-            CompPtr->g = ((UINTN)CompPtr->g * RevAlpha + (UINTN)TopPtr->g * Alpha) / 255;
-            CompPtr->r = ((UINTN)CompPtr->r * RevAlpha + (UINTN)TopPtr->r * Alpha) / 255;
-            */
-            TopPtr++, CompPtr++;
-        }
-        TopBasePtr += TopLineOffset;
-        CompBasePtr += CompLineOffset;
-    }
-}
-
 VOID egComposeImage(IN OUT EG_IMAGE *CompImage, IN EG_IMAGE *TopImage, IN UINTN PosX, IN UINTN PosY)
 {
     UINTN       CompWidth, CompHeight;
@@ -492,13 +536,17 @@ VOID egComposeImage(IN OUT EG_IMAGE *CompImage, IN EG_IMAGE *TopImage, IN UINTN
     egRestrictImageArea(CompImage, PosX, PosY, &CompWidth, &CompHeight);
     
     // compose
-    if (CompWidth > 0) {
+    if (CompWidth > 0 && egMakeImageWritable(CompImage) == EFI_SUCCESS) {
         if (CompImage->HasAlpha) {
             CompImage->HasAlpha = FALSE;
+            CompImage->Premultiplied = FALSE;
             egSetPlane(PLPTR(CompImage, a), 0, CompImage->Width * CompImage->Height);
         }
         
-        if (TopImage->HasAlpha)
+        if (TopImage->HasAlpha && TopImage->Premultiplied)
+            egRawComposePremultiplied(CompImage->PixelData + PosY * CompImage->Width + PosX, TopImage->PixelData,
+                                      CompWidth, CompHeight, CompImage->Width, TopImage->Width);
+        else if (TopImage->HasAlpha)
             egRawCompose(CompImage->PixelData + PosY * CompImage->Width + PosX, TopImage->PixelData,
                          CompWidth, CompHeight, CompImage->Width, TopImage->Width);
         else
@@ -527,6 +575,39 @@ EG_IMAGE * egEnsureImageSize(IN EG_IMAGE *Image, IN UINTN Width, IN UINTN Height
     return NewImage;
 }
 
+// Converts an image with straight alpha into premultiplied form, so that
+// egComposeImage() can use the cheaper compositing kernel for it. Images
+// without an alpha channel are simply flagged, since they're unaffected.
+VOID egPremultiplyImage(IN OUT EG_IMAGE *Image)
+{
+    UINTN       i, PixelCount;
+    UINTN       Alpha;
+    UINTN       Temp;
+    EG_PIXEL    *PixelPtr;
+
+    if (Image == NULL || Image->Premultiplied)
+        return;
+    if (Image->HasAlpha && egMakeImageWritable(Image) != EFI_SUCCESS)
+        return;
+
+    if (Image->HasAlpha) {
+        PixelCount = Image->Width * Image->Height;
+        PixelPtr = Image->PixelData;
+        for (i = 0; i < PixelCount; i++, PixelPtr++) {
+            Alpha = PixelPtr->a;
+            if (Alpha == 255)
+                continue;
+            Temp = (UINTN)PixelPtr->b * Alpha + 0x80;
+            PixelPtr->b = (Temp + (Temp >> 8)) >> 8;
+            Temp = (UINTN)PixelPtr->g * Alpha + 0x80;
+            PixelPtr->g = (Temp + (Temp >> 8)) >> 8;
+            Temp = (UINTN)PixelPtr->r * Alpha + 0x80;
+            PixelPtr->r = (Temp + (Temp >> 8)) >> 8;
+        }
+    }
+    Image->Premultiplied = TRUE;
+}
+
 //
 // misc internal functions
 //
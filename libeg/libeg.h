@@ -49,19 +49,37 @@ typedef struct {
     UINTN       Width;
     UINTN       Height;
     BOOLEAN     HasAlpha;
+    BOOLEAN     Premultiplied;  // colour channels already multiplied by alpha
+    BOOLEAN     ReadOnly;       // PixelData is shared constant data; see egMakeImageWritable()
     EG_PIXEL    *PixelData;
 } EG_IMAGE;
 
+// values for the WantAlpha argument of the image loading functions;
+// FALSE and TRUE continue to work as before
+#define EG_ALPHA_NONE               (0)
+#define EG_ALPHA_STRAIGHT           (1)
+#define EG_ALPHA_PREMULTIPLIED      (2)
+
 #define EG_EIPIXELMODE_GRAY         (0)
 #define EG_EIPIXELMODE_GRAY_ALPHA   (1)
 #define EG_EIPIXELMODE_COLOR        (2)
 #define EG_EIPIXELMODE_COLOR_ALPHA  (3)
 #define EG_EIPIXELMODE_ALPHA        (4)
-#define EG_MAX_EIPIXELMODE          EG_EIPIXELMODE_ALPHA
+#define EG_EIPIXELMODE_COLOR_PREMULTIPLIED (5)   // only with EG_EICOMPMODE_BGRA
+#define EG_MAX_EIPIXELMODE          EG_EIPIXELMODE_COLOR_PREMULTIPLIED
 
 #define EG_EICOMPMODE_NONE          (0)
 #define EG_EICOMPMODE_RLE           (1)
 #define EG_EICOMPMODE_EFICOMPRESS   (2)
+#define EG_EICOMPMODE_BGRA          (3)   // Data is an array of EG_PIXELs, as built by mkegemb
+
+typedef struct {
+    UINTN       FrameCount;         // frames presented via egEndFrame()
+    UINTN       BltCount;           // Blt calls made by the last frame
+    UINTN       PixelCount;         // pixels transferred by the last frame
+    UINTN       TotalBltCount;      // all Blt calls, buffered or not
+    UINTN       TotalPixelCount;
+} EG_SCREEN_STATS;
 
 typedef struct {
     UINTN       Width;
@@ -89,11 +107,13 @@ EG_IMAGE * egCreateImage(IN UINTN Width, IN UINTN Height, IN BOOLEAN HasAlpha);
 EG_IMAGE * egCreateFilledImage(IN UINTN Width, IN UINTN Height, IN BOOLEAN HasAlpha, IN EG_PIXEL *Color);
 EG_IMAGE * egCopyImage(IN EG_IMAGE *Image);
 VOID egFreeImage(IN EG_IMAGE *Image);
+EFI_STATUS egMakeImageWritable(IN OUT EG_IMAGE *Image);
+VOID egPremultiplyImage(IN OUT EG_IMAGE *Image);
 
-EG_IMAGE * egLoadImage(IN EFI_FILE* BaseDir, IN CHAR16 *FileName, IN BOOLEAN WantAlpha);
+EG_IMAGE * egLoadImage(IN EFI_FILE* BaseDir, IN CHAR16 *FileName, IN UINTN WantAlpha);
 EG_IMAGE * egLoadIcon(IN EFI_FILE* BaseDir, IN CHAR16 *FileName, IN UINTN IconSize);
-EG_IMAGE * egDecodeImage(IN UINT8 *FileData, IN UINTN FileDataLength, IN CHAR16 *Format, IN BOOLEAN WantAlpha);
-EG_IMAGE * egPrepareEmbeddedImage(IN EG_EMBEDDED_IMAGE *EmbeddedImage, IN BOOLEAN WantAlpha);
+EG_IMAGE * egDecodeImage(IN UINT8 *FileData, IN UINTN FileDataLength, IN CHAR16 *Format, IN UINTN WantAlpha);
+EG_IMAGE * egPrepareEmbeddedImage(IN EG_EMBEDDED_IMAGE *EmbeddedImage, IN UINTN WantAlpha);
 
 EG_IMAGE * egEnsureImageSize(IN EG_IMAGE *Image, IN UINTN Width, IN UINTN Height, IN EG_PIXEL *Color);
 
@@ -111,6 +131,8 @@ VOID egComposeImage(IN OUT EG_IMAGE *CompImage, IN EG_IMAGE *TopImage, IN UINTN
 
 VOID egMeasureText(IN CHAR16 *Text, OUT UINTN *Width, OUT UINTN *Height);
 VOID egRenderText(IN CHAR16 *Text, IN OUT EG_IMAGE *CompImage, IN UINTN PosX, IN UINTN PosY);
+VOID egRenderTextOnBackground(IN CHAR16 *Text, IN OUT EG_IMAGE *CompImage, IN UINTN PosX, IN UINTN PosY,
+                              IN EG_PIXEL *Background);
 
 VOID egClearScreen(IN EG_PIXEL *Color);
 VOID egDrawImage(IN EG_IMAGE *Image, IN UINTN ScreenPosX, IN UINTN ScreenPosY);
@@ -119,6 +141,11 @@ VOID egDrawImageArea(IN EG_IMAGE *Image,
                      IN UINTN AreaWidth, IN UINTN AreaHeight,
                      IN UINTN ScreenPosX, IN UINTN ScreenPosY);
 
+VOID egBeginFrame(VOID);
+VOID egEndFrame(VOID);
+VOID egInvalidateScreen(VOID);
+VOID egGetScreenStats(OUT EG_SCREEN_STATS *Stats);
+
 VOID egScreenShot(VOID);
 
 
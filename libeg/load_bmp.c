@@ -72,7 +72,7 @@ typedef struct {
 // Load BMP image
 //
 
-EG_IMAGE * egDecodeBMP(IN UINT8 *FileData, IN UINTN FileDataLength, IN UINTN IconSize, IN BOOLEAN WantAlpha)
+EG_IMAGE * egDecodeBMP(IN UINT8 *FileData, IN UINTN FileDataLength, IN UINTN IconSize, IN UINTN WantAlpha)
 {
     EG_IMAGE            *NewImage;
     BMP_IMAGE_HEADER    *BmpHeader;
@@ -112,10 +112,12 @@ EG_IMAGE * egDecodeBMP(IN UINT8 *FileData, IN UINTN FileDataLength, IN UINTN Ico
         return NULL;
     
     // allocate image structure and buffer
-    NewImage = egCreateImage(BmpHeader->PixelWidth, BmpHeader->PixelHeight, WantAlpha);
+    NewImage = egCreateImage(BmpHeader->PixelWidth, BmpHeader->PixelHeight, WantAlpha != EG_ALPHA_NONE);
     if (NewImage == NULL)
         return NULL;
     AlphaValue = WantAlpha ? 255 : 0;
+    // BMPs are always opaque, so they're premultiplied as they stand
+    NewImage->Premultiplied = (WantAlpha == EG_ALPHA_PREMULTIPLIED);
     
     // convert image
     BmpColorMap = (BMP_COLOR_MAP *)(FileData + sizeof(BMP_IMAGE_HEADER));
@@ -92,7 +92,7 @@ VOID egDecompressIcnsRLE(IN OUT UINT8 **CompData, IN OUT UINTN *CompLen, IN UINT
 // Load Apple .icns icons
 //
 
-EG_IMAGE * egDecodeICNS(IN UINT8 *FileData, IN UINTN FileDataLength, IN UINTN IconSize, IN BOOLEAN WantAlpha)
+EG_IMAGE * egDecodeICNS(IN UINT8 *FileData, IN UINTN FileDataLength, IN UINTN IconSize, IN UINTN WantAlpha)
 {
     EG_IMAGE            *NewImage;
     UINT8               *Ptr, *BufferEnd, *DataPtr, *MaskPtr;
@@ -181,7 +181,7 @@ EG_IMAGE * egDecodeICNS(IN UINT8 *FileData, IN UINTN FileDataLength, IN UINTN Ic
         return NULL;   // no image found
 
     // allocate image structure and buffer
-    NewImage = egCreateImage(FetchPixelSize, FetchPixelSize, WantAlpha);
+    NewImage = egCreateImage(FetchPixelSize, FetchPixelSize, WantAlpha != EG_ALPHA_NONE);
     if (NewImage == NULL)
         return NULL;
     PixelCount = FetchPixelSize * FetchPixelSize;
@@ -217,6 +217,8 @@ EG_IMAGE * egDecodeICNS(IN UINT8 *FileData, IN UINTN FileDataLength, IN UINTN Ic
         egInsertPlane(MaskPtr, PLPTR(NewImage, a), PixelCount);
     else
         egSetPlane(PLPTR(NewImage, a), WantAlpha ? 255 : 0, PixelCount);
+    if (WantAlpha == EG_ALPHA_PREMULTIPLIED)
+        egPremultiplyImage(NewImage);
 
     // FUTURE: scale to originally requested size if we had to load another size
 
@@ -57,6 +57,27 @@ static BOOLEAN egHasGraphics = FALSE;
 static UINTN egScreenWidth  = 800;
 static UINTN egScreenHeight = 600;
 
+// Back buffer and dirty-rectangle state (see egBeginFrame())
+
+// Merging two damaged areas is worthwhile if it adds no more than this many
+// untouched pixels; a Blt call costs roughly as much as moving that many.
+#define EG_BLT_OVERHEAD_PIXELS  (4096)
+#define EG_MAX_DIRTY_RECTS      (16)
+
+typedef struct {
+    UINTN       XPos, YPos;
+    UINTN       Width, Height;
+} EG_RECT;
+
+static EG_IMAGE *egBackBuffer = NULL;
+static EG_IMAGE *egFrontBuffer = NULL;
+static BOOLEAN  egFrontBufferValid = FALSE;
+static BOOLEAN  egFrameCleared = FALSE;
+static UINTN    egFrameDepth = 0;
+static EG_RECT  egDirtyRects[EG_MAX_DIRTY_RECTS];
+static UINTN    egDirtyRectCount = 0;
+static EG_SCREEN_STATS egStats = { 0, 0, 0, 0, 0 };
+
 //
 // Screen handling
 //
@@ -95,6 +116,9 @@ VOID egInitScreen(VOID)
             egHasGraphics = TRUE;
         }
     }
+
+    // pick the alpha compositing kernel for this CPU
+    egInitCompose();
 }
 
 // Sets the screen resolution to the specified value, if possible.
@@ -206,6 +230,9 @@ VOID egSetGraphicsModeEnabled(IN BOOLEAN Enable)
     EFI_CONSOLE_CONTROL_SCREEN_MODE CurrentMode;
     EFI_CONSOLE_CONTROL_SCREEN_MODE NewMode;
 
+    // whatever was on the screen before may be gone
+    egInvalidateScreen();
+
     if (ConsoleControl != NULL) {
         refit_call4_wrapper(ConsoleControl->GetMode, ConsoleControl, &CurrentMode, NULL, NULL);
 
@@ -220,13 +247,301 @@ VOID egSetGraphicsModeEnabled(IN BOOLEAN Enable)
 // Drawing to the screen
 //
 
+// While a frame is open (see egBeginFrame()), drawing goes to an off-screen
+// back buffer rather than straight to the firmware, and the damaged areas
+// are recorded. egEndFrame() merges those areas and presents them with as
+// few Blt calls as possible. A second buffer shadows what is actually on
+// the screen, so areas whose contents didn't really change -- the usual
+// case when a menu is repainted -- are trimmed or skipped entirely.
+// Outside of a frame, drawing goes straight to the screen as before, but
+// both buffers are kept up to date once they exist.
+
+// Hands pixels to the firmware. All BufferToVideo transfers go through here.
+static VOID egBltToScreen(IN EG_IMAGE *Image,
+                          IN UINTN AreaPosX, IN UINTN AreaPosY,
+                          IN UINTN AreaWidth, IN UINTN AreaHeight,
+                          IN UINTN ScreenPosX, IN UINTN ScreenPosY)
+{
+    if (GraphicsOutput != NULL) {
+        refit_call10_wrapper(GraphicsOutput->Blt, GraphicsOutput, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)Image->PixelData, EfiBltBufferToVideo,
+                            AreaPosX, AreaPosY, ScreenPosX, ScreenPosY, AreaWidth, AreaHeight, Image->Width * 4);
+    } else if (UgaDraw != NULL) {
+        refit_call10_wrapper(UgaDraw->Blt, UgaDraw, (EFI_UGA_PIXEL *)Image->PixelData, EfiUgaBltBufferToVideo,
+                     AreaPosX, AreaPosY, ScreenPosX, ScreenPosY, AreaWidth, AreaHeight, Image->Width * 4);
+    }
+    egStats.TotalBltCount++;
+    egStats.TotalPixelCount += AreaWidth * AreaHeight;
+}
+
+// Creates the back and front buffers if necessary (or if the screen size
+// has changed). Returns FALSE if there isn't enough memory for them.
+static BOOLEAN egAllocBackBuffer(VOID)
+{
+    if (egBackBuffer != NULL &&
+        (egBackBuffer->Width != egScreenWidth || egBackBuffer->Height != egScreenHeight)) {
+        egFreeImage(egBackBuffer);
+        egFreeImage(egFrontBuffer);
+        egBackBuffer = egFrontBuffer = NULL;
+    }
+
+    if (egBackBuffer == NULL) {
+        egBackBuffer = egCreateImage(egScreenWidth, egScreenHeight, FALSE);
+        egFrontBuffer = egCreateImage(egScreenWidth, egScreenHeight, FALSE);
+        if (egBackBuffer == NULL || egFrontBuffer == NULL) {
+            egFreeImage(egBackBuffer);
+            egFreeImage(egFrontBuffer);
+            egBackBuffer = egFrontBuffer = NULL;
+            return FALSE;
+        }
+        egFrontBufferValid = FALSE;
+        egDirtyRectCount = 0;
+    }
+    return TRUE;
+}
+
+// Copies an area of Image into one of the screen-sized buffers, clipping
+// it to the screen.
+static VOID egCopyToBuffer(IN EG_IMAGE *Buffer, IN EG_IMAGE *Image,
+                           IN UINTN AreaPosX, IN UINTN AreaPosY,
+                           IN UINTN AreaWidth, IN UINTN AreaHeight,
+                           IN UINTN ScreenPosX, IN UINTN ScreenPosY)
+{
+    egRestrictImageArea(Buffer, ScreenPosX, ScreenPosY, &AreaWidth, &AreaHeight);
+    if (AreaWidth == 0)
+        return;
+    egRawCopy(Buffer->PixelData + ScreenPosY * Buffer->Width + ScreenPosX,
+              Image->PixelData + AreaPosY * Image->Width + AreaPosX,
+              AreaWidth, AreaHeight, Buffer->Width, Image->Width);
+}
+
+static VOID egUnionRect(IN EG_RECT *A, IN EG_RECT *B, OUT EG_RECT *Union)
+{
+    UINTN Right, Bottom;
+
+    Right  = A->XPos + A->Width;
+    if (B->XPos + B->Width > Right)
+        Right = B->XPos + B->Width;
+    Bottom = A->YPos + A->Height;
+    if (B->YPos + B->Height > Bottom)
+        Bottom = B->YPos + B->Height;
+    Union->XPos   = (A->XPos < B->XPos) ? A->XPos : B->XPos;
+    Union->YPos   = (A->YPos < B->YPos) ? A->YPos : B->YPos;
+    Union->Width  = Right - Union->XPos;
+    Union->Height = Bottom - Union->YPos;
+}
+
+#define RECT_AREA(Rect) ((Rect).Width * (Rect).Height)
+
+// Returns the number of pixels that A and B have in common.
+static UINTN egOverlapArea(IN EG_RECT *A, IN EG_RECT *B)
+{
+    UINTN Left, Right, Top, Bottom;
+
+    Left   = (A->XPos > B->XPos) ? A->XPos : B->XPos;
+    Right  = (A->XPos + A->Width < B->XPos + B->Width) ? A->XPos + A->Width : B->XPos + B->Width;
+    Top    = (A->YPos > B->YPos) ? A->YPos : B->YPos;
+    Bottom = (A->YPos + A->Height < B->YPos + B->Height) ? A->YPos + A->Height : B->YPos + B->Height;
+    if (Right <= Left || Bottom <= Top)
+        return 0;
+    return (Right - Left) * (Bottom - Top);
+}
+
+static VOID egFlushDirtyRects(VOID);
+
+// Records a damaged area of the back buffer, merging it with any already
+// recorded areas that it overlaps or nearly touches. A merged area takes in
+// pixels that weren't drawn in this frame; that's harmless while the front
+// buffer is valid, since those pixels are then the same on the screen and
+// get trimmed away. Otherwise the screen may hold something else there, so
+// areas are only merged if they fill their bounding box exactly.
+static VOID egAddDirtyRect(IN UINTN XPos, IN UINTN YPos, IN UINTN Width, IN UINTN Height)
+{
+    EG_RECT     NewRect, Union;
+    UINTN       i, Best, Growth, BestGrowth, Covered;
+
+    egRestrictImageArea(egBackBuffer, XPos, YPos, &Width, &Height);
+    if (Width == 0 || Height == 0)
+        return;
+    NewRect.XPos = XPos;
+    NewRect.YPos = YPos;
+    NewRect.Width = Width;
+    NewRect.Height = Height;
+
+    i = 0;
+    while (i < egDirtyRectCount) {
+        egUnionRect(&NewRect, &egDirtyRects[i], &Union);
+        Covered = RECT_AREA(NewRect) + RECT_AREA(egDirtyRects[i]) - egOverlapArea(&NewRect, &egDirtyRects[i]);
+        if (RECT_AREA(Union) == Covered ||
+            (egFrontBufferValid && RECT_AREA(Union) <= Covered + EG_BLT_OVERHEAD_PIXELS)) {
+            NewRect = Union;
+            egDirtyRects[i] = egDirtyRects[--egDirtyRectCount];
+            i = 0;   // the grown rectangle may now reach earlier ones
+        } else {
+            i++;
+        }
+    }
+
+    if (egDirtyRectCount >= EG_MAX_DIRTY_RECTS && !egFrontBufferValid) {
+        // can't merge safely, so put what's been drawn so far on the screen
+        egFlushDirtyRects();
+    }
+    if (egDirtyRectCount < EG_MAX_DIRTY_RECTS) {
+        egDirtyRects[egDirtyRectCount++] = NewRect;
+        return;
+    }
+
+    // list is full; fold the new area into the one it enlarges least
+    Best = 0;
+    BestGrowth = (UINTN)-1;
+    for (i = 0; i < egDirtyRectCount; i++) {
+        egUnionRect(&NewRect, &egDirtyRects[i], &Union);
+        Growth = RECT_AREA(Union) - RECT_AREA(egDirtyRects[i]);
+        if (Growth < BestGrowth) {
+            Best = i;
+            BestGrowth = Growth;
+        }
+    }
+    egUnionRect(&NewRect, &egDirtyRects[Best], &egDirtyRects[Best]);
+}
+
+#define PIXEL_DIFFERS(A, B) (((A).b != (B).b) || ((A).g != (B).g) || ((A).r != (B).r))
+
+// Shrinks Rect to the bounding box of the pixels that differ between the
+// back and front buffers. Returns FALSE if nothing in it has changed.
+static BOOLEAN egTrimUnchanged(IN OUT EG_RECT *Rect)
+{
+    UINTN       x, y, Top = 0, Bottom = 0, Left, Right;
+    EG_PIXEL    *BackLine, *FrontLine;
+    BOOLEAN     Changed = FALSE;
+
+    Left  = Rect->XPos + Rect->Width;
+    Right = Rect->XPos;
+    for (y = Rect->YPos; y < Rect->YPos + Rect->Height; y++) {
+        BackLine  = egBackBuffer->PixelData + y * egBackBuffer->Width;
+        FrontLine = egFrontBuffer->PixelData + y * egFrontBuffer->Width;
+        for (x = Rect->XPos; x < Rect->XPos + Rect->Width; x++) {
+            if (PIXEL_DIFFERS(BackLine[x], FrontLine[x]))
+                break;
+        }
+        if (x == Rect->XPos + Rect->Width)
+            continue;   // whole line is unchanged
+        if (x < Left)
+            Left = x;
+        for (x = Rect->XPos + Rect->Width; x > Right; x--) {
+            if (PIXEL_DIFFERS(BackLine[x - 1], FrontLine[x - 1])) {
+                Right = x;
+                break;
+            }
+        }
+        if (!Changed)
+            Top = y;
+        Bottom = y + 1;
+        Changed = TRUE;
+    }
+
+    if (Changed) {
+        Rect->XPos   = Left;
+        Rect->Width  = Right - Left;
+        Rect->YPos   = Top;
+        Rect->Height = Bottom - Top;
+    }
+    return Changed;
+}
+
+// Puts the recorded areas of the back buffer on the screen.
+static VOID egFlushDirtyRects(VOID)
+{
+    UINTN       i;
+    EG_RECT     Rect;
+
+    for (i = 0; i < egDirtyRectCount; i++) {
+        Rect = egDirtyRects[i];
+        if (egFrontBufferValid && !egTrimUnchanged(&Rect))
+            continue;
+        egBltToScreen(egBackBuffer, Rect.XPos, Rect.YPos, Rect.Width, Rect.Height, Rect.XPos, Rect.YPos);
+        egCopyToBuffer(egFrontBuffer, egBackBuffer, Rect.XPos, Rect.YPos, Rect.Width, Rect.Height, Rect.XPos, Rect.YPos);
+    }
+    egDirtyRectCount = 0;
+}
+
+static VOID egPresentFrame(VOID)
+{
+    UINTN       BltCount, PixelCount;
+
+    BltCount = egStats.TotalBltCount;
+    PixelCount = egStats.TotalPixelCount;
+    egFlushDirtyRects();
+
+    // a frame that cleared the screen has now put all of it in a known state
+    if (egFrameCleared)
+        egFrontBufferValid = TRUE;
+    egFrameCleared = FALSE;
+
+    egStats.FrameCount++;
+    egStats.BltCount = egStats.TotalBltCount - BltCount;
+    egStats.PixelCount = egStats.TotalPixelCount - PixelCount;
+}
+
+// Starts collecting drawing operations in the back buffer. Calls may be
+// nested; the screen is updated when the outermost egEndFrame() is called.
+// The buffers are allocated on the first drawing operation within a frame,
+// so frames that draw nothing (e.g. text-mode menus) cost nothing. If they
+// can't be allocated, drawing simply stays unbuffered.
+VOID egBeginFrame(VOID)
+{
+    if (egHasGraphics)
+        egFrameDepth++;
+}
+
+VOID egEndFrame(VOID)
+{
+    if (egFrameDepth == 0)
+        return;
+    if (--egFrameDepth == 0 && egBackBuffer != NULL)
+        egPresentFrame();
+}
+
+// Tells libeg that something else (text output, a tool or loader that
+// returned) may have drawn on the screen, so the next frame must not assume
+// that the screen still holds what libeg last put there.
+VOID egInvalidateScreen(VOID)
+{
+    egFrontBufferValid = FALSE;
+}
+
+// Returns the Blt and pixel counts for the most recently presented frame,
+// along with running totals that also include unbuffered drawing.
+VOID egGetScreenStats(OUT EG_SCREEN_STATS *Stats)
+{
+    if (Stats != NULL)
+        *Stats = egStats;
+}
+
 VOID egClearScreen(IN EG_PIXEL *Color)
 {
     EFI_UGA_PIXEL FillColor;
+    EG_PIXEL      FillPixel;
 
     if (!egHasGraphics)
         return;
 
+    FillPixel = *Color;
+    FillPixel.a = 0;
+    if (egFrameDepth > 0)
+        egAllocBackBuffer();
+    if (egBackBuffer != NULL) {
+        egFillImage(egBackBuffer, &FillPixel);
+        if (egFrameDepth > 0) {
+            // everything recorded so far has just been painted over
+            egDirtyRectCount = 0;
+            egAddDirtyRect(0, 0, egScreenWidth, egScreenHeight);
+            egFrameCleared = TRUE;
+            return;
+        }
+        egFillImage(egFrontBuffer, &FillPixel);
+        egFrontBufferValid = TRUE;
+    }
+
     FillColor.Red   = Color->r;
     FillColor.Green = Color->g;
     FillColor.Blue  = Color->b;
@@ -242,25 +557,13 @@ VOID egClearScreen(IN EG_PIXEL *Color)
         refit_call10_wrapper(UgaDraw->Blt, UgaDraw, &FillColor, EfiUgaVideoFill,
                      0, 0, 0, 0, egScreenWidth, egScreenHeight, 0);
     }
+    egStats.TotalBltCount++;
+    egStats.TotalPixelCount += egScreenWidth * egScreenHeight;
 }
 
 VOID egDrawImage(IN EG_IMAGE *Image, IN UINTN ScreenPosX, IN UINTN ScreenPosY)
 {
-    if (!egHasGraphics)
-        return;
-
-    if (Image->HasAlpha) {
-        Image->HasAlpha = FALSE;
-        egSetPlane(PLPTR(Image, a), 0, Image->Width * Image->Height);
-    }
-    
-    if (GraphicsOutput != NULL) {
-        refit_call10_wrapper(GraphicsOutput->Blt, GraphicsOutput, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)Image->PixelData, EfiBltBufferToVideo,
-                            0, 0, ScreenPosX, ScreenPosY, Image->Width, Image->Height, 0);
-    } else if (UgaDraw != NULL) {
-        refit_call10_wrapper(UgaDraw->Blt, UgaDraw, (EFI_UGA_PIXEL *)Image->PixelData, EfiUgaBltBufferToVideo,
-                     0, 0, ScreenPosX, ScreenPosY, Image->Width, Image->Height, 0);
-    }
+    egDrawImageArea(Image, 0, 0, Image->Width, Image->Height, ScreenPosX, ScreenPosY);
 }
 
 VOID egDrawImageArea(IN EG_IMAGE *Image,
@@ -268,6 +571,8 @@ VOID egDrawImageArea(IN EG_IMAGE *Image,
                      IN UINTN AreaWidth, IN UINTN AreaHeight,
                      IN UINTN ScreenPosX, IN UINTN ScreenPosY)
 {
+    EG_IMAGE *Opaque;
+
     if (!egHasGraphics)
         return;
     
@@ -275,18 +580,33 @@ VOID egDrawImageArea(IN EG_IMAGE *Image,
     if (AreaWidth == 0)
         return;
     
+    // The screen has no alpha channel, so draw a copy of the area with the
+    // alpha cleared; Image itself may be shared (e.g. a cached icon) or
+    // read-only, so it's left alone.
     if (Image->HasAlpha) {
-        Image->HasAlpha = FALSE;
-        egSetPlane(PLPTR(Image, a), 0, Image->Width * Image->Height);
+        Opaque = egCreateImage(AreaWidth, AreaHeight, FALSE);
+        if (Opaque == NULL)
+            return;
+        egRawCopy(Opaque->PixelData, Image->PixelData + AreaPosY * Image->Width + AreaPosX,
+                  AreaWidth, AreaHeight, AreaWidth, Image->Width);
+        egSetPlane(PLPTR(Opaque, a), 0, AreaWidth * AreaHeight);
+        egDrawImageArea(Opaque, 0, 0, AreaWidth, AreaHeight, ScreenPosX, ScreenPosY);
+        egFreeImage(Opaque);
+        return;
     }
-    
-    if (GraphicsOutput != NULL) {
-        refit_call10_wrapper(GraphicsOutput->Blt, GraphicsOutput, (EFI_GRAPHICS_OUTPUT_BLT_PIXEL *)Image->PixelData, EfiBltBufferToVideo,
-                            AreaPosX, AreaPosY, ScreenPosX, ScreenPosY, AreaWidth, AreaHeight, Image->Width * 4);
-    } else if (UgaDraw != NULL) {
-        refit_call10_wrapper(UgaDraw->Blt, UgaDraw, (EFI_UGA_PIXEL *)Image->PixelData, EfiUgaBltBufferToVideo,
-                     AreaPosX, AreaPosY, ScreenPosX, ScreenPosY, AreaWidth, AreaHeight, Image->Width * 4);
+
+    if (egFrameDepth > 0)
+        egAllocBackBuffer();
+    if (egBackBuffer != NULL) {
+        egCopyToBuffer(egBackBuffer, Image, AreaPosX, AreaPosY, AreaWidth, AreaHeight, ScreenPosX, ScreenPosY);
+        if (egFrameDepth > 0) {
+            egAddDirtyRect(ScreenPosX, ScreenPosY, AreaWidth, AreaHeight);
+            return;
+        }
+        egCopyToBuffer(egFrontBuffer, Image, AreaPosX, AreaPosY, AreaWidth, AreaHeight, ScreenPosX, ScreenPosY);
     }
+
+    egBltToScreen(Image, AreaPosX, AreaPosY, AreaWidth, AreaHeight, ScreenPosX, ScreenPosY);
 }
 
 //
@@ -36,11 +36,18 @@
 
 #include "libegint.h"
 
-#include "egemb_font.h"
+// generated from egemb_font.h by mkegemb
+#include "egemb_font_bgra.h"
 #define FONT_CELL_WIDTH (7)
 #define FONT_CELL_HEIGHT (12)
 
+// the font pre-blended onto the most recently used solid backgrounds
+#define FONT_ATLAS_COUNT (2)
+
 static EG_IMAGE *FontImage = NULL;
+static EG_IMAGE *FontAtlas[FONT_ATLAS_COUNT] = { NULL, NULL };
+static EG_PIXEL FontAtlasBackground[FONT_ATLAS_COUNT];
+static UINTN    FontAtlasNext = 0;
 
 //
 // Text rendering
@@ -62,6 +69,9 @@ VOID egRenderText(IN CHAR16 *Text, IN OUT EG_IMAGE *CompImage, IN UINTN PosX, IN
     UINTN           TextLength;
     UINTN           i, c;
     
+    if (egMakeImageWritable(CompImage) != EFI_SUCCESS)
+        return;
+
     // clip the text
     TextLength = StrLen(Text);
     if (TextLength * FONT_CELL_WIDTH + PosX > CompImage->Width)
@@ -69,7 +79,9 @@ VOID egRenderText(IN CHAR16 *Text, IN OUT EG_IMAGE *CompImage, IN UINTN PosX, IN
 
     // load the font
     if (FontImage == NULL)
-        FontImage = egPrepareEmbeddedImage(&egemb_font, TRUE);
+        FontImage = egPrepareEmbeddedImage(&egemb_font, EG_ALPHA_PREMULTIPLIED);
+    if (FontImage == NULL)
+        return;
     
     // render it
     BufferPtr = CompImage->PixelData;
@@ -83,11 +95,81 @@ VOID egRenderText(IN CHAR16 *Text, IN OUT EG_IMAGE *CompImage, IN UINTN PosX, IN
             c = 95;
         else
             c -= 32;
-        egRawCompose(BufferPtr, FontPixelData + c * FONT_CELL_WIDTH,
-                     FONT_CELL_WIDTH, FONT_CELL_HEIGHT,
-                     BufferLineOffset, FontLineOffset);
+        egRawComposePremultiplied(BufferPtr, FontPixelData + c * FONT_CELL_WIDTH,
+                                  FONT_CELL_WIDTH, FONT_CELL_HEIGHT,
+                                  BufferLineOffset, FontLineOffset);
         BufferPtr += FONT_CELL_WIDTH;
     }
 }
 
+// Returns the font composited onto a solid Background, building it if
+// it isn't among the FONT_ATLAS_COUNT most recently used backgrounds.
+static EG_IMAGE * egGetFontAtlas(IN EG_PIXEL *Background)
+{
+    UINTN       i;
+    EG_PIXEL    Fill;
+
+    Fill = *Background;
+    Fill.a = 0;   // as egFillImage() leaves it in an image without alpha
+    for (i = 0; i < FONT_ATLAS_COUNT; i++) {
+        if (FontAtlas[i] != NULL && CompareMem(&FontAtlasBackground[i], &Fill, sizeof(EG_PIXEL)) == 0)
+            return FontAtlas[i];
+    }
+
+    i = FontAtlasNext;
+    FontAtlasNext = (FontAtlasNext + 1) % FONT_ATLAS_COUNT;
+    egFreeImage(FontAtlas[i]);
+    FontAtlas[i] = egCreateFilledImage(FontImage->Width, FontImage->Height, FALSE, &Fill);
+    if (FontAtlas[i] != NULL) {
+        egComposeImage(FontAtlas[i], FontImage, 0, 0);
+        FontAtlasBackground[i] = Fill;
+    }
+    return FontAtlas[i];
+}
+
+// Like egRenderText(), but for text drawn onto an area of CompImage that's
+// known to be filled with the solid color Background. The glyphs are then
+// copied from a pre-blended copy of the font, with no per-pixel blending.
+// The result is identical to egRenderText()'s.
+VOID egRenderTextOnBackground(IN CHAR16 *Text, IN OUT EG_IMAGE *CompImage, IN UINTN PosX, IN UINTN PosY,
+                              IN EG_PIXEL *Background)
+{
+    EG_PIXEL        *BufferPtr;
+    EG_IMAGE        *Atlas;
+    UINTN           BufferLineOffset;
+    UINTN           TextLength;
+    UINTN           i, c;
+
+    if (FontImage == NULL)
+        FontImage = egPrepareEmbeddedImage(&egemb_font, EG_ALPHA_PREMULTIPLIED);
+    if (FontImage == NULL)
+        return;
+
+    Atlas = CompImage->HasAlpha ? NULL : egGetFontAtlas(Background);
+    if (Atlas == NULL || egMakeImageWritable(CompImage) != EFI_SUCCESS) {
+        egRenderText(Text, CompImage, PosX, PosY);
+        return;
+    }
+
+    // clip the text
+    TextLength = StrLen(Text);
+    if (TextLength * FONT_CELL_WIDTH + PosX > CompImage->Width)
+        TextLength = (CompImage->Width - PosX) / FONT_CELL_WIDTH;
+
+    // render it
+    BufferLineOffset = CompImage->Width;
+    BufferPtr = CompImage->PixelData + PosX + PosY * BufferLineOffset;
+    for (i = 0; i < TextLength; i++) {
+        c = Text[i];
+        if (c < 32 || c >= 127)
+            c = 95;
+        else
+            c -= 32;
+        egRawCopy(BufferPtr, Atlas->PixelData + c * FONT_CELL_WIDTH,
+                  FONT_CELL_WIDTH, FONT_CELL_HEIGHT,
+                  BufferLineOffset, Atlas->Width);
+        BufferPtr += FONT_CELL_WIDTH;
+    }
+} // VOID egRenderTextOnBackground()
+
 /* EOF */
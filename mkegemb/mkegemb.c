@@ -0,0 +1,250 @@
+/*
+ * mkegemb/mkegemb.c
+ * Host-side tool to pre-expand embedded images into BGRA pixel arrays
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Usage: mkegemb -a none|straight|premultiplied input.h output.h
+ *
+ * Reads an egemb_*.h header holding a planar, optionally RLE-compressed
+ * EG_EMBEDDED_IMAGE and writes a header that defines an image of the same
+ * name whose data is an array of ready-to-use EG_PIXELs
+ * (EG_EICOMPMODE_BGRA). egPrepareEmbeddedImage() returns such images as
+ * read-only views of the array, without decoding or copying anything.
+ *
+ * The -a option picks the alpha form to store, and should match the
+ * WantAlpha value the image is prepared with: "none" gives an image
+ * without an alpha channel (alpha bytes 0), "straight" one with straight
+ * alpha and "premultiplied" one with premultiplied alpha. The expansion
+ * follows egPrepareEmbeddedImage() in libeg/image.c exactly.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// from libeg/libeg.h
+#define EG_EIPIXELMODE_GRAY         (0)
+#define EG_EIPIXELMODE_GRAY_ALPHA   (1)
+#define EG_EIPIXELMODE_COLOR        (2)
+#define EG_EIPIXELMODE_COLOR_ALPHA  (3)
+#define EG_EIPIXELMODE_ALPHA        (4)
+
+#define ALPHA_NONE                  (0)
+#define ALPHA_STRAIGHT              (1)
+#define ALPHA_PREMULTIPLIED         (2)
+
+static const char *PixelModeNames[] = {
+    "EG_EIPIXELMODE_GRAY", "EG_EIPIXELMODE_GRAY_ALPHA", "EG_EIPIXELMODE_COLOR",
+    "EG_EIPIXELMODE_COLOR_ALPHA", "EG_EIPIXELMODE_ALPHA"
+};
+
+static void Fail(const char *Message, const char *Detail)
+{
+    fprintf(stderr, "mkegemb: %s%s\n", Message, Detail ? Detail : "");
+    exit(1);
+}
+
+static void *XMalloc(size_t Size)
+{
+    void *Ptr = calloc(1, Size ? Size : 1);
+
+    if (Ptr == NULL)
+        Fail("out of memory", NULL);
+    return Ptr;
+}
+
+static char *ReadText(const char *Path)
+{
+    FILE *File;
+    char *Text;
+    long Size;
+
+    File = fopen(Path, "rb");
+    if (File == NULL)
+        Fail("can't read ", Path);
+    fseek(File, 0, SEEK_END);
+    Size = ftell(File);
+    fseek(File, 0, SEEK_SET);
+    Text = XMalloc(Size + 1);
+    if (Size < 0 || fread(Text, 1, Size, File) != (size_t)Size)
+        Fail("can't read ", Path);
+    fclose(File);
+    return Text;
+}
+
+// Same as egDecompressIcnsRLE(): decodes one plane into every fourth byte.
+static void DecompressRLE(const unsigned char **CompData, const unsigned char *CompEnd,
+                          unsigned char *Pixels, size_t PixelCount)
+{
+    const unsigned char *cp = *CompData;
+    size_t              Left = PixelCount, Len, i;
+    unsigned char       Value;
+
+    while (cp + 1 < CompEnd && Left > 0) {
+        Len = *cp++;
+        if (Len & 0x80) {
+            Len -= 125;
+            if (Len > Left)
+                break;
+            Value = *cp++;
+            for (i = 0; i < Len; i++, Pixels += 4)
+                *Pixels = Value;
+        } else {
+            Len++;
+            if (Len > Left || cp + Len > CompEnd)
+                break;
+            for (i = 0; i < Len; i++, Pixels += 4)
+                *Pixels = *cp++;
+        }
+        Left -= Len;
+    }
+    *CompData = cp;
+}
+
+// Decodes or copies one plane of the source image.
+static void ReadPlane(const unsigned char **Data, const unsigned char *DataEnd, int Compressed,
+                      unsigned char *Pixels, size_t PixelCount)
+{
+    size_t i;
+
+    if (Compressed) {
+        DecompressRLE(Data, DataEnd, Pixels, PixelCount);
+    } else {
+        for (i = 0; i < PixelCount && *Data < DataEnd; i++)
+            Pixels[i * 4] = *(*Data)++;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    char          *Text, *Ptr, *End, *Image, Name[128], Mode[64], Comp[64];
+    unsigned char *Data, *Pixels, *Pixel;
+    const unsigned char *DataPtr;
+    size_t        DataLength = 0, Width, Height, PixelCount, i;
+    unsigned      Temp;
+    int           Alpha, PixelMode, Compressed;
+    FILE          *Out;
+
+    if (argc != 5 || strcmp(argv[1], "-a") != 0) {
+        fprintf(stderr, "Usage: %s -a none|straight|premultiplied input.h output.h\n", argv[0]);
+        return 1;
+    }
+    if (strcmp(argv[2], "none") == 0)
+        Alpha = ALPHA_NONE;
+    else if (strcmp(argv[2], "straight") == 0)
+        Alpha = ALPHA_STRAIGHT;
+    else if (strcmp(argv[2], "premultiplied") == 0)
+        Alpha = ALPHA_PREMULTIPLIED;
+    else
+        Fail("unknown alpha form ", argv[2]);
+
+    // the data array: every 0x.. constant between its braces
+    Text = ReadText(argv[3]);
+    Ptr = strchr(Text, '{');
+    End = Ptr ? strstr(Ptr, "};") : NULL;
+    if (End == NULL)
+        Fail("no data array in ", argv[3]);
+    Data = XMalloc(End - Ptr);
+    while ((Ptr = strstr(Ptr, "0x")) != NULL && Ptr < End) {
+        Data[DataLength++] = (unsigned char)strtoul(Ptr, &Ptr, 16);
+    }
+
+    // the image itself
+    Image = strstr(End, "EG_EMBEDDED_IMAGE");
+    if (Image == NULL ||
+        sscanf(Image, "EG_EMBEDDED_IMAGE %127s = { %zu , %zu , %63[A-Z_] , %63[A-Z_]",
+               Name, &Width, &Height, Mode, Comp) != 5)
+        Fail("no EG_EMBEDDED_IMAGE in ", argv[3]);
+    for (PixelMode = 0; PixelMode <= EG_EIPIXELMODE_ALPHA; PixelMode++) {
+        if (strcmp(Mode, PixelModeNames[PixelMode]) == 0)
+            break;
+    }
+    if (PixelMode > EG_EIPIXELMODE_ALPHA)
+        Fail("unsupported pixel mode ", Mode);
+    if (strcmp(Comp, "EG_EICOMPMODE_RLE") == 0)
+        Compressed = 1;
+    else if (strcmp(Comp, "EG_EICOMPMODE_NONE") == 0)
+        Compressed = 0;
+    else
+        Fail("unsupported compression mode ", Comp);
+
+    // expand, exactly as egPrepareEmbeddedImage() does
+    PixelCount = Width * Height;
+    Pixels = XMalloc(PixelCount * 4);
+    DataPtr = Data;
+    if (PixelMode == EG_EIPIXELMODE_GRAY || PixelMode == EG_EIPIXELMODE_GRAY_ALPHA) {
+        ReadPlane(&DataPtr, Data + DataLength, Compressed, Pixels + 2, PixelCount);
+        for (i = 0; i < PixelCount; i++)
+            Pixels[i * 4 + 1] = Pixels[i * 4] = Pixels[i * 4 + 2];
+    } else if (PixelMode == EG_EIPIXELMODE_COLOR || PixelMode == EG_EIPIXELMODE_COLOR_ALPHA) {
+        ReadPlane(&DataPtr, Data + DataLength, Compressed, Pixels + 2, PixelCount);
+        ReadPlane(&DataPtr, Data + DataLength, Compressed, Pixels + 1, PixelCount);
+        ReadPlane(&DataPtr, Data + DataLength, Compressed, Pixels + 0, PixelCount);
+    }
+    if (Alpha != ALPHA_NONE && (PixelMode == EG_EIPIXELMODE_GRAY_ALPHA ||
+                                PixelMode == EG_EIPIXELMODE_COLOR_ALPHA ||
+                                PixelMode == EG_EIPIXELMODE_ALPHA)) {
+        ReadPlane(&DataPtr, Data + DataLength, Compressed, Pixels + 3, PixelCount);
+    } else {
+        for (i = 0; i < PixelCount; i++)
+            Pixels[i * 4 + 3] = (Alpha != ALPHA_NONE) ? 255 : 0;
+    }
+    if (Alpha == ALPHA_PREMULTIPLIED) {
+        // same rounding as egPremultiplyImage()
+        for (i = 0, Pixel = Pixels; i < PixelCount; i++, Pixel += 4) {
+            if (Pixel[3] == 255)
+                continue;
+            Temp = Pixel[0] * Pixel[3] + 0x80;
+            Pixel[0] = (Temp + (Temp >> 8)) >> 8;
+            Temp = Pixel[1] * Pixel[3] + 0x80;
+            Pixel[1] = (Temp + (Temp >> 8)) >> 8;
+            Temp = Pixel[2] * Pixel[3] + 0x80;
+            Pixel[2] = (Temp + (Temp >> 8)) >> 8;
+        }
+    }
+
+    Out = fopen(argv[4], "w");
+    if (Out == NULL)
+        Fail("can't create ", argv[4]);
+    Ptr = strrchr(argv[3], '/');
+    fprintf(Out, "// Generated by mkegemb from %s; do not edit.\n", Ptr ? Ptr + 1 : argv[3]);
+    fprintf(Out, "static const EG_PIXEL %s_pixels[%zu] = {\n", Name, PixelCount);
+    for (i = 0; i < PixelCount; i++) {
+        fprintf(Out, " {0x%02x,0x%02x,0x%02x,0x%02x},",
+                Pixels[i * 4], Pixels[i * 4 + 1], Pixels[i * 4 + 2], Pixels[i * 4 + 3]);
+        if (i % 6 == 5 || i == PixelCount - 1)
+            fputc('\n', Out);
+    }
+    fprintf(Out, "};\n");
+    fprintf(Out, "static EG_EMBEDDED_IMAGE %s = { %zu, %zu, %s, EG_EICOMPMODE_BGRA, (const UINT8 *)%s_pixels, sizeof(%s_pixels) };\n",
+            Name, Width, Height,
+            Alpha == ALPHA_NONE ? "EG_EIPIXELMODE_COLOR" :
+            Alpha == ALPHA_STRAIGHT ? "EG_EIPIXELMODE_COLOR_ALPHA" : "EG_EIPIXELMODE_COLOR_PREMULTIPLIED",
+            Name, Name);
+    if (fclose(Out) != 0)
+        Fail("error writing ", argv[4]);
+
+    free(Pixels);
+    free(Data);
+    free(Text);
+    return 0;
+}
+
+/* EOF */
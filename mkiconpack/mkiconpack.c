@@ -0,0 +1,431 @@
+/*
+ * mkiconpack/mkiconpack.c
+ * Host-side tool to build an icons.pak theme pack from a directory of
+ * .icns files
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+/*
+ * Usage: mkiconpack icons-dir [output-file]
+ *
+ * Every .icns file in icons-dir is decoded at each size rEFInd can use
+ * (128, 48, 32 and 16 pixels), premultiplied, RLE-compressed and written
+ * to output-file (icons-dir/icons.pak by default). The .icns decoding
+ * follows libeg/load_icns.c, so packed icons look exactly like the ones
+ * rEFInd would load from the individual files. See include/iconpack.h for
+ * the file layout.
+ */
+
+#include <ctype.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+#include "../include/iconpack.h"
+
+typedef struct {
+    char     *Name;
+    uint32_t Hash;
+    uint32_t PixelSize;
+    uint8_t  *Data;
+    uint32_t DataLength;
+    uint32_t Next;
+} PACK_ENTRY;
+
+static PACK_ENTRY *Entries = NULL;
+static uint32_t   EntryCount = 0;
+
+static const struct {
+    uint32_t   PixelSize;
+    const char *DataTag;
+    const char *MaskTag;
+    uint32_t   DataSkip;
+} IcnsSizes[] = {
+    { 128, "it32", "t8mk", 4 },
+    {  48, "ih32", "h8mk", 0 },
+    {  32, "il32", "l8mk", 0 },
+    {  16, "is32", "s8mk", 0 },
+};
+
+static void *XMalloc(size_t Size)
+{
+    void *Ptr = calloc(1, Size ? Size : 1);
+
+    if (Ptr == NULL) {
+        fprintf(stderr, "mkiconpack: out of memory\n");
+        exit(1);
+    }
+    return Ptr;
+}
+
+static uint32_t HashName(const char *Name)
+{
+    uint32_t Hash = ICONPACK_HASH_INIT;
+
+    while (*Name)
+        Hash = (Hash ^ (uint8_t)tolower((unsigned char)*Name++)) * ICONPACK_HASH_PRIME;
+    return Hash;
+}
+
+static uint32_t GetBE32(const uint8_t *Ptr)
+{
+    return ((uint32_t)Ptr[0] << 24) | ((uint32_t)Ptr[1] << 16) | ((uint32_t)Ptr[2] << 8) | Ptr[3];
+}
+
+static void PutLE32(uint8_t *Ptr, uint32_t Value)
+{
+    Ptr[0] = Value & 0xff;
+    Ptr[1] = (Value >> 8) & 0xff;
+    Ptr[2] = (Value >> 16) & 0xff;
+    Ptr[3] = (Value >> 24) & 0xff;
+}
+
+// Same as egDecompressIcnsRLE(): decodes one color plane into every
+// fourth byte of Pixels.
+static void DecompressIcnsRLE(const uint8_t **CompData, const uint8_t *CompEnd, uint8_t *Pixels, uint32_t PixelCount)
+{
+    const uint8_t *cp = *CompData;
+    uint32_t      Left = PixelCount, Len, i;
+    uint8_t       Value;
+
+    while (cp + 1 < CompEnd && Left > 0) {
+        Len = *cp++;
+        if (Len & 0x80) {
+            Len -= 125;
+            if (Len > Left)
+                break;
+            Value = *cp++;
+            for (i = 0; i < Len; i++, Pixels += 4)
+                *Pixels = Value;
+        } else {
+            Len++;
+            if (Len > Left || cp + Len > CompEnd)
+                break;
+            for (i = 0; i < Len; i++, Pixels += 4)
+                *Pixels = *cp++;
+        }
+        Left -= Len;
+    }
+    *CompData = cp;
+}
+
+// Decodes one size from an .icns file into premultiplied BGRA pixels, as
+// egDecodeICNS() with EG_ALPHA_PREMULTIPLIED would. Returns NULL if the
+// file doesn't contain that size.
+static uint8_t *DecodeIcns(const uint8_t *File, size_t FileLength, unsigned SizeIndex)
+{
+    const uint8_t *Ptr, *End, *DataPtr = NULL, *MaskPtr = NULL;
+    uint32_t      BlockLen, DataLen = 0, MaskLen = 0, PixelCount, i, Temp;
+    uint32_t      PixelSize = IcnsSizes[SizeIndex].PixelSize;
+    uint8_t       *Pixels, *Pixel;
+
+    if (FileLength < 8 || memcmp(File, "icns", 4) != 0)
+        return NULL;
+
+    End = File + FileLength;
+    for (Ptr = File + 8; Ptr + 8 <= End; Ptr += BlockLen) {
+        BlockLen = GetBE32(Ptr + 4);
+        if (BlockLen < 8 || Ptr + BlockLen > End)
+            break;
+        if (memcmp(Ptr, IcnsSizes[SizeIndex].DataTag, 4) == 0) {
+            if (IcnsSizes[SizeIndex].DataSkip == 0 || (BlockLen >= 12 && GetBE32(Ptr + 8) == 0)) {
+                DataPtr = Ptr + 8 + IcnsSizes[SizeIndex].DataSkip;
+                DataLen = BlockLen - 8 - IcnsSizes[SizeIndex].DataSkip;
+            }
+        } else if (memcmp(Ptr, IcnsSizes[SizeIndex].MaskTag, 4) == 0) {
+            MaskPtr = Ptr + 8;
+            MaskLen = BlockLen - 8;
+        }
+    }
+    if (DataPtr == NULL)
+        return NULL;
+
+    PixelCount = PixelSize * PixelSize;
+    Pixels = XMalloc(PixelCount * 4);
+    if (DataLen < PixelCount * 3) {
+        const uint8_t *CompData = DataPtr;
+        DecompressIcnsRLE(&CompData, DataPtr + DataLen, Pixels + 2, PixelCount);
+        DecompressIcnsRLE(&CompData, DataPtr + DataLen, Pixels + 1, PixelCount);
+        DecompressIcnsRLE(&CompData, DataPtr + DataLen, Pixels + 0, PixelCount);
+    } else {
+        for (i = 0; i < PixelCount; i++) {
+            Pixels[i * 4 + 2] = DataPtr[i * 3];
+            Pixels[i * 4 + 1] = DataPtr[i * 3 + 1];
+            Pixels[i * 4 + 0] = DataPtr[i * 3 + 2];
+        }
+    }
+
+    for (i = 0, Pixel = Pixels; i < PixelCount; i++, Pixel += 4) {
+        Pixel[3] = (MaskPtr != NULL && MaskLen >= PixelCount) ? MaskPtr[i] : 255;
+        if (Pixel[3] == 255)
+            continue;
+        // same rounding as egPremultiplyImage()
+        Temp = Pixel[0] * Pixel[3] + 0x80;
+        Pixel[0] = (Temp + (Temp >> 8)) >> 8;
+        Temp = Pixel[1] * Pixel[3] + 0x80;
+        Pixel[1] = (Temp + (Temp >> 8)) >> 8;
+        Temp = Pixel[2] * Pixel[3] + 0x80;
+        Pixel[2] = (Temp + (Temp >> 8)) >> 8;
+    }
+    return Pixels;
+}
+
+// Run-length encodes whole BGRA pixels, as described in iconpack.h.
+static uint8_t *CompressPixels(const uint8_t *Pixels, uint32_t PixelCount, uint32_t *OutLength)
+{
+    // worst case: one control byte per ICONPACK_MAX_LITERAL pixels
+    uint8_t  *Out = XMalloc(PixelCount * 4 + PixelCount / ICONPACK_MAX_LITERAL + 1);
+    uint32_t OutPos = 0, Pos = 0, Run, Literal;
+
+    while (Pos < PixelCount) {
+        Run = 1;
+        while (Pos + Run < PixelCount && Run < ICONPACK_MAX_REPEAT &&
+               memcmp(Pixels + (Pos + Run) * 4, Pixels + Pos * 4, 4) == 0)
+            Run++;
+        if (Run >= 2) {
+            Out[OutPos++] = (uint8_t)(Run + 0x7e);
+            memcpy(Out + OutPos, Pixels + Pos * 4, 4);
+            OutPos += 4;
+            Pos += Run;
+            continue;
+        }
+
+        // collect literals up to the next run of at least two pixels
+        Literal = 1;
+        while (Pos + Literal < PixelCount && Literal < ICONPACK_MAX_LITERAL &&
+               !(Pos + Literal + 1 < PixelCount &&
+                 memcmp(Pixels + (Pos + Literal) * 4, Pixels + (Pos + Literal + 1) * 4, 4) == 0))
+            Literal++;
+        Out[OutPos++] = (uint8_t)(Literal - 1);
+        memcpy(Out + OutPos, Pixels + Pos * 4, Literal * 4);
+        OutPos += Literal * 4;
+        Pos += Literal;
+    }
+
+    *OutLength = OutPos;
+    return Out;
+}
+
+static uint8_t *ReadFile(const char *Path, size_t *Length)
+{
+    FILE    *File;
+    uint8_t *Data;
+    long    Size;
+
+    File = fopen(Path, "rb");
+    if (File == NULL)
+        return NULL;
+    fseek(File, 0, SEEK_END);
+    Size = ftell(File);
+    fseek(File, 0, SEEK_SET);
+    Data = XMalloc(Size > 0 ? Size : 1);
+    if (Size < 0 || fread(Data, 1, Size, File) != (size_t)Size) {
+        free(Data);
+        fclose(File);
+        return NULL;
+    }
+    fclose(File);
+    *Length = Size;
+    return Data;
+}
+
+static void AddIcon(const char *Dir, const char *FileName)
+{
+    char     *Path, *Name;
+    uint8_t  *File, *Pixels;
+    size_t   FileLength, i;
+    unsigned SizeIndex;
+    uint32_t PixelCount;
+
+    Path = XMalloc(strlen(Dir) + strlen(FileName) + 2);
+    sprintf(Path, "%s/%s", Dir, FileName);
+    File = ReadFile(Path, &FileLength);
+    if (File == NULL) {
+        fprintf(stderr, "mkiconpack: can't read %s\n", Path);
+        exit(1);
+    }
+
+    Name = XMalloc(strlen(FileName) + 1);
+    for (i = 0; FileName[i]; i++)
+        Name[i] = tolower((unsigned char)FileName[i]);
+
+    for (SizeIndex = 0; SizeIndex < sizeof(IcnsSizes) / sizeof(IcnsSizes[0]); SizeIndex++) {
+        Pixels = DecodeIcns(File, FileLength, SizeIndex);
+        if (Pixels == NULL)
+            continue;
+        Entries = realloc(Entries, (EntryCount + 1) * sizeof(PACK_ENTRY));
+        if (Entries == NULL) {
+            fprintf(stderr, "mkiconpack: out of memory\n");
+            exit(1);
+        }
+        PixelCount = IcnsSizes[SizeIndex].PixelSize * IcnsSizes[SizeIndex].PixelSize;
+        Entries[EntryCount].Name = Name;
+        Entries[EntryCount].Hash = HashName(Name);
+        Entries[EntryCount].PixelSize = IcnsSizes[SizeIndex].PixelSize;
+        Entries[EntryCount].Data = CompressPixels(Pixels, PixelCount, &Entries[EntryCount].DataLength);
+        Entries[EntryCount].Next = 0;
+        EntryCount++;
+        free(Pixels);
+    }
+
+    free(File);
+    free(Path);
+}
+
+static int CompareNames(const void *a, const void *b)
+{
+    return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static int IsIcnsFile(const char *Name)
+{
+    size_t Len = strlen(Name);
+
+    return Len > 5 && strcasecmp(Name + Len - 5, ".icns") == 0;
+}
+
+static void WritePack(const char *OutPath)
+{
+    FILE     *Out;
+    uint8_t  Header[ICONPACK_HEADER_SIZE], Record[ICONPACK_ENTRY_SIZE], Word[4];
+    uint32_t BucketCount = 1, *Buckets, BucketOffset, EntryOffset, NameOffset, DataOffset;
+    uint32_t i, Bucket;
+    const char *LastName = NULL;
+
+    while (BucketCount < EntryCount)
+        BucketCount <<= 1;
+    Buckets = XMalloc(BucketCount * sizeof(uint32_t));
+    // insert in reverse so that each chain lists entries in file order
+    for (i = EntryCount; i-- > 0; ) {
+        Bucket = Entries[i].Hash & (BucketCount - 1);
+        Entries[i].Next = Buckets[Bucket];
+        Buckets[Bucket] = i + 1;
+    }
+
+    BucketOffset = ICONPACK_HEADER_SIZE;
+    EntryOffset = BucketOffset + BucketCount * 4;
+    NameOffset = EntryOffset + EntryCount * ICONPACK_ENTRY_SIZE;
+    DataOffset = NameOffset;
+    for (i = 0; i < EntryCount; i++) {
+        if (Entries[i].Name != LastName)
+            DataOffset += strlen(Entries[i].Name) + 1;
+        LastName = Entries[i].Name;
+    }
+
+    Out = fopen(OutPath, "wb");
+    if (Out == NULL) {
+        fprintf(stderr, "mkiconpack: can't create %s\n", OutPath);
+        exit(1);
+    }
+
+    memcpy(Header, ICONPACK_MAGIC, 4);
+    PutLE32(Header + 4, ICONPACK_VERSION);
+    PutLE32(Header + 8, EntryCount);
+    PutLE32(Header + 12, BucketCount);
+    PutLE32(Header + 16, BucketOffset);
+    PutLE32(Header + 20, EntryOffset);
+    fwrite(Header, 1, sizeof(Header), Out);
+
+    for (i = 0; i < BucketCount; i++) {
+        PutLE32(Word, Buckets[i]);
+        fwrite(Word, 1, 4, Out);
+    }
+
+    // entries; all sizes of one icon share a single copy of its name
+    LastName = NULL;
+    for (i = 0; i < EntryCount; i++) {
+        if (LastName != NULL && Entries[i].Name != LastName)
+            NameOffset += strlen(LastName) + 1;
+        LastName = Entries[i].Name;
+        memset(Record, 0, sizeof(Record));
+        PutLE32(Record + 0, Entries[i].Hash);
+        PutLE32(Record + 4, Entries[i].Next);
+        PutLE32(Record + 8, NameOffset);
+        PutLE32(Record + 12, Entries[i].PixelSize);
+        PutLE32(Record + 16, ICONPACK_FLAG_PREMULTIPLIED);
+        PutLE32(Record + 20, DataOffset);
+        PutLE32(Record + 24, Entries[i].DataLength);
+        fwrite(Record, 1, sizeof(Record), Out);
+        DataOffset += Entries[i].DataLength;
+    }
+
+    LastName = NULL;
+    for (i = 0; i < EntryCount; i++) {
+        if (Entries[i].Name != LastName)
+            fwrite(Entries[i].Name, 1, strlen(Entries[i].Name) + 1, Out);
+        LastName = Entries[i].Name;
+    }
+    for (i = 0; i < EntryCount; i++)
+        fwrite(Entries[i].Data, 1, Entries[i].DataLength, Out);
+
+    if (fclose(Out) != 0) {
+        fprintf(stderr, "mkiconpack: error writing %s\n", OutPath);
+        exit(1);
+    }
+    free(Buckets);
+}
+
+int main(int argc, char *argv[])
+{
+    DIR           *Dir;
+    struct dirent *DirEntry;
+    char          **Names = NULL, *OutPath;
+    size_t        NameCount = 0, i;
+
+    if (argc < 2 || argc > 3) {
+        fprintf(stderr, "Usage: %s icons-dir [output-file]\n", argv[0]);
+        return 1;
+    }
+
+    Dir = opendir(argv[1]);
+    if (Dir == NULL) {
+        fprintf(stderr, "mkiconpack: can't open directory %s\n", argv[1]);
+        return 1;
+    }
+    while ((DirEntry = readdir(Dir)) != NULL) {
+        if (!IsIcnsFile(DirEntry->d_name))
+            continue;
+        Names = realloc(Names, (NameCount + 1) * sizeof(char *));
+        if (Names == NULL) {
+            fprintf(stderr, "mkiconpack: out of memory\n");
+            return 1;
+        }
+        Names[NameCount++] = strdup(DirEntry->d_name);
+    }
+    closedir(Dir);
+
+    // sort so that the pack is reproducible
+    qsort(Names, NameCount, sizeof(char *), CompareNames);
+    for (i = 0; i < NameCount; i++)
+        AddIcon(argv[1], Names[i]);
+
+    if (argc == 3) {
+        OutPath = argv[2];
+    } else {
+        OutPath = XMalloc(strlen(argv[1]) + strlen(ICONPACK_FILE_NAME) + 2);
+        sprintf(OutPath, "%s/%s", argv[1], ICONPACK_FILE_NAME);
+    }
+    WritePack(OutPath);
+    printf("%s: %u images from %u icons\n", OutPath, (unsigned)EntryCount, (unsigned)NameCount);
+    return 0;
+}
+
+/* EOF */
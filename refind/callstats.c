@@ -0,0 +1,175 @@
+/*
+ * refind/callstats.c
+ * Accounting of firmware calls, for finding out where start-up time goes
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// When REFIT_CALL_STATS is set in refit_call_wrapper.h, every call made
+// through a refit_callN_wrapper() macro (in rEFInd and in libeg) is timed,
+// and counted under the name of the method called: the last part of the
+// function expression, so "FileHandle->Read" and "DirHandle->Read" are both
+// counted as "Read". For the methods that move data (file Read and Write,
+// block and disk I/O, and Blt), the number of bytes is added up as well.
+//
+// The totals are written to refind_calls.log in rEFInd's directory, ranked
+// by the time spent in each method, whenever the main menu is left and when
+// F9 is pressed in a menu. Without REFIT_CALL_STATS, none of this is built.
+
+#include "global.h"
+#include "lib.h"
+#include "callstats.h"
+#include "refit_call_wrapper.h"
+#include "../libeg/libeg.h"
+
+#if REFIT_CALL_STATS > 0
+
+#define CALL_STATS_FILE_NAME     L"refind_calls.log"
+#define CALL_STATS_MAX_METHODS   (64)
+#define CALL_STATS_NAME_LENGTH   (32)
+
+typedef struct {
+   CHAR8    Name[CALL_STATS_NAME_LENGTH];
+   UINT64   Calls;
+   UINT64   Ticks;
+   UINT64   Bytes;
+} CALL_STATS_METHOD;
+
+static CALL_STATS_METHOD Methods[CALL_STATS_MAX_METHODS];
+static UINTN             MethodCount = 0;
+static UINT64            OtherCalls = 0;   // calls to methods that didn't fit in Methods
+
+// Returns TRUE if the CHAR8 strings are equal.
+static BOOLEAN SameName(IN CHAR8 *First, IN CHAR8 *Second) {
+   while (*First != '\0' && *First == *Second) {
+      First++;
+      Second++;
+   }
+   return (*First == *Second);
+} // static BOOLEAN SameName()
+
+// Returns the method name at the end of Call (a function expression such as
+// "Volume->RootDir->Open"), copied into Name.
+static VOID MethodName(IN CHAR8 *Call, OUT CHAR8 *Name) {
+   CHAR8 *Start = Call;
+   UINTN i;
+
+   for (i = 0; Call[i] != '\0'; i++) {
+      if (Call[i] == '>' || Call[i] == '.' || Call[i] == ' ' || Call[i] == '(' || Call[i] == '*')
+         Start = &Call[i + 1];
+   }
+   for (i = 0; Start[i] != '\0' && Start[i] != ')' && i < CALL_STATS_NAME_LENGTH - 1; i++)
+      Name[i] = Start[i];
+   Name[i] = '\0';
+} // static VOID MethodName()
+
+// Returns the number of bytes that a call to the named method transferred,
+// given the argument that refit_counted_call() passes along for its number
+// of arguments; or 0 for methods that don't transfer data.
+static UINT64 BytesTransferred(IN CHAR8 *Name, IN UINTN ArgCount, IN UINT64 SizeArg) {
+   if (ArgCount == 3 && (SameName(Name, (CHAR8 *) "Read") || SameName(Name, (CHAR8 *) "Write")))
+      return (SizeArg != 0) ? *((UINTN *) (UINTN) SizeArg) : 0;   // EFI_FILE: BufferSize (in/out)
+   if (ArgCount == 5 && (SameName(Name, (CHAR8 *) "ReadBlocks") || SameName(Name, (CHAR8 *) "WriteBlocks") ||
+                         SameName(Name, (CHAR8 *) "ReadDisk") || SameName(Name, (CHAR8 *) "WriteDisk")))
+      return SizeArg;
+   if (ArgCount == 6 && (SameName(Name, (CHAR8 *) "ReadBlocksEx") || SameName(Name, (CHAR8 *) "WriteBlocksEx")))
+      return SizeArg;
+   if (ArgCount == 10 && SameName(Name, (CHAR8 *) "Blt"))
+      return SizeArg * sizeof(EG_PIXEL);                           // Width * Height pixels
+   return 0;
+} // static UINT64 BytesTransferred()
+
+UINT64 RefitCallBegin(VOID) {
+   return ReadTimestampCounter();
+} // UINT64 RefitCallBegin()
+
+// Adds a call that started at Start to the totals.
+VOID RefitCallEnd(IN CHAR8 *Call, IN UINTN ArgCount, IN UINT64 Start, IN UINT64 SizeArg) {
+   UINT64 Ticks = ReadTimestampCounter() - Start;
+   CHAR8  Name[CALL_STATS_NAME_LENGTH];
+   UINTN  i;
+
+   MethodName(Call, Name);
+   for (i = 0; i < MethodCount; i++) {
+      if (SameName(Methods[i].Name, Name))
+         break;
+   }
+   if (i == MethodCount) {
+      if (MethodCount >= CALL_STATS_MAX_METHODS) {
+         OtherCalls++;
+         return;
+      }
+      CopyMem(Methods[i].Name, Name, CALL_STATS_NAME_LENGTH);
+      Methods[i].Calls = Methods[i].Ticks = Methods[i].Bytes = 0;
+      MethodCount++;
+   } // if
+   Methods[i].Calls++;
+   Methods[i].Ticks += Ticks;
+   Methods[i].Bytes += BytesTransferred(Name, ArgCount, SizeArg);
+} // VOID RefitCallEnd()
+
+// Writes the totals to the log file, slowest method first.
+VOID SaveCallStats(VOID) {
+   CALL_STATS_METHOD Snapshot[CALL_STATS_MAX_METHODS], Temp;
+   CHAR16            *Text = NULL, *Line;
+   UINT64            TicksPerMs, Us;
+   UINTN             Count, i, j;
+
+   // work from a copy, since writing the log makes more calls
+   Count = MethodCount;
+   CopyMem(Snapshot, Methods, Count * sizeof(CALL_STATS_METHOD));
+   for (i = 1; i < Count; i++) {
+      Temp = Snapshot[i];
+      for (j = i; j > 0 && Snapshot[j - 1].Ticks < Temp.Ticks; j--)
+         Snapshot[j] = Snapshot[j - 1];
+      Snapshot[j] = Temp;
+   } // for
+
+   TicksPerMs = TimestampTicksPerMs();
+   Text = PoolPrint(L"# rEFInd firmware calls: total ms, calls, bytes, method (%ld ticks/ms)", TicksPerMs);
+   for (i = 0; i < Count && Text != NULL; i++) {
+      Us = (TicksPerMs > 0) ? (Snapshot[i].Ticks * 1000) / TicksPerMs : 0;
+      Line = PoolPrint(L"%ld.%03ld %ld %ld %a", Us / 1000, Us % 1000, Snapshot[i].Calls, Snapshot[i].Bytes,
+                       Snapshot[i].Name);
+      if (Line != NULL) {
+         MergeStrings(&Text, Line, L'\n');
+         FreePool(Line);
+      }
+   } // for
+   if (OtherCalls > 0 && Text != NULL) {
+      Line = PoolPrint(L"# %ld calls to other methods not counted", OtherCalls);
+      if (Line != NULL) {
+         MergeStrings(&Text, Line, L'\n');
+         FreePool(Line);
+      }
+   }
+   MergeStrings(&Text, L"", L'\n');
+   if (Text == NULL)
+      return;
+
+   SaveTextFile(SelfDir, CALL_STATS_FILE_NAME, Text, FALSE);
+   FreePool(Text);
+} // VOID SaveCallStats()
+
+#else
+
+VOID SaveCallStats(VOID) {
+} // VOID SaveCallStats()
+
+#endif
+
+/* EOF */
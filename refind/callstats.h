@@ -0,0 +1,32 @@
+/*
+ * refind/callstats.h
+ * Firmware call accounting header file
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __CALLSTATS_H_
+#define __CALLSTATS_H_
+
+#include "efi.h"
+
+// does nothing unless REFIT_CALL_STATS is set in refit_call_wrapper.h
+VOID SaveCallStats(VOID);
+
+#endif
+
+/* EOF */
@@ -54,7 +54,6 @@
 // constants
 
 #define CONFIG_FILE_NAME         L"refind.conf"
-#define LINUX_OPTIONS_FILENAMES  L"refind_linux.conf,refind-linux.conf,linux.conf"
 #define MAXCONFIGFILESIZE        (128*1024)
 
 #define ENCODING_ISO8859_1  (0)
@@ -67,15 +66,97 @@ static REFIT_MENU_ENTRY MenuEntryReturn   = { L"Return to Main Menu", TAG_RETURN
 // read a file into a buffer
 //
 
-static EFI_STATUS ReadFile(IN EFI_FILE_HANDLE BaseDir, CHAR16 *FileName, REFIT_FILE *File)
+// Token lists are allocated from a per-file arena of chunks like this one,
+// all of which are freed by FreeFile().
+#define ARENA_CHUNK_SIZE    (4096)
+
+typedef struct _refit_arena_chunk {
+    struct _refit_arena_chunk *Next;
+    UINTN                     Size;    // bytes available after the header
+    UINTN                     Used;
+} REFIT_ARENA_CHUNK;
+
+// Returns Size bytes from File's arena, or NULL if out of memory.
+static VOID *ArenaAlloc(IN OUT REFIT_FILE *File, IN UINTN Size)
+{
+    REFIT_ARENA_CHUNK *Chunk = (REFIT_ARENA_CHUNK *) File->Arena;
+    UINTN             ChunkSize;
+    VOID              *Result;
+
+    Size = (Size + sizeof(UINTN) - 1) & ~(sizeof(UINTN) - 1);
+    if (Chunk == NULL || Chunk->Size - Chunk->Used < Size) {
+        ChunkSize = (Size > ARENA_CHUNK_SIZE) ? Size : ARENA_CHUNK_SIZE;
+        Chunk = AllocatePool(sizeof(REFIT_ARENA_CHUNK) + ChunkSize);
+        if (Chunk == NULL)
+            return NULL;
+        Chunk->Next = (REFIT_ARENA_CHUNK *) File->Arena;
+        Chunk->Size = ChunkSize;
+        Chunk->Used = 0;
+        File->Arena = Chunk;
+    }
+    Result = (UINT8 *) (Chunk + 1) + Chunk->Used;
+    Chunk->Used += Size;
+    return Result;
+}
+
+// Decodes Length bytes of UTF-8 at Source into Dest, which must have room
+// for Length characters; returns the number of characters stored. Each
+// character beyond the BMP, and each malformed sequence, becomes one '?'.
+static UINTN DecodeUtf8(IN CHAR8 *Source, IN UINTN Length, OUT CHAR16 *Dest)
+{
+    UINT8   *p = (UINT8 *) Source, *End = (UINT8 *) Source + Length;
+    CHAR16  *q = Dest;
+    UINTN   Extra, i;
+    UINT32  c;
+
+    while (p < End) {
+        c = *p++;
+        if (c < 0x80) {
+            Extra = 0;
+        } else if ((c & 0xE0) == 0xC0) {
+            Extra = 1;
+            c &= 0x1F;
+        } else if ((c & 0xF0) == 0xE0) {
+            Extra = 2;
+            c &= 0x0F;
+        } else if ((c & 0xF8) == 0xF0) {
+            Extra = 3;   // beyond the BMP; skipped below
+            c &= 0x07;
+        } else {
+            Extra = 0;
+            c = '?';
+        }
+        for (i = 0; i < Extra; i++) {
+            if (p >= End || (*p & 0xC0) != 0x80) {
+                c = '?';
+                break;
+            }
+            c = (c << 6) | (*p++ & 0x3F);
+        }
+        if (c > 0xFFFF)
+            c = '?';
+        *q++ = (CHAR16) c;
+    }
+    return (UINTN) (q - Dest);
+}
+
+// Reads FileName into File->Buffer, decoded to NUL-terminated UTF-16, which
+// ReadTokenLine() then splits up in place. Call FreeFile() when done.
+EFI_STATUS ReadFile(IN EFI_FILE_HANDLE BaseDir, CHAR16 *FileName, REFIT_FILE *File)
 {
     EFI_STATUS      Status;
     EFI_FILE_HANDLE FileHandle;
     EFI_FILE_INFO   *FileInfo;
     UINT64          ReadSize;
+    UINT8           *Raw;
+    UINTN           RawSize, Length;
 
     File->Buffer = NULL;
     File->BufferSize = 0;
+    File->Current16Ptr = File->End16Ptr = NULL;
+    File->Arena = NULL;
+    File->Tokens = NULL;
+    File->TokensSize = 0;
 
     // read the file, allocating a buffer on the way
     Status = refit_call5_wrapper(BaseDir->Open, BaseDir, &FileHandle, FileName, EFI_FILE_MODE_READ, 0);
@@ -93,119 +174,109 @@ static EFI_STATUS ReadFile(IN EFI_FILE_HANDLE BaseDir, CHAR16 *FileName, REFIT_F
         ReadSize = MAXCONFIGFILESIZE;
     FreePool(FileInfo);
 
-    File->BufferSize = (UINTN)ReadSize;   // was limited to a few K before, so this is safe
-    File->Buffer = AllocatePool(File->BufferSize);
-    Status = refit_call3_wrapper(FileHandle->Read, FileHandle, &File->BufferSize, File->Buffer);
+    RawSize = (UINTN)ReadSize;   // was limited to a few K before, so this is safe
+    Raw = AllocatePool(RawSize + sizeof(CHAR16));   // room for a terminating NUL
+    if (Raw == NULL) {
+        refit_call1_wrapper(FileHandle->Close, FileHandle);
+        return EFI_OUT_OF_RESOURCES;
+    }
+    Status = refit_call3_wrapper(FileHandle->Read, FileHandle, &RawSize, Raw);
     if (CheckError(Status, L"while loading the configuration file")) {
-        FreePool(File->Buffer);
-        File->Buffer = NULL;
+        FreePool(Raw);
         refit_call1_wrapper(FileHandle->Close, FileHandle);
         return Status;
     }
     Status = refit_call1_wrapper(FileHandle->Close, FileHandle);
 
-    // setup for reading
-    File->Current8Ptr  = (CHAR8 *)File->Buffer;
-    File->End8Ptr      = File->Current8Ptr + File->BufferSize;
-    File->Current16Ptr = (CHAR16 *)File->Buffer;
-    File->End16Ptr     = File->Current16Ptr + (File->BufferSize >> 1);
-
     // detect encoding
     File->Encoding = ENCODING_ISO8859_1;   // default: 1:1 translation of CHAR8 to CHAR16
-    if (File->BufferSize >= 4) {
-        if (File->Buffer[0] == 0xFF && File->Buffer[1] == 0xFE) {
+    if (RawSize >= 4) {
+        if (Raw[0] == 0xFF && Raw[1] == 0xFE) {
             // BOM in UTF-16 little endian (or UTF-32 little endian)
             File->Encoding = ENCODING_UTF16_LE;   // use CHAR16 as is
-            File->Current16Ptr++;
-        } else if (File->Buffer[0] == 0xEF && File->Buffer[1] == 0xBB && File->Buffer[2] == 0xBF) {
+        } else if (Raw[0] == 0xEF && Raw[1] == 0xBB && Raw[2] == 0xBF) {
             // BOM in UTF-8
             File->Encoding = ENCODING_UTF8;       // translate from UTF-8 to UTF-16
-            File->Current8Ptr += 3;
-        } else if (File->Buffer[1] == 0 && File->Buffer[3] == 0) {
+        } else if (Raw[1] == 0 && Raw[3] == 0) {
             File->Encoding = ENCODING_UTF16_LE;   // use CHAR16 as is
         }
         // TODO: detect other encodings as they are implemented
     }
- 
+
+    // decode the whole file once, in place if it's already UTF-16
+    if (File->Encoding == ENCODING_UTF16_LE) {
+        File->Buffer = Raw;
+        File->BufferSize = RawSize;
+        File->Current16Ptr = (CHAR16 *) Raw;
+        File->End16Ptr = File->Current16Ptr + RawSize / sizeof(CHAR16);
+        if (File->Current16Ptr < File->End16Ptr && File->Current16Ptr[0] == 0xFEFF)
+            File->Current16Ptr++;
+    } else {
+        File->Buffer = AllocatePool((RawSize + 1) * sizeof(CHAR16));
+        if (File->Buffer == NULL) {
+            FreePool(Raw);
+            return EFI_OUT_OF_RESOURCES;
+        }
+        File->Current16Ptr = (CHAR16 *) File->Buffer;
+        if (File->Encoding == ENCODING_UTF8) {
+            Length = DecodeUtf8((CHAR8 *) Raw + 3, RawSize - 3, File->Current16Ptr);
+        } else {
+            for (Length = 0; Length < RawSize; Length++)
+                File->Current16Ptr[Length] = Raw[Length];
+        }
+        File->End16Ptr = File->Current16Ptr + Length;
+        File->BufferSize = (RawSize + 1) * sizeof(CHAR16);
+        FreePool(Raw);
+    }
+    *File->End16Ptr = 0;
+
     return EFI_SUCCESS;
 }
 
+// Frees what ReadFile() and ReadTokenLine() allocated for File (but not File
+// itself), including all the tokens returned for it.
+VOID FreeFile(IN OUT REFIT_FILE *File)
+{
+    REFIT_ARENA_CHUNK *Chunk, *Next;
+
+    if (File == NULL)
+        return;
+    for (Chunk = (REFIT_ARENA_CHUNK *) File->Arena; Chunk != NULL; Chunk = Next) {
+        Next = Chunk->Next;
+        FreePool(Chunk);
+    }
+    File->Arena = NULL;
+    if (File->Tokens != NULL)
+        FreePool(File->Tokens);
+    File->Tokens = NULL;
+    File->TokensSize = 0;
+    if (File->Buffer != NULL)
+        FreePool(File->Buffer);
+    File->Buffer = NULL;
+    File->Current16Ptr = File->End16Ptr = NULL;
+}
+
 //
 // get a single line of text from a file
 //
 
+// Returns the next line, terminated in place, or NULL at the end of the file.
 static CHAR16 *ReadLine(REFIT_FILE *File)
 {
-    CHAR16  *Line, *q;
-    UINTN   LineLength;
+    CHAR16  *p, *Line;
 
-    if (File->Buffer == NULL)
+    if (File->Buffer == NULL || File->Current16Ptr >= File->End16Ptr)
         return NULL;
 
-    if (File->Encoding == ENCODING_ISO8859_1 || File->Encoding == ENCODING_UTF8) {
-
-        CHAR8 *p, *LineStart, *LineEnd;
-
-        p = File->Current8Ptr;
-        if (p >= File->End8Ptr)
-            return NULL;
-
-        LineStart = p;
-        for (; p < File->End8Ptr; p++)
-            if (*p == 13 || *p == 10)
-                break;
-        LineEnd = p;
-        for (; p < File->End8Ptr; p++)
-            if (*p != 13 && *p != 10)
-                break;
-        File->Current8Ptr = p;
-
-        LineLength = (UINTN)(LineEnd - LineStart) + 1;
-        Line = AllocatePool(LineLength * sizeof(CHAR16));
-        if (Line == NULL)
-            return NULL;
-
-        q = Line;
-        if (File->Encoding == ENCODING_ISO8859_1) {
-            for (p = LineStart; p < LineEnd; )
-                *q++ = *p++;
-        } else if (File->Encoding == ENCODING_UTF8) {
-            // TODO: actually handle UTF-8
-            for (p = LineStart; p < LineEnd; )
-                *q++ = *p++;
-        }
-        *q = 0;
-
-    } else if (File->Encoding == ENCODING_UTF16_LE) {
-
-        CHAR16 *p, *LineStart, *LineEnd;
-
-        p = File->Current16Ptr;
-        if (p >= File->End16Ptr)
-            return NULL;
-
-        LineStart = p;
-        for (; p < File->End16Ptr; p++)
-            if (*p == 13 || *p == 10)
-                break;
-        LineEnd = p;
-        for (; p < File->End16Ptr; p++)
-            if (*p != 13 && *p != 10)
-                break;
-        File->Current16Ptr = p;
-
-        LineLength = (UINTN)(LineEnd - LineStart) + 1;
-        Line = AllocatePool(LineLength * sizeof(CHAR16));
-        if (Line == NULL)
-            return NULL;
-
-        for (p = LineStart, q = Line; p < LineEnd; )
-            *q++ = *p++;
-        *q = 0;
-
-    } else
-        return NULL;   // unsupported encoding
-
+    Line = p = File->Current16Ptr;
+    while (p < File->End16Ptr && *p != 13 && *p != 10)
+        p++;
+    if (p < File->End16Ptr) {
+        *p++ = 0;
+        while (p < File->End16Ptr && (*p == 13 || *p == 10))
+            p++;
+    }
+    File->Current16Ptr = p;
     return Line;
 }
 
@@ -213,10 +284,13 @@ static CHAR16 *ReadLine(REFIT_FILE *File)
 // get a line of tokens from a file
 //
 
+// Splits the next non-empty line of File into tokens. The tokens point into
+// File's buffer, and the list of them is allocated from File's arena, so both
+// stay valid until FreeFile() is called; FreeTokenLine() frees nothing.
 UINTN ReadTokenLine(IN REFIT_FILE *File, OUT CHAR16 ***TokenList)
 {
     BOOLEAN         LineFinished, IsQuoted = FALSE;
-    CHAR16          *Line, *Token, *p;
+    CHAR16          *Line, *Token, *p, **NewTokens;
     UINTN           TokenCount = 0;
 
     *TokenList = NULL;
@@ -253,18 +327,35 @@ UINTN ReadTokenLine(IN REFIT_FILE *File, OUT CHAR16 ***TokenList)
                 LineFinished = TRUE;
             *p++ = 0;
 
-            AddListElement((VOID ***)TokenList, &TokenCount, (VOID *)StrDuplicate(Token));
+            // collect the line's tokens in a scratch list that's reused for every line
+            if (TokenCount >= File->TokensSize) {
+                NewTokens = AllocatePool((File->TokensSize + 16) * sizeof(CHAR16 *));
+                if (NewTokens == NULL)
+                    break;
+                if (File->Tokens != NULL) {
+                    CopyMem(NewTokens, File->Tokens, TokenCount * sizeof(CHAR16 *));
+                    FreePool(File->Tokens);
+                }
+                File->Tokens = NewTokens;
+                File->TokensSize += 16;
+            }
+            File->Tokens[TokenCount++] = Token;
         }
-
-        FreePool(Line);
     }
+
+    *TokenList = ArenaAlloc(File, TokenCount * sizeof(CHAR16 *));
+    if (*TokenList == NULL)
+        return 0;
+    CopyMem(*TokenList, File->Tokens, TokenCount * sizeof(CHAR16 *));
     return (TokenCount);
 } /* ReadTokenLine() */
 
+// The tokens belong to the file they were read from (see ReadTokenLine()),
+// so this just resets the caller's variables.
 VOID FreeTokenLine(IN OUT CHAR16 ***TokenList, IN OUT UINTN *TokenCount)
 {
-    // TODO: also free the items
-    FreeList((VOID ***)TokenList, TokenCount);
+    *TokenList = NULL;
+    *TokenCount = 0;
 }
 
 // handle a parameter with a single integer argument
@@ -296,33 +387,242 @@ static VOID HandleStrings(IN CHAR16 **TokenList, IN UINTN TokenCount, OUT CHAR16
        MergeStrings(Target, TokenList[i], L',');
 } // static VOID HandleStrings()
 
+//
+// parsed config file
+//
+
+// refind.conf is read and tokenized once, into ConfigModel, which both
+// ReadConfig() and ScanUserConfigured() then work from. The model is kept
+// across rescans and only rebuilt when the file's size or modification time
+// changes. The lines stay in file order, for ReadConfig(); a menuentry or
+// submenuentry line records where its stanza ends, which gives the stanza
+// tree that ScanUserConfigured() walks.
+
+// keywords, identified by their index in ConfigKeywords[]
+#define CONFIG_KEY_UNKNOWN                (0)
+#define CONFIG_KEY_TIMEOUT                (1)
+#define CONFIG_KEY_HIDEUI                 (2)
+#define CONFIG_KEY_ICONS_DIR              (3)
+#define CONFIG_KEY_SCANFOR                (4)
+#define CONFIG_KEY_ALSO_SCAN_DIRS         (5)
+#define CONFIG_KEY_SCAN_DRIVER_DIRS       (6)
+#define CONFIG_KEY_SHOWTOOLS              (7)
+#define CONFIG_KEY_BANNER                 (8)
+#define CONFIG_KEY_SELECTION_SMALL        (9)
+#define CONFIG_KEY_SELECTION_BIG          (10)
+#define CONFIG_KEY_DEFAULT_SELECTION      (11)
+#define CONFIG_KEY_TEXTONLY               (12)
+#define CONFIG_KEY_RESOLUTION             (13)
+#define CONFIG_KEY_SCAN_ALL_LINUX_KERNELS (14)
+#define CONFIG_KEY_PROGRESSIVE_SCAN       (15)
+#define CONFIG_KEY_SCAN_CACHE             (16)
+#define CONFIG_KEY_LOG_TIMELINE           (17)
+#define CONFIG_KEY_MAX_TAGS               (18)
+#define CONFIG_KEY_MENUENTRY              (19)
+#define CONFIG_KEY_SUBMENUENTRY           (20)
+#define CONFIG_KEY_LOADER                 (21)
+#define CONFIG_KEY_VOLUME                 (22)
+#define CONFIG_KEY_ICON                   (23)
+#define CONFIG_KEY_INITRD                 (24)
+#define CONFIG_KEY_OPTIONS                (25)
+#define CONFIG_KEY_ADD_OPTIONS            (26)
+#define CONFIG_KEY_OSTYPE                 (27)
+#define CONFIG_KEY_GRAPHICS               (28)
+#define CONFIG_KEY_DISABLED               (29)
+#define CONFIG_KEY_CLOSE                  (30)
+#define CONFIG_KEY_COUNT                  (31)
+
+static CHAR16 *ConfigKeywords[CONFIG_KEY_COUNT] = {
+   NULL, L"timeout", L"hideui", L"icons_dir", L"scanfor", L"also_scan_dirs", L"scan_driver_dirs", L"showtools",
+   L"banner", L"selection_small", L"selection_big", L"default_selection", L"textonly", L"resolution",
+   L"scan_all_linux_kernels", L"progressive_scan", L"scan_cache", L"log_timeline", L"max_tags", L"menuentry",
+   L"submenuentry", L"loader", L"volume", L"icon", L"initrd", L"options", L"add_options", L"ostype",
+   L"graphics", L"disabled", L"}"
+};
+
+// The keyword table is a hash table whose hash function was picked to give
+// each of the keywords above a slot of its own, so finding a keyword takes
+// one hash and one comparison. If keywords are added and two of them collide,
+// lookups still work (by linear probing), but it's worth trying other
+// multipliers in HashKeyword() to make the table collision-free again.
+#define CONFIG_KEY_HASH_BITS              (6)
+#define CONFIG_KEY_HASH_SIZE              (1 << CONFIG_KEY_HASH_BITS)
+
+static UINT8   KeywordSlots[CONFIG_KEY_HASH_SIZE];
+static BOOLEAN KeywordSlotsReady = FALSE;
+
+// Returns the keyword table slot for Token, ignoring case.
+static UINTN HashKeyword(IN CHAR16 *Token) {
+   UINT32 Hash = 0;
+   CHAR16 c;
+
+   while ((c = *Token++) != 0) {
+      if (c >= L'A' && c <= L'Z')
+         c += L'a' - L'A';
+      Hash = Hash * 31 + c;
+   }
+   return (UINTN) ((UINT32) (Hash * 0x184F) >> (32 - CONFIG_KEY_HASH_BITS));
+} // static UINTN HashKeyword()
+
+// Returns the CONFIG_KEY_* value for Token, or CONFIG_KEY_UNKNOWN.
+static UINTN LookUpKeyword(IN CHAR16 *Token) {
+   UINTN Key, Slot, i;
+
+   if (!KeywordSlotsReady) {
+      for (Key = 1; Key < CONFIG_KEY_COUNT; Key++) {
+         Slot = HashKeyword(ConfigKeywords[Key]);
+         while (KeywordSlots[Slot] != CONFIG_KEY_UNKNOWN)
+            Slot = (Slot + 1) % CONFIG_KEY_HASH_SIZE;
+         KeywordSlots[Slot] = (UINT8) Key;
+      } // for
+      KeywordSlotsReady = TRUE;
+   } // if
+
+   Slot = HashKeyword(Token);
+   for (i = 0; i < CONFIG_KEY_HASH_SIZE && KeywordSlots[Slot] != CONFIG_KEY_UNKNOWN; i++) {
+      if (StriCmp(ConfigKeywords[KeywordSlots[Slot]], Token) == 0)
+         return KeywordSlots[Slot];
+      Slot = (Slot + 1) % CONFIG_KEY_HASH_SIZE;
+   }
+   return CONFIG_KEY_UNKNOWN;
+} // static UINTN LookUpKeyword()
+
+typedef struct {
+   UINTN    Key;           // CONFIG_KEY_* for TokenList[0]
+   UINTN    TokenCount;
+   CHAR16   **TokenList;
+   UINTN    End;           // index of the line after this one's stanza, or of the next line
+} CONFIG_LINE;
+
+typedef struct {
+   BOOLEAN      Loaded;
+   REFIT_FILE   File;      // holds the tokens and (in its arena) the lines
+   CONFIG_LINE  **Lines;
+   UINTN        LineCount;
+   UINT64       FileSize;
+   EFI_TIME     ModificationTime;
+} CONFIG_MODEL;
+
+static CONFIG_MODEL ConfigModel;
+
+static VOID FreeConfigModel(VOID) {
+   if (!ConfigModel.Loaded)
+      return;
+   FreeFile(&ConfigModel.File);
+   if (ConfigModel.Lines != NULL)
+      FreePool(ConfigModel.Lines);
+   ConfigModel.Lines = NULL;
+   ConfigModel.LineCount = 0;
+   ConfigModel.Loaded = FALSE;
+} // static VOID FreeConfigModel()
+
+// Sets the End of the menuentry or submenuentry line at Start to the index
+// of the line after the stanza's closing "}" (or to the end of the file),
+// and returns it. Submenus can't be nested within submenus.
+static UINTN LinkStanza(IN UINTN Start, IN BOOLEAN IsSubmenu) {
+   CONFIG_LINE *Line;
+   UINTN       i = Start + 1;
+
+   while ((i < ConfigModel.LineCount) && (ConfigModel.Lines[i]->Key != CONFIG_KEY_CLOSE)) {
+      Line = ConfigModel.Lines[i];
+      if (!IsSubmenu && (Line->Key == CONFIG_KEY_SUBMENUENTRY) && (Line->TokenCount > 1))
+         i = LinkStanza(i, TRUE);
+      else
+         i++;
+   } // while
+   if (i < ConfigModel.LineCount)
+      i++;
+   ConfigModel.Lines[Start]->End = i;
+   return i;
+} // static UINTN LinkStanza()
+
+// Makes sure that ConfigModel holds the current contents of refind.conf,
+// reading and parsing the file only if it's new or its size or modification
+// time has changed since it was last read.
+static EFI_STATUS LoadConfigModel(VOID) {
+   EFI_STATUS       Status;
+   EFI_FILE_HANDLE  FileHandle;
+   EFI_FILE_INFO    *FileInfo;
+   CONFIG_LINE      *Line;
+   CHAR16           **TokenList;
+   UINTN            TokenCount, i;
+
+   Status = refit_call5_wrapper(SelfDir->Open, SelfDir, &FileHandle, CONFIG_FILE_NAME, EFI_FILE_MODE_READ, 0);
+   if (EFI_ERROR(Status)) {
+      FreeConfigModel();
+      return Status;
+   }
+   FileInfo = LibFileInfo(FileHandle);
+   refit_call1_wrapper(FileHandle->Close, FileHandle);
+   if (FileInfo == NULL) {
+      FreeConfigModel();
+      return EFI_LOAD_ERROR;
+   }
+   if (ConfigModel.Loaded && (ConfigModel.FileSize == FileInfo->FileSize) &&
+       (CompareMem(&ConfigModel.ModificationTime, &FileInfo->ModificationTime, sizeof(EFI_TIME)) == 0)) {
+      FreePool(FileInfo);
+      return EFI_SUCCESS;
+   }
+
+   FreeConfigModel();
+   ConfigModel.FileSize = FileInfo->FileSize;
+   CopyMem(&ConfigModel.ModificationTime, &FileInfo->ModificationTime, sizeof(EFI_TIME));
+   FreePool(FileInfo);
+   Status = ReadFile(SelfDir, CONFIG_FILE_NAME, &ConfigModel.File);
+   if (EFI_ERROR(Status))
+      return Status;
+   ConfigModel.Loaded = TRUE;
+
+   while ((TokenCount = ReadTokenLine(&ConfigModel.File, &TokenList)) > 0) {
+      Line = ArenaAlloc(&ConfigModel.File, sizeof(CONFIG_LINE));
+      if (Line == NULL)
+         break;
+      Line->Key = LookUpKeyword(TokenList[0]);
+      Line->TokenCount = TokenCount;
+      Line->TokenList = TokenList;
+      Line->End = ConfigModel.LineCount + 1;
+      AddListElement((VOID ***) &ConfigModel.Lines, &ConfigModel.LineCount, Line);
+   } // while
+
+   i = 0;
+   while (i < ConfigModel.LineCount) {
+      Line = ConfigModel.Lines[i];
+      if ((Line->Key == CONFIG_KEY_MENUENTRY) && (Line->TokenCount > 1))
+         i = LinkStanza(i, FALSE);
+      else
+         i++;
+   } // while
+   return EFI_SUCCESS;
+} // static EFI_STATUS LoadConfigModel()
+
 // read config file
 VOID ReadConfig(VOID)
 {
     EFI_STATUS      Status;
-    REFIT_FILE      File;
+    CONFIG_LINE     *Line;
     CHAR16          **TokenList;
     CHAR16          *FlagName;
-    UINTN           TokenCount, i;
+    UINTN           TokenCount, i, LineIndex;
 
-    if (!FileExists(SelfDir, CONFIG_FILE_NAME)) {
+    Status = LoadConfigModel();
+    if (Status == EFI_NOT_FOUND) {
         Print(L"Configuration file missing!\n");
         return;
     }
-
-    Status = ReadFile(SelfDir, CONFIG_FILE_NAME, &File);
     if (EFI_ERROR(Status))
         return;
 
-    for (;;) {
-        TokenCount = ReadTokenLine(&File, &TokenList);
-        if (TokenCount == 0)
-            break;
+    for (LineIndex = 0; LineIndex < ConfigModel.LineCount; LineIndex++) {
+        Line = ConfigModel.Lines[LineIndex];
+        TokenList = Line->TokenList;
+        TokenCount = Line->TokenCount;
 
-        if (StriCmp(TokenList[0], L"timeout") == 0) {
+        switch (Line->Key) {
+        case CONFIG_KEY_TIMEOUT:
             HandleInt(TokenList, TokenCount, &(GlobalConfig.Timeout));
+            break;
 
-        } else if (StriCmp(TokenList[0], L"hideui") == 0) {
+        case CONFIG_KEY_HIDEUI:
             for (i = 1; i < TokenCount; i++) {
                 FlagName = TokenList[i];
                 if (StriCmp(FlagName, L"banner") == 0) {
@@ -341,25 +641,30 @@ VOID ReadConfig(VOID)
                     Print(L" unknown hideui flag: '%s'\n", FlagName);
                 }
             }
+            break;
 
-        } else if (StriCmp(TokenList[0], L"icons_dir") == 0) {
+        case CONFIG_KEY_ICONS_DIR:
            HandleString(TokenList, TokenCount, &(GlobalConfig.IconsDir));
+           break;
 
-        } else if (StriCmp(TokenList[0], L"scanfor") == 0) {
+        case CONFIG_KEY_SCANFOR:
            for (i = 0; i < NUM_SCAN_OPTIONS; i++) {
               if (i < TokenCount)
                  GlobalConfig.ScanFor[i] = TokenList[i][0];
               else
                  GlobalConfig.ScanFor[i] = ' ';
            }
+           break;
 
-        } else if (StriCmp(TokenList[0], L"also_scan_dirs") == 0) {
+        case CONFIG_KEY_ALSO_SCAN_DIRS:
             HandleStrings(TokenList, TokenCount, &(GlobalConfig.AlsoScan));
+            break;
 
-        } else if (StriCmp(TokenList[0], L"scan_driver_dirs") == 0) {
+        case CONFIG_KEY_SCAN_DRIVER_DIRS:
             HandleStrings(TokenList, TokenCount, &(GlobalConfig.DriverDirs));
+            break;
 
-        } else if (StriCmp(TokenList[0], L"showtools") == 0) {
+        case CONFIG_KEY_SHOWTOOLS:
             SetMem(GlobalConfig.ShowTools, NUM_TOOLS * sizeof(UINTN), 0);
             for (i = 1; (i < TokenCount) && (i < NUM_TOOLS); i++) {
                 FlagName = TokenList[i];
@@ -379,42 +684,65 @@ VOID ReadConfig(VOID)
                    Print(L" unknown showtools flag: '%s'\n", FlagName);
                 }
             } // showtools options
+            break;
 
-        } else if (StriCmp(TokenList[0], L"banner") == 0) {
+        case CONFIG_KEY_BANNER:
            HandleString(TokenList, TokenCount, &(GlobalConfig.BannerFileName));
+           break;
 
-        } else if (StriCmp(TokenList[0], L"selection_small") == 0) {
+        case CONFIG_KEY_SELECTION_SMALL:
            HandleString(TokenList, TokenCount, &(GlobalConfig.SelectionSmallFileName));
+           break;
 
-        } else if (StriCmp(TokenList[0], L"selection_big") == 0) {
+        case CONFIG_KEY_SELECTION_BIG:
            HandleString(TokenList, TokenCount, &(GlobalConfig.SelectionBigFileName));
+           break;
 
-        } else if (StriCmp(TokenList[0], L"default_selection") == 0) {
+        case CONFIG_KEY_DEFAULT_SELECTION:
            HandleString(TokenList, TokenCount, &(GlobalConfig.DefaultSelection));
+           break;
 
-        } else if (StriCmp(TokenList[0], L"textonly") == 0) {
+        case CONFIG_KEY_TEXTONLY:
             GlobalConfig.TextOnly = TRUE;
+            break;
 
-        } else if ((StriCmp(TokenList[0], L"resolution") == 0) && (TokenCount == 3)) {
-           GlobalConfig.RequestedScreenWidth = Atoi(TokenList[1]);
-           GlobalConfig.RequestedScreenHeight = Atoi(TokenList[2]);
+        case CONFIG_KEY_RESOLUTION:
+           if (TokenCount == 3) {
+              GlobalConfig.RequestedScreenWidth = Atoi(TokenList[1]);
+              GlobalConfig.RequestedScreenHeight = Atoi(TokenList[2]);
+           }
+           break;
 
-        } else if (StriCmp(TokenList[0], L"scan_all_linux_kernels") == 0) {
+        case CONFIG_KEY_SCAN_ALL_LINUX_KERNELS:
            GlobalConfig.ScanAllLinux = TRUE;
+           break;
 
-        } else if (StriCmp(TokenList[0], L"max_tags") == 0) {
-           HandleInt(TokenList, TokenCount, &(GlobalConfig.MaxTags));
-        }
+        case CONFIG_KEY_PROGRESSIVE_SCAN:
+           GlobalConfig.ProgressiveScan = TRUE;
+           break;
 
-        FreeTokenLine(&TokenList, &TokenCount);
+        case CONFIG_KEY_SCAN_CACHE:
+           GlobalConfig.ScanCache = TRUE;
+           break;
+
+        case CONFIG_KEY_LOG_TIMELINE:
+           GlobalConfig.LogTimeline = TRUE;
+           break;
+
+        case CONFIG_KEY_MAX_TAGS:
+           HandleInt(TokenList, TokenCount, &(GlobalConfig.MaxTags));
+           break;
+        } // switch
     }
-    FreePool(File.Buffer);
 } /* VOID ReadConfig() */
 
-static VOID AddSubmenu(LOADER_ENTRY *Entry, REFIT_FILE *File, REFIT_VOLUME *Volume, CHAR16 *Title) {
+// Adds the submenu whose submenuentry line is ConfigModel.Lines[Start] to
+// Entry's submenu screen.
+static VOID AddSubmenu(LOADER_ENTRY *Entry, UINTN Start, REFIT_VOLUME *Volume, CHAR16 *Title) {
    REFIT_MENU_SCREEN  *SubScreen;
    LOADER_ENTRY       *SubEntry;
-   UINTN              TokenCount;
+   CONFIG_LINE        *Line;
+   UINTN              TokenCount, i;
    CHAR16             **TokenList;
 
    SubScreen = InitializeSubScreen(Entry);
@@ -426,35 +754,37 @@ static VOID AddSubmenu(LOADER_ENTRY *Entry, REFIT_FILE *File, REFIT_VOLUME *Volu
       return;
    SubEntry->me.Title        = StrDuplicate(Title);
 
-   while (((TokenCount = ReadTokenLine(File, &TokenList)) > 0) && (StriCmp(TokenList[0], L"}") != 0)) {
-      if ((StriCmp(TokenList[0], L"loader") == 0) && (TokenCount > 1)) { // set the boot loader filename
+   for (i = Start + 1; (i < ConfigModel.Lines[Start]->End) && (ConfigModel.Lines[i]->Key != CONFIG_KEY_CLOSE); i++) {
+      Line = ConfigModel.Lines[i];
+      TokenList = Line->TokenList;
+      TokenCount = Line->TokenCount;
+      if ((Line->Key == CONFIG_KEY_LOADER) && (TokenCount > 1)) { // set the boot loader filename
          if (SubEntry->LoaderPath != NULL)
             FreePool(SubEntry->LoaderPath);
          SubEntry->LoaderPath = StrDuplicate(TokenList[1]);
          SubEntry->DevicePath = FileDevicePath(Volume->DeviceHandle, SubEntry->LoaderPath);
-      } else if (StriCmp(TokenList[0], L"initrd") == 0) {
+      } else if (Line->Key == CONFIG_KEY_INITRD) {
          if (SubEntry->InitrdPath != NULL)
             FreePool(SubEntry->InitrdPath);
          SubEntry->InitrdPath = NULL;
          if (TokenCount > 1) {
             SubEntry->InitrdPath = StrDuplicate(TokenList[1]);
          }
-      } else if (StriCmp(TokenList[0], L"options") == 0) {
+      } else if (Line->Key == CONFIG_KEY_OPTIONS) {
          if (SubEntry->LoadOptions != NULL)
             FreePool(SubEntry->LoadOptions);
          SubEntry->LoadOptions = NULL;
          if (TokenCount > 1) {
             SubEntry->LoadOptions = StrDuplicate(TokenList[1]);
          } // if/else
-      } else if ((StriCmp(TokenList[0], L"add_options") == 0) && (TokenCount > 1)) {
+      } else if ((Line->Key == CONFIG_KEY_ADD_OPTIONS) && (TokenCount > 1)) {
          MergeStrings(&SubEntry->LoadOptions, TokenList[1], L' ');
-      } else if ((StriCmp(TokenList[0], L"graphics") == 0) && (TokenCount > 1)) {
+      } else if ((Line->Key == CONFIG_KEY_GRAPHICS) && (TokenCount > 1)) {
          SubEntry->UseGraphicsMode = (StriCmp(TokenList[1], L"on") == 0);
-      } else if (StriCmp(TokenList[0], L"disabled") == 0) {
+      } else if (Line->Key == CONFIG_KEY_DISABLED) {
          SubEntry->Enabled = FALSE;
       } // ief/elseif
-      FreeTokenLine(&TokenList, &TokenCount);
-   } // while()
+   } // for
    if (SubEntry->InitrdPath != NULL) {
       MergeStrings(&SubEntry->LoadOptions, L"initrd=", L' ');
       MergeStrings(&SubEntry->LoadOptions, SubEntry->InitrdPath, 0);
@@ -500,12 +830,13 @@ static BOOLEAN FindVolume(REFIT_VOLUME **Volume, CHAR16 *Identifier) {
    return (Found);
 } // static VOID FindVolume()
 
-// Adds the options from a SINGLE refind.conf stanza to a new loader entry and returns
-// that entry. The calling function is then responsible for adding the entry to the
-// list of entries.
-static LOADER_ENTRY * AddStanzaEntries(REFIT_FILE *File, REFIT_VOLUME *Volume, CHAR16 *Title) {
+// Adds the options from a SINGLE refind.conf stanza, whose menuentry line is
+// ConfigModel.Lines[Start], to a new loader entry and returns that entry. The
+// calling function is then responsible for adding the entry to the list of entries.
+static LOADER_ENTRY * AddStanzaEntries(UINTN Start, REFIT_VOLUME *Volume, CHAR16 *Title) {
+   CONFIG_LINE  *Line;
    CHAR16       **TokenList;
-   UINTN        TokenCount;
+   UINTN        TokenCount, i;
    LOADER_ENTRY *Entry;
    BOOLEAN      DefaultsSet = FALSE, AddedSubmenu = FALSE;
    REFIT_VOLUME *CurrentVolume = Volume;
@@ -521,50 +852,55 @@ static LOADER_ENTRY * AddStanzaEntries(REFIT_FILE *File, REFIT_VOLUME *Volume, C
    Entry->me.BadgeImage   = CurrentVolume->VolBadgeImage;
    Entry->VolName         = CurrentVolume->VolName;
 
-   // Parse the config file to add options for a single stanza, terminating when the token
-   // is "}" or when the end of file is reached.
-   while (((TokenCount = ReadTokenLine(File, &TokenList)) > 0) && (StriCmp(TokenList[0], L"}") != 0)) {
-      if ((StriCmp(TokenList[0], L"loader") == 0) && (TokenCount > 1)) { // set the boot loader filename
+   // Go through the lines of a single stanza, terminating when the token is "}" or
+   // when the end of file is reached. Submenus are skipped over as they're added.
+   i = Start + 1;
+   while ((i < ConfigModel.Lines[Start]->End) && (ConfigModel.Lines[i]->Key != CONFIG_KEY_CLOSE)) {
+      Line = ConfigModel.Lines[i];
+      TokenList = Line->TokenList;
+      TokenCount = Line->TokenCount;
+      if ((Line->Key == CONFIG_KEY_LOADER) && (TokenCount > 1)) { // set the boot loader filename
          Entry->LoaderPath = StrDuplicate(TokenList[1]);
          Entry->DevicePath = FileDevicePath(CurrentVolume->DeviceHandle, Entry->LoaderPath);
          SetLoaderDefaults(Entry, TokenList[1], CurrentVolume);
          FreePool(Entry->LoadOptions);
          Entry->LoadOptions = NULL; // Discard default options, if any
          DefaultsSet = TRUE;
-      } else if ((StriCmp(TokenList[0], L"volume") == 0) && (TokenCount > 1)) {
+      } else if ((Line->Key == CONFIG_KEY_VOLUME) && (TokenCount > 1)) {
          if (FindVolume(&CurrentVolume, TokenList[1])) {
             FreePool(Entry->me.Title);
             Entry->me.Title        = PoolPrint(L"Boot %s from %s", (Title != NULL) ? Title : L"Unknown", CurrentVolume->VolName);
             Entry->me.BadgeImage   = CurrentVolume->VolBadgeImage;
             Entry->VolName         = CurrentVolume->VolName;
          } // if match found
-      } else if ((StriCmp(TokenList[0], L"icon") == 0) && (TokenCount > 1)) {
-         FreePool(Entry->me.Image);
+      } else if ((Line->Key == CONFIG_KEY_ICON) && (TokenCount > 1)) {
+         if (Entry->me.Image != CurrentVolume->VolIconImage)
+            ReleaseIcon(Entry->me.Image);
          Entry->me.Image = LoadIcns(CurrentVolume->RootDir, TokenList[1], 128);
          if (Entry->me.Image == NULL) {
             Entry->me.Image = DummyImage(128);
          }
-      } else if ((StriCmp(TokenList[0], L"initrd") == 0) && (TokenCount > 1)) {
+      } else if ((Line->Key == CONFIG_KEY_INITRD) && (TokenCount > 1)) {
          if (Entry->InitrdPath)
             FreePool(Entry->InitrdPath);
          Entry->InitrdPath = StrDuplicate(TokenList[1]);
-      } else if ((StriCmp(TokenList[0], L"options") == 0) && (TokenCount > 1)) {
+      } else if ((Line->Key == CONFIG_KEY_OPTIONS) && (TokenCount > 1)) {
          if (Entry->LoadOptions)
             FreePool(Entry->LoadOptions);
          Entry->LoadOptions = StrDuplicate(TokenList[1]);
-      } else if ((StriCmp(TokenList[0], L"ostype") == 0) && (TokenCount > 1)) {
+      } else if ((Line->Key == CONFIG_KEY_OSTYPE) && (TokenCount > 1)) {
          if (TokenCount > 1) {
             Entry->OSType = TokenList[1][0];
          }
-      } else if ((StriCmp(TokenList[0], L"graphics") == 0) && (TokenCount > 1)) {
+      } else if ((Line->Key == CONFIG_KEY_GRAPHICS) && (TokenCount > 1)) {
          Entry->UseGraphicsMode = (StriCmp(TokenList[1], L"on") == 0);
-      } else if (StriCmp(TokenList[0], L"disabled") == 0) {
+      } else if (Line->Key == CONFIG_KEY_DISABLED) {
          Entry->Enabled = FALSE;
-      } else if ((StriCmp(TokenList[0], L"submenuentry") == 0) && (TokenCount > 1)) {
-         AddSubmenu(Entry, File, CurrentVolume, TokenList[1]);
+      } else if ((Line->Key == CONFIG_KEY_SUBMENUENTRY) && (TokenCount > 1)) {
+         AddSubmenu(Entry, i, CurrentVolume, TokenList[1]);
          AddedSubmenu = TRUE;
       } // set options to pass to the loader program
-      FreeTokenLine(&TokenList, &TokenCount);
+      i = Line->End;
    } // while()
 
    if (AddedSubmenu)
@@ -583,41 +919,30 @@ static LOADER_ENTRY * AddStanzaEntries(REFIT_FILE *File, REFIT_VOLUME *Volume, C
    return(Entry);
 } // static VOID AddStanzaEntries()
 
-// Read the user-configured loaders file, refind_loaders.conf, and add or delete
-// entries based on the contents of that file....
+// Add or delete entries based on the menuentry stanzas in refind.conf, which
+// ReadConfig() has already loaded into ConfigModel.
 VOID ScanUserConfigured(VOID)
 {
-   EFI_STATUS        Status;
-   REFIT_FILE        File;
    REFIT_VOLUME      *Volume;
-   CHAR16            **TokenList;
-   CHAR16            *Title = NULL;
-   UINTN             TokenCount;
+   CONFIG_LINE       *Line;
+   UINTN             i;
    LOADER_ENTRY      *Entry;
 
-   if (FileExists(SelfDir, CONFIG_FILE_NAME)) {
-      Status = ReadFile(SelfDir, CONFIG_FILE_NAME, &File);
-      if (EFI_ERROR(Status))
-         return;
-
-      Volume = SelfVolume;
-
-      while ((TokenCount = ReadTokenLine(&File, &TokenList)) > 0) {
-         if ((StriCmp(TokenList[0], L"menuentry") == 0) && (TokenCount > 1)) {
-            Title = StrDuplicate(TokenList[1]);
-            Entry = AddStanzaEntries(&File, Volume, TokenList[1]);
-            if (Entry->Enabled) {
-               if (Entry->me.SubScreen == NULL)
-                  GenerateSubScreen(Entry, Volume);
-               AddPreparedLoaderEntry(Entry);
-            } else {
-               FreePool(Entry);
-            } // if/else
-            FreePool(Title);
-         } // if
-         FreeTokenLine(&TokenList, &TokenCount);
-      } // while()
-   } // if()
+   Volume = SelfVolume;
+
+   for (i = 0; i < ConfigModel.LineCount; i = Line->End) {
+      Line = ConfigModel.Lines[i];
+      if ((Line->Key == CONFIG_KEY_MENUENTRY) && (Line->TokenCount > 1)) {
+         Entry = AddStanzaEntries(i, Volume, Line->TokenList[1]);
+         if (Entry->Enabled) {
+            if (Entry->me.SubScreen == NULL)
+               GenerateSubScreen(Entry, Volume);
+            AddPreparedLoaderEntry(Entry);
+         } else {
+            FreePool(Entry);
+         } // if/else
+      } // if
+   } // for
 } // VOID ScanUserConfigured()
 
 // Read a Linux kernel options file for a Linux boot loader into memory. The LoaderPath
@@ -681,6 +1006,7 @@ CHAR16 * GetFirstOptionsFromFile(IN CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume)
       if (TokenCount > 1)
          Options = StrDuplicate(TokenList[1]);
       FreeTokenLine(&TokenList, &TokenCount);
+      FreeFile(File);
       FreePool(File);
    }
    return Options;
@@ -53,16 +53,22 @@
 // config module
 //
 
+// Buffer holds the whole file as NUL-terminated UTF-16 (whatever its encoding
+// on disk); tokens point into it, and token lists come from Arena.
 typedef struct {
     UINT8   *Buffer;
     UINTN   BufferSize;
     UINTN   Encoding;
-    CHAR8   *Current8Ptr;
-    CHAR8   *End8Ptr;
     CHAR16  *Current16Ptr;
     CHAR16  *End16Ptr;
+    VOID    *Arena;
+    CHAR16  **Tokens;       // scratch list reused by ReadTokenLine()
+    UINTN   TokensSize;
 } REFIT_FILE;
 
+// names of the files that hold Linux kernel options, in order of preference
+#define LINUX_OPTIONS_FILENAMES  L"refind_linux.conf,refind-linux.conf,linux.conf"
+
 #define HIDEUI_FLAG_BANNER     (0x0001)
 #define HIDEUI_FLAG_LABEL      (0x0002)
 #define HIDEUI_FLAG_SINGLEUSER (0x0004)
@@ -70,6 +76,8 @@ typedef struct {
 #define HIDEUI_FLAG_ARROWS     (0x0010)
 #define HIDEUI_ALL             ((0xffff))
 
+EFI_STATUS ReadFile(IN EFI_FILE_HANDLE BaseDir, CHAR16 *FileName, REFIT_FILE *File);
+VOID FreeFile(IN OUT REFIT_FILE *File);
 VOID ReadConfig(VOID);
 VOID ScanUserConfigured(VOID);
 UINTN ReadTokenLine(IN REFIT_FILE *File, OUT CHAR16 ***TokenList);
@@ -106,6 +106,10 @@ typedef struct {
    EFI_BLOCK_IO        *WholeDiskBlockIO;
    EFI_DEVICE_PATH     *WholeDiskDevicePath;
    MBR_PARTITION_INFO  *MbrPartitionTable;
+   BOOLEAN             IsGptPartition;
+   EFI_GUID            PartTypeGuid;     // GPT partition type, unique GUID and name;
+   EFI_GUID            PartGuid;         // set only if IsGptPartition
+   CHAR16              *PartName;        // NULL if the GPT entry has no name
    BOOLEAN             IsReadable;
 } REFIT_VOLUME;
 
@@ -117,7 +121,11 @@ typedef struct _refit_menu_entry {
    CHAR16      ShortcutLetter;
    EG_IMAGE    *Image;
    EG_IMAGE    *BadgeImage;
+   CHAR16      *IconName;          // while Image is still to be loaded: LoadOSIcon() arguments
+   CHAR16      *IconFallback;      // (NULL if nothing is pending)
    struct _refit_menu_screen *SubScreen;
+   EG_IMAGE    *TileImages[2];     // cached main-menu tiles: [0] = selected, [1] = not selected
+   UINTN       TileGeneration;     // see InvalidateMenuTiles()
 } REFIT_MENU_ENTRY;
 
 typedef struct _refit_menu_screen {
@@ -129,6 +137,7 @@ typedef struct _refit_menu_screen {
    REFIT_MENU_ENTRY **Entries;
    UINTN       TimeoutSeconds;
    CHAR16      *TimeoutText;
+   BOOLEAN     (*IdleFunc)(struct _refit_menu_screen *Screen);   // optional; see RunGenericMenu()
 } REFIT_MENU_SCREEN;
 
 typedef struct {
@@ -142,6 +151,7 @@ typedef struct {
    CHAR16           *LoadOptions;
    CHAR16           *InitrdPath; // Linux stub loader only
    CHAR8            OSType;
+   REFIT_VOLUME     *Volume;     // set while the subscreen is still to be built
 } LOADER_ENTRY;
 
 typedef struct {
@@ -154,6 +164,9 @@ typedef struct {
 typedef struct {
    BOOLEAN     TextOnly;
    BOOLEAN     ScanAllLinux;
+   BOOLEAN     ProgressiveScan;
+   BOOLEAN     ScanCache;
+   BOOLEAN     LogTimeline;
    UINTN       RequestedScreenWidth;
    UINTN       RequestedScreenHeight;
    UINTN       Timeout;
@@ -187,6 +200,7 @@ extern REFIT_CONFIG     GlobalConfig;
 LOADER_ENTRY *InitializeLoaderEntry(IN LOADER_ENTRY *Entry);
 REFIT_MENU_SCREEN *InitializeSubScreen(IN LOADER_ENTRY *Entry);
 VOID GenerateSubScreen(LOADER_ENTRY *Entry, IN REFIT_VOLUME *Volume);
+VOID GeneratePendingSubScreen(IN OUT REFIT_MENU_ENTRY *Entry);
 LOADER_ENTRY * MakeGenericLoaderEntry(VOID);
 LOADER_ENTRY * AddLoaderEntry(IN CHAR16 *LoaderPath, IN CHAR16 *LoaderTitle, IN REFIT_VOLUME *Volume);
 VOID SetLoaderDefaults(LOADER_ENTRY *Entry, CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume);
@@ -38,6 +38,362 @@
 #include "lib.h"
 #include "icns.h"
 #include "config.h"
+#include "../include/iconpack.h"
+
+//
+// icon cache
+//
+
+// Icons are cached by (directory handle, path, size). Several loader entries
+// commonly share the same OS icon, and the same missing files tend to be
+// probed over and over, so both successful and failed loads are remembered.
+// Images handed out by LoadIcns() are shared; callers that are done with
+// one should pass it to ReleaseIcon() rather than freeing it. Images that
+// nobody holds any more stay cached until they exceed ICON_CACHE_BUDGET
+// bytes, and are then evicted least-recently-used first.
+
+#define ICON_CACHE_BUDGET       (2 * 1024 * 1024)
+#define ICON_CACHE_MAX_MISSES   (64)
+
+typedef struct _icon_cache_entry {
+    EFI_FILE_HANDLE     BaseDir;        // NULL once flushed; never matches again
+    CHAR16              *FileName;
+    UINTN               PixelSize;
+    UINT32              Hash;
+    EG_IMAGE            *Image;         // NULL for a failed load
+    UINTN               RefCount;
+    UINTN               LastUse;
+    struct _icon_cache_entry *Next;
+} ICON_CACHE_ENTRY;
+
+static ICON_CACHE_ENTRY *IconCache = NULL;
+static UINTN IconCacheClock = 0;
+static UINTN IconCacheIdleBytes = 0;   // pixel data held by unreferenced images
+static UINTN IconCacheMisses = 0;      // number of failed-load entries
+
+// Case-insensitive FNV-1a hash of a path, so most non-matching entries can
+// be skipped without a string comparison.
+static UINT32 HashIconPath(IN CHAR16 *Path)
+{
+    UINT32 Hash = 2166136261U;
+    CHAR16 c;
+
+    while ((c = *Path++) != 0) {
+        if (c >= 'a' && c <= 'z')
+            c -= 'a' - 'A';
+        else if (c == '/')
+            c = '\\';
+        Hash = (Hash ^ c) * 16777619U;
+    }
+    return Hash;
+}
+
+static UINTN IconImageBytes(IN EG_IMAGE *Image)
+{
+    return (Image == NULL) ? 0 : Image->Width * Image->Height * sizeof(EG_PIXEL);
+}
+
+static VOID FreeIconCacheEntry(IN ICON_CACHE_ENTRY *Entry)
+{
+    ICON_CACHE_ENTRY **Link;
+
+    for (Link = &IconCache; *Link != NULL; Link = &((*Link)->Next)) {
+        if (*Link == Entry) {
+            *Link = Entry->Next;
+            break;
+        }
+    }
+    if (Entry->Image == NULL && Entry->BaseDir != NULL)
+        IconCacheMisses--;
+    else if (Entry->RefCount == 0 && Entry->BaseDir != NULL)
+        IconCacheIdleBytes -= IconImageBytes(Entry->Image);
+    egFreeImage(Entry->Image);
+    if (Entry->FileName != NULL)
+        FreePool(Entry->FileName);
+    FreePool(Entry);
+} // static VOID FreeIconCacheEntry()
+
+// Evicts the least-recently-used unreferenced images until the cache fits
+// its budget, and the oldest failed loads beyond ICON_CACHE_MAX_MISSES.
+static VOID TrimIconCache(VOID)
+{
+    ICON_CACHE_ENTRY *Entry, *Oldest;
+
+    while (IconCacheIdleBytes > ICON_CACHE_BUDGET || IconCacheMisses > ICON_CACHE_MAX_MISSES) {
+        Oldest = NULL;
+        for (Entry = IconCache; Entry != NULL; Entry = Entry->Next) {
+            if (Entry->RefCount > 0 || Entry->BaseDir == NULL)
+                continue;
+            if ((IconCacheIdleBytes > ICON_CACHE_BUDGET) != (Entry->Image != NULL))
+                continue;
+            if (Oldest == NULL || Entry->LastUse < Oldest->LastUse)
+                Oldest = Entry;
+        }
+        if (Oldest == NULL)
+            break;
+        FreeIconCacheEntry(Oldest);
+    } // while
+} // static VOID TrimIconCache()
+
+static ICON_CACHE_ENTRY * FindCachedIcon(IN EFI_FILE_HANDLE BaseDir, IN CHAR16 *FileName,
+                                         IN UINTN PixelSize, IN UINT32 Hash)
+{
+    ICON_CACHE_ENTRY *Entry;
+
+    for (Entry = IconCache; Entry != NULL; Entry = Entry->Next) {
+        if (Entry->Hash == Hash && Entry->BaseDir == BaseDir && Entry->PixelSize == PixelSize &&
+            StriCmp(Entry->FileName, FileName) == 0)
+            return Entry;
+    }
+    return NULL;
+}
+
+// Gives up a reference to an image obtained from LoadIcns(). Images that
+// didn't come from the cache are simply freed.
+VOID ReleaseIcon(IN EG_IMAGE *Image)
+{
+    ICON_CACHE_ENTRY *Entry;
+
+    if (Image == NULL)
+        return;
+
+    for (Entry = IconCache; Entry != NULL; Entry = Entry->Next) {
+        if (Entry->Image == Image)
+            break;
+    }
+    if (Entry == NULL) {
+        egFreeImage(Image);
+        return;
+    }
+
+    if (Entry->RefCount > 0 && --Entry->RefCount == 0) {
+        if (Entry->BaseDir == NULL) {
+            FreeIconCacheEntry(Entry);   // flushed while in use
+            return;
+        }
+        IconCacheIdleBytes += IconImageBytes(Image);
+        TrimIconCache();
+    }
+} // VOID ReleaseIcon()
+
+// Forgets all cached icons and failed loads, e.g. because the volumes are
+// being closed or rescanned and directory handles may be reused. Images
+// that are still in use stay valid until they're released, but are never
+// handed out again.
+VOID FlushIconCache(VOID)
+{
+    ICON_CACHE_ENTRY *Entry, *Next;
+
+    for (Entry = IconCache; Entry != NULL; Entry = Next) {
+        Next = Entry->Next;
+        if (Entry->RefCount == 0) {
+            FreeIconCacheEntry(Entry);
+        } else {
+            Entry->BaseDir = NULL;
+            if (Entry->FileName != NULL)
+                FreePool(Entry->FileName);
+            Entry->FileName = NULL;
+        }
+    }
+} // VOID FlushIconCache()
+
+//
+// icon theme pack
+//
+
+// If the icons directory contains an icons.pak file (built by mkiconpack),
+// icons are decoded from it instead of from individual .icns files, which
+// saves a firmware file open and read per icon. The pack is read in one go
+// the first time it's needed; icons it doesn't contain are still loaded
+// from their own files.
+
+static UINT8  *IconPackData = NULL;
+static UINTN  IconPackSize = 0;
+static CHAR16 *IconPackDir = NULL;     // directory the pack was looked for in
+
+static CHAR16 LowerAscii(IN CHAR16 c)
+{
+    return (c >= 'A' && c <= 'Z') ? c + ('a' - 'A') : c;
+}
+
+static UINT32 GetLE32(IN UINT8 *Ptr)
+{
+    return (UINT32)Ptr[0] | ((UINT32)Ptr[1] << 8) | ((UINT32)Ptr[2] << 16) | ((UINT32)Ptr[3] << 24);
+}
+
+// Reads Dir\icons.pak, unless it's already been tried. An invalid pack is
+// treated as a missing one.
+static VOID LoadIconPack(IN CHAR16 *Dir)
+{
+    CHAR16      FileName[256];
+    UINT32      EntryCount, BucketCount, BucketOffset, EntryOffset;
+    EFI_STATUS  Status;
+
+    if (IconPackDir != NULL && StriCmp(IconPackDir, Dir) == 0)
+        return;
+
+    if (IconPackData != NULL)
+        FreePool(IconPackData);
+    if (IconPackDir != NULL)
+        FreePool(IconPackDir);
+    IconPackData = NULL;
+    IconPackSize = 0;
+    IconPackDir = StrDuplicate(Dir);
+
+    SPrint(FileName, 255, L"%s\\%a", Dir, ICONPACK_FILE_NAME);
+    Status = egLoadFile(SelfDir, FileName, &IconPackData, &IconPackSize);
+    if (EFI_ERROR(Status)) {
+        IconPackData = NULL;
+        return;
+    }
+
+    if (IconPackSize >= ICONPACK_HEADER_SIZE && CompareMem(IconPackData, ICONPACK_MAGIC, 4) == 0 &&
+        GetLE32(IconPackData + 4) == ICONPACK_VERSION) {
+        EntryCount = GetLE32(IconPackData + 8);
+        BucketCount = GetLE32(IconPackData + 12);
+        BucketOffset = GetLE32(IconPackData + 16);
+        EntryOffset = GetLE32(IconPackData + 20);
+        if (BucketCount > 0 && (BucketCount & (BucketCount - 1)) == 0 &&
+            BucketOffset <= IconPackSize && BucketCount <= (IconPackSize - BucketOffset) / 4 &&
+            EntryOffset <= IconPackSize && EntryCount <= (IconPackSize - EntryOffset) / ICONPACK_ENTRY_SIZE)
+            return;
+    }
+
+#if REFIT_DEBUG > 0
+    Print(L"Ignoring invalid icon pack %s\n", FileName);
+#endif
+    FreePool(IconPackData);
+    IconPackData = NULL;
+    IconPackSize = 0;
+} // static VOID LoadIconPack()
+
+// Decodes the run-length encoded BGRA pixels of a pack entry; see
+// iconpack.h for the encoding.
+static BOOLEAN DecodePackedPixels(IN UINT8 *Data, IN UINTN DataLength, OUT EG_PIXEL *Pixels, IN UINTN PixelCount)
+{
+    UINT8  *DataEnd = Data + DataLength;
+    UINTN  Count, i;
+
+    while (PixelCount > 0 && Data < DataEnd) {
+        if (*Data < 0x80) {
+            Count = *Data++ + 1;
+            if (Count > PixelCount || Count * 4 > (UINTN)(DataEnd - Data))
+                return FALSE;
+            CopyMem(Pixels, Data, Count * 4);
+            Data += Count * 4;
+        } else {
+            Count = *Data++ - 0x7e;
+            if (Count > PixelCount || (UINTN)(DataEnd - Data) < 4)
+                return FALSE;
+            for (i = 0; i < Count; i++)
+                CopyMem(Pixels + i, Data, 4);
+            Data += 4;
+        }
+        Pixels += Count;
+        PixelCount -= Count;
+    }
+    return (PixelCount == 0);
+} // static BOOLEAN DecodePackedPixels()
+
+// Returns the named icon from the current theme's icon pack, or NULL if
+// there's no pack or the icon isn't in it.
+static EG_IMAGE * LoadPackedIcon(IN CHAR16 *FileName, IN UINTN PixelSize)
+{
+    CHAR16      *IconsDir, *Name;
+    UINT8       *Entry, *PackName;
+    UINT32      Hash, Index, Flags, NameOffset, DataOffset, DataLength;
+    UINT32      EntryCount, EntryOffset, BucketOffset, Steps;
+    UINTN       DirLength, i;
+    CHAR16      c;
+    EG_IMAGE    *Image;
+
+    IconsDir = GlobalConfig.IconsDir ? GlobalConfig.IconsDir : DEFAULT_ICONS_DIR;
+
+    // only icons that live directly in the icons directory can be packed
+    Name = Basename(FileName);
+    DirLength = StrLen(IconsDir);
+    if (Name != FileName + DirLength + 1)
+        return NULL;
+    for (i = 0; i < DirLength; i++) {
+        if (LowerAscii(FileName[i]) != LowerAscii(IconsDir[i]))
+            return NULL;
+    }
+
+    LoadIconPack(IconsDir);
+    if (IconPackData == NULL)
+        return NULL;
+
+    Hash = ICONPACK_HASH_INIT;
+    for (i = 0; (c = Name[i]) != 0; i++) {
+        if (c > 0x7f)
+            return NULL;   // pack names are ASCII
+        Hash = (Hash ^ LowerAscii(c)) * ICONPACK_HASH_PRIME;
+    }
+
+    // LoadIconPack() checked that the bucket and entry tables lie within the
+    // pack; the chain can still be corrupt, so follow at most EntryCount links
+    EntryCount = GetLE32(IconPackData + 8);
+    BucketOffset = GetLE32(IconPackData + 16) + (Hash & (GetLE32(IconPackData + 12) - 1)) * 4;
+    EntryOffset = GetLE32(IconPackData + 20);
+    if (BucketOffset > IconPackSize - 4)
+        return NULL;
+    Index = GetLE32(IconPackData + BucketOffset);
+    for (Steps = 0; Steps < EntryCount && Index > 0 && Index <= EntryCount; Steps++) {
+        if (EntryOffset + (UINTN)(Index - 1) * ICONPACK_ENTRY_SIZE > IconPackSize - ICONPACK_ENTRY_SIZE)
+            return NULL;
+        Entry = IconPackData + EntryOffset + (Index - 1) * ICONPACK_ENTRY_SIZE;
+        Index = GetLE32(Entry + 4);
+        if (GetLE32(Entry) != Hash || GetLE32(Entry + 12) != PixelSize)
+            continue;
+
+        // compare names, making sure the stored one is terminated within the pack
+        NameOffset = GetLE32(Entry + 8);
+        if (NameOffset >= IconPackSize)
+            continue;
+        PackName = IconPackData + NameOffset;
+        for (i = 0; NameOffset + i < IconPackSize && PackName[i] != 0 && Name[i] != 0; i++) {
+            if (PackName[i] != LowerAscii(Name[i]))
+                break;
+        }
+        if (NameOffset + i >= IconPackSize || PackName[i] != 0 || Name[i] != 0)
+            continue;
+
+        Flags = GetLE32(Entry + 16);
+        DataOffset = GetLE32(Entry + 20);
+        DataLength = GetLE32(Entry + 24);
+        if (DataOffset > IconPackSize || DataLength > IconPackSize - DataOffset)
+            return NULL;
+
+        Image = egCreateImage(PixelSize, PixelSize, TRUE);
+        if (Image == NULL)
+            return NULL;
+        if (!DecodePackedPixels(IconPackData + DataOffset, DataLength, Image->PixelData, PixelSize * PixelSize)) {
+            egFreeImage(Image);
+            return NULL;
+        }
+        if (Flags & ICONPACK_FLAG_PREMULTIPLIED)
+            Image->Premultiplied = TRUE;
+        else
+            egPremultiplyImage(Image);
+        return Image;
+    } // for
+
+    return NULL;
+} // static EG_IMAGE * LoadPackedIcon()
+
+// Loads an icon from the theme's icon pack if possible, or from its own file.
+// The pack wins over the loose file, so that the icons directory needn't be
+// searched at all; an edited icon only shows up once the pack is rebuilt.
+static EG_IMAGE * LoadIconUncached(IN EFI_FILE_HANDLE BaseDir, IN CHAR16 *FileName, IN UINTN PixelSize)
+{
+    EG_IMAGE *Image = NULL;
+
+    if (BaseDir == SelfDir)
+        Image = LoadPackedIcon(FileName, PixelSize);
+    if (Image == NULL)
+        Image = egLoadIcon(BaseDir, FileName, PixelSize);
+    return Image;
+}
 
 //
 // well-known icons
@@ -99,16 +455,16 @@ EG_IMAGE * LoadOSIcon(IN CHAR16 *OSIconName OPTIONAL, IN CHAR16 *FallbackIconNam
               BootLogo ? L"boot" : L"os", CutoutName);
 
         // try to load it
-        Image = egLoadIcon(SelfDir, FileName, 128);
+        Image = LoadIcns(SelfDir, FileName, 128);
+        FreePool(CutoutName);
         if (Image != NULL)
             return Image;
-        FreePool(CutoutName);
     } // while
 
     // try the fallback name
     SPrint(FileName, 255, L"%s\\%s_%s.icns", GlobalConfig.IconsDir ? GlobalConfig.IconsDir : DEFAULT_ICONS_DIR,
            BootLogo ? L"boot" : L"os", FallbackIconName);
-    Image = egLoadIcon(SelfDir, FileName, 128);
+    Image = LoadIcns(SelfDir, FileName, 128);
     if (Image != NULL)
         return Image;
 
@@ -123,12 +479,45 @@ EG_IMAGE * LoadOSIcon(IN CHAR16 *OSIconName OPTIONAL, IN CHAR16 *FallbackIconNam
 // Load an image from a .icns file
 //
 
+// Returns the icon, shared with any other callers that asked for the same
+// one; see ReleaseIcon().
 EG_IMAGE * LoadIcns(IN EFI_FILE_HANDLE BaseDir, IN CHAR16 *FileName, IN UINTN PixelSize)
 {
+    ICON_CACHE_ENTRY *Entry;
+    UINT32           Hash;
+
     if (GlobalConfig.TextOnly)      // skip loading if it's not used anyway
         return NULL;
-    return egLoadIcon(BaseDir, FileName, PixelSize);
-}
+    if (BaseDir == NULL || FileName == NULL)
+        return NULL;
+
+    Hash = HashIconPath(FileName);
+    Entry = FindCachedIcon(BaseDir, FileName, PixelSize, Hash);
+    if (Entry == NULL) {
+        Entry = AllocateZeroPool(sizeof(ICON_CACHE_ENTRY));
+        if (Entry == NULL)
+            return LoadIconUncached(BaseDir, FileName, PixelSize);   // uncached, but still usable
+        Entry->BaseDir = BaseDir;
+        Entry->FileName = StrDuplicate(FileName);
+        Entry->PixelSize = PixelSize;
+        Entry->Hash = Hash;
+        Entry->Image = LoadIconUncached(BaseDir, FileName, PixelSize);
+        Entry->Next = IconCache;
+        IconCache = Entry;
+        if (Entry->Image == NULL)
+            IconCacheMisses++;
+    } else if (Entry->Image != NULL && Entry->RefCount == 0) {
+        IconCacheIdleBytes -= IconImageBytes(Entry->Image);
+    }
+
+    Entry->LastUse = ++IconCacheClock;
+    if (Entry->Image == NULL) {
+        TrimIconCache();
+        return NULL;
+    }
+    Entry->RefCount++;
+    return Entry->Image;
+} // EG_IMAGE * LoadIcns()
 
 static EG_PIXEL BlackPixel  = { 0x00, 0x00, 0x00, 0 };
 //static EG_PIXEL YellowPixel = { 0x00, 0xff, 0xff, 0 };
@@ -139,6 +139,11 @@ EFI_STATUS InitRefitLib(IN EFI_HANDLE ImageHandle)
 // called before running external programs to close open file handles
 VOID UninitRefitLib(VOID)
 {
+    // cached icons and directory listings are keyed by directory handle,
+    // which are about to go away
+    FlushIconCache();
+    FlushDirCache();
+
     UninitVolumes();
 
     if (SelfDir != NULL) {
@@ -319,17 +324,384 @@ VOID ExtractLegacyLoaderPaths(EFI_DEVICE_PATH **PathList, UINTN MaxPaths, EFI_DE
     PathList[PathCount] = NULL;
 }
 
+//
+// sector read cache
+//
+
+// Volume scanning reads the same few sectors several times over: each
+// partition's boot sector is read by ScanVolumeBootcode() and again when
+// ScanVolumes() matches partitions against the MBR, and the extended
+// partition chain is read by ScanExtendedPartition() and again by
+// ActivateMbrPartition(). Those reads go through ReadCachedBlocks(), which
+// keeps the last SECTOR_CACHE_ENTRIES reads, keyed by BlockIO media and
+// LBA, so that each is done only once per scan.
+
+#define SECTOR_CACHE_ENTRIES 64
+
+typedef struct {
+    EFI_BLOCK_IO_MEDIA      *Media;
+    UINT32                  MediaId;
+    EFI_LBA                 Lba;
+    UINTN                   Size;
+    UINT8                   *Data;
+} SECTOR_CACHE_ENTRY;
+
+static SECTOR_CACHE_ENTRY   SectorCache[SECTOR_CACHE_ENTRIES];
+static UINTN                SectorCacheNext = 0;    // entry to replace next
+static SECTOR_CACHE_STATS   SectorCacheStats = { 0, 0, 0 };
+
+// Drops all cached sectors; or, if Media is given, those of that medium.
+VOID FlushSectorCache(IN EFI_BLOCK_IO_MEDIA *Media OPTIONAL)
+{
+    UINTN i;
+
+    for (i = 0; i < SECTOR_CACHE_ENTRIES; i++) {
+        if (SectorCache[i].Data != NULL && (Media == NULL || SectorCache[i].Media == Media)) {
+            FreePool(SectorCache[i].Data);
+            SectorCache[i].Data = NULL;
+        }
+    }
+}
+
+// Adds a read to the cache, replacing the oldest one if it's full. The
+// cache takes over Data, which must come from AllocatePool().
+static VOID AddSectorCacheEntry(IN EFI_BLOCK_IO_MEDIA *Media, IN EFI_LBA Lba, IN UINTN Size, IN UINT8 *Data)
+{
+    SECTOR_CACHE_ENTRY      *Entry;
+
+    Entry = &SectorCache[SectorCacheNext];
+    SectorCacheNext = (SectorCacheNext + 1) % SECTOR_CACHE_ENTRIES;
+    if (Entry->Data != NULL)
+        FreePool(Entry->Data);
+    Entry->Media = Media;
+    Entry->MediaId = Media->MediaId;
+    Entry->Lba = Lba;
+    Entry->Size = Size;
+    Entry->Data = Data;
+}
+
+// Reads Size bytes starting at Lba, as BlockIO->ReadBlocks() does, but
+// serves the read from the cache if an earlier one covered it.
+EFI_STATUS ReadCachedBlocks(IN EFI_BLOCK_IO *BlockIO, IN EFI_LBA Lba, IN UINTN Size, OUT VOID *Buffer)
+{
+    EFI_STATUS              Status;
+    EFI_BLOCK_IO_MEDIA      *Media = BlockIO->Media;
+    SECTOR_CACHE_ENTRY      *Entry;
+    UINT8                   *Data;
+    UINT64                  Offset;
+    UINTN                   i;
+
+    for (i = 0; i < SECTOR_CACHE_ENTRIES; i++) {
+        Entry = &SectorCache[i];
+        if (Entry->Data == NULL || Entry->Media != Media || Entry->MediaId != Media->MediaId || Lba < Entry->Lba)
+            continue;
+        Offset = MultU64x32(Lba - Entry->Lba, Media->BlockSize);
+        if (Offset + Size <= Entry->Size) {
+            CopyMem(Buffer, Entry->Data + Offset, Size);
+            SectorCacheStats.Hits++;
+            return EFI_SUCCESS;
+        }
+    }
+
+    SectorCacheStats.Misses++;
+    Status = refit_call5_wrapper(BlockIO->ReadBlocks, BlockIO, Media->MediaId, Lba, Size, Buffer);
+    if (EFI_ERROR(Status))
+        return Status;
+
+    Data = AllocatePool(Size);
+    if (Data != NULL) {
+        CopyMem(Data, Buffer, Size);
+        AddSectorCacheEntry(Media, Lba, Size, Data);
+    }
+    return Status;
+}
+
+// Writes blocks as BlockIO->WriteBlocks() does, and drops the cached reads
+// that overlap them. (Reads of the same sectors through another BlockIO,
+// such as a partition's, stay cached until the next ScanVolumes().)
+EFI_STATUS WriteCachedBlocks(IN EFI_BLOCK_IO *BlockIO, IN EFI_LBA Lba, IN UINTN Size, IN VOID *Buffer)
+{
+    EFI_BLOCK_IO_MEDIA      *Media = BlockIO->Media;
+    SECTOR_CACHE_ENTRY      *Entry;
+    UINT64                  Start, EntryStart;
+    UINTN                   i;
+
+    Start = MultU64x32(Lba, Media->BlockSize);
+    for (i = 0; i < SECTOR_CACHE_ENTRIES; i++) {
+        Entry = &SectorCache[i];
+        if (Entry->Data == NULL || Entry->Media != Media)
+            continue;
+        EntryStart = MultU64x32(Entry->Lba, Media->BlockSize);
+        if (EntryStart < Start + Size && Start < EntryStart + Entry->Size) {
+            FreePool(Entry->Data);
+            Entry->Data = NULL;
+        }
+    }
+    return refit_call5_wrapper(BlockIO->WriteBlocks, BlockIO, Media->MediaId, Lba, Size, Buffer);
+}
+
+VOID GetSectorCacheStats(OUT SECTOR_CACHE_STATS *Stats)
+{
+    *Stats = SectorCacheStats;
+}
+
+//
+// overlapped boot sector reads
+//
+
+// EFI_BLOCK_IO2_PROTOCOL (UEFI 2.3.1), which GNU-EFI doesn't define
+#define REFIT_BLOCK_IO2_PROTOCOL_GUID \
+    { 0xa77b2472, 0xe282, 0x4e9f, { 0xa2, 0x45, 0xc2, 0xc0, 0xe2, 0x7b, 0xbc, 0xc1 } }
+
+typedef struct {
+    EFI_EVENT               Event;
+    EFI_STATUS              TransactionStatus;
+} REFIT_BLOCK_IO2_TOKEN;
+
+typedef EFI_STATUS (EFIAPI *REFIT_BLOCK_READ_EX)(IN VOID *This, IN UINT32 MediaId, IN EFI_LBA Lba,
+                                                 IN OUT REFIT_BLOCK_IO2_TOKEN *Token, IN UINTN BufferSize,
+                                                 OUT VOID *Buffer);
+
+typedef struct {
+    EFI_BLOCK_IO_MEDIA      *Media;
+    VOID                    *Reset;
+    REFIT_BLOCK_READ_EX     ReadBlocksEx;
+    VOID                    *WriteBlocksEx;
+    VOID                    *FlushBlocksEx;
+} REFIT_BLOCK_IO2;
+
+static EFI_GUID BlockIo2Protocol = REFIT_BLOCK_IO2_PROTOCOL_GUID;
+
+typedef struct {
+    EFI_BLOCK_IO            *BlockIO;
+    REFIT_BLOCK_IO2_TOKEN   Token;
+    UINT8                   *Data;
+} PREFETCH_READ;
+
+// Reads the first SECTOR_SIZE bytes of every device in Handles into the
+// sector cache, where ScanVolumeBootcode() will find them. Devices with
+// EFI_BLOCK_IO2_PROTOCOL are all sent their reads before any is waited
+// for, so that slow devices (USB card readers, optical drives) spin up and
+// seek at the same time rather than one after another. Devices without it
+// are left for ScanVolumeBootcode() to read as before.
+static VOID PrefetchBootSectors(IN EFI_HANDLE *Handles, IN UINTN HandleCount)
+{
+    EFI_STATUS              Status;
+    EFI_BLOCK_IO            *BlockIO;
+    REFIT_BLOCK_IO2         *BlockIO2;
+    PREFETCH_READ           *Reads;
+    UINTN                   HandleIndex, ReadCount = 0, i, Index;
+
+    if (HandleCount > SECTOR_CACHE_ENTRIES)
+        HandleCount = SECTOR_CACHE_ENTRIES;   // later ones would push out earlier ones
+    Reads = AllocateZeroPool(HandleCount * sizeof(PREFETCH_READ));
+    if (Reads == NULL)
+        return;
+
+    // start all the reads...
+    for (HandleIndex = 0; HandleIndex < HandleCount; HandleIndex++) {
+        Status = refit_call3_wrapper(BS->HandleProtocol, Handles[HandleIndex], &BlockIoProtocol, (VOID **) &BlockIO);
+        if (EFI_ERROR(Status))
+            continue;
+        Status = refit_call3_wrapper(BS->HandleProtocol, Handles[HandleIndex], &BlockIo2Protocol, (VOID **) &BlockIO2);
+        if (EFI_ERROR(Status) || BlockIO2->ReadBlocksEx == NULL)
+            continue;
+        if (!BlockIO->Media->MediaPresent || BlockIO->Media->BlockSize > SECTOR_SIZE ||
+            BlockIO->Media->IoAlign > 8)   // AllocatePool() only guarantees 8-byte alignment
+            continue;
+
+        Reads[ReadCount].Data = AllocatePool(SECTOR_SIZE);
+        if (Reads[ReadCount].Data == NULL)
+            break;
+        Status = refit_call5_wrapper(BS->CreateEvent, 0, 0, NULL, NULL, &Reads[ReadCount].Token.Event);
+        if (EFI_ERROR(Status)) {
+            FreePool(Reads[ReadCount].Data);
+            break;
+        }
+        Status = refit_call6_wrapper(BlockIO2->ReadBlocksEx, BlockIO2, BlockIO->Media->MediaId, 0,
+                                     &Reads[ReadCount].Token, SECTOR_SIZE, Reads[ReadCount].Data);
+        if (EFI_ERROR(Status)) {
+            refit_call1_wrapper(BS->CloseEvent, Reads[ReadCount].Token.Event);
+            FreePool(Reads[ReadCount].Data);
+            continue;
+        }
+        Reads[ReadCount++].BlockIO = BlockIO;
+    }
+
+    // ...then collect the results
+    for (i = 0; i < ReadCount; i++) {
+        refit_call3_wrapper(BS->WaitForEvent, 1, &Reads[i].Token.Event, &Index);
+        refit_call1_wrapper(BS->CloseEvent, Reads[i].Token.Event);
+        if (EFI_ERROR(Reads[i].Token.TransactionStatus)) {
+            FreePool(Reads[i].Data);
+        } else {
+            AddSectorCacheEntry(Reads[i].BlockIO->Media, 0, SECTOR_SIZE, Reads[i].Data);
+            SectorCacheStats.Misses++;
+            SectorCacheStats.Overlapped++;
+        }
+    }
+    FreePool(Reads);
+}
+
 //
 // volume functions
 //
 
+// Boot loaders that can be identified by their boot sectors. The first
+// detector (in table order) with a matching signature names the OS, so a
+// more specific detector must come before a more general one.
+typedef struct {
+    CHAR16                  *OSIconName;
+    CHAR16                  *OSName;
+} BOOTCODE_DETECTOR;
+
+#define BOOTCODE_LINUX          (0)
+#define BOOTCODE_GRUB           (1)
+#define BOOTCODE_FREEBSD        (2)
+#define BOOTCODE_OPENBSD        (3)
+#define BOOTCODE_NETBSD         (4)
+#define BOOTCODE_WINDOWS        (5)
+#define BOOTCODE_WINVISTA       (6)
+#define BOOTCODE_FREEDOS        (7)
+#define BOOTCODE_ECOMSTATION    (8)
+#define BOOTCODE_BEOS           (9)
+#define BOOTCODE_ZETA           (10)
+#define BOOTCODE_HAIKU          (11)
+#define BOOTCODE_DETECTOR_COUNT (12)
+#define BOOTCODE_NOT_BOOTABLE   (BOOTCODE_DETECTOR_COUNT)   // dummy boot sector; clears HasBootCode
+
+static BOOTCODE_DETECTOR BootCodeDetectors[BOOTCODE_DETECTOR_COUNT] = {
+    { L"linux", L"Linux" },
+    { L"grub,linux", L"Linux" },
+    { L"freebsd", L"FreeBSD" },
+    { L"openbsd", L"OpenBSD" },
+    { L"netbsd", L"NetBSD" },
+    { L"win", L"Windows" },
+    { L"winvista,win", L"Windows" },
+    { L"freedos", L"FreeDOS" },
+    { L"ecomstation", L"eComStation" },
+    { L"beos", L"BeOS" },
+    { L"zeta,beos", L"ZETA" },
+    { L"haiku,beos", L"Haiku" }
+};
+
+// A byte string that identifies a detector's boot code. It's matched at a
+// fixed Offset into the boot sector or, with BOOTCODE_ANYWHERE, anywhere
+// within its first Range bytes.
+typedef struct {
+    UINTN                   Detector;
+    INTN                    Offset;
+    UINTN                   Range;
+    VOID                    *Bytes;
+    UINTN                   Length;
+} BOOTCODE_SIGNATURE;
+
+#define BOOTCODE_ANYWHERE       (-1)
+
+static BOOTCODE_SIGNATURE BootCodeSignatures[] = {
+    { BOOTCODE_LINUX, 2, 0, "LILO", 4 },
+    { BOOTCODE_LINUX, 6, 0, "LILO", 4 },
+    { BOOTCODE_LINUX, 3, 0, "SYSLINUX", 8 },
+    { BOOTCODE_LINUX, BOOTCODE_ANYWHERE, SECTOR_SIZE, "ISOLINUX", 8 },
+    { BOOTCODE_GRUB, BOOTCODE_ANYWHERE, 512, "Geom\0Hard Disk\0Read\0 Error", 26 },
+    // GRUB in a BIOS boot partition ("Geom\0Read\0 Error") doesn't produce a
+    // bootable entry, so it isn't detected for the moment.
+    { BOOTCODE_FREEBSD, 502, 0, "\x00\x00\x00\x00\x50\xc3\x00\x00\x55\xaa", 10 },
+    { BOOTCODE_FREEBSD, BOOTCODE_ANYWHERE, SECTOR_SIZE, "Starting the BTX loader", 23 },
+    { BOOTCODE_OPENBSD, BOOTCODE_ANYWHERE, 512, "!Loading", 8 },
+    { BOOTCODE_OPENBSD, BOOTCODE_ANYWHERE, SECTOR_SIZE, "/cdboot\0/CDBOOT\0", 16 },
+    { BOOTCODE_NETBSD, BOOTCODE_ANYWHERE, 512, "Not a bootxx image", 18 },
+    { BOOTCODE_NETBSD, 1028, 0, "\xd1\xb6\x86\x78", 4 },
+    { BOOTCODE_WINDOWS, BOOTCODE_ANYWHERE, SECTOR_SIZE, "NTLDR", 5 },
+    { BOOTCODE_WINVISTA, BOOTCODE_ANYWHERE, SECTOR_SIZE, "BOOTMGR", 7 },
+    { BOOTCODE_FREEDOS, BOOTCODE_ANYWHERE, 512, "CPUBOOT SYS", 11 },
+    { BOOTCODE_FREEDOS, BOOTCODE_ANYWHERE, 512, "KERNEL  SYS", 11 },
+    { BOOTCODE_ECOMSTATION, BOOTCODE_ANYWHERE, 512, "OS2LDR", 6 },
+    { BOOTCODE_ECOMSTATION, BOOTCODE_ANYWHERE, 512, "OS2BOOT", 7 },
+    { BOOTCODE_BEOS, BOOTCODE_ANYWHERE, 512, "Be Boot Loader", 14 },
+    { BOOTCODE_ZETA, BOOTCODE_ANYWHERE, 512, "yT Boot Loader", 14 },
+    { BOOTCODE_HAIKU, BOOTCODE_ANYWHERE, 512, "\x04" "beos\x06" "system\x05" "zbeos", 18 },
+    { BOOTCODE_HAIKU, BOOTCODE_ANYWHERE, 512, "\x06" "system\x0c" "haiku_loader", 20 },
+    // dummy FAT boot sectors, created by OS X's newfs_msdos, Linux's mkdosfs and Windows
+    { BOOTCODE_NOT_BOOTABLE, BOOTCODE_ANYWHERE, 512, "Non-system disk", 15 },
+    { BOOTCODE_NOT_BOOTABLE, BOOTCODE_ANYWHERE, 512, "This is not a bootable disk", 27 },
+    { BOOTCODE_NOT_BOOTABLE, BOOTCODE_ANYWHERE, 512, "Press any key to restart", 24 }
+};
+
+#define BOOTCODE_SIGNATURE_COUNT (sizeof(BootCodeSignatures) / sizeof(BOOTCODE_SIGNATURE))
+
+// The BOOTCODE_ANYWHERE signatures, grouped by their first byte: those that
+// start with byte b are SignatureIndex[SignatureBucket[b]] up to (but not
+// including) SignatureIndex[SignatureBucket[b + 1]].
+static UINT8 SignatureBucket[257];
+static UINT8 SignatureIndex[BOOTCODE_SIGNATURE_COUNT];
+static BOOLEAN SignatureBucketsReady = FALSE;
+
+static VOID BuildSignatureBuckets(VOID)
+{
+    UINT8 Next[256];
+    UINTN i, b;
+
+    SetMem(SignatureBucket, sizeof(SignatureBucket), 0);
+    for (i = 0; i < BOOTCODE_SIGNATURE_COUNT; i++) {
+        if (BootCodeSignatures[i].Offset == BOOTCODE_ANYWHERE)
+            SignatureBucket[*(UINT8 *) BootCodeSignatures[i].Bytes + 1]++;
+    }
+    for (b = 1; b <= 256; b++)
+        SignatureBucket[b] += SignatureBucket[b - 1];
+    CopyMem(Next, SignatureBucket, sizeof(Next));
+    for (i = 0; i < BOOTCODE_SIGNATURE_COUNT; i++) {
+        if (BootCodeSignatures[i].Offset == BOOTCODE_ANYWHERE)
+            SignatureIndex[Next[*(UINT8 *) BootCodeSignatures[i].Bytes]++] = (UINT8) i;
+    }
+    SignatureBucketsReady = TRUE;
+}
+
+// Matches all the boot code signatures against a SECTOR_SIZE-byte boot
+// sector in a single pass over it. Returns the index of the first detector
+// with a match, or BOOTCODE_DETECTOR_COUNT if there's none, and sets
+// *NotBootable if the sector is a dummy that just prints an error.
+static UINTN MatchBootCodeSignatures(IN UINT8 *Sector, OUT BOOLEAN *NotBootable)
+{
+    BOOTCODE_SIGNATURE      *Signature;
+    UINT32                  Matched = 0;    // one bit per detector
+    UINTN                   i, Pos, Detector;
+
+    if (!SignatureBucketsReady)
+        BuildSignatureBuckets();
+
+    for (i = 0; i < BOOTCODE_SIGNATURE_COUNT; i++) {
+        Signature = &BootCodeSignatures[i];
+        if (Signature->Offset != BOOTCODE_ANYWHERE && Signature->Offset + Signature->Length <= SECTOR_SIZE &&
+            CompareMem(Sector + Signature->Offset, Signature->Bytes, Signature->Length) == 0)
+            Matched |= 1 << Signature->Detector;
+    }
+
+    for (Pos = 0; Pos < SECTOR_SIZE; Pos++) {
+        for (i = SignatureBucket[Sector[Pos]]; i < SignatureBucket[Sector[Pos] + 1]; i++) {
+            Signature = &BootCodeSignatures[SignatureIndex[i]];
+            if ((Matched & (1 << Signature->Detector)) == 0 && Pos + Signature->Length <= Signature->Range &&
+                CompareMem(Sector + Pos, Signature->Bytes, Signature->Length) == 0)
+                Matched |= 1 << Signature->Detector;
+        }
+    }
+
+    *NotBootable = (Matched & (1 << BOOTCODE_NOT_BOOTABLE)) ? TRUE : FALSE;
+    for (Detector = 0; Detector < BOOTCODE_DETECTOR_COUNT; Detector++) {
+        if (Matched & (1 << Detector))
+            break;
+    }
+    return Detector;
+}
+
 static VOID ScanVolumeBootcode(IN OUT REFIT_VOLUME *Volume, OUT BOOLEAN *Bootable)
 {
     EFI_STATUS              Status;
     UINT8                   SectorBuffer[SECTOR_SIZE];
     UINTN                   i;
     MBR_PARTITION_INFO      *MbrTable;
-    BOOLEAN                 MbrTableFound;
+    BOOLEAN                 MbrTableFound, NotBootable;
+    UINTN                   DetectorIndex;
 
     Volume->HasBootCode = FALSE;
     Volume->OSIconName = NULL;
@@ -342,9 +714,7 @@ static VOID ScanVolumeBootcode(IN OUT REFIT_VOLUME *Volume, OUT BOOLEAN *Bootabl
         return;   // our buffer is too small...
 
     // look at the boot sector (this is used for both hard disks and El Torito images!)
-    Status = refit_call5_wrapper(Volume->BlockIO->ReadBlocks,
-                                 Volume->BlockIO, Volume->BlockIO->Media->MediaId,
-                                 Volume->BlockIOOffset, SECTOR_SIZE, SectorBuffer);
+    Status = ReadCachedBlocks(Volume->BlockIO, Volume->BlockIOOffset, SECTOR_SIZE, SectorBuffer);
     if (!EFI_ERROR(Status)) {
 
         if (*((UINT16 *)(SectorBuffer + 510)) == 0xaa55 && SectorBuffer[0] != 0) {
@@ -352,87 +722,12 @@ static VOID ScanVolumeBootcode(IN OUT REFIT_VOLUME *Volume, OUT BOOLEAN *Bootabl
             Volume->HasBootCode = TRUE;
         }
 
-        // detect specific boot codes
-        if (CompareMem(SectorBuffer + 2, "LILO", 4) == 0 ||
-            CompareMem(SectorBuffer + 6, "LILO", 4) == 0 ||
-            CompareMem(SectorBuffer + 3, "SYSLINUX", 8) == 0 ||
-            FindMem(SectorBuffer, SECTOR_SIZE, "ISOLINUX", 8) >= 0) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"linux";
-            Volume->OSName = L"Linux";
-
-        } else if (FindMem(SectorBuffer, 512, "Geom\0Hard Disk\0Read\0 Error", 26) >= 0) {   // GRUB
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"grub,linux";
-            Volume->OSName = L"Linux";
-
-//         // Below doesn't produce a bootable entry, so commented out for the moment....
-//         // GRUB in BIOS boot partition:
-//         } else if (FindMem(SectorBuffer, 512, "Geom\0Read\0 Error", 16) >= 0) {
-//             Volume->HasBootCode = TRUE;
-//             Volume->OSIconName = L"grub,linux";
-//             Volume->OSName = L"Linux";
-//             Volume->VolName = L"BIOS Boot Partition";
-//             *Bootable = TRUE;
-
-        } else if ((*((UINT32 *)(SectorBuffer + 502)) == 0 &&
-                    *((UINT32 *)(SectorBuffer + 506)) == 50000 &&
-                    *((UINT16 *)(SectorBuffer + 510)) == 0xaa55) ||
-                    FindMem(SectorBuffer, SECTOR_SIZE, "Starting the BTX loader", 23) >= 0) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"freebsd";
-            Volume->OSName = L"FreeBSD";
-
-        } else if (FindMem(SectorBuffer, 512, "!Loading", 8) >= 0 ||
-                   FindMem(SectorBuffer, SECTOR_SIZE, "/cdboot\0/CDBOOT\0", 16) >= 0) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"openbsd";
-            Volume->OSName = L"OpenBSD";
-
-        } else if (FindMem(SectorBuffer, 512, "Not a bootxx image", 18) >= 0 ||
-                   *((UINT32 *)(SectorBuffer + 1028)) == 0x7886b6d1) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"netbsd";
-            Volume->OSName = L"NetBSD";
-
-        } else if (FindMem(SectorBuffer, SECTOR_SIZE, "NTLDR", 5) >= 0) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"win";
-            Volume->OSName = L"Windows";
-
-        } else if (FindMem(SectorBuffer, SECTOR_SIZE, "BOOTMGR", 7) >= 0) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"winvista,win";
-            Volume->OSName = L"Windows";
-
-        } else if (FindMem(SectorBuffer, 512, "CPUBOOT SYS", 11) >= 0 ||
-                   FindMem(SectorBuffer, 512, "KERNEL  SYS", 11) >= 0) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"freedos";
-            Volume->OSName = L"FreeDOS";
-
-        } else if (FindMem(SectorBuffer, 512, "OS2LDR", 6) >= 0 ||
-                   FindMem(SectorBuffer, 512, "OS2BOOT", 7) >= 0) {
+        // detect specific boot codes, and dummy FAT boot sectors
+        DetectorIndex = MatchBootCodeSignatures(SectorBuffer, &NotBootable);
+        if (DetectorIndex < BOOTCODE_DETECTOR_COUNT) {
             Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"ecomstation";
-            Volume->OSName = L"eComStation";
-
-        } else if (FindMem(SectorBuffer, 512, "Be Boot Loader", 14) >= 0) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"beos";
-            Volume->OSName = L"BeOS";
-
-        } else if (FindMem(SectorBuffer, 512, "yT Boot Loader", 14) >= 0) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"zeta,beos";
-            Volume->OSName = L"ZETA";
-
-        } else if (FindMem(SectorBuffer, 512, "\x04" "beos\x06" "system\x05" "zbeos", 18) >= 0 ||
-                   FindMem(SectorBuffer, 512, "\x06" "system\x0c" "haiku_loader", 20) >= 0) {
-            Volume->HasBootCode = TRUE;
-            Volume->OSIconName = L"haiku,beos";
-            Volume->OSName = L"Haiku";
-
+            Volume->OSIconName = BootCodeDetectors[DetectorIndex].OSIconName;
+            Volume->OSName = BootCodeDetectors[DetectorIndex].OSName;
         }
 
         // NOTE: If you add an operating system with a name that starts with 'W' or 'L', you
@@ -444,16 +739,7 @@ static VOID ScanVolumeBootcode(IN OUT REFIT_VOLUME *Volume, OUT BOOLEAN *Bootabl
               Volume->OSName, Volume->OSIconName);
 #endif
 
-        // dummy FAT boot sector (created by OS X's newfs_msdos)
-        if (FindMem(SectorBuffer, 512, "Non-system disk", 15) >= 0)
-            Volume->HasBootCode = FALSE;
-
-        // dummy FAT boot sector (created by Linux's mkdosfs)
-        if (FindMem(SectorBuffer, 512, "This is not a bootable disk", 27) >= 0)
-            Volume->HasBootCode = FALSE;
-
-        // dummy FAT boot sector (created by Windows)
-        if (FindMem(SectorBuffer, 512, "Press any key to restart", 24) >= 0)
+        if (NotBootable)
             Volume->HasBootCode = FALSE;
 
         // check for MBR partition table
@@ -495,6 +781,198 @@ static VOID ScanVolumeDefaultIcon(IN OUT REFIT_VOLUME *Volume)
     } // switch()
 }
 
+//
+// GPT partition tables
+//
+
+#define GPT_SIGNATURE           (0x5452415020494645ULL)  // "EFI PART"
+#define GPT_HEADER_MIN_SIZE     (92)
+#define GPT_MAX_ENTRIES_SIZE    (1024 * 1024)
+#define GPT_NAME_LENGTH         (36)
+
+typedef struct {
+    UINT64                  Signature;
+    UINT32                  Revision;
+    UINT32                  HeaderSize;
+    UINT32                  HeaderCrc32;
+    UINT32                  Reserved;
+    UINT64                  MyLBA;
+    UINT64                  AlternateLBA;
+    UINT64                  FirstUsableLBA;
+    UINT64                  LastUsableLBA;
+    EFI_GUID                DiskGuid;
+    UINT64                  PartitionEntryLBA;
+    UINT32                  NumberOfPartitionEntries;
+    UINT32                  SizeOfPartitionEntry;
+    UINT32                  PartitionEntryArrayCrc32;
+} GPT_HEADER;
+
+typedef struct {
+    EFI_GUID                TypeGuid;
+    EFI_GUID                UniqueGuid;
+    UINT64                  StartingLBA;
+    UINT64                  EndingLBA;
+    UINT64                  Attributes;
+    CHAR16                  Name[GPT_NAME_LENGTH];
+} GPT_ENTRY;
+
+// a whole disk's partition entries, read by FindGptDisk()
+typedef struct {
+    EFI_BLOCK_IO            *BlockIO;
+    UINTN                   EntryCount;
+    UINTN                   EntrySize;
+    UINT8                   *Entries;       // NULL if the disk has no valid GPT
+} GPT_DISK;
+
+static GPT_DISK             **GptDisks = NULL;
+static UINTN                GptDiskCount = 0;
+
+// Partition types that can't hold boot loaders. ScanVolume() doesn't open
+// file systems on them (some firmware has drivers that will try). Linux
+// RAID isn't one: a RAID 1 member with its metadata at the end, as used
+// for mirrored ESPs, holds an ordinary FAT file system.
+static EFI_GUID NonLoaderPartTypes[] = {
+    { 0x0657fd6d, 0xa4ab, 0x43c4, { 0x84, 0xe5, 0x09, 0x33, 0xc8, 0x4b, 0x4f, 0x4f } },  // Linux swap
+    { 0xe6d6d379, 0xf507, 0x44c2, { 0xa2, 0x3c, 0x23, 0x8f, 0x2a, 0x3d, 0xf9, 0x28 } },  // Linux LVM
+    { 0xe3c9e316, 0x0b5c, 0x4db8, { 0x81, 0x7d, 0xf9, 0x2d, 0xf0, 0x02, 0x15, 0xae } },  // Microsoft reserved
+    { 0x21686148, 0x6449, 0x6e6f, { 0x74, 0x4e, 0x65, 0x65, 0x64, 0x45, 0x46, 0x49 } }   // BIOS boot
+};
+
+#define NON_LOADER_PART_TYPE_COUNT (sizeof(NonLoaderPartTypes) / sizeof(EFI_GUID))
+
+// Reads a GPT header from Lba and, if it and its partition entry array
+// have valid CRCs, the entries into Disk.
+static BOOLEAN ReadGptAt(IN EFI_BLOCK_IO *BlockIO, IN EFI_LBA Lba, IN OUT GPT_DISK *Disk)
+{
+    EFI_STATUS              Status;
+    GPT_HEADER              *Header;
+    UINT8                   HeaderBuffer[SECTOR_SIZE], *Entries;
+    UINT32                  BlockSize = BlockIO->Media->BlockSize, Crc, HeaderCrc;
+    UINTN                   Size, ReadSize;
+
+    if (BlockSize < sizeof(GPT_HEADER) || BlockSize > SECTOR_SIZE)
+        return FALSE;
+    Status = ReadCachedBlocks(BlockIO, Lba, BlockSize, HeaderBuffer);
+    if (EFI_ERROR(Status))
+        return FALSE;
+
+    // check the header
+    Header = (GPT_HEADER *) HeaderBuffer;
+    if (Header->Signature != GPT_SIGNATURE || Header->MyLBA != Lba ||
+        Header->HeaderSize < GPT_HEADER_MIN_SIZE || Header->HeaderSize > BlockSize ||
+        Header->SizeOfPartitionEntry < sizeof(GPT_ENTRY) || (Header->SizeOfPartitionEntry % 8) != 0 ||
+        Header->NumberOfPartitionEntries > GPT_MAX_ENTRIES_SIZE / Header->SizeOfPartitionEntry)
+        return FALSE;
+    HeaderCrc = Header->HeaderCrc32;
+    Header->HeaderCrc32 = 0;
+    Status = refit_call3_wrapper(BS->CalculateCrc32, Header, Header->HeaderSize, &Crc);
+    if (EFI_ERROR(Status) || Crc != HeaderCrc)
+        return FALSE;
+
+    // read and check the partition entries
+    Size = Header->NumberOfPartitionEntries * Header->SizeOfPartitionEntry;
+    ReadSize = ((Size + BlockSize - 1) / BlockSize) * BlockSize;
+    if (ReadSize == 0)
+        return FALSE;
+    Entries = AllocatePool(ReadSize);
+    if (Entries == NULL)
+        return FALSE;
+    Status = refit_call5_wrapper(BlockIO->ReadBlocks, BlockIO, BlockIO->Media->MediaId,
+                                 Header->PartitionEntryLBA, ReadSize, Entries);
+    if (!EFI_ERROR(Status))
+        Status = refit_call3_wrapper(BS->CalculateCrc32, Entries, Size, &Crc);
+    if (EFI_ERROR(Status) || Crc != Header->PartitionEntryArrayCrc32) {
+        FreePool(Entries);
+        return FALSE;
+    }
+
+    Disk->EntryCount = Header->NumberOfPartitionEntries;
+    Disk->EntrySize = Header->SizeOfPartitionEntry;
+    Disk->Entries = Entries;
+    return TRUE;
+}
+
+// Returns the GPT of the disk behind BlockIO, reading it the first time the
+// disk is asked for. Uses the backup GPT if the primary one is damaged.
+static GPT_DISK * FindGptDisk(IN EFI_BLOCK_IO *BlockIO)
+{
+    GPT_DISK                *Disk;
+    UINTN                   i;
+
+    for (i = 0; i < GptDiskCount; i++) {
+        if (GptDisks[i]->BlockIO == BlockIO)
+            return GptDisks[i];
+    }
+
+    Disk = AllocateZeroPool(sizeof(GPT_DISK));
+    if (Disk == NULL)
+        return NULL;
+    Disk->BlockIO = BlockIO;
+    if (BlockIO->Media->MediaPresent && !ReadGptAt(BlockIO, 1, Disk))
+        ReadGptAt(BlockIO, BlockIO->Media->LastBlock, Disk);
+    AddListElement((VOID ***) &GptDisks, &GptDiskCount, Disk);
+    return Disk;
+}
+
+static VOID FreeGptDisks(VOID)
+{
+    UINTN i;
+
+    for (i = 0; i < GptDiskCount; i++) {
+        if (GptDisks[i]->Entries != NULL)
+            FreePool(GptDisks[i]->Entries);
+    }
+    FreeList((VOID ***) &GptDisks, &GptDiskCount);
+    GptDisks = NULL;
+    GptDiskCount = 0;
+}
+
+// Fills in the GPT fields of a partition's volume, finding its entry by the
+// unique GUID in its hard drive device path node.
+static VOID ScanVolumeGptEntry(IN OUT REFIT_VOLUME *Volume, IN HARDDRIVE_DEVICE_PATH *HdDevicePath)
+{
+    GPT_DISK                *Disk;
+    GPT_ENTRY               *Entry;
+    CHAR16                  Name[GPT_NAME_LENGTH + 1];
+    UINTN                   i;
+
+    if (HdDevicePath == NULL || Volume->WholeDiskBlockIO == NULL ||
+        HdDevicePath->MBRType != MBR_TYPE_EFI_PARTITION_TABLE_HEADER ||
+        HdDevicePath->SignatureType != SIGNATURE_TYPE_GUID)
+        return;
+    Disk = FindGptDisk(Volume->WholeDiskBlockIO);
+    if (Disk == NULL || Disk->Entries == NULL)
+        return;
+
+    for (i = 0; i < Disk->EntryCount; i++) {
+        Entry = (GPT_ENTRY *)(Disk->Entries + i * Disk->EntrySize);
+        if (CompareMem(&Entry->UniqueGuid, HdDevicePath->Signature, sizeof(EFI_GUID)) == 0) {
+            Volume->IsGptPartition = TRUE;
+            CopyMem(&Volume->PartTypeGuid, &Entry->TypeGuid, sizeof(EFI_GUID));
+            CopyMem(&Volume->PartGuid, &Entry->UniqueGuid, sizeof(EFI_GUID));
+            CopyMem(Name, Entry->Name, sizeof(Entry->Name));
+            Name[GPT_NAME_LENGTH] = 0;
+            if (Name[0] != 0)
+                Volume->PartName = StrDuplicate(Name);
+            break;
+        }
+    }
+}
+
+// Returns TRUE if Volume is a GPT partition of a type that can't hold boot loaders.
+static BOOLEAN IsNonLoaderPartition(IN REFIT_VOLUME *Volume)
+{
+    UINTN i;
+
+    if (!Volume->IsGptPartition)
+        return FALSE;
+    for (i = 0; i < NON_LOADER_PART_TYPE_COUNT; i++) {
+        if (CompareGuid(&Volume->PartTypeGuid, &NonLoaderPartTypes[i]) == 0)
+            return TRUE;
+    }
+    return FALSE;
+}
+
 static VOID ScanVolume(IN OUT REFIT_VOLUME *Volume)
 {
     EFI_STATUS              Status;
@@ -503,6 +981,7 @@ static VOID ScanVolume(IN OUT REFIT_VOLUME *Volume)
     EFI_HANDLE              WholeDiskHandle;
     UINTN                   PartialLength;
     EFI_FILE_SYSTEM_INFO    *FileSystemInfoPtr;
+    HARDDRIVE_DEVICE_PATH   *HdDevicePath = NULL;
     BOOLEAN                 Bootable;
 
     // get device path
@@ -548,6 +1027,8 @@ static VOID ScanVolume(IN OUT REFIT_VOLUME *Volume)
             Volume->DiskKind = DISK_KIND_OPTICAL;     // El Torito entry -> optical disk
             Bootable = TRUE;
         }
+        if (DevicePathType(DevicePath) == MEDIA_DEVICE_PATH && DevicePathSubType(DevicePath) == MEDIA_HARDDRIVE_DP)
+            HdDevicePath = (HARDDRIVE_DEVICE_PATH *) DevicePath;
 
         if (DevicePathType(DevicePath) == MEDIA_DEVICE_PATH && DevicePathSubType(DevicePath) == MEDIA_VENDOR_DP) {
             Volume->IsAppleLegacy = TRUE;             // legacy BIOS device entry
@@ -608,6 +1089,15 @@ static VOID ScanVolume(IN OUT REFIT_VOLUME *Volume)
     // default volume icon based on disk kind
     ScanVolumeDefaultIcon(Volume);
 
+    // identify GPT partitions, and leave those that can't hold boot loaders unopened
+    ScanVolumeGptEntry(Volume, HdDevicePath);
+    if (IsNonLoaderPartition(Volume)) {
+        Volume->IsReadable = FALSE;
+        if (Volume->PartName != NULL)
+            Volume->VolName = StrDuplicate(Volume->PartName);
+        return;
+    }
+
     // open the root directory of the volume
     Volume->RootDir = LibOpenRoot(Volume->DeviceHandle);
     if (Volume->RootDir == NULL) {
@@ -624,13 +1114,17 @@ static VOID ScanVolume(IN OUT REFIT_VOLUME *Volume)
         FreePool(FileSystemInfoPtr);
     }
 
+    if (Volume->VolName != NULL && Volume->VolName[0] == 0 && Volume->PartName != NULL) {
+       FreePool(Volume->VolName);
+       Volume->VolName = NULL;
+    }
     if (Volume->VolName == NULL) {
-       Volume->VolName = StrDuplicate(L"Unknown");
+       Volume->VolName = StrDuplicate((Volume->PartName != NULL) ? Volume->PartName : L"Unknown");
     }
     // TODO: if no official volume name is found or it is empty, use something else, e.g.:
     //   - name from bytes 3 to 10 of the boot sector
     //   - partition number
-    //   - name derived from file system type or partition type
+    //   - name derived from file system type
 
     // get custom volume icon if present
     if (FileExists(Volume->RootDir, VOLUME_BADGE_NAME))
@@ -655,10 +1149,7 @@ static VOID ScanExtendedPartition(REFIT_VOLUME *WholeDiskVolume, MBR_PARTITION_I
 
     for (ExtCurrent = ExtBase; ExtCurrent; ExtCurrent = NextExtCurrent) {
         // read current EMBR
-      Status = refit_call5_wrapper(WholeDiskVolume->BlockIO->ReadBlocks,
-                                   WholeDiskVolume->BlockIO,
-                                   WholeDiskVolume->BlockIO->Media->MediaId,
-                                   ExtCurrent, 512, SectorBuffer);
+        Status = ReadCachedBlocks(WholeDiskVolume->BlockIO, ExtCurrent, 512, SectorBuffer);
         if (EFI_ERROR(Status))
             break;
         if (*((UINT16 *)(SectorBuffer + 510)) != 0xaa55)
@@ -711,12 +1202,15 @@ VOID ScanVolumes(VOID)
     UINTN                   VolumeIndex, VolumeIndex2;
     MBR_PARTITION_INFO      *MbrTable;
     UINTN                   PartitionIndex;
-    UINT8                   *SectorBuffer1, *SectorBuffer2;
+    UINT8                   SectorBuffer1[512], SectorBuffer2[512];
     UINTN                   SectorSum, i;
 
     FreePool(Volumes);
     Volumes = NULL;
     VolumesCount = 0;
+    FlushSectorCache(NULL);   // disks may have changed since the last scan
+    FlushDirCache();
+    FreeGptDisks();
 
     // get all filesystem handles
     Status = LibLocateHandle(ByProtocol, &BlockIoProtocol, NULL, &HandleCount, &Handles);
@@ -727,6 +1221,7 @@ VOID ScanVolumes(VOID)
         return;
 
     // first pass: collect information about all handles
+    PrefetchBootSectors(Handles, HandleCount);
     for (HandleIndex = 0; HandleIndex < HandleCount; HandleIndex++) {
         Volume = AllocateZeroPool(sizeof(REFIT_VOLUME));
         Volume->DeviceHandle = Handles[HandleIndex];
@@ -771,22 +1266,16 @@ VOID ScanVolumes(VOID)
         if (WholeDiskVolume != NULL && WholeDiskVolume->MbrPartitionTable != NULL) {
             // check if this volume is one of the partitions in the table
             MbrTable = WholeDiskVolume->MbrPartitionTable;
-            SectorBuffer1 = AllocatePool(512);
-            SectorBuffer2 = AllocatePool(512);
             for (PartitionIndex = 0; PartitionIndex < 4; PartitionIndex++) {
                 // check size
                 if ((UINT64)(MbrTable[PartitionIndex].Size) != Volume->BlockIO->Media->LastBlock + 1)
                     continue;
 
                 // compare boot sector read through offset vs. directly
-                Status = refit_call5_wrapper(Volume->BlockIO->ReadBlocks,
-                                             Volume->BlockIO, Volume->BlockIO->Media->MediaId,
-                                             Volume->BlockIOOffset, 512, SectorBuffer1);
+                Status = ReadCachedBlocks(Volume->BlockIO, Volume->BlockIOOffset, 512, SectorBuffer1);
                 if (EFI_ERROR(Status))
                     break;
-                Status = refit_call5_wrapper(Volume->WholeDiskBlockIO->ReadBlocks,
-                                             Volume->WholeDiskBlockIO, Volume->WholeDiskBlockIO->Media->MediaId,
-                                             MbrTable[PartitionIndex].StartLBA, 512, SectorBuffer2);
+                Status = ReadCachedBlocks(Volume->WholeDiskBlockIO, MbrTable[PartitionIndex].StartLBA, 512, SectorBuffer2);
                 if (EFI_ERROR(Status))
                     break;
                 if (CompareMem(SectorBuffer1, SectorBuffer2, 512) != 0)
@@ -806,9 +1295,6 @@ VOID ScanVolumes(VOID)
                     Volume->VolName = PoolPrint(L"Partition %d", PartitionIndex + 1);
                 break;
             }
-
-            FreePool(SectorBuffer1);
-            FreePool(SectorBuffer2);
         }
 
     }
@@ -881,82 +1367,365 @@ VOID ReinitVolumes(VOID)
 // file and dir functions
 //
 
-BOOLEAN FileExists(IN EFI_FILE *BaseDir, IN CHAR16 *RelativePath)
-{
-    EFI_STATUS         Status;
-    EFI_FILE_HANDLE    TestFile;
-
-    Status = refit_call5_wrapper(BaseDir->Open, BaseDir, &TestFile, RelativePath, EFI_FILE_MODE_READ, 0);
-    if (Status == EFI_SUCCESS) {
-        refit_call1_wrapper(TestFile->Close, TestFile);
-        return TRUE;
-    }
-    return FALSE;
-}
-
-EFI_STATUS DirNextEntry(IN EFI_FILE *Directory, IN OUT EFI_FILE_INFO **DirEntry, IN UINTN FilterMode)
+// Directory listing cache. The first FileExists() probe or DirIterOpen()
+// of a directory reads the whole directory into memory, and later probes
+// and iterations of it are answered from there. Listings are keyed by base
+// directory handle and path, so they're dropped by FlushDirCache() whenever
+// those handles are closed, and on every rescan. Names are matched without
+// regard to case, as FAT and HFS+ do.
+
+#define DIR_ENTRY_BUFFER_SIZE (256)
+
+// Reads the next directory entry that passes FilterMode (0 for everything,
+// 1 for directories only, 2 for files only) into *Buffer, a pool buffer of
+// *BufferSize bytes. The buffer is allocated if *Buffer is NULL and grown
+// if an entry doesn't fit, so a caller that keeps passing the same buffer
+// back reads a whole directory with few or no allocations. Sets *EntryRead
+// to FALSE at the end of the listing or on an error.
+static EFI_STATUS DirReadEntry(IN EFI_FILE *Directory, IN OUT EFI_FILE_INFO **Buffer, IN OUT UINTN *BufferSize,
+                               IN UINTN FilterMode, OUT BOOLEAN *EntryRead)
 {
     EFI_STATUS Status;
-    VOID *Buffer;
-    UINTN LastBufferSize, BufferSize;
+    UINTN ReadSize;
     INTN IterCount;
 
-    for (;;) {
-
-        // free pointer from last call
-        if (*DirEntry != NULL) {
-            FreePool(*DirEntry);
-            *DirEntry = NULL;
-        }
+    *EntryRead = FALSE;
+    if (*Buffer == NULL) {
+        *BufferSize = DIR_ENTRY_BUFFER_SIZE;
+        *Buffer = AllocatePool(*BufferSize);
+        if (*Buffer == NULL)
+            return EFI_OUT_OF_RESOURCES;
+    }
 
+    for (;;) {
         // read next directory entry
-        LastBufferSize = BufferSize = 256;
-        Buffer = AllocatePool(BufferSize);
         for (IterCount = 0; ; IterCount++) {
-            Status = refit_call3_wrapper(Directory->Read, Directory, &BufferSize, Buffer);
+            ReadSize = *BufferSize;
+            Status = refit_call3_wrapper(Directory->Read, Directory, &ReadSize, *Buffer);
             if (Status != EFI_BUFFER_TOO_SMALL || IterCount >= 4)
                 break;
-            if (BufferSize <= LastBufferSize) {
-                Print(L"FS Driver requests bad buffer size %d (was %d), using %d instead\n", BufferSize, LastBufferSize, LastBufferSize * 2);
-                BufferSize = LastBufferSize * 2;
+            if (ReadSize <= *BufferSize) {
+                Print(L"FS Driver requests bad buffer size %d (was %d), using %d instead\n", ReadSize, *BufferSize, *BufferSize * 2);
+                ReadSize = *BufferSize * 2;
 #if REFIT_DEBUG > 0
             } else {
-                Print(L"Reallocating buffer from %d to %d\n", LastBufferSize, BufferSize);
+                Print(L"Reallocating buffer from %d to %d\n", *BufferSize, ReadSize);
 #endif
             }
-            Buffer = ReallocatePool(Buffer, LastBufferSize, BufferSize);
-            LastBufferSize = BufferSize;
-        }
-        if (EFI_ERROR(Status)) {
-            FreePool(Buffer);
-            break;
-        }
-
-        // check for end of listing
-        if (BufferSize == 0) {    // end of directory listing
-            FreePool(Buffer);
-            break;
+            FreePool(*Buffer);
+            *Buffer = AllocatePool(ReadSize);
+            *BufferSize = (*Buffer != NULL) ? ReadSize : 0;
+            if (*Buffer == NULL)
+                return EFI_OUT_OF_RESOURCES;
         }
-
-        // entry is ready to be returned
-        *DirEntry = (EFI_FILE_INFO *)Buffer;
+        if (EFI_ERROR(Status) || ReadSize == 0)   // error or end of directory listing
+            return Status;
 
         // filter results
         if (FilterMode == 1) {   // only return directories
-            if (((*DirEntry)->Attribute & EFI_FILE_DIRECTORY))
+            if (((*Buffer)->Attribute & EFI_FILE_DIRECTORY))
                 break;
         } else if (FilterMode == 2) {   // only return files
-            if (((*DirEntry)->Attribute & EFI_FILE_DIRECTORY) == 0)
+            if (((*Buffer)->Attribute & EFI_FILE_DIRECTORY) == 0)
                 break;
         } else                   // no filter or unknown filter -> return everything
             break;
+    }
+    *EntryRead = TRUE;
+    return Status;
+}
+
+typedef struct _refit_dir_listing {
+    EFI_FILE                *BaseDir;
+    CHAR16                  *Path;          // see DirCachePath()
+    EFI_STATUS              Status;         // from opening or reading the directory
+    UINTN                   EntryCount;
+    EFI_FILE_INFO           **Entries;
+    UINTN                   HashSize;       // a power of two, at least twice EntryCount
+    UINTN                   *HashTable;     // index + 1 into Entries, or 0 if unused
+} REFIT_DIR_LISTING;
+
+static REFIT_DIR_LISTING    **DirListings = NULL;
+static UINTN                DirListingCount = 0;
+static DIR_CACHE_STATS      DirCacheStats = { 0, 0 };
+
+static UINTN HashFileName(IN CHAR16 *Name)
+{
+    UINTN   Hash = 2166136261U;
+    CHAR16  c;
 
+    while ((c = *Name++) != 0) {
+        if (c >= 'a' && c <= 'z')
+            c = c - 'a' + 'A';
+        Hash = (Hash ^ c) * 16777619U;
     }
+    return Hash;
+}
+
+static VOID FreeDirListing(IN REFIT_DIR_LISTING *Listing)
+{
+    UINTN i;
+
+    for (i = 0; i < Listing->EntryCount; i++)
+        FreePool(Listing->Entries[i]);
+    if (Listing->Entries != NULL)
+        FreePool(Listing->Entries);
+    if (Listing->HashTable != NULL)
+        FreePool(Listing->HashTable);
+    FreePool(Listing->Path);
+    FreePool(Listing);
+}
+
+// Drops all cached directory listings.
+VOID FlushDirCache(VOID)
+{
+    UINTN i;
+
+    for (i = 0; i < DirListingCount; i++)
+        FreeDirListing(DirListings[i]);
+    if (DirListings != NULL)
+        FreePool(DirListings);
+    DirListings = NULL;
+    DirListingCount = 0;
+}
+
+VOID GetDirCacheStats(OUT DIR_CACHE_STATS *Stats)
+{
+    *Stats = DirCacheStats;
+}
+
+// Returns Path in the form used to key directory listings: without
+// redundant slashes, with a leading backslash only if it's relative to the
+// volume root, and "" for the base directory itself. Returns NULL if the
+// path has "." or ".." components, which aren't worth resolving.
+static CHAR16 * DirCachePath(IN CHAR16 *Path OPTIONAL)
+{
+    CHAR16  *Clean, *Result, *p;
+    BOOLEAN Absolute;
+
+    if (Path == NULL)
+        return StrDuplicate(L"");
+    Absolute = (Path[0] == L'\\' || Path[0] == L'/');
+    Clean = StrDuplicate(Path);
+    if (Clean == NULL)
+        return NULL;
+    CleanUpPathNameSlashes(Clean);
+    if (StrCmp(Clean, L"\\") == 0)
+        Clean[0] = 0;
+    for (p = Clean; *p; ) {
+        if (p[0] == L'.' && (p[1] == 0 || p[1] == L'\\' || (p[1] == L'.' && (p[2] == 0 || p[2] == L'\\')))) {
+            FreePool(Clean);
+            return NULL;
+        }
+        while (*p && *p != L'\\')
+            p++;
+        if (*p)
+            p++;
+    }
+    if (!Absolute)
+        return Clean;
+    Result = PoolPrint(L"\\%s", Clean);
+    FreePool(Clean);
+    return Result;
+}
+
+// Returns the listing of the directory Path (in DirCachePath() form) under
+// BaseDir, reading it if it isn't cached yet; or NULL if out of memory.
+static REFIT_DIR_LISTING * GetDirListing(IN EFI_FILE *BaseDir, IN CHAR16 *Path)
+{
+    REFIT_DIR_LISTING       *Listing;
+    EFI_FILE_HANDLE         DirHandle = BaseDir;
+    EFI_FILE_INFO           *DirEntry, *Buffer = NULL;
+    BOOLEAN                 CloseDirHandle = FALSE, EntryRead;
+    UINTN                   i, Slot, BufferSize = 0, EntrySize;
+
+    for (i = 0; i < DirListingCount; i++) {
+        if (DirListings[i]->BaseDir == BaseDir && StriCmp(DirListings[i]->Path, Path) == 0) {
+            DirCacheStats.Hits++;
+            return DirListings[i];
+        }
+    }
+
+    DirCacheStats.Misses++;
+    Listing = AllocateZeroPool(sizeof(REFIT_DIR_LISTING));
+    if (Listing == NULL)
+        return NULL;
+    Listing->BaseDir = BaseDir;
+    Listing->Path = StrDuplicate(Path);
+
+    // read the directory
+    if (Path[0] == 0) {
+        Listing->Status = refit_call2_wrapper(BaseDir->SetPosition, BaseDir, 0);
+    } else {
+        Listing->Status = refit_call5_wrapper(BaseDir->Open, BaseDir, &DirHandle, Path, EFI_FILE_MODE_READ, 0);
+        CloseDirHandle = EFI_ERROR(Listing->Status) ? FALSE : TRUE;
+    }
+    while (!EFI_ERROR(Listing->Status)) {
+        Listing->Status = DirReadEntry(DirHandle, &Buffer, &BufferSize, 0, &EntryRead);
+        if (!EntryRead)
+            break;
+        EntrySize = (Buffer->Size < BufferSize) ? (UINTN) Buffer->Size : BufferSize;
+        DirEntry = AllocatePool(EntrySize);
+        if (DirEntry == NULL)
+            break;
+        CopyMem(DirEntry, Buffer, EntrySize);
+        AddListElement((VOID ***) &Listing->Entries, &Listing->EntryCount, DirEntry);
+    }
+    if (Buffer != NULL)
+        FreePool(Buffer);
+    if (CloseDirHandle)
+        refit_call1_wrapper(DirHandle->Close, DirHandle);
+
+    // index the names
+    for (Listing->HashSize = 16; Listing->HashSize < Listing->EntryCount * 2; Listing->HashSize *= 2)
+        ;
+    Listing->HashTable = AllocateZeroPool(Listing->HashSize * sizeof(UINTN));
+    if (Listing->HashTable == NULL) {
+        FreeDirListing(Listing);
+        return NULL;
+    }
+    for (i = 0; i < Listing->EntryCount; i++) {
+        Slot = HashFileName(Listing->Entries[i]->FileName) & (Listing->HashSize - 1);
+        while (Listing->HashTable[Slot] != 0)
+            Slot = (Slot + 1) & (Listing->HashSize - 1);
+        Listing->HashTable[Slot] = i + 1;
+    }
+
+    AddListElement((VOID ***) &DirListings, &DirListingCount, Listing);
+    return Listing;
+}
+
+// Returns the directory entry named Name in Listing, or NULL if there's none.
+static EFI_FILE_INFO * FindDirListingEntry(IN REFIT_DIR_LISTING *Listing, IN CHAR16 *Name)
+{
+    UINTN Slot, Index;
+
+    Slot = HashFileName(Name) & (Listing->HashSize - 1);
+    while ((Index = Listing->HashTable[Slot]) != 0) {
+        if (StriCmp(Listing->Entries[Index - 1]->FileName, Name) == 0)
+            return Listing->Entries[Index - 1];
+        Slot = (Slot + 1) & (Listing->HashSize - 1);
+    }
+    return NULL;
+}
+
+BOOLEAN FileExists(IN EFI_FILE *BaseDir, IN CHAR16 *RelativePath)
+{
+    EFI_STATUS         Status;
+    EFI_FILE_HANDLE    TestFile;
+    REFIT_DIR_LISTING  *Listing = NULL;
+    CHAR16             *Path, *Name;
+    BOOLEAN            Found = FALSE;
+    UINTN              i;
+
+    // look up the name in its directory's listing...
+    Path = DirCachePath(RelativePath);
+    if (Path != NULL) {
+        for (i = StrLen(Path); i > 0 && Path[i - 1] != L'\\'; i--)
+            ;
+        Name = StrDuplicate(Path + i);
+        Path[(i > 1) ? i - 1 : i] = 0;   // keep a lone leading backslash
+        if (Name != NULL && Name[0] != 0) {
+            Listing = GetDirListing(BaseDir, Path);
+            if (Listing != NULL)
+                Found = (FindDirListingEntry(Listing, Name) != NULL);
+        }
+        if (Name != NULL)
+            FreePool(Name);
+        FreePool(Path);
+        if (Listing != NULL)
+            return Found;
+    }
+
+    // ...or, if that can't be done, try to open the file
+    Status = refit_call5_wrapper(BaseDir->Open, BaseDir, &TestFile, RelativePath, EFI_FILE_MODE_READ, 0);
+    if (Status == EFI_SUCCESS) {
+        refit_call1_wrapper(TestFile->Close, TestFile);
+        return TRUE;
+    }
+    return FALSE;
+}
+
+// Writes Text to FileName in BaseDir, replacing the file if it exists.
+// With Unicode FALSE the file is ASCII, and other characters are written as
+// '?'; with Unicode TRUE it's UTF-16 with a byte order mark, as ReadFile()
+// expects.
+EFI_STATUS SaveTextFile(IN EFI_FILE *BaseDir, IN CHAR16 *FileName, IN CHAR16 *Text, IN BOOLEAN Unicode)
+{
+    EFI_STATUS      Status;
+    EFI_FILE_HANDLE FileHandle;
+    UINT8           *Buffer;
+    CHAR16          *Wide;
+    UINTN           Length, Size, i;
+
+    Length = StrLen(Text);
+    Size = Unicode ? (Length + 1) * sizeof(CHAR16) : Length;
+    Buffer = AllocatePool((Size > 0) ? Size : 1);
+    if (Buffer == NULL)
+        return EFI_OUT_OF_RESOURCES;
+    if (Unicode) {
+        Wide = (CHAR16 *) Buffer;
+        Wide[0] = 0xFEFF;
+        CopyMem(Wide + 1, Text, Length * sizeof(CHAR16));
+    } else {
+        for (i = 0; i < Length; i++)
+            Buffer[i] = (Text[i] < 0x80) ? (UINT8) Text[i] : '?';
+    }
+
+    // egSaveFile() doesn't truncate, so remove the old file first
+    Status = refit_call5_wrapper(BaseDir->Open, BaseDir, &FileHandle, FileName,
+                                 EFI_FILE_MODE_READ | EFI_FILE_MODE_WRITE, 0);
+    if (!EFI_ERROR(Status))
+        refit_call1_wrapper(FileHandle->Delete, FileHandle);
+    Status = egSaveFile(BaseDir, FileName, Buffer, Size);
+    FreePool(Buffer);
+    return Status;
+}
+
+// Reads the next directory entry as DirReadEntry() does, but into a new
+// buffer, which the caller must free (or pass back in *DirEntry to be freed).
+EFI_STATUS DirNextEntry(IN EFI_FILE *Directory, IN OUT EFI_FILE_INFO **DirEntry, IN UINTN FilterMode)
+{
+    EFI_STATUS      Status;
+    EFI_FILE_INFO   *Buffer = NULL;
+    UINTN           BufferSize = 0;
+    BOOLEAN         EntryRead;
+
+    // free pointer from last call
+    if (*DirEntry != NULL) {
+        FreePool(*DirEntry);
+        *DirEntry = NULL;
+    }
+
+    Status = DirReadEntry(Directory, &Buffer, &BufferSize, FilterMode, &EntryRead);
+    if (EntryRead)
+        *DirEntry = Buffer;
+    else if (Buffer != NULL)
+        FreePool(Buffer);
     return Status;
 }
 
 VOID DirIterOpen(IN EFI_FILE *BaseDir, IN CHAR16 *RelativePath OPTIONAL, OUT REFIT_DIR_ITER *DirIter)
 {
+    CHAR16 *Path;
+
+    // iterate over the cached listing if possible
+    DirIter->LastFileInfo = NULL;
+    DirIter->LastFileInfoSize = 0;
+    DirIter->NextIndex = 0;
+    DirIter->Listing = NULL;
+    Path = DirCachePath(RelativePath);
+    if (Path != NULL) {
+        DirIter->Listing = GetDirListing(BaseDir, Path);
+        FreePool(Path);
+    }
+    if (DirIter->Listing != NULL) {
+        DirIter->LastStatus = DirIter->Listing->Status;
+        DirIter->DirHandle = NULL;
+        DirIter->CloseDirHandle = FALSE;
+        return;
+    }
+
     if (RelativePath == NULL) {
         DirIter->LastStatus = EFI_SUCCESS;
         DirIter->DirHandle = BaseDir;
@@ -965,42 +1734,159 @@ VOID DirIterOpen(IN EFI_FILE *BaseDir, IN CHAR16 *RelativePath OPTIONAL, OUT REF
         DirIter->LastStatus = refit_call5_wrapper(BaseDir->Open, BaseDir, &(DirIter->DirHandle), RelativePath, EFI_FILE_MODE_READ, 0);
         DirIter->CloseDirHandle = EFI_ERROR(DirIter->LastStatus) ? FALSE : TRUE;
     }
-    DirIter->LastFileInfo = NULL;
 }
 
-BOOLEAN DirIterNext(IN OUT REFIT_DIR_ITER *DirIter, IN UINTN FilterMode, IN CHAR16 *FilePattern OPTIONAL,
-                    OUT EFI_FILE_INFO **DirEntry)
+//
+// glob sets
+//
+
+// Folds ASCII letters to upper case; other characters are returned as-is.
+static CHAR16 GlobUpcase(IN CHAR16 c)
 {
-    BOOLEAN KeepGoing = TRUE;
-    UINTN   i;
-    CHAR16  *OnePattern;
+    return (c >= L'a' && c <= L'z') ? (c - (L'a' - L'A')) : c;
+}
 
-    if (DirIter->LastFileInfo != NULL) {
-        FreePool(DirIter->LastFileInfo);
-        DirIter->LastFileInfo = NULL;
+// Compiles a comma-delimited list of glob patterns (as in LOADER_MATCH_PATTERNS)
+// into GlobSet: the list is split once and each pattern is case-folded, so
+// that GlobSetMatch() can test names without splitting or allocating.
+VOID CompileGlobSet(IN CHAR16 *PatternList, OUT REFIT_GLOB_SET *GlobSet)
+{
+    CHAR16 *OnePattern;
+    UINTN  i = 0, j;
+
+    GlobSet->PatternCount = 0;
+    GlobSet->Patterns = NULL;
+    if (PatternList == NULL)
+        return;
+    while ((OnePattern = FindCommaDelimited(PatternList, i++)) != NULL) {
+        if (OnePattern[0] == L'\0') {
+            FreePool(OnePattern);
+            continue;
+        }
+        for (j = 0; OnePattern[j] != L'\0'; j++)
+            OnePattern[j] = GlobUpcase(OnePattern[j]);
+        AddListElement((VOID ***) &GlobSet->Patterns, &GlobSet->PatternCount, OnePattern);
+    }
+}
+
+VOID FreeGlobSet(IN OUT REFIT_GLOB_SET *GlobSet)
+{
+    FreeList((VOID ***) &GlobSet->Patterns, &GlobSet->PatternCount);
+    GlobSet->Patterns = NULL;
+    GlobSet->PatternCount = 0;
+}
+
+// Matches the upper-case character c against the "[...]" set that starts at
+// Pattern (just past the '['). Returns a pointer just past the closing ']',
+// or NULL if c isn't in the set; an unterminated set matches a literal '['.
+static CHAR16 * GlobMatchSet(IN CHAR16 *Pattern, IN CHAR16 c)
+{
+    BOOLEAN Match = FALSE;
+    CHAR16  *p = Pattern;
+
+    while (*p != L']') {
+        if (*p == L'\0')
+            return (c == L'[') ? Pattern : NULL;
+        if (p[1] == L'-' && p[2] != L']' && p[2] != L'\0') {
+            if (c >= p[0] && c <= p[2])
+                Match = TRUE;
+            p += 3;
+        } else {
+            if (c == *p)
+                Match = TRUE;
+            p++;
+        }
+    }
+    return Match ? p + 1 : NULL;
+}
+
+// Matches FileName against one compiled pattern, supporting '*', '?' and
+// "[a-z]"-style sets. A '*' is retried from one character further on when a
+// later part of the pattern fails, so no recursion or allocation is needed.
+static BOOLEAN GlobMatch(IN CHAR16 *Pattern, IN CHAR16 *FileName)
+{
+    CHAR16 *p = Pattern, *n = FileName, *StarPattern = NULL, *StarName = NULL, *Next;
+    CHAR16 c;
+
+    while (*n != L'\0') {
+        c = GlobUpcase(*n);
+        if (*p == L'*') {
+            StarPattern = ++p;
+            StarName = n;
+            continue;
+        }
+        Next = NULL;
+        if (*p == L'?')
+            Next = p + 1;
+        else if (*p == L'[')
+            Next = GlobMatchSet(p + 1, c);
+        else if (*p != L'\0' && *p == c)
+            Next = p + 1;
+        if (Next != NULL) {
+            p = Next;
+            n++;
+        } else if (StarPattern != NULL) {
+            p = StarPattern;
+            n = ++StarName;
+        } else
+            return FALSE;
+    }
+    while (*p == L'*')
+        p++;
+    return (*p == L'\0');
+}
+
+// Returns TRUE if FileName matches any pattern in GlobSet.
+BOOLEAN GlobSetMatch(IN REFIT_GLOB_SET *GlobSet, IN CHAR16 *FileName)
+{
+    UINTN i;
+
+    for (i = 0; i < GlobSet->PatternCount; i++) {
+        if (GlobMatch(GlobSet->Patterns[i], FileName))
+            return TRUE;
     }
+    return FALSE;
+}
+
+// Returns TRUE if DirEntry passes DirIterNext()'s FilterMode and Globs.
+// Directories always pass the pattern test.
+static BOOLEAN DirIterMatch(IN EFI_FILE_INFO *DirEntry, IN UINTN FilterMode, IN REFIT_GLOB_SET *Globs OPTIONAL)
+{
+    if (FilterMode == 1 && (DirEntry->Attribute & EFI_FILE_DIRECTORY) == 0)
+        return FALSE;
+    if (FilterMode == 2 && (DirEntry->Attribute & EFI_FILE_DIRECTORY))
+        return FALSE;
+    if (Globs == NULL || (DirEntry->Attribute & EFI_FILE_DIRECTORY))
+        return TRUE;
+    return GlobSetMatch(Globs, DirEntry->FileName);
+}
+
+// Returns the next entry that passes FilterMode and Globs in *DirEntry. The
+// entry belongs to the iterator and is only valid until the next call.
+BOOLEAN DirIterNext(IN OUT REFIT_DIR_ITER *DirIter, IN UINTN FilterMode, IN REFIT_GLOB_SET *Globs OPTIONAL,
+                    OUT EFI_FILE_INFO **DirEntry)
+{
+    BOOLEAN EntryRead;
 
     if (EFI_ERROR(DirIter->LastStatus))
         return FALSE;   // stop iteration
 
+    if (DirIter->Listing != NULL) {
+        while (DirIter->NextIndex < DirIter->Listing->EntryCount) {
+            *DirEntry = DirIter->Listing->Entries[DirIter->NextIndex++];
+            if (DirIterMatch(*DirEntry, FilterMode, Globs))
+                return TRUE;
+        }
+        return FALSE;
+    }
+
+    // read into the iterator's own buffer, which is reused from call to call
     do {
-        DirIter->LastStatus = DirNextEntry(DirIter->DirHandle, &(DirIter->LastFileInfo), FilterMode);
-        if (EFI_ERROR(DirIter->LastStatus))
-           return FALSE;
-        if (DirIter->LastFileInfo == NULL)  // end of listing
+        DirIter->LastStatus = DirReadEntry(DirIter->DirHandle, &(DirIter->LastFileInfo), &(DirIter->LastFileInfoSize),
+                                           FilterMode, &EntryRead);
+        if (EFI_ERROR(DirIter->LastStatus) || !EntryRead)   // error or end of listing
             return FALSE;
-        if (FilePattern != NULL) {
-            if ((DirIter->LastFileInfo->Attribute & EFI_FILE_DIRECTORY))
-                KeepGoing = FALSE;
-            i = 0;
-            while (KeepGoing && (OnePattern = FindCommaDelimited(FilePattern, i++)) != NULL) {
-               if (MetaiMatch(DirIter->LastFileInfo->FileName, OnePattern))
-                   KeepGoing = FALSE;
-            } // while
-            // else continue loop
-        } else
-            break;
-   } while (KeepGoing);
+    } while (!DirIterMatch(DirIter->LastFileInfo, FilterMode, Globs));
 
     *DirEntry = DirIter->LastFileInfo;
     return TRUE;
@@ -1276,3 +2162,50 @@ CHAR16 *FindCommaDelimited(IN CHAR16 *InString, IN UINTN Index) {
    } // if
    return (FoundString);
 } // CHAR16 *FindCommaDelimited()
+
+// Returns the value of a free-running CPU counter, for timing things in
+// debug output. Only differences between two values mean anything, and the
+// units are CPU-specific (cycles on x86). Returns 0 on CPUs without a
+// counter we know how to read.
+UINT64 ReadTimestampCounter(VOID) {
+#if defined(__x86_64__) || defined(__i386__)
+   UINT32   Low, High;
+
+   __asm__ __volatile__ ("rdtsc" : "=a" (Low), "=d" (High));
+   return ((UINT64) High << 32) | Low;
+#elif defined(__aarch64__)
+   UINT64   Count;
+
+   __asm__ __volatile__ ("mrs %0, cntvct_el0" : "=r" (Count));
+   return Count;
+#else
+   return 0;
+#endif
+} // UINT64 ReadTimestampCounter()
+
+static UINT64 TicksPerMs = 0;
+static BOOLEAN TicksPerMsKnown = FALSE;
+
+// Measures the rate of ReadTimestampCounter() against BS->Stall(). This
+// stalls for a few milliseconds, so efi_main() calls it once at start-up,
+// before anything interactive is running; later callers of
+// TimestampTicksPerMs() then never wait.
+VOID CalibrateTimestampCounter(VOID) {
+   UINT64 Start;
+
+   if (TicksPerMsKnown)
+      return;
+   TicksPerMsKnown = TRUE;
+   Start = ReadTimestampCounter();
+   if (Start == 0)
+      return;   // no counter
+   refit_call1_wrapper(BS->Stall, 2000);
+   TicksPerMs = (ReadTimestampCounter() - Start) / 2;
+} // VOID CalibrateTimestampCounter()
+
+// Returns the number of ReadTimestampCounter() units per millisecond, or 0
+// if there's no counter.
+UINT64 TimestampTicksPerMs(VOID) {
+   CalibrateTimestampCounter();
+   return TicksPerMs;
+} // UINT64 TimestampTicksPerMs()
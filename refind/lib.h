@@ -60,9 +60,25 @@ typedef struct {
     EFI_STATUS          LastStatus;
     EFI_FILE_HANDLE     DirHandle;
     BOOLEAN             CloseDirHandle;
-    EFI_FILE_INFO       *LastFileInfo;
+    EFI_FILE_INFO       *LastFileInfo;       // entry buffer, reused from one entry to the next
+    UINTN               LastFileInfoSize;
+    struct _refit_dir_listing *Listing;    // cached listing being iterated, if any
+    UINTN               NextIndex;
 } REFIT_DIR_ITER;
 
+// comma-delimited glob patterns, split and case-folded once by CompileGlobSet()
+typedef struct {
+    UINTN               PatternCount;
+    CHAR16              **Patterns;
+} REFIT_GLOB_SET;
+
+// counts of directory lookups answered from cached listings, and of
+// directories read to list them
+typedef struct {
+   UINTN Hits;
+   UINTN Misses;
+} DIR_CACHE_STATS;
+
 #define DISK_KIND_INTERNAL  (0)
 #define DISK_KIND_EXTERNAL  (1)
 #define DISK_KIND_OPTICAL   (2)
@@ -80,17 +96,36 @@ VOID FreeList(IN OUT VOID ***ListPtr, IN OUT UINTN *ElementCount);
 
 VOID ExtractLegacyLoaderPaths(EFI_DEVICE_PATH **PathList, UINTN MaxPaths, EFI_DEVICE_PATH **HardcodedPathList);
 
+// counts of ReadCachedBlocks() calls served from the cache and from the disk
+typedef struct {
+   UINTN Hits;
+   UINTN Misses;
+   UINTN Overlapped;    // misses read with EFI_BLOCK_IO2_PROTOCOL, in parallel
+} SECTOR_CACHE_STATS;
+
+EFI_STATUS ReadCachedBlocks(IN EFI_BLOCK_IO *BlockIO, IN EFI_LBA Lba, IN UINTN Size, OUT VOID *Buffer);
+EFI_STATUS WriteCachedBlocks(IN EFI_BLOCK_IO *BlockIO, IN EFI_LBA Lba, IN UINTN Size, IN VOID *Buffer);
+VOID FlushSectorCache(IN EFI_BLOCK_IO_MEDIA *Media OPTIONAL);
+VOID GetSectorCacheStats(OUT SECTOR_CACHE_STATS *Stats);
+
 VOID ScanVolumes(VOID);
 
+VOID FlushDirCache(VOID);
+VOID GetDirCacheStats(OUT DIR_CACHE_STATS *Stats);
 BOOLEAN FileExists(IN EFI_FILE *BaseDir, IN CHAR16 *RelativePath);
 BOOLEAN DirectoryExists(IN EFI_FILE *BaseDir, IN CHAR16 *RelativePath);
+EFI_STATUS SaveTextFile(IN EFI_FILE *BaseDir, IN CHAR16 *FileName, IN CHAR16 *Text, IN BOOLEAN Unicode);
 
 EFI_STATUS DirNextEntry(IN EFI_FILE *Directory, IN OUT EFI_FILE_INFO **DirEntry, IN UINTN FilterMode);
 
 VOID DirIterOpen(IN EFI_FILE *BaseDir, IN CHAR16 *RelativePath OPTIONAL, OUT REFIT_DIR_ITER *DirIter);
-BOOLEAN DirIterNext(IN OUT REFIT_DIR_ITER *DirIter, IN UINTN FilterMode, IN CHAR16 *FilePattern OPTIONAL, OUT EFI_FILE_INFO **DirEntry);
+BOOLEAN DirIterNext(IN OUT REFIT_DIR_ITER *DirIter, IN UINTN FilterMode, IN REFIT_GLOB_SET *Globs OPTIONAL, OUT EFI_FILE_INFO **DirEntry);
 EFI_STATUS DirIterClose(IN OUT REFIT_DIR_ITER *DirIter);
 
+VOID CompileGlobSet(IN CHAR16 *PatternList, OUT REFIT_GLOB_SET *GlobSet);
+BOOLEAN GlobSetMatch(IN REFIT_GLOB_SET *GlobSet, IN CHAR16 *FileName);
+VOID FreeGlobSet(IN OUT REFIT_GLOB_SET *GlobSet);
+
 CHAR16 * Basename(IN CHAR16 *Path);
 VOID ReplaceEfiExtension(IN OUT CHAR16 *Path, IN CHAR16 *Extension);
 
@@ -104,5 +139,8 @@ CHAR16 *FindLastDirName(IN CHAR16 *Path);
 CHAR16 *FindPath(IN CHAR16* FullPath);
 CHAR16 *FindNumbers(IN CHAR16 *InString);
 CHAR16 *FindCommaDelimited(IN CHAR16 *InString, IN UINTN Index);
+UINT64 ReadTimestampCounter(VOID);
+VOID CalibrateTimestampCounter(VOID);
+UINT64 TimestampTicksPerMs(VOID);
 
 #endif
\ No newline at end of file
@@ -50,6 +50,9 @@
 #include "menu.h"
 #include "refit_call_wrapper.h"
 #include "driver_support.h"
+#include "scancache.h"
+#include "timeline.h"
+#include "callstats.h"
 #include "../include/syslinux_mbr.h"
 
 // 
@@ -81,11 +84,21 @@ static REFIT_MENU_ENTRY MenuEntryReset    = { L"Reboot Computer", TAG_REBOOT, 1,
 static REFIT_MENU_ENTRY MenuEntryShutdown = { L"Shut Down Computer", TAG_SHUTDOWN, 1, 0, 'U', NULL, NULL, NULL };
 static REFIT_MENU_ENTRY MenuEntryReturn   = { L"Return to Main Menu", TAG_RETURN, 0, 0, 0, NULL, NULL, NULL };
 static REFIT_MENU_ENTRY MenuEntryExit     = { L"Exit rEFInd", TAG_EXIT, 1, 0, 0, NULL, NULL, NULL };
+static REFIT_MENU_ENTRY MenuEntryTimeline = { L"Show Start-up Timeline", TAG_ABOUT, 0, 0, 0, NULL, NULL, NULL };
 
 static REFIT_MENU_SCREEN MainMenu       = { L"Main Menu", NULL, 0, NULL, 0, NULL, 0, L"Automatic boot" };
+
+// progress of the deferred part of a progressive scan; see ScanNextDeferredVolume()
+static UINTN DeferredScanIndex = NUM_SCAN_OPTIONS;
+static UINTN DeferredVolumeIndex = 0;
+
+// ReadTimestampCounter() values for the About screen
+static UINT64 StartTimestamp = 0;
+static UINT64 ScanDoneTimestamp = 0;
 static REFIT_MENU_SCREEN AboutMenu      = { L"About", NULL, 0, NULL, 0, NULL, 0, NULL };
+static REFIT_MENU_SCREEN TimelineMenu   = { L"Start-up Timeline", NULL, 0, NULL, 0, NULL, 0, NULL };
 
-REFIT_CONFIG GlobalConfig = { FALSE, FALSE, 0, 0, 20, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
+REFIT_CONFIG GlobalConfig = { FALSE, FALSE, FALSE, FALSE, FALSE, 0, 0, 20, 0, 0, NULL, NULL, NULL, NULL, NULL, NULL, NULL,
                               {TAG_SHELL, TAG_ABOUT, TAG_SHUTDOWN, TAG_REBOOT, 0, 0, 0, 0, 0 }};
 
 // Structure used to hold boot loader filenames and time stamps in
@@ -102,6 +115,12 @@ struct LOADER_LIST {
 
 static VOID AboutrEFInd(VOID)
 {
+    SECTOR_CACHE_STATS SectorStats;
+    DIR_CACHE_STATS    DirStats;
+    MENU_KEY_STATS     KeyStats;
+    EG_SCREEN_STATS    ScreenStats;
+    REFIT_MENU_ENTRY   *ChosenEntry;
+
     if (AboutMenu.EntryCount == 0) {
         AboutMenu.TitleImage = BuiltinIcon(BUILTIN_ICON_FUNC_ABOUT);
         AddMenuInfoLine(&AboutMenu, L"rEFInd Version 0.3.5");
@@ -124,13 +143,50 @@ static VOID AboutrEFInd(VOID)
         AddMenuInfoLine(&AboutMenu, PoolPrint(L" Firmware: %s %d.%02d",
             ST->FirmwareVendor, ST->FirmwareRevision >> 16, ST->FirmwareRevision & ((1 << 16) - 1)));
         AddMenuInfoLine(&AboutMenu, PoolPrint(L" Screen Output: %s", egScreenDescription()));
+        egGetScreenStats(&ScreenStats);
+        if (ScreenStats.FrameCount > 0) {
+            AddMenuInfoLine(&AboutMenu, PoolPrint(L" Screen updates: %d frames, %d Blt calls, %ld pixels",
+                            ScreenStats.FrameCount, ScreenStats.TotalBltCount, (UINT64) ScreenStats.TotalPixelCount));
+            AddMenuInfoLine(&AboutMenu, PoolPrint(L" Last screen update: %d Blt calls, %ld pixels",
+                            ScreenStats.BltCount, (UINT64) ScreenStats.PixelCount));
+        }
+        if (TimestampTicksPerMs() > 0 && GetMenuFirstPaintTimestamp() > StartTimestamp) {
+            AddMenuInfoLine(&AboutMenu, PoolPrint(L" Menu shown after %ld ms",
+                            (GetMenuFirstPaintTimestamp() - StartTimestamp) / TimestampTicksPerMs()));
+            if (ScanDoneTimestamp > StartTimestamp)
+                AddMenuInfoLine(&AboutMenu, PoolPrint(L" Boot loader scan done after %ld ms",
+                                (ScanDoneTimestamp - StartTimestamp) / TimestampTicksPerMs()));
+            GetMenuKeyStats(&KeyStats);
+            if (KeyStats.KeyCount > 0)
+                AddMenuInfoLine(&AboutMenu, PoolPrint(L" Menu key response: %d keys, %ld us average, %ld us worst",
+                                KeyStats.KeyCount,
+                                KeyStats.TotalLatency * 1000 / TimestampTicksPerMs() / KeyStats.KeyCount,
+                                KeyStats.MaxLatency * 1000 / TimestampTicksPerMs()));
+        }
+        GetSectorCacheStats(&SectorStats);
+        AddMenuInfoLine(&AboutMenu, PoolPrint(L" Sector reads: %d from disk (%d overlapped), %d from cache",
+                        SectorStats.Misses, SectorStats.Overlapped, SectorStats.Hits));
+        GetDirCacheStats(&DirStats);
+        AddMenuInfoLine(&AboutMenu, PoolPrint(L" Directory lookups: %d from disk, %d from cache",
+                        DirStats.Misses, DirStats.Hits));
         AddMenuInfoLine(&AboutMenu, L"");
         AddMenuInfoLine(&AboutMenu, L"For more information, see the rEFInd Web site:");
         AddMenuInfoLine(&AboutMenu, L"http://www.rodsbooks.com/refind/");
+        AddMenuEntry(&AboutMenu, &MenuEntryTimeline);
         AddMenuEntry(&AboutMenu, &MenuEntryReturn);
     }
 
-    RunMenu(&AboutMenu, NULL);
+    while (RunMenu(&AboutMenu, &ChosenEntry) == MENU_EXIT_ENTER && ChosenEntry == &MenuEntryTimeline) {
+        // rebuilt each time, since a rescan adds to the timeline
+        FreeList((VOID ***) &TimelineMenu.InfoLines, &TimelineMenu.InfoLineCount);
+        TimelineMenu.InfoLines = NULL;
+        TimelineMenu.InfoLineCount = 0;
+        TimelineMenu.TitleImage = BuiltinIcon(BUILTIN_ICON_FUNC_ABOUT);
+        AddTimelineInfoLines(&TimelineMenu);
+        if (TimelineMenu.EntryCount == 0)
+            AddMenuEntry(&TimelineMenu, &MenuEntryReturn);
+        RunMenu(&TimelineMenu, NULL);
+    }
 } /* VOID AboutrEFInd() */
 
 static EFI_STATUS StartEFIImageList(IN EFI_DEVICE_PATH **DevicePaths,
@@ -239,6 +295,256 @@ static VOID StartLoader(IN LOADER_ENTRY *Entry)
     FinishExternalScreen();
 }
 
+//
+// initrd version index
+//
+
+// The init* files in one directory, indexed by the version number found in
+// their names, so that FindInitrd() needn't re-read the directory and compare
+// every file for each kernel in it. ScanLoaderDir() fills in the index while it
+// enumerates a directory; FindInitrd() builds one on demand for directories it
+// hasn't seen (kernels added from the scan cache).
+typedef struct {
+   CHAR16   *FileName;
+   CHAR16   *Version;       // FindNumbers() of FileName, upper-cased; NULL if none
+} INITRD_INDEX_ENTRY;
+
+typedef struct {
+   EFI_FILE             *RootDir;
+   CHAR16               *Path;          // cleaned up with CleanUpPathNameSlashes(); L"" for the root
+   UINTN                EntryCount;
+   INITRD_INDEX_ENTRY   **Entries;      // in directory order
+   UINTN                HashSize;       // power of 2; 0 until the first lookup
+   UINTN                *HashTable;     // index + 1 of the first entry with a version; 0 if free
+   INITRD_INDEX_ENTRY   *Unversioned;   // first entry with no version number
+   INITRD_INDEX_ENTRY   *Latest;        // entry with the highest version number
+} INITRD_INDEX;
+
+static REFIT_GLOB_SET InitrdGlobs = { 0, NULL };
+static INITRD_INDEX   **InitrdIndexes = NULL;
+static UINTN          InitrdIndexCount = 0;
+
+#define IsDigit(c) ((c) >= L'0' && (c) <= L'9')
+
+static UINTN HashVersion(IN CHAR16 *Version, IN UINTN Length) {
+   UINT32 Hash = 2166136261U;
+   UINTN  i;
+
+   for (i = 0; i < Length; i++) {
+      Hash ^= (UINT32) Version[i];
+      Hash *= 16777619U;
+   }
+   return (UINTN) Hash;
+} // static UINTN HashVersion()
+
+// Compares two version strings, taking runs of digits as numbers, so that
+// "3.10" sorts after "3.9". Returns <0, 0 or >0, as StriCmp() does.
+static INTN CompareVersions(IN CHAR16 *First, IN CHAR16 *Second) {
+   UINTN FirstDigits, SecondDigits, i;
+
+   while (*First != L'\0' && *Second != L'\0') {
+      if (IsDigit(*First) && IsDigit(*Second)) {
+         while (*First == L'0')
+            First++;
+         while (*Second == L'0')
+            Second++;
+         for (FirstDigits = 0; IsDigit(First[FirstDigits]); FirstDigits++)
+            ;
+         for (SecondDigits = 0; IsDigit(Second[SecondDigits]); SecondDigits++)
+            ;
+         if (FirstDigits != SecondDigits)
+            return (FirstDigits > SecondDigits) ? 1 : -1;
+         for (i = 0; i < FirstDigits; i++) {
+            if (First[i] != Second[i])
+               return (First[i] > Second[i]) ? 1 : -1;
+         }
+         First += FirstDigits;
+         Second += SecondDigits;
+      } else {
+         if (*First != *Second)
+            return (*First > *Second) ? 1 : -1;
+         First++;
+         Second++;
+      } // if/else
+   } // while
+   return (*First != L'\0') ? 1 : ((*Second != L'\0') ? -1 : 0);
+} // static INTN CompareVersions()
+
+// Returns Path as an index key; the caller must free it.
+static CHAR16 * InitrdIndexPath(IN CHAR16 *Path OPTIONAL) {
+   CHAR16 *Key;
+
+   // CleanUpPathNameSlashes() turns "" into "\\", so it needs two characters
+   Key = StrDuplicate(((Path != NULL) && (*Path != L'\0')) ? Path : L"\\");
+   if (Key != NULL) {
+      CleanUpPathNameSlashes(Key);
+      if (StrCmp(Key, L"\\") == 0)
+         Key[0] = 0;
+   }
+   return Key;
+} // static CHAR16 * InitrdIndexPath()
+
+// Returns the index for Path on RootDir, or NULL if there is none. With
+// Create TRUE, a new, empty index is added and returned instead of NULL.
+static INITRD_INDEX * FindInitrdIndex(IN EFI_FILE *RootDir, IN CHAR16 *Path OPTIONAL, IN BOOLEAN Create) {
+   INITRD_INDEX *Index = NULL;
+   CHAR16       *Key;
+   UINTN        i;
+
+   Key = InitrdIndexPath(Path);
+   if (Key == NULL)
+      return NULL;
+   for (i = 0; i < InitrdIndexCount; i++) {
+      if (InitrdIndexes[i]->RootDir == RootDir && StriCmp(InitrdIndexes[i]->Path, Key) == 0) {
+         FreePool(Key);
+         return InitrdIndexes[i];
+      }
+   } // for
+   if (Create)
+      Index = AllocateZeroPool(sizeof(INITRD_INDEX));
+   if (Index != NULL) {
+      Index->RootDir = RootDir;
+      Index->Path = Key;
+      AddListElement((VOID ***) &InitrdIndexes, &InitrdIndexCount, Index);
+   } else {
+      FreePool(Key);
+   }
+   return Index;
+} // static INITRD_INDEX * FindInitrdIndex()
+
+// Adds FileName, an init* file in Index's directory, to Index.
+static VOID AddToInitrdIndex(IN OUT INITRD_INDEX *Index, IN CHAR16 *FileName) {
+   INITRD_INDEX_ENTRY *Entry;
+   UINTN              i;
+
+   Entry = AllocateZeroPool(sizeof(INITRD_INDEX_ENTRY));
+   if (Entry == NULL)
+      return;
+   Entry->FileName = StrDuplicate(FileName);
+   Entry->Version = FindNumbers(FileName);
+   if (Entry->Version != NULL) {
+      for (i = 0; Entry->Version[i] != L'\0'; i++) {
+         if (Entry->Version[i] >= L'a' && Entry->Version[i] <= L'z')
+            Entry->Version[i] -= (L'a' - L'A');
+      }
+      if (Index->Latest == NULL || CompareVersions(Entry->Version, Index->Latest->Version) > 0)
+         Index->Latest = Entry;
+   } else if (Index->Unversioned == NULL) {
+      Index->Unversioned = Entry;
+   }
+   AddListElement((VOID ***) &Index->Entries, &Index->EntryCount, Entry);
+   if (Index->HashTable != NULL) {   // rebuilt on the next lookup
+      FreePool(Index->HashTable);
+      Index->HashTable = NULL;
+      Index->HashSize = 0;
+   }
+} // static VOID AddToInitrdIndex()
+
+// Builds Index's hash table of versions. Where several files have the same
+// version, the first one in the directory wins, as it did before the index.
+static VOID HashInitrdIndex(IN OUT INITRD_INDEX *Index) {
+   UINTN i, Slot;
+
+   Index->HashSize = 8;
+   while (Index->HashSize < Index->EntryCount * 2)
+      Index->HashSize *= 2;
+   Index->HashTable = AllocateZeroPool(Index->HashSize * sizeof(UINTN));
+   if (Index->HashTable == NULL) {
+      Index->HashSize = 0;
+      return;
+   }
+   for (i = 0; i < Index->EntryCount; i++) {
+      if (Index->Entries[i]->Version == NULL)
+         continue;
+      Slot = HashVersion(Index->Entries[i]->Version, StrLen(Index->Entries[i]->Version)) & (Index->HashSize - 1);
+      while (Index->HashTable[Slot] != 0) {
+         if (StrCmp(Index->Entries[Index->HashTable[Slot] - 1]->Version, Index->Entries[i]->Version) == 0)
+            break;
+         Slot = (Slot + 1) & (Index->HashSize - 1);
+      }
+      if (Index->HashTable[Slot] == 0)
+         Index->HashTable[Slot] = i + 1;
+   } // for
+} // static VOID HashInitrdIndex()
+
+// Returns the entry whose version is exactly the first Length characters of
+// Version, or NULL if there is none.
+static INITRD_INDEX_ENTRY * LookUpInitrdVersion(IN INITRD_INDEX *Index, IN CHAR16 *Version, IN UINTN Length) {
+   INITRD_INDEX_ENTRY *Entry;
+   UINTN              Slot;
+
+   if (Index->HashSize == 0)
+      return NULL;
+   Slot = HashVersion(Version, Length) & (Index->HashSize - 1);
+   while (Index->HashTable[Slot] != 0) {
+      Entry = Index->Entries[Index->HashTable[Slot] - 1];
+      if (StrLen(Entry->Version) == Length && CompareMem(Entry->Version, Version, Length * sizeof(CHAR16)) == 0)
+         return Entry;
+      Slot = (Slot + 1) & (Index->HashSize - 1);
+   }
+   return NULL;
+} // static INITRD_INDEX_ENTRY * LookUpInitrdVersion()
+
+// Returns the entry that best matches the kernel version KernelVersion, which
+// may be NULL. In order of preference, that is:
+//  - the file with exactly the kernel's version;
+//  - the file with the longest version that is a leading part of the kernel's,
+//    ending where a number in it ends (so kernel 3.3.0-rc7 can use an
+//    initramfs-3.3.0.img, but kernel 3.30 never uses initramfs-3.3.img);
+//  - for a kernel with no version, the first file with no version, or else
+//    the file with the latest version.
+static INITRD_INDEX_ENTRY * MatchInitrdIndex(IN OUT INITRD_INDEX *Index, IN CHAR16 *KernelVersion OPTIONAL) {
+   INITRD_INDEX_ENTRY *Entry = NULL;
+   CHAR16             *Version;
+   UINTN              Length, i;
+
+   if (KernelVersion == NULL)
+      return (Index->Unversioned != NULL) ? Index->Unversioned : Index->Latest;
+
+   if (Index->HashTable == NULL)
+      HashInitrdIndex(Index);
+   Version = StrDuplicate(KernelVersion);
+   if (Version == NULL)
+      return NULL;
+   for (i = 0; Version[i] != L'\0'; i++) {
+      if (Version[i] >= L'a' && Version[i] <= L'z')
+         Version[i] -= (L'a' - L'A');
+   }
+   Length = StrLen(Version);
+   while (Length > 0 && (Entry = LookUpInitrdVersion(Index, Version, Length)) == NULL) {
+      // back up to the end of the previous number in the version
+      do {
+         Length--;
+      } while (Length > 0 && !(IsDigit(Version[Length - 1]) && !IsDigit(Version[Length])));
+   } // while
+   FreePool(Version);
+   return Entry;
+} // static INITRD_INDEX_ENTRY * MatchInitrdIndex()
+
+static VOID FreeInitrdIndexes(VOID) {
+   UINTN i, j;
+
+   for (i = 0; i < InitrdIndexCount; i++) {
+      for (j = 0; j < InitrdIndexes[i]->EntryCount; j++) {
+         if (InitrdIndexes[i]->Entries[j]->FileName != NULL)
+            FreePool(InitrdIndexes[i]->Entries[j]->FileName);
+         if (InitrdIndexes[i]->Entries[j]->Version != NULL)
+            FreePool(InitrdIndexes[i]->Entries[j]->Version);
+         FreePool(InitrdIndexes[i]->Entries[j]);
+      }
+      if (InitrdIndexes[i]->Entries != NULL)
+         FreePool(InitrdIndexes[i]->Entries);
+      if (InitrdIndexes[i]->HashTable != NULL)
+         FreePool(InitrdIndexes[i]->HashTable);
+      FreePool(InitrdIndexes[i]->Path);
+      FreePool(InitrdIndexes[i]);
+   } // for
+   if (InitrdIndexes != NULL)
+      FreePool(InitrdIndexes);
+   InitrdIndexes = NULL;
+   InitrdIndexCount = 0;
+} // static VOID FreeInitrdIndexes()
+
 // Locate an initrd or initramfs file that matches the kernel specified by LoaderPath.
 // The matching file has a name that begins with "init" and includes the same version
 // number string as is found in LoaderPath -- but not a longer version number string.
@@ -248,44 +554,43 @@ static VOID StartLoader(IN LOADER_ENTRY *Entry)
 // initramfs-3.3.0-rc7.img or initramfs-13.3.0.img, those files will NOT match;
 // however, initmine-3.3.0.img might match. (FindInitrd() returns the first match it
 // finds). Thus, care should be taken to avoid placing duplicate matching files in
-// the kernel's directory.
+// the kernel's directory. Failing an exact match, a shorter version is accepted as
+// described for MatchInitrdIndex().
 // If no matching init file can be found, returns NULL.
 static CHAR16 * FindInitrd(IN CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume) {
-   CHAR16              *InitrdName = NULL, *FileName, *KernelVersion, *InitrdVersion, *Path;
+   CHAR16              *InitrdName = NULL, *FileName, *KernelVersion, *Path;
+   INITRD_INDEX        *Index;
+   INITRD_INDEX_ENTRY  *Entry;
    REFIT_DIR_ITER      DirIter;
    EFI_FILE_INFO       *DirEntry;
 
+   if (InitrdGlobs.Patterns == NULL)
+      CompileGlobSet(L"init*", &InitrdGlobs);
+
    FileName = Basename(LoaderPath);
    KernelVersion = FindNumbers(FileName);
    Path = FindPath(LoaderPath);
 
-   // Add trailing backslash for root directory; necessary on some systems, but must
-   // NOT be added to all directories, since on other systems, a trailing backslash on
-   // anything but the root directory causes them to flake out!
-   if (StrLen(Path) == 0) {
-      MergeStrings(&Path, L"\\", 0);
+   Index = FindInitrdIndex(Volume->RootDir, Path, FALSE);
+   if (Index == NULL && (Index = FindInitrdIndex(Volume->RootDir, Path, TRUE)) != NULL) {
+      // Add trailing backslash for root directory; necessary on some systems, but must
+      // NOT be added to all directories, since on other systems, a trailing backslash on
+      // anything but the root directory causes them to flake out!
+      DirIterOpen(Volume->RootDir, (StrLen(Path) == 0) ? L"\\" : Path, &DirIter);
+      while (DirIterNext(&DirIter, 2, &InitrdGlobs, &DirEntry))
+         AddToInitrdIndex(Index, DirEntry->FileName);
+      DirIterClose(&DirIter);
    } // if
-   DirIterOpen(Volume->RootDir, Path, &DirIter);
-   // Now add a trailing backslash if it was NOT added earlier, for consistency in
-   // building the InitrdName later....
-   if ((StrLen(Path) > 0) && (Path[StrLen(Path) - 1] != L'\\'))
+
+   // Add a trailing backslash, for consistency in building the InitrdName....
+   if ((StrLen(Path) == 0) || (Path[StrLen(Path) - 1] != L'\\'))
       MergeStrings(&Path, L"\\", 0);
-   while ((DirIterNext(&DirIter, 2, L"init*", &DirEntry)) && (InitrdName == NULL)) {
-      InitrdVersion = FindNumbers(DirEntry->FileName);
-      if (KernelVersion != NULL) {
-         if (StriCmp(InitrdVersion, KernelVersion) == 0)
-            InitrdName = PoolPrint(L"%s%s", Path, DirEntry->FileName);
-      } else {
-         if (InitrdVersion == NULL)
-            InitrdName = PoolPrint(L"%s%s", Path, DirEntry->FileName);
-      } // if/else
-      if (InitrdVersion != NULL)
-         FreePool(InitrdVersion);
-   } // while
-   DirIterClose(&DirIter);
+   if (Index != NULL && (Entry = MatchInitrdIndex(Index, KernelVersion)) != NULL)
+      InitrdName = PoolPrint(L"%s%s", Path, Entry->FileName);
 
    // Note: Don't FreePool(FileName), since Basename returns a pointer WITHIN the string it's passed.
-   FreePool(KernelVersion);
+   if (KernelVersion != NULL)
+      FreePool(KernelVersion);
    FreePool(Path);
    return (InitrdName);
 } // static CHAR16 * FindInitrd()
@@ -336,6 +641,8 @@ static REFIT_MENU_ENTRY* CopyMenuEntry(REFIT_MENU_ENTRY *Entry) {
    if ((Entry != NULL) && (NewEntry != NULL)) {
       CopyMem(NewEntry, Entry, sizeof(REFIT_MENU_ENTRY));
       NewEntry->Title = StrDuplicate(Entry->Title);
+      NewEntry->TileImages[0] = NewEntry->TileImages[1] = NULL;   // don't share the cached tiles
+      NewEntry->TileGeneration = 0;
       if (Entry->BadgeImage != NULL) {
          NewEntry->BadgeImage = AllocatePool(sizeof(EG_IMAGE));
          if (NewEntry->BadgeImage != NULL)
@@ -525,6 +832,7 @@ VOID GenerateSubScreen(LOADER_ENTRY *Entry, IN REFIT_VOLUME *Volume) {
             FreePool(InitrdOption);
          if (Temp)
             FreePool(Temp);
+         FreeFile(File);
          FreePool(File);
       } // if Linux options file exists
 
@@ -564,9 +872,6 @@ VOID GenerateSubScreen(LOADER_ENTRY *Entry, IN REFIT_VOLUME *Volume) {
       AddMenuInfoLine(SubScreen, L"marked with (*) may not work.");
 
    } else if (Entry->OSType == 'X') {   // entries for xom.efi
-        // by default, skip the built-in selection and boot from hard disk only
-        Entry->LoadOptions = L"-s -h";
-
         SubEntry = InitializeLoaderEntry(Entry);
         if (SubEntry != NULL) {
            SubEntry->me.Title        = L"Boot Windows from Hard Disk";
@@ -593,6 +898,21 @@ VOID GenerateSubScreen(LOADER_ENTRY *Entry, IN REFIT_VOLUME *Volume) {
    Entry->me.SubScreen = SubScreen;
 } // VOID GenerateSubScreen()
 
+// Builds the subscreen of a loader entry whose subscreen AddLoaderEntry()
+// deferred. Called when the user first asks for the entry's details; the
+// result stays attached to the entry, so this does nothing the next time.
+VOID GeneratePendingSubScreen(IN OUT REFIT_MENU_ENTRY *Entry) {
+   LOADER_ENTRY *LoaderEntry;
+
+   if ((Entry == NULL) || (Entry->Tag != TAG_LOADER) || (Entry->SubScreen != NULL))
+      return;
+   LoaderEntry = (LOADER_ENTRY *) Entry;
+   if (LoaderEntry->Volume != NULL) {
+      GenerateSubScreen(LoaderEntry, LoaderEntry->Volume);
+      LoaderEntry->Volume = NULL;
+   } // if
+} // VOID GeneratePendingSubScreen()
+
 // Returns options for a Linux kernel. Reads them from an options file in the
 // kernel's directory; and if present, adds an initrd= option for an initial
 // RAM disk file with the same version number as the kernel file.
@@ -611,10 +931,11 @@ static CHAR16 * GetMainLinuxOptions(IN CHAR16 * LoaderPath, IN REFIT_VOLUME *Vol
    return (Options);
 } // static CHAR16 * GetMainLinuxOptions()
 
-// Sets a few defaults for a loader entry -- mainly the icon, but also the OS type
-// code and shortcut letter. For Linux EFI stub loaders, also sets kernel options
-// that will (with luck) work fairly automatically.
-VOID SetLoaderDefaults(LOADER_ENTRY *Entry, CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume) {
+// Does the work of SetLoaderDefaults(). If Cached is given, the results of
+// the file probes (custom icon and Linux options) are taken from it instead
+// of from the volume. Sets *HasIcon to whether a custom icon file exists.
+static VOID SetLoaderDefaultsCached(LOADER_ENTRY *Entry, CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume,
+                                    IN SCAN_CACHE_LOADER *Cached OPTIONAL, OUT BOOLEAN *HasIcon) {
    CHAR16          IconFileName[256];
    CHAR16          *FileName, *PathOnly, *OSIconName = NULL, *Temp;
    CHAR16          ShortcutLetter = 0;
@@ -625,7 +946,11 @@ VOID SetLoaderDefaults(LOADER_ENTRY *Entry, CHAR16 *LoaderPath, IN REFIT_VOLUME
    // locate a custom icon for the loader
    StrCpy(IconFileName, LoaderPath);
    ReplaceEfiExtension(IconFileName, L".icns");
-   if (FileExists(Volume->RootDir, IconFileName)) {
+   if (Cached != NULL)
+      *HasIcon = Cached->HasIcon;
+   else
+      *HasIcon = FileExists(Volume->RootDir, IconFileName);
+   if (*HasIcon) {
       Entry->me.Image = LoadIcns(Volume->RootDir, IconFileName, 128);
    } else if ((StrLen(PathOnly) == 0) && (Volume->VolIconImage != NULL)) {
       Entry->me.Image = Volume->VolIconImage;
@@ -644,7 +969,10 @@ VOID SetLoaderDefaults(LOADER_ENTRY *Entry, CHAR16 *LoaderPath, IN REFIT_VOLUME
       Entry->OSType = 'L';
       if (ShortcutLetter == 0)
          ShortcutLetter = 'L';
-      Entry->LoadOptions = GetMainLinuxOptions(LoaderPath, Volume);
+      if (Cached == NULL)
+         Entry->LoadOptions = GetMainLinuxOptions(LoaderPath, Volume);
+      else if (Cached->LoadOptions != NULL)
+         Entry->LoadOptions = StrDuplicate(Cached->LoadOptions);
    } else if (StriSubCmp(L"refit", LoaderPath)) {
       MergeStrings(&OSIconName, L"refit", L',');
       Entry->OSType = 'R';
@@ -678,21 +1006,42 @@ VOID SetLoaderDefaults(LOADER_ENTRY *Entry, CHAR16 *LoaderPath, IN REFIT_VOLUME
       Entry->UseGraphicsMode = TRUE;
       Entry->OSType = 'X';
       ShortcutLetter = 'W';
+      // by default, skip the built-in selection and boot from hard disk only;
+      // callers (such as refind.conf stanzas) may free and replace this
+      if (Entry->LoadOptions != NULL)
+         FreePool(Entry->LoadOptions);
+      Entry->LoadOptions = StrDuplicate(L"-s -h");
    }
 
    if ((ShortcutLetter >= 'a') && (ShortcutLetter <= 'z'))
       ShortcutLetter = ShortcutLetter - 'a' + 'A'; // convert lowercase to uppercase
    Entry->me.ShortcutLetter = ShortcutLetter;
-   if (Entry->me.Image == NULL)
-      Entry->me.Image = LoadOSIcon(OSIconName, L"unknown", FALSE);
+   if (Entry->me.Image == NULL) { // loaded once the menu is up; see LoadPendingIcon() in menu.c
+      Entry->me.IconName = OSIconName;
+      Entry->me.IconFallback = L"unknown";
+   } else if (OSIconName != NULL) {
+      FreePool(OSIconName);
+   }
    if (PathOnly != NULL)
       FreePool(PathOnly);
+} // static VOID SetLoaderDefaultsCached()
+
+// Sets a few defaults for a loader entry -- mainly the icon, but also the OS type
+// code and shortcut letter. For Linux EFI stub loaders, also sets kernel options
+// that will (with luck) work fairly automatically.
+VOID SetLoaderDefaults(LOADER_ENTRY *Entry, CHAR16 *LoaderPath, IN REFIT_VOLUME *Volume) {
+   BOOLEAN HasIcon;
+
+   SetLoaderDefaultsCached(Entry, LoaderPath, Volume, NULL, &HasIcon);
 } // VOID SetLoaderDefaults()
 
-// Add a specified EFI boot loader to the list, using automatic settings
-// for icons, options, etc.
-LOADER_ENTRY * AddLoaderEntry(IN CHAR16 *LoaderPath, IN CHAR16 *LoaderTitle, IN REFIT_VOLUME *Volume) {
+// Adds a loader as AddLoaderEntry() does. If Cached is given, the loader
+// comes from the scan cache and its file probes aren't repeated; otherwise
+// it's recorded in the cache (if one is being recorded).
+static LOADER_ENTRY * AddLoaderEntryCached(IN CHAR16 *LoaderPath, IN CHAR16 *LoaderTitle, IN REFIT_VOLUME *Volume,
+                                           IN SCAN_CACHE_LOADER *Cached OPTIONAL) {
    LOADER_ENTRY      *Entry;
+   BOOLEAN           HasIcon;
 
    CleanUpPathNameSlashes(LoaderPath);
    Entry = InitializeLoaderEntry(NULL);
@@ -704,12 +1053,24 @@ LOADER_ENTRY * AddLoaderEntry(IN CHAR16 *LoaderPath, IN CHAR16 *LoaderTitle, IN
       Entry->LoaderPath = StrDuplicate(LoaderPath);
       Entry->VolName = Volume->VolName;
       Entry->DevicePath = FileDevicePath(Volume->DeviceHandle, Entry->LoaderPath);
-      SetLoaderDefaults(Entry, LoaderPath, Volume);
-      GenerateSubScreen(Entry, Volume);
+      SetLoaderDefaultsCached(Entry, LoaderPath, Volume, Cached, &HasIcon);
+      if (Cached == NULL) {
+         ScanCacheAddLoader(LoaderPath, LoaderTitle, HasIcon, (Entry->OSType == 'L') ? Entry->LoadOptions : NULL,
+                            Entry->OSType == 'L');
+      }
+      // The subscreen reads options files and directories, so it's built only
+      // if the user asks for it; see GeneratePendingSubScreen().
+      Entry->Volume = Volume;
       AddMenuEntry(&MainMenu, (REFIT_MENU_ENTRY *)Entry);
    }
 
    return(Entry);
+} // static LOADER_ENTRY * AddLoaderEntryCached()
+
+// Add a specified EFI boot loader to the list, using automatic settings
+// for icons, options, etc.
+LOADER_ENTRY * AddLoaderEntry(IN CHAR16 *LoaderPath, IN CHAR16 *LoaderTitle, IN REFIT_VOLUME *Volume) {
+   return AddLoaderEntryCached(LoaderPath, LoaderTitle, Volume, NULL);
 } // LOADER_ENTRY * AddLoaderEntry()
 
 // Returns -1 if (Time1 < Time2), +1 if (Time1 > Time2), or 0 if
@@ -772,19 +1133,33 @@ static VOID CleanUpLoaderList(struct LOADER_LIST *LoaderList) {
 // Scan an individual directory for EFI boot loader files and, if found,
 // add them to the list. Sorts the entries within the loader directory
 // so that the most recent one appears first in the list.
-static VOID ScanLoaderDir(IN REFIT_VOLUME *Volume, IN CHAR16 *Path, IN CHAR16 *Pattern)
+static VOID ScanLoaderDir(IN REFIT_VOLUME *Volume, IN CHAR16 *Path, IN REFIT_GLOB_SET *Globs)
 {
     EFI_STATUS              Status;
     REFIT_DIR_ITER          DirIter;
     EFI_FILE_INFO           *DirEntry;
     CHAR16                  FileName[256], *Extension;
     struct LOADER_LIST      *LoaderList = NULL, *NewLoader;
+    INITRD_INDEX            *InitrdIndex;
 
     if (!SelfDirPath || !Path || ((StriCmp(Path, SelfDirPath) == 0) && Volume != SelfVolume) ||
         (StriCmp(Path, SelfDirPath) != 0)) {
+       ScanCacheStamp(Path);
+       if (InitrdGlobs.Patterns == NULL)
+          CompileGlobSet(L"init*", &InitrdGlobs);
+       // index the directory's initrd files as we go, unless that's been done
+       InitrdIndex = FindInitrdIndex(Volume->RootDir, Path, FALSE);
+       if (InitrdIndex == NULL)
+          InitrdIndex = FindInitrdIndex(Volume->RootDir, Path, TRUE);
+       else
+          InitrdIndex = NULL;
        // look through contents of the directory
        DirIterOpen(Volume->RootDir, Path, &DirIter);
-       while (DirIterNext(&DirIter, 2, Pattern, &DirEntry)) {
+       while (DirIterNext(&DirIter, 2, NULL, &DirEntry)) {
+          if (InitrdIndex != NULL && GlobSetMatch(&InitrdGlobs, DirEntry->FileName))
+             AddToInitrdIndex(InitrdIndex, DirEntry->FileName);
+          if (!GlobSetMatch(Globs, DirEntry->FileName))
+             continue;
           Extension = FindExtension(DirEntry->FileName);
           if (DirEntry->FileName[0] == '.' ||
               StriCmp(DirEntry->FileName, L"TextMode.efi") == 0 ||
@@ -824,18 +1199,44 @@ static VOID ScanLoaderDir(IN REFIT_VOLUME *Volume, IN CHAR16 *Path, IN CHAR16 *P
     } // if not scanning our own directory
 } /* static VOID ScanLoaderDir() */
 
+// Boot loader match patterns, compiled by ScanForBootloaders() for each scan.
+static REFIT_GLOB_SET LoaderGlobs = { 0, NULL };
+
+// Returns the patterns that identify boot loader files.
+static CHAR16 * GetMatchPatterns(VOID) {
+   CHAR16 *MatchPatterns;
+
+   MatchPatterns = StrDuplicate(LOADER_MATCH_PATTERNS);
+   if (GlobalConfig.ScanAllLinux)
+      MergeStrings(&MatchPatterns, LINUX_MATCH_PATTERNS, L',');
+   return MatchPatterns;
+} // static CHAR16 * GetMatchPatterns()
+
 static VOID ScanEfiFiles(REFIT_VOLUME *Volume) {
    EFI_STATUS              Status;
    REFIT_DIR_ITER          EfiDirIter;
    EFI_FILE_INFO           *EfiDirEntry;
-   CHAR16                  FileName[256], *Directory, *MatchPatterns;
-   UINTN                   i, Length;
-
-    MatchPatterns = StrDuplicate(LOADER_MATCH_PATTERNS);
-    if (GlobalConfig.ScanAllLinux)
-       MergeStrings(&MatchPatterns, LINUX_MATCH_PATTERNS, L',');
+   CHAR16                  FileName[256], *Directory;
+   UINTN                   i, Length, LoaderCount, Span;
+   SCAN_CACHE_LOADER       **Loaders;
 
    if ((Volume->RootDir != NULL) && (Volume->VolName != NULL)) {
+      Span = TimelineBegin(L"ScanEfiFiles", Volume->VolName);
+      // if nothing has changed since the last boot, add what was found then
+      if (ScanCacheLookup(Volume, &LoaderCount, &Loaders)) {
+         for (i = 0; i < LoaderCount; i++) {
+            StrCpy(FileName, Loaders[i]->LoaderPath);
+            AddLoaderEntryCached(FileName, Loaders[i]->Title, Volume, Loaders[i]);
+         } // for
+         TimelineEnd(Span);
+         return;
+      } // if
+
+      ScanCacheStartVolume(Volume);
+      ScanCacheStamp(L"System\\Library\\CoreServices");
+      ScanCacheStamp(L"EFI\\Microsoft\\Boot");
+      ScanCacheStamp(L"EFI");
+
       // check for Mac OS X boot loader
       StrCpy(FileName, MACOSX_LOADER_PATH);
       if (FileExists(Volume->RootDir, FileName)) {
@@ -855,7 +1256,7 @@ static VOID ScanEfiFiles(REFIT_VOLUME *Volume) {
       }
 
       // scan the root directory for EFI executables
-      ScanLoaderDir(Volume, L"\\", MatchPatterns);
+      ScanLoaderDir(Volume, L"\\", &LoaderGlobs);
 
       // scan subdirectories of the EFI directory (as per the standard)
       DirIterOpen(Volume->RootDir, L"EFI", &EfiDirIter);
@@ -863,7 +1264,7 @@ static VOID ScanEfiFiles(REFIT_VOLUME *Volume) {
          if (StriCmp(EfiDirEntry->FileName, L"tools") == 0 || EfiDirEntry->FileName[0] == '.')
             continue;   // skip this, doesn't contain boot loaders
          SPrint(FileName, 255, L"EFI\\%s", EfiDirEntry->FileName);
-         ScanLoaderDir(Volume, FileName, MatchPatterns);
+         ScanLoaderDir(Volume, FileName, &LoaderGlobs);
       } // while()
       Status = DirIterClose(&EfiDirIter);
       if (Status != EFI_NOT_FOUND)
@@ -875,9 +1276,11 @@ static VOID ScanEfiFiles(REFIT_VOLUME *Volume) {
          CleanUpPathNameSlashes(Directory);
          Length = StrLen(Directory);
          if (Length > 0)
-            ScanLoaderDir(Volume, Directory, MatchPatterns);
+            ScanLoaderDir(Volume, Directory, &LoaderGlobs);
          FreePool(Directory);
       } // while
+      ScanCacheEndVolume();
+      TimelineEnd(Span);
    } // if
 } // static VOID ScanEfiFiles()
 
@@ -929,7 +1332,7 @@ static EFI_STATUS ActivateMbrPartition(IN EFI_BLOCK_IO *BlockIO, IN UINTN Partit
     BOOLEAN             HaveBootCode;
 
     // read MBR
-    Status = refit_call5_wrapper(BlockIO->ReadBlocks, BlockIO, BlockIO->Media->MediaId, 0, 512, SectorBuffer);
+    Status = ReadCachedBlocks(BlockIO, 0, 512, SectorBuffer);
     if (EFI_ERROR(Status))
         return Status;
     if (*((UINT16 *)(SectorBuffer + 510)) != 0xaa55)
@@ -965,7 +1368,7 @@ static EFI_STATUS ActivateMbrPartition(IN EFI_BLOCK_IO *BlockIO, IN UINTN Partit
     }
 
     // write MBR
-    Status = refit_call5_wrapper(BlockIO->WriteBlocks, BlockIO, BlockIO->Media->MediaId, 0, 512, SectorBuffer);
+    Status = WriteCachedBlocks(BlockIO, 0, 512, SectorBuffer);
     if (EFI_ERROR(Status))
         return Status;
 
@@ -975,7 +1378,7 @@ static EFI_STATUS ActivateMbrPartition(IN EFI_BLOCK_IO *BlockIO, IN UINTN Partit
         // NOTE: ExtBase was set above while looking at the MBR table
         for (ExtCurrent = ExtBase; ExtCurrent; ExtCurrent = NextExtCurrent) {
             // read current EMBR
-            Status = refit_call5_wrapper(BlockIO->ReadBlocks, BlockIO, BlockIO->Media->MediaId, ExtCurrent, 512, SectorBuffer);
+            Status = ReadCachedBlocks(BlockIO, ExtCurrent, 512, SectorBuffer);
             if (EFI_ERROR(Status))
                 return Status;
             if (*((UINT16 *)(SectorBuffer + 510)) != 0xaa55)
@@ -1002,7 +1405,7 @@ static EFI_STATUS ActivateMbrPartition(IN EFI_BLOCK_IO *BlockIO, IN UINTN Partit
             }
 
             // write current EMBR
-            Status = refit_call5_wrapper(BlockIO->WriteBlocks, BlockIO, BlockIO->Media->MediaId, ExtCurrent, 512, SectorBuffer);
+            Status = WriteCachedBlocks(BlockIO, ExtCurrent, 512, SectorBuffer);
             if (EFI_ERROR(Status))
                 return Status;
 
@@ -1131,7 +1534,8 @@ static LEGACY_ENTRY * AddLegacyEntry(IN CHAR16 *LoaderTitle, IN REFIT_VOLUME *Vo
     Entry->me.Tag          = TAG_LEGACY;
     Entry->me.Row          = 0;
     Entry->me.ShortcutLetter = ShortcutLetter;
-    Entry->me.Image        = LoadOSIcon(Volume->OSIconName, L"legacy", FALSE);
+    Entry->me.IconName     = (Volume->OSIconName != NULL) ? StrDuplicate(Volume->OSIconName) : NULL;
+    Entry->me.IconFallback = L"legacy";    // the icon itself is loaded once the menu is up
     Entry->me.BadgeImage   = Volume->VolBadgeImage;
     Entry->Volume          = Volume;
     Entry->LoadOptions     = (Volume->DiskKind == DISK_KIND_OPTICAL) ? L"CD" :
@@ -1141,7 +1545,7 @@ static LEGACY_ENTRY * AddLegacyEntry(IN CHAR16 *LoaderTitle, IN REFIT_VOLUME *Vo
     // create the submenu
     SubScreen = AllocateZeroPool(sizeof(REFIT_MENU_SCREEN));
     SubScreen->Title = PoolPrint(L"Boot Options for %s on %s", LoaderTitle, VolDesc);
-    SubScreen->TitleImage = Entry->me.Image;
+    // TitleImage is set by RunMainMenu(), after the entry's icon has been loaded
 
     // default entry
     SubEntry = AllocateZeroPool(sizeof(LEGACY_ENTRY));
@@ -1267,16 +1671,20 @@ static LOADER_ENTRY * AddToolEntry(IN CHAR16 *LoaderPath, IN CHAR16 *LoaderTitle
 
 static UINTN ScanDriverDir(IN CHAR16 *Path)
 {
+    static REFIT_GLOB_SET   DriverGlobs = { 0, NULL };
     EFI_STATUS              Status;
     REFIT_DIR_ITER          DirIter;
     UINTN                   NumFound = 0;
     EFI_FILE_INFO           *DirEntry;
     CHAR16                  FileName[256];
 
+    if (DriverGlobs.Patterns == NULL)
+        CompileGlobSet(LOADER_MATCH_PATTERNS, &DriverGlobs);
+
     CleanUpPathNameSlashes(Path);
     // look through contents of the directory
     DirIterOpen(SelfRootDir, Path, &DirIter);
-    while (DirIterNext(&DirIter, 2, LOADER_MATCH_PATTERNS, &DirEntry)) {
+    while (DirIterNext(&DirIter, 2, &DriverGlobs, &DirEntry)) {
         if (DirEntry->FileName[0] == '.')
             continue;   // skip this
 
@@ -1389,10 +1797,88 @@ static VOID LoadDrivers(VOID)
        ConnectAllDriversToAllControllers();
 } /* static VOID LoadDrivers() */
 
-static VOID ScanForBootloaders(VOID) {
+// Moves any first-row entries that were added after the second-row (tool)
+// entries in front of them, keeping their order; the menu layout code
+// expects all first-row entries to come first.
+static VOID SortMainMenuRows(VOID) {
+   REFIT_MENU_ENTRY *Entry;
+   UINTN            i, j, Row0Count = 0;
+
+   for (i = 0; i < MainMenu.EntryCount; i++) {
+      if (MainMenu.Entries[i]->Row == 0) {
+         Entry = MainMenu.Entries[i];
+         for (j = i; j > Row0Count; j--)
+            MainMenu.Entries[j] = MainMenu.Entries[j - 1];
+         MainMenu.Entries[Row0Count++] = Entry;
+      } // if
+   } // for
+} // static VOID SortMainMenuRows()
+
+static VOID AssignShortcutDigits(VOID) {
    UINTN i;
 
+   for (i = 0; i < MainMenu.EntryCount && MainMenu.Entries[i]->Row == 0 && i < 9; i++)
+      MainMenu.Entries[i]->ShortcutDigit = (CHAR16)('1' + i);
+} // static VOID AssignShortcutDigits()
+
+// With progressive_scan set, ScanForBootloaders() skips the external and
+// optical volumes, whose directories can take seconds to read, so that the
+// menu can be shown sooner. The main menu then calls this function between
+// key polls; each call scans one of those volumes and adds what it finds.
+// Returns FALSE once they've all been scanned.
+static BOOLEAN ScanNextDeferredVolume(IN REFIT_MENU_SCREEN *Screen) {
+   UINTN        DiskKind;
+   REFIT_VOLUME *Volume;
+
+   while (DeferredScanIndex < NUM_SCAN_OPTIONS) {
+      switch (GlobalConfig.ScanFor[DeferredScanIndex]) {
+         case 'e': case 'E':
+            DiskKind = DISK_KIND_EXTERNAL;
+            break;
+         case 'o': case 'O':
+            DiskKind = DISK_KIND_OPTICAL;
+            break;
+         default:
+            DiskKind = DISK_KIND_INTERNAL;   // not deferred
+            break;
+      } // switch()
+      while (DiskKind != DISK_KIND_INTERNAL && DeferredVolumeIndex < VolumesCount) {
+         Volume = Volumes[DeferredVolumeIndex++];
+         if (Volume->DiskKind == DiskKind) {
+            ScanEfiFiles(Volume);
+            SortMainMenuRows();
+            AssignShortcutDigits();
+            return TRUE;
+         } // if
+      } // while
+      DeferredScanIndex++;
+      DeferredVolumeIndex = 0;
+   } // while
+
+   Screen->IdleFunc = NULL;
+   ScanCacheSave();
+   if (ScanDoneTimestamp == 0)
+      ScanDoneTimestamp = ReadTimestampCounter();
+   return FALSE;
+} // static BOOLEAN ScanNextDeferredVolume()
+
+// Scans for boot loaders. With ReuseCache FALSE (a rescan requested by the
+// user), the scan cache (if enabled) is rebuilt instead of used.
+static VOID ScanForBootloaders(IN BOOLEAN ReuseCache) {
+   UINTN  i, Span;
+   CHAR16 *CacheKey, PassName[2];
+
+   Span = TimelineBegin(L"ScanVolumes", NULL);
    ScanVolumes();
+   TimelineEnd(Span);
+   FreeInitrdIndexes();
+   CacheKey = GetMatchPatterns();
+   FreeGlobSet(&LoaderGlobs);
+   CompileGlobSet(CacheKey, &LoaderGlobs);
+   MergeStrings(&CacheKey, GlobalConfig.AlsoScan, L'|');
+   MergeStrings(&CacheKey, SelfDirPath, L'|');
+   ScanCacheBegin(CacheKey, ReuseCache);
+   FreePool(CacheKey);
    // Commented-out below: Was part of an attempt to get rEFInd to
    // re-scan disk devices on pressing Esc; but doesn't work (yet), so
    // removed....
@@ -1408,6 +1894,11 @@ static VOID ScanForBootloaders(VOID) {
 
    // scan for loaders and tools, add them to the menu
    for (i = 0; i < NUM_SCAN_OPTIONS; i++) {
+      if (GlobalConfig.ScanFor[i] == ' ' || GlobalConfig.ScanFor[i] == '\0')
+         continue;
+      PassName[0] = (CHAR16) GlobalConfig.ScanFor[i];
+      PassName[1] = 0;
+      Span = TimelineBegin(L"ScanFor", PassName);
       switch(GlobalConfig.ScanFor[i]) {
          case 'c': case 'C':
             ScanLegacyDisc();
@@ -1422,20 +1913,32 @@ static VOID ScanForBootloaders(VOID) {
             ScanUserConfigured();
             break;
          case 'e': case 'E':
-            ScanExternal();
+            if (!GlobalConfig.ProgressiveScan)
+               ScanExternal();
             break;
          case 'i': case 'I':
             ScanInternal();
             break;
          case 'o': case 'O':
-            ScanOptical();
+            if (!GlobalConfig.ProgressiveScan)
+               ScanOptical();
             break;
       } // switch()
+      TimelineEnd(Span);
    } // for
 
-   // assign shortcut keys
-   for (i = 0; i < MainMenu.EntryCount && MainMenu.Entries[i]->Row == 0 && i < 9; i++)
-      MainMenu.Entries[i]->ShortcutDigit = (CHAR16)('1' + i);
+   // external and optical volumes are scanned while the menu is up
+   if (GlobalConfig.ProgressiveScan) {
+      DeferredScanIndex = 0;
+      DeferredVolumeIndex = 0;
+      MainMenu.IdleFunc = ScanNextDeferredVolume;
+   } else {
+      ScanCacheSave();
+      if (ScanDoneTimestamp == 0)
+         ScanDoneTimestamp = ReadTimestampCounter();
+   }
+
+   AssignShortcutDigits();
 
    // wait for user ACK when there were errors
    FinishTextScreen(FALSE);
@@ -1503,42 +2006,70 @@ efi_main (IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
     EFI_STATUS         Status;
     BOOLEAN            MainLoopRunning = TRUE;
     REFIT_MENU_ENTRY   *ChosenEntry;
-    UINTN              MenuExit;
+    UINTN              MenuExit, i, Span;
+    UINT64             MenuTimestamp;
     CHAR16             *Selection;
 
     // bootstrap
     InitializeLib(ImageHandle, SystemTable);
+    StartTimestamp = ReadTimestampCounter();
+    TimelineStart(StartTimestamp);
+    CalibrateTimestampCounter();   // now, rather than during the menu's first idle tick
+    Span = TimelineBegin(L"InitScreen", NULL);
     InitScreen();
+    TimelineEnd(Span);
+    Span = TimelineBegin(L"InitRefitLib", NULL);
     Status = InitRefitLib(ImageHandle);
+    TimelineEnd(Span);
     if (EFI_ERROR(Status))
         return Status;
 
     // read configuration
     CopyMem(GlobalConfig.ScanFor, "ieo       ", NUM_SCAN_OPTIONS);
+    Span = TimelineBegin(L"ReadConfig", NULL);
     ReadConfig();
+    TimelineEnd(Span);
     MainMenu.TimeoutSeconds = GlobalConfig.Timeout;
 
     // disable EFI watchdog timer
     refit_call4_wrapper(BS->SetWatchdogTimer, 0x0000, 0x0000, 0x0000, NULL);
 
     // further bootstrap (now with config available)
+    Span = TimelineBegin(L"SetupScreen", NULL);
     SetupScreen();
+    TimelineEnd(Span);
+    Span = TimelineBegin(L"LoadDrivers", NULL);
     LoadDrivers();
-    ScanForBootloaders();
+    TimelineEnd(Span);
+    Span = TimelineBegin(L"ScanForBootloaders", NULL);
+    ScanForBootloaders(TRUE);
+    TimelineEnd(Span);
+    Span = TimelineBegin(L"ScanForTools", NULL);
     ScanForTools();
+    TimelineEnd(Span);
 
     Selection = StrDuplicate(GlobalConfig.DefaultSelection);
+    MenuTimestamp = ReadTimestampCounter();
     while (MainLoopRunning) {
         MenuExit = RunMainMenu(&MainMenu, Selection, &ChosenEntry);
+        if (MenuTimestamp != 0) {
+            TimelineAddSpan(L"RunMainMenu first paint", MenuTimestamp, GetMenuFirstPaintTimestamp());
+            MenuTimestamp = 0;
+        }
+        TimelineSave();
+        SaveCallStats();
 
         // We don't allow exiting the main menu with the Escape key.
         if (MenuExit == MENU_EXIT_ESCAPE) {
+            for (i = 0; i < MainMenu.EntryCount; i++)
+                FreeMenuEntryTiles(MainMenu.Entries[i]);
             FreeList((VOID ***) &(MainMenu.Entries), &MainMenu.EntryCount);
             MainMenu.Entries = NULL;
             MainMenu.EntryCount = 0;
+            FlushIconCache();
             ReadConfig();
             ConnectAllDriversToAllControllers();
-            ScanForBootloaders();
+            ScanForBootloaders(FALSE);
             ScanForTools();
             SetupScreen();
             continue;
@@ -1548,13 +2079,13 @@ efi_main (IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
 
             case TAG_REBOOT:    // Reboot
                 TerminateScreen();
-                refit_call4_wrapper(RT->ResetSystem, EfiResetCold, EFI_SUCCESS, 0, NULL);
+                refit_call4_void_wrapper(RT->ResetSystem, EfiResetCold, EFI_SUCCESS, 0, NULL);
                 MainLoopRunning = FALSE;   // just in case we get this far
                 break;
 
             case TAG_SHUTDOWN: // Shut Down
                 TerminateScreen();
-                refit_call4_wrapper(RT->ResetSystem, EfiResetShutdown, EFI_SUCCESS, 0, NULL);
+                refit_call4_void_wrapper(RT->ResetSystem, EfiResetShutdown, EFI_SUCCESS, 0, NULL);
                 MainLoopRunning = FALSE;   // just in case we get this far
                 break;
 
@@ -1586,7 +2117,7 @@ efi_main (IN EFI_HANDLE ImageHandle, IN EFI_SYSTEM_TABLE *SystemTable)
 
     // If we end up here, things have gone wrong. Try to reboot, and if that
     // fails, go into an endless loop.
-    refit_call4_wrapper(RT->ResetSystem, EfiResetCold, EFI_SUCCESS, 0, NULL);
+    refit_call4_void_wrapper(RT->ResetSystem, EfiResetCold, EFI_SUCCESS, 0, NULL);
     EndlessIdleLoop();
 
     return EFI_SUCCESS;
@@ -47,12 +47,15 @@
 #include "lib.h"
 #include "menu.h"
 #include "config.h"
+#include "icns.h"
 #include "libeg.h"
 #include "refit_call_wrapper.h"
+#include "callstats.h"
 
-#include "egemb_back_selected_small.h"
-#include "egemb_arrow_left.h"
-#include "egemb_arrow_right.h"
+// generated from ../include/egemb_*.h by mkegemb
+#include "egemb_back_selected_small_bgra.h"
+#include "egemb_arrow_left_bgra.h"
+#include "egemb_arrow_right_bgra.h"
 
 // other menu definitions
 
@@ -83,7 +86,10 @@ static CHAR16 ArrowDown[2] = { ARROW_DOWN, 0 };
 
 static EG_IMAGE *SelectionImages[4] = { NULL, NULL, NULL, NULL };
 static EG_PIXEL SelectionBackgroundPixel = { 0xff, 0xff, 0xff, 0 };
-static EG_IMAGE *TextBuffer = NULL;
+static UINTN TileGeneration = 1;
+static MENU_KEY_STATS KeyStats = { 0, 0, 0 };
+static UINT64 FirstPaintTimestamp = 0;
+static CHAR16 *MainMenuDefault = NULL;   // RunMainMenu()'s DefaultSelection, for entries added later
 
 //
 // Graphics helper functions
@@ -152,6 +158,9 @@ static VOID InitSelection(VOID)
     // non-selected background images
     SelectionImages[1] = egCreateFilledImage(ROW0_TILESIZE, ROW0_TILESIZE, FALSE, &MenuBackgroundPixel);
     SelectionImages[3] = egCreateFilledImage(ROW1_TILESIZE, ROW1_TILESIZE, FALSE, &MenuBackgroundPixel);
+
+    // any tiles composed on the old backgrounds are now stale
+    InvalidateMenuTiles();
 }
 
 //
@@ -314,6 +323,88 @@ VOID FreeMenu(IN REFIT_MENU_SCREEN *Screen)
         FreePool(Screen->Entries);
 }
 
+// Marks every entry's cached main-menu tiles as stale, so they're rebuilt
+// the next time they're drawn. Call this when the selection backgrounds
+// change.
+VOID InvalidateMenuTiles(VOID)
+{
+    TileGeneration++;
+}
+
+// Frees an entry's cached main-menu tiles. Call this when its Image or
+// BadgeImage changes, or before freeing the entry.
+VOID FreeMenuEntryTiles(IN REFIT_MENU_ENTRY *Entry)
+{
+    UINTN i;
+
+    for (i = 0; i < 2; i++) {
+        egFreeImage(Entry->TileImages[i]);
+        Entry->TileImages[i] = NULL;
+    }
+} // VOID FreeMenuEntryTiles()
+
+// Loads an entry's icon if loading it was deferred (see SetLoaderDefaults()
+// and AddLegacyEntry() in main.c); until then, its tile shows just the
+// selection background. Returns TRUE if there was anything to load.
+static BOOLEAN LoadPendingIcon(IN REFIT_MENU_ENTRY *Entry)
+{
+    if (Entry->Image != NULL || Entry->IconFallback == NULL)
+        return FALSE;
+
+    Entry->Image = LoadOSIcon(Entry->IconName, Entry->IconFallback, FALSE);
+    if (Entry->IconName != NULL)
+        FreePool(Entry->IconName);
+    Entry->IconName = NULL;
+    Entry->IconFallback = NULL;
+    FreeMenuEntryTiles(Entry);
+    return TRUE;
+} // static BOOLEAN LoadPendingIcon()
+
+// Loads one deferred icon while the menu waits for a key, taking entries on
+// screen first: the visible part of the first row, and the second row. The
+// menu is repainted if the icon is on screen. Returns FALSE once there's
+// nothing left to load.
+static BOOLEAN LoadNextPendingIcon(IN REFIT_MENU_SCREEN *Screen, IN OUT SCROLL_STATE *State)
+{
+    INTN i;
+
+    if (!AllowGraphicsMode)
+        return FALSE;
+
+    for (i = 0; i <= State->MaxIndex; i++) {
+        if ((Screen->Entries[i]->Row != 0 || (i >= State->FirstVisible && i <= State->LastVisible)) &&
+            LoadPendingIcon(Screen->Entries[i])) {
+            State->PaintAll = TRUE;
+            return TRUE;
+        }
+    }
+    for (i = 0; i <= State->MaxIndex; i++) {
+        if (LoadPendingIcon(Screen->Entries[i]))
+            return TRUE;
+    }
+    return FALSE;
+} // static BOOLEAN LoadNextPendingIcon()
+
+static VOID RecordKeyLatency(IN UINT64 Latency)
+{
+    KeyStats.KeyCount++;
+    KeyStats.TotalLatency += Latency;
+    if (Latency > KeyStats.MaxLatency)
+        KeyStats.MaxLatency = Latency;
+}
+
+VOID GetMenuKeyStats(OUT MENU_KEY_STATS *Stats)
+{
+    *Stats = KeyStats;
+}
+
+// Returns the ReadTimestampCounter() value at which the first menu had been
+// painted, or 0 if no menu has been shown yet.
+UINT64 GetMenuFirstPaintTimestamp(VOID)
+{
+    return FirstPaintTimestamp;
+}
+
 static INTN FindMenuShortcutEntry(IN REFIT_MENU_SCREEN *Screen, IN CHAR16 *Shortcut)
 {
     UINTN i;
@@ -359,6 +450,50 @@ static VOID IdentifyRows(IN SCROLL_STATE *State, IN REFIT_MENU_SCREEN *Screen) {
       State->MaxVisible = State->FinalRow0 + 1;
 } // static VOID IdentifyRows()
 
+// Calls the screen's IdleFunc, which may add entries to it, and lays the menu
+// out again if it did. The selected entry stays selected; but until a key
+// has been pressed, an added entry that matches the main menu's default
+// selection takes over. Returns FALSE once IdleFunc has nothing left to do.
+static BOOLEAN RunIdleFunc(IN REFIT_MENU_SCREEN *Screen, IN MENU_STYLE_FUNC StyleFunc,
+                           IN OUT SCROLL_STATE *State, IN BOOLEAN KeyPressed)
+{
+    REFIT_MENU_ENTRY *Selected;
+    UINTN OldCount;
+    INTN i, FirstVisible;
+    BOOLEAN MoreWork;
+
+    Selected = Screen->Entries[State->CurrentSelection];
+    OldCount = Screen->EntryCount;
+    MoreWork = Screen->IdleFunc(Screen);
+    if (Screen->EntryCount == OldCount)
+        return MoreWork;
+
+    FirstVisible = State->FirstVisible;
+    StyleFunc(Screen, State, MENU_FUNCTION_CLEANUP, NULL);
+    StyleFunc(Screen, State, MENU_FUNCTION_INIT, NULL);   // sets State->PaintAll
+    IdentifyRows(State, Screen);
+    for (i = 0; i <= State->MaxIndex; i++) {
+        if (Screen->Entries[i] == Selected)
+            State->CurrentSelection = i;
+    }
+    if (!KeyPressed && MainMenuDefault != NULL) {
+        i = FindMenuShortcutEntry(Screen, MainMenuDefault);
+        if (i >= 0)
+            State->CurrentSelection = i;
+    }
+
+    // MENU_FUNCTION_INIT scrolled back to the start; keep the view where it
+    // was, then scroll as little as needed to bring the selection into it
+    // (in icon mode, only the first row scrolls)
+    if (FirstVisible <= State->MaxIndex)
+        State->FirstVisible = FirstVisible;
+    State->LastVisible = State->FirstVisible + State->MaxVisible - 1;
+    if (State->ScrollMode == SCROLL_MODE_TEXT || Screen->Entries[State->CurrentSelection]->Row == 0)
+        AdjustScrollState(State);
+    UpdateScroll(State, SCROLL_NONE);
+    return MoreWork;
+} // static BOOLEAN RunIdleFunc()
+
 //
 // generic menu function
 //
@@ -371,17 +506,41 @@ static UINTN RunGenericMenu(IN REFIT_MENU_SCREEN *Screen, IN MENU_STYLE_FUNC Sty
     INTN ShortcutEntry;
     BOOLEAN HaveTimeout = FALSE;
     UINTN TimeoutCountdown = 0;
+    UINTN ShownCountdown = 0;   // seconds in the painted timeout message; 0 = not painted
     CHAR16 *TimeoutMessage;
     CHAR16 KeyAsString[2];
-    UINTN MenuExit;
+    UINTN MenuExit, OldCount;
+    EFI_EVENT WaitList[2];
+    EFI_EVENT TimerEvent = NULL;
+    UINT64 KeyTimestamp = 0;
+    BOOLEAN IconsPending = TRUE;
+    BOOLEAN IdlePending = (Screen->IdleFunc != NULL);
+    BOOLEAN KeyPressed = FALSE;
 
     if (Screen->TimeoutSeconds > 0) {
         HaveTimeout = TRUE;
         TimeoutCountdown = Screen->TimeoutSeconds * 10;
+
+        // tick once a second while waiting for a key; if there's no timer,
+        // fall back to polling the keyboard every 100 ms
+        Status = refit_call5_wrapper(BS->CreateEvent, EVT_TIMER, 0, NULL, NULL, &TimerEvent);
+        if (!EFI_ERROR(Status)) {
+            Status = refit_call3_wrapper(BS->SetTimer, TimerEvent, TimerPeriodic, 10000000);
+            if (EFI_ERROR(Status)) {
+                refit_call1_wrapper(BS->CloseEvent, TimerEvent);
+                TimerEvent = NULL;
+            }
+        } else {
+            TimerEvent = NULL;
+        }
     }
+    WaitList[0] = ST->ConIn->WaitForKey;
+    WaitList[1] = TimerEvent;
     MenuExit = 0;
 
+    egBeginFrame();
     StyleFunc(Screen, &State, MENU_FUNCTION_INIT, NULL);
+    egEndFrame();
     IdentifyRows(&State, Screen);
     // override the starting selection with the default index, if any
     if (DefaultEntryIndex >= 0 && DefaultEntryIndex <= State.MaxIndex) {
@@ -390,38 +549,69 @@ static UINTN RunGenericMenu(IN REFIT_MENU_SCREEN *Screen, IN MENU_STYLE_FUNC Sty
     }
 
     while (!MenuExit) {
-        // update the screen
+        // update the screen; everything painted in one pass is presented together
+        egBeginFrame();
         if (State.PaintAll) {
             StyleFunc(Screen, &State, MENU_FUNCTION_PAINT_ALL, NULL);
             State.PaintAll = FALSE;
+            ShownCountdown = 0;
         } else if (State.PaintSelection) {
             StyleFunc(Screen, &State, MENU_FUNCTION_PAINT_SELECTION, NULL);
             State.PaintSelection = FALSE;
         }
 
-        if (HaveTimeout) {
-            TimeoutMessage = PoolPrint(L"%s in %d seconds", Screen->TimeoutText, (TimeoutCountdown + 5) / 10);
+        // the message only changes once a second, so only repaint it then
+        if (HaveTimeout && (TimeoutCountdown + 5) / 10 != ShownCountdown) {
+            ShownCountdown = (TimeoutCountdown + 5) / 10;
+            TimeoutMessage = PoolPrint(L"%s in %d seconds", Screen->TimeoutText, ShownCountdown);
             StyleFunc(Screen, &State, MENU_FUNCTION_PAINT_TIMEOUT, TimeoutMessage);
             FreePool(TimeoutMessage);
         }
+        egEndFrame();
+        if (FirstPaintTimestamp == 0)
+            FirstPaintTimestamp = ReadTimestampCounter();
+        if (KeyTimestamp != 0) {
+            RecordKeyLatency(ReadTimestampCounter() - KeyTimestamp);
+            KeyTimestamp = 0;
+        }
 
         // read key press (and wait for it if applicable)
         Status = refit_call2_wrapper(ST->ConIn->ReadKeyStroke, ST->ConIn, &key);
         if (Status == EFI_NOT_READY) {
-            if (HaveTimeout && TimeoutCountdown == 0) {
-                // timeout expired
+            if (HaveTimeout && TimeoutCountdown == 0 && !IdlePending) {
+                // timeout expired (but not before the menu is complete)
                 MenuExit = MENU_EXIT_TIMEOUT;
                 break;
-            } else if (HaveTimeout) {
+            } else if (IdlePending || IconsPending) {
+                // do deferred work instead of waiting, counting any timer tick that went by
+                if (IdlePending) {
+                    OldCount = Screen->EntryCount;
+                    IdlePending = RunIdleFunc(Screen, StyleFunc, &State, KeyPressed);
+                    if (Screen->EntryCount != OldCount)
+                        IconsPending = TRUE;
+                } else {
+                    IconsPending = LoadNextPendingIcon(Screen, &State);
+                }
+                if (HaveTimeout && TimerEvent != NULL &&
+                    refit_call1_wrapper(BS->CheckEvent, TimerEvent) == EFI_SUCCESS)
+                    TimeoutCountdown = (TimeoutCountdown > 10) ? TimeoutCountdown - 10 : 0;
+            } else if (HaveTimeout && TimerEvent == NULL) {
                 refit_call1_wrapper(BS->Stall, 100000);
                 TimeoutCountdown--;
-            } else
-                refit_call3_wrapper(BS->WaitForEvent, 1, &ST->ConIn->WaitForKey, &index);
+            } else {
+                Status = refit_call3_wrapper(BS->WaitForEvent, HaveTimeout ? 2 : 1, WaitList, &index);
+                if (!EFI_ERROR(Status) && index == 1)
+                    TimeoutCountdown = (TimeoutCountdown > 10) ? TimeoutCountdown - 10 : 0;
+            }
             continue;
         }
+        KeyTimestamp = ReadTimestampCounter();
+        KeyPressed = TRUE;
         if (HaveTimeout) {
             // the user pressed a key, cancel the timeout
+            egBeginFrame();
             StyleFunc(Screen, &State, MENU_FUNCTION_PAINT_TIMEOUT, L"");
+            egEndFrame();
             HaveTimeout = FALSE;
         }
 
@@ -458,6 +648,9 @@ static UINTN RunGenericMenu(IN REFIT_MENU_SCREEN *Screen, IN MENU_STYLE_FUNC Sty
             case SCAN_F2:
                 MenuExit = MENU_EXIT_DETAILS;
                 break;
+            case SCAN_F9:
+                SaveCallStats();
+                break;
             case SCAN_F10:
                 egScreenShot();
                 break;
@@ -483,6 +676,8 @@ static UINTN RunGenericMenu(IN REFIT_MENU_SCREEN *Screen, IN MENU_STYLE_FUNC Sty
         }
     }
 
+    if (TimerEvent != NULL)
+        refit_call1_wrapper(BS->CloseEvent, TimerEvent);
     StyleFunc(Screen, &State, MENU_FUNCTION_CLEANUP, NULL);
 
     if (ChosenEntry)
@@ -607,6 +802,130 @@ static VOID TextMenuStyle(IN REFIT_MENU_SCREEN *Screen, IN SCROLL_STATE *State,
     }
 }
 
+//
+// text label cache
+//
+
+// Menu text is drawn as fixed-width labels. The same few labels get drawn
+// over and over as the selection moves, so rendered labels are kept,
+// keyed by their text and everything else that affects their appearance,
+// until they exceed TEXT_LABEL_BUDGET bytes; the least recently used ones
+// are then dropped.
+
+#define TEXT_LABEL_BUDGET (512 * 1024)
+
+typedef struct _text_label {
+    CHAR16      *Text;
+    UINTN       SelectedWidth;      // width of the selection bar, or 0
+    BOOLEAN     Centered;
+    EG_PIXEL    Background;
+    EG_PIXEL    Selection;
+    EG_IMAGE    *Image;
+    UINTN       LastUse;
+    struct _text_label *Next;
+} TEXT_LABEL;
+
+static TEXT_LABEL *TextLabels = NULL;
+static UINTN TextLabelBytes = 0;
+static UINTN TextLabelClock = 0;
+
+static VOID FreeTextLabel(IN TEXT_LABEL *Label)
+{
+    TextLabelBytes -= Label->Image->Width * Label->Image->Height * sizeof(EG_PIXEL);
+    egFreeImage(Label->Image);
+    FreePool(Label->Text);
+    FreePool(Label);
+}
+
+// Renders a label; Centered text is centered without margins, otherwise
+// the text starts at TEXT_XMARGIN and a selection bar SelectedWidth pixels
+// wide is drawn behind it.
+static EG_IMAGE * RenderTextLabel(IN CHAR16 *Text, IN UINTN SelectedWidth, IN BOOLEAN Centered)
+{
+    EG_IMAGE    *Image;
+    UINTN       TextWidth, TextPosX, TextPosY;
+    EG_PIXEL    *TextBackground = &MenuBackgroundPixel;
+
+    Image = egCreateFilledImage(LAYOUT_TEXT_WIDTH, TEXT_LINE_HEIGHT, FALSE, &MenuBackgroundPixel);
+    if (Image == NULL)
+        return NULL;
+
+    egMeasureText(Text, &TextWidth, NULL);
+    if (Centered) {
+        TextPosX = (TextWidth > Image->Width) ? 0 : (Image->Width - TextWidth) / 2;
+        TextPosY = 0;
+    } else {
+        TextPosX = TEXT_XMARGIN;
+        TextPosY = TEXT_YMARGIN;
+        if (SelectedWidth > 0) {
+            // draw selection bar background
+            egFillImageArea(Image, 0, 0, SelectedWidth, Image->Height, &SelectionBackgroundPixel);
+            TextBackground = &SelectionBackgroundPixel;
+        }
+    }
+
+    // the glyphs can be copied instead of blended if they all land on one color
+    if (SelectedWidth == 0 || Centered || TextPosX + TextWidth <= SelectedWidth)
+        egRenderTextOnBackground(Text, Image, TextPosX, TextPosY, TextBackground);
+    else
+        egRenderText(Text, Image, TextPosX, TextPosY);
+    return Image;
+} // static EG_IMAGE * RenderTextLabel()
+
+// Returns the label for Text, rendering it if it's not cached. The label
+// belongs to the cache and must not be freed.
+static EG_IMAGE * GetTextLabel(IN CHAR16 *Text, IN UINTN SelectedWidth, IN BOOLEAN Centered)
+{
+    TEXT_LABEL  *Label, **Link, **OldestLink;
+
+    for (Label = TextLabels; Label != NULL; Label = Label->Next) {
+        if (Label->SelectedWidth == SelectedWidth && Label->Centered == Centered &&
+            CompareMem(&Label->Background, &MenuBackgroundPixel, sizeof(EG_PIXEL)) == 0 &&
+            CompareMem(&Label->Selection, &SelectionBackgroundPixel, sizeof(EG_PIXEL)) == 0 &&
+            StrCmp(Label->Text, Text) == 0) {
+            Label->LastUse = ++TextLabelClock;
+            return Label->Image;
+        }
+    }
+
+    Label = AllocateZeroPool(sizeof(TEXT_LABEL));
+    if (Label == NULL)
+        return NULL;
+    Label->Text = StrDuplicate(Text);
+    Label->Image = RenderTextLabel(Text, SelectedWidth, Centered);
+    if (Label->Text == NULL || Label->Image == NULL) {
+        if (Label->Text != NULL)
+            FreePool(Label->Text);
+        egFreeImage(Label->Image);
+        FreePool(Label);
+        return NULL;
+    }
+    Label->SelectedWidth = SelectedWidth;
+    Label->Centered = Centered;
+    Label->Background = MenuBackgroundPixel;
+    Label->Selection = SelectionBackgroundPixel;
+    Label->LastUse = ++TextLabelClock;
+    Label->Next = TextLabels;
+    TextLabels = Label;
+    TextLabelBytes += Label->Image->Width * Label->Image->Height * sizeof(EG_PIXEL);
+
+    // evict least recently used labels, but never the new one
+    while (TextLabelBytes > TEXT_LABEL_BUDGET) {
+        OldestLink = NULL;
+        for (Link = &TextLabels->Next; *Link != NULL; Link = &((*Link)->Next)) {
+            if (OldestLink == NULL || (*Link)->LastUse < (*OldestLink)->LastUse)
+                OldestLink = Link;
+        }
+        if (OldestLink == NULL)
+            break;
+        Label = *OldestLink;
+        *OldestLink = Label->Next;
+        FreeTextLabel(Label);
+    }
+
+    return TextLabels->Image;
+} // static EG_IMAGE * GetTextLabel()
+
 //
 // graphical generic style
 //
@@ -614,19 +933,11 @@ static VOID TextMenuStyle(IN REFIT_MENU_SCREEN *Screen, IN SCROLL_STATE *State,
 
 static VOID DrawMenuText(IN CHAR16 *Text, IN UINTN SelectedWidth, IN UINTN XPos, IN UINTN YPos)
 {
-    if (TextBuffer == NULL)
-        TextBuffer = egCreateImage(LAYOUT_TEXT_WIDTH, TEXT_LINE_HEIGHT, FALSE);
-
-    egFillImage(TextBuffer, &MenuBackgroundPixel);
-    if (SelectedWidth > 0) {
-        // draw selection bar background
-        egFillImageArea(TextBuffer, 0, 0, SelectedWidth, TextBuffer->Height,
-                        &SelectionBackgroundPixel);
-    }
+    EG_IMAGE *Label;
 
-    // render the text
-    egRenderText(Text, TextBuffer, TEXT_XMARGIN, TEXT_YMARGIN);
-    BltImage(TextBuffer, XPos, YPos);
+    Label = GetTextLabel(Text, SelectedWidth, FALSE);
+    if (Label != NULL)
+        BltImage(Label, XPos, YPos);
 }
 
 // Displays sub-menus
@@ -713,34 +1024,32 @@ static VOID GraphicsMenuStyle(IN REFIT_MENU_SCREEN *Screen, IN SCROLL_STATE *Sta
 // graphical main menu style
 //
 
+// Draws a main-menu tile. The composited tile is kept with the entry, so
+// moving the selection back and forth only has to blit it.
 static VOID DrawMainMenuEntry(REFIT_MENU_ENTRY *Entry, BOOLEAN selected, UINTN XPos, UINTN YPos)
 {
-    UINTN ImageNum;
+    UINTN ImageNum, TileNum;
 
     ImageNum = ((Entry->Row == 0) ? 0 : 2) + (selected ? 0 : 1);
-    if (SelectionImages != NULL)
-        BltImageCompositeBadge(SelectionImages[ImageNum],
-                               Entry->Image, Entry->BadgeImage, XPos, YPos);
+    TileNum = selected ? 0 : 1;
+    if (Entry->TileGeneration != TileGeneration) {
+        FreeMenuEntryTiles(Entry);
+        Entry->TileGeneration = TileGeneration;
+    }
+    if (Entry->TileImages[TileNum] == NULL)
+        Entry->TileImages[TileNum] = ComposeImageWithBadge(SelectionImages[ImageNum],
+                                                           Entry->Image, Entry->BadgeImage);
+    if (Entry->TileImages[TileNum] != NULL)
+        BltImage(Entry->TileImages[TileNum], XPos, YPos);
 }
 
 static VOID DrawMainMenuText(IN CHAR16 *Text, IN UINTN XPos, IN UINTN YPos)
 {
-    UINTN TextWidth, TextPosX;
-
-    if (TextBuffer == NULL)
-        TextBuffer = egCreateImage(LAYOUT_TEXT_WIDTH, TEXT_LINE_HEIGHT, FALSE);
+    EG_IMAGE *Label;
 
-    egFillImage(TextBuffer, &MenuBackgroundPixel);
-
-    // render the text
-    egMeasureText(Text, &TextWidth, NULL);
-    if (TextWidth > TextBuffer->Width)
-       TextPosX = 0;
-    else
-       TextPosX = (TextBuffer->Width - TextWidth) / 2;
-    egRenderText(Text, TextBuffer, TextPosX, 0);
-//    egRenderText(Text, TextBuffer, (TextBuffer->Width - TextWidth) >> 1, 0);
-    BltImage(TextBuffer, XPos, YPos);
+    Label = GetTextLabel(Text, 0, TRUE);
+    if (Label != NULL)
+        BltImage(Label, XPos, YPos);
 }
 
 static VOID PaintAll(IN REFIT_MENU_SCREEN *Screen, IN SCROLL_STATE *State, UINTN *itemPosX,
@@ -802,16 +1111,17 @@ static VOID PaintSelection(IN REFIT_MENU_SCREEN *Screen, IN SCROLL_STATE *State,
 // edge if Alignment == ALIGN_LEFT, and along the right edge if
 // Alignment == ALIGN_RIGHT
 static VOID PaintIcon(IN EG_EMBEDDED_IMAGE *BuiltInIcon, IN CHAR16 *ExternalFilename, UINTN PosX, UINTN PosY, UINTN Alignment) {
-   EG_IMAGE *Icon = NULL;
+   EG_IMAGE *Icon;
 
-   if (FileExists(SelfDir, ExternalFilename))
-      Icon = egLoadIcon(SelfDir, ExternalFilename, 48);
+   // LoadIcns() remembers missing files, so no FileExists() probe is needed
+   Icon = LoadIcns(SelfDir, ExternalFilename, 48);
    if (Icon == NULL)
-      Icon = egPrepareEmbeddedImage(BuiltInIcon, TRUE);
+      Icon = egPrepareEmbeddedImage(BuiltInIcon, EG_ALPHA_PREMULTIPLIED);
    if (Icon != NULL) {
       if (Alignment == ALIGN_RIGHT)
          PosX -= Icon->Width;
       BltImageAlpha(Icon, PosX, PosY - (Icon->Height / 2), &MenuBackgroundPixel);
+      ReleaseIcon(Icon);
    }
 } // static VOID PaintIcon()
 
@@ -932,6 +1242,7 @@ UINTN RunMainMenu(IN REFIT_MENU_SCREEN *Screen, IN CHAR16* DefaultSelection, OUT
         DefaultEntryIndex = FindMenuShortcutEntry(Screen, DefaultSelection);
         // If that didn't work, should we scan more characters?  For now, no.
     }
+    MainMenuDefault = (DefaultEntryIndex == -1) ? DefaultSelection : NULL;
 
     if (AllowGraphicsMode) {
         Style = GraphicsMenuStyle;
@@ -941,7 +1252,14 @@ UINTN RunMainMenu(IN REFIT_MENU_SCREEN *Screen, IN CHAR16* DefaultSelection, OUT
     while (!MenuExit) {
         MenuExit = RunGenericMenu(Screen, MainStyle, DefaultEntryIndex, &TempChosenEntry);
         Screen->TimeoutSeconds = 0;
+        MainMenuDefault = NULL;
 
+        if (MenuExit == MENU_EXIT_DETAILS) {
+            LoadPendingIcon(TempChosenEntry);
+            GeneratePendingSubScreen(TempChosenEntry);
+            if (TempChosenEntry->SubScreen != NULL && TempChosenEntry->SubScreen->TitleImage == NULL)
+                TempChosenEntry->SubScreen->TitleImage = TempChosenEntry->Image;
+        }
         if (MenuExit == MENU_EXIT_DETAILS && TempChosenEntry->SubScreen != NULL) {
             MenuExit = RunGenericMenu(TempChosenEntry->SubScreen, Style, -1, &TempChosenEntry);
             if (MenuExit == MENU_EXIT_ESCAPE || TempChosenEntry->Tag == TAG_RETURN)
@@ -61,6 +61,14 @@
 
 #define TAG_RETURN       (99)
 
+// time from reading a key press to having painted its effect, in
+// ReadTimestampCounter() units
+typedef struct {
+   UINTN  KeyCount;
+   UINT64 TotalLatency;
+   UINT64 MaxLatency;
+} MENU_KEY_STATS;
+
 // scrolling definitions
 
 typedef struct {
@@ -89,9 +97,13 @@ struct _refit_menu_screen;
 VOID AddMenuInfoLine(IN REFIT_MENU_SCREEN *Screen, IN CHAR16 *InfoLine);
 VOID AddMenuEntry(IN REFIT_MENU_SCREEN *Screen, IN REFIT_MENU_ENTRY *Entry);
 VOID FreeMenu(IN REFIT_MENU_SCREEN *Screen);
+VOID InvalidateMenuTiles(VOID);
+VOID FreeMenuEntryTiles(IN REFIT_MENU_ENTRY *Entry);
 VOID MainMenuStyle(IN REFIT_MENU_SCREEN *Screen, IN SCROLL_STATE *State, IN UINTN Function, IN CHAR16 *ParamText);
 UINTN RunMenu(IN REFIT_MENU_SCREEN *Screen, OUT REFIT_MENU_ENTRY **ChosenEntry);
 UINTN RunMainMenu(IN REFIT_MENU_SCREEN *Screen, IN CHAR16* DefaultSelection, OUT REFIT_MENU_ENTRY **ChosenEntry);
+VOID GetMenuKeyStats(OUT MENU_KEY_STATS *Stats);
+UINT64 GetMenuFirstPaintTimestamp(VOID);
 
 #endif
 
@@ -0,0 +1,415 @@
+/*
+ * refind/scancache.c
+ * Persistent cache of boot loader scan results
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// With scan_cache set in refind.conf, the boot loaders that ScanEfiFiles()
+// finds on each volume are saved in a file in rEFInd's own directory, along
+// with the icon and Linux options probes made for them. On the next boot, a
+// volume whose record is still valid has its loaders added straight from
+// the cache, without reading its directories or probing its files.
+//
+// A volume's record is keyed by its device path and name. It holds a
+// "stamp" (modification time and size, or absence) for every directory that
+// was scanned or probed, for every loader and for every Linux options file,
+// and it's reused only if all of those stamps still match. The cache file
+// also records the scan settings, and is ignored if they've changed. The
+// stamps can't catch everything (some OSes don't update a FAT directory's
+// time when a file is added to it), so pressing Esc in the main menu
+// rescans all volumes and rewrites the cache.
+//
+// The file is a UTF-16 text file in the token format of refind.conf:
+//   refind_scan_cache <version> "<settings>"
+//   volume "<key>"
+//   stamp "<path>" "<stamp>"
+//   loader "<path>" "<title>" <flags> "<options>"
+// Strings that contain quotes can't be written this way, so volumes with
+// such names or options simply aren't cached.
+
+#include "global.h"
+#include "lib.h"
+#include "config.h"
+#include "scancache.h"
+#include "refit_call_wrapper.h"
+
+#define SCAN_CACHE_FILE_NAME       L"refind_scan.cache"
+#define SCAN_CACHE_VERSION         L"1"
+
+#define SCAN_CACHE_HAS_TITLE       (0x01)
+#define SCAN_CACHE_HAS_ICON        (0x02)
+#define SCAN_CACHE_HAS_OPTIONS     (0x04)
+
+// loader paths are copied into the CHAR16 FileName[256] buffers of the
+// scanning code, so longer ones mean the file is damaged
+#define SCAN_CACHE_MAX_PATH        (256)
+
+typedef struct {
+   CHAR16   *Path;
+   CHAR16   *Stamp;
+} SCAN_CACHE_STAMP;
+
+typedef struct {
+   CHAR16             *Key;
+   UINTN              StampCount;
+   SCAN_CACHE_STAMP   **Stamps;
+   UINTN              LoaderCount;
+   SCAN_CACHE_LOADER  **Loaders;
+   BOOLEAN            Uncacheable;
+} SCAN_CACHE_VOLUME;
+
+static BOOLEAN            CacheActive = FALSE;
+static BOOLEAN            CacheChanged = FALSE;
+static CHAR16             *CacheConfigKey = NULL;
+static UINTN              OldVolumeCount = 0;     // read from the cache file
+static SCAN_CACHE_VOLUME  **OldVolumes = NULL;
+static UINTN              NewVolumeCount = 0;     // to be written back
+static SCAN_CACHE_VOLUME  **NewVolumes = NULL;
+static SCAN_CACHE_VOLUME  *Recording = NULL;      // volume being scanned
+static EFI_FILE           *RecordingRootDir = NULL;
+
+static VOID FreeScanCacheVolume(IN SCAN_CACHE_VOLUME *CacheVolume) {
+   UINTN i;
+
+   for (i = 0; i < CacheVolume->StampCount; i++) {
+      FreePool(CacheVolume->Stamps[i]->Path);
+      FreePool(CacheVolume->Stamps[i]->Stamp);
+   } // for
+   FreeList((VOID ***) &CacheVolume->Stamps, &CacheVolume->StampCount);
+   for (i = 0; i < CacheVolume->LoaderCount; i++) {
+      FreePool(CacheVolume->Loaders[i]->LoaderPath);
+      if (CacheVolume->Loaders[i]->Title != NULL)
+         FreePool(CacheVolume->Loaders[i]->Title);
+      if (CacheVolume->Loaders[i]->LoadOptions != NULL)
+         FreePool(CacheVolume->Loaders[i]->LoadOptions);
+   } // for
+   FreeList((VOID ***) &CacheVolume->Loaders, &CacheVolume->LoaderCount);
+   FreePool(CacheVolume->Key);
+   FreePool(CacheVolume);
+} // static VOID FreeScanCacheVolume()
+
+static VOID FreeScanCacheVolumes(IN OUT SCAN_CACHE_VOLUME ***List, IN OUT UINTN *Count) {
+   UINTN i;
+
+   for (i = 0; i < *Count; i++) {
+      if ((*List)[i] != NULL)
+         FreeScanCacheVolume((*List)[i]);
+   } // for
+   if (*List != NULL)
+      FreePool(*List);
+   *List = NULL;
+   *Count = 0;
+} // static VOID FreeScanCacheVolumes()
+
+static VOID AddStamp(IN SCAN_CACHE_VOLUME *CacheVolume, IN CHAR16 *Path, IN CHAR16 *Stamp) {
+   SCAN_CACHE_STAMP *NewStamp;
+
+   NewStamp = AllocateZeroPool(sizeof(SCAN_CACHE_STAMP));
+   if (NewStamp != NULL) {
+      NewStamp->Path = StrDuplicate(Path);
+      NewStamp->Stamp = Stamp;
+      AddListElement((VOID ***) &CacheVolume->Stamps, &CacheVolume->StampCount, NewStamp);
+   } // if
+} // static VOID AddStamp()
+
+static VOID AddLoader(IN SCAN_CACHE_VOLUME *CacheVolume, IN CHAR16 *LoaderPath, IN CHAR16 *Title,
+                      IN BOOLEAN HasIcon, IN CHAR16 *LoadOptions) {
+   SCAN_CACHE_LOADER *Loader;
+
+   Loader = AllocateZeroPool(sizeof(SCAN_CACHE_LOADER));
+   if (Loader != NULL) {
+      Loader->LoaderPath = StrDuplicate(LoaderPath);
+      Loader->Title = (Title != NULL) ? StrDuplicate(Title) : NULL;
+      Loader->HasIcon = HasIcon;
+      Loader->LoadOptions = (LoadOptions != NULL) ? StrDuplicate(LoadOptions) : NULL;
+      AddListElement((VOID ***) &CacheVolume->Loaders, &CacheVolume->LoaderCount, Loader);
+   } // if
+} // static VOID AddLoader()
+
+// Returns TRUE if String can be written to the cache file.
+static BOOLEAN IsCacheableString(IN CHAR16 *String) {
+   if (String != NULL) {
+      while (*String) {
+         if (*String == '"' || *String == '\r' || *String == '\n')
+            return FALSE;
+         String++;
+      } // while
+   } // if
+   return TRUE;
+} // static BOOLEAN IsCacheableString()
+
+// Returns a string that identifies Volume across boots.
+static CHAR16 * GetVolumeKey(IN REFIT_VOLUME *Volume) {
+   CHAR16 *DevicePathString, *Key;
+
+   DevicePathString = DevicePathToStr(Volume->DevicePath);
+   Key = PoolPrint(L"%s|%s%s", DevicePathString, Volume->VolName, (Volume == SelfVolume) ? L"|self" : L"");
+   FreePool(DevicePathString);
+   return Key;
+} // static CHAR16 * GetVolumeKey()
+
+// Returns the current stamp of a file or directory: its modification time
+// and size, or "-" if it doesn't exist.
+static CHAR16 * GetStamp(IN EFI_FILE *RootDir, IN CHAR16 *Path) {
+   EFI_STATUS       Status;
+   EFI_FILE_HANDLE  FileHandle;
+   EFI_FILE_INFO    *FileInfo;
+   CHAR16           *Stamp;
+
+   Status = refit_call5_wrapper(RootDir->Open, RootDir, &FileHandle, Path, EFI_FILE_MODE_READ, 0);
+   if (EFI_ERROR(Status))
+      return StrDuplicate(L"-");
+   FileInfo = LibFileInfo(FileHandle);
+   refit_call1_wrapper(FileHandle->Close, FileHandle);
+   if (FileInfo == NULL)
+      return StrDuplicate(L"?");   // never matches a recorded stamp
+   Stamp = PoolPrint(L"%d.%d.%d.%d.%d.%d.%d.%ld",
+                     FileInfo->ModificationTime.Year, FileInfo->ModificationTime.Month,
+                     FileInfo->ModificationTime.Day, FileInfo->ModificationTime.Hour,
+                     FileInfo->ModificationTime.Minute, FileInfo->ModificationTime.Second,
+                     FileInfo->ModificationTime.Nanosecond, FileInfo->FileSize);
+   FreePool(FileInfo);
+   return Stamp;
+} // static CHAR16 * GetStamp()
+
+// Reads the cache file into OldVolumes. Leaves OldVolumes empty if the file
+// doesn't exist, or was written by another version or with other settings.
+static VOID LoadScanCache(VOID) {
+   EFI_STATUS         Status;
+   REFIT_FILE         File;
+   CHAR16             **TokenList;
+   UINTN              TokenCount, Flags;
+   SCAN_CACHE_VOLUME  *CacheVolume = NULL;
+   BOOLEAN            Valid = FALSE;
+
+   if (!FileExists(SelfDir, SCAN_CACHE_FILE_NAME))
+      return;
+   Status = ReadFile(SelfDir, SCAN_CACHE_FILE_NAME, &File);
+   if (EFI_ERROR(Status))
+      return;
+
+   TokenCount = ReadTokenLine(&File, &TokenList);
+   if ((TokenCount == 3) && (StriCmp(TokenList[0], L"refind_scan_cache") == 0) &&
+       (StrCmp(TokenList[1], SCAN_CACHE_VERSION) == 0) && (StrCmp(TokenList[2], CacheConfigKey) == 0))
+      Valid = TRUE;
+   FreeTokenLine(&TokenList, &TokenCount);
+
+   while (Valid && ((TokenCount = ReadTokenLine(&File, &TokenList)) > 0)) {
+      if ((StriCmp(TokenList[0], L"volume") == 0) && (TokenCount == 2)) {
+         CacheVolume = AllocateZeroPool(sizeof(SCAN_CACHE_VOLUME));
+         if (CacheVolume != NULL) {
+            CacheVolume->Key = StrDuplicate(TokenList[1]);
+            AddListElement((VOID ***) &OldVolumes, &OldVolumeCount, CacheVolume);
+         } // if
+      } else if ((StriCmp(TokenList[0], L"stamp") == 0) && (TokenCount == 3) && (CacheVolume != NULL)) {
+         AddStamp(CacheVolume, TokenList[1], StrDuplicate(TokenList[2]));
+      } else if ((StriCmp(TokenList[0], L"loader") == 0) && (TokenCount == 5) && (CacheVolume != NULL) &&
+                 (StrLen(TokenList[1]) < SCAN_CACHE_MAX_PATH)) {
+         Flags = Atoi(TokenList[3]);
+         AddLoader(CacheVolume, TokenList[1], (Flags & SCAN_CACHE_HAS_TITLE) ? TokenList[2] : NULL,
+                   (Flags & SCAN_CACHE_HAS_ICON) ? TRUE : FALSE,
+                   (Flags & SCAN_CACHE_HAS_OPTIONS) ? TokenList[4] : NULL);
+      } else {
+         Valid = FALSE;   // damaged or unknown; rescan everything
+      } // if/else
+      FreeTokenLine(&TokenList, &TokenCount);
+   } // while
+
+   if (!Valid)
+      FreeScanCacheVolumes(&OldVolumes, &OldVolumeCount);
+   FreeFile(&File);
+} // static VOID LoadScanCache()
+
+// Prepares for a scan. ConfigKey summarizes the settings that affect the
+// results; if Reuse is FALSE, the existing cache is ignored and every volume
+// is scanned (and recorded) afresh. Does nothing unless scan_cache is set.
+VOID ScanCacheBegin(IN CHAR16 *ConfigKey, IN BOOLEAN Reuse) {
+   FreeScanCacheVolumes(&OldVolumes, &OldVolumeCount);
+   FreeScanCacheVolumes(&NewVolumes, &NewVolumeCount);
+   if (CacheConfigKey != NULL)
+      FreePool(CacheConfigKey);
+   CacheConfigKey = NULL;
+   Recording = NULL;
+   CacheChanged = FALSE;
+   CacheActive = GlobalConfig.ScanCache && (SelfDir != NULL) && IsCacheableString(ConfigKey);
+   if (!CacheActive)
+      return;
+
+   CacheConfigKey = StrDuplicate(ConfigKey);
+   if (Reuse)
+      LoadScanCache();
+} // VOID ScanCacheBegin()
+
+// Looks for a valid cached record of Volume. If there is one, returns TRUE
+// and the loaders it lists, which stay valid until the next ScanCacheBegin().
+BOOLEAN ScanCacheLookup(IN REFIT_VOLUME *Volume, OUT UINTN *LoaderCount, OUT SCAN_CACHE_LOADER ***Loaders) {
+   SCAN_CACHE_VOLUME  *CacheVolume = NULL;
+   CHAR16             *Key, *Stamp;
+   UINTN              i;
+   BOOLEAN            Valid;
+
+   if (!CacheActive || (Volume->RootDir == NULL))
+      return FALSE;
+
+   Key = GetVolumeKey(Volume);
+   for (i = 0; i < OldVolumeCount; i++) {
+      if ((OldVolumes[i] != NULL) && (StrCmp(OldVolumes[i]->Key, Key) == 0)) {
+         CacheVolume = OldVolumes[i];
+         OldVolumes[i] = NULL;   // each record is used at most once
+         break;
+      } // if
+   } // for
+   FreePool(Key);
+   if (CacheVolume == NULL) {
+      CacheChanged = TRUE;
+      return FALSE;
+   } // if
+
+   Valid = TRUE;
+   for (i = 0; (i < CacheVolume->StampCount) && Valid; i++) {
+      Stamp = GetStamp(Volume->RootDir, CacheVolume->Stamps[i]->Path);
+      if (StrCmp(Stamp, CacheVolume->Stamps[i]->Stamp) != 0)
+         Valid = FALSE;
+      FreePool(Stamp);
+   } // for
+   if (!Valid) {
+      FreeScanCacheVolume(CacheVolume);
+      CacheChanged = TRUE;
+      return FALSE;
+   } // if
+
+   AddListElement((VOID ***) &NewVolumes, &NewVolumeCount, CacheVolume);
+   *LoaderCount = CacheVolume->LoaderCount;
+   *Loaders = CacheVolume->Loaders;
+   return TRUE;
+} // BOOLEAN ScanCacheLookup()
+
+// Starts recording the scan of Volume; see ScanCacheStamp() and
+// ScanCacheAddLoader(). The record is kept by ScanCacheEndVolume().
+VOID ScanCacheStartVolume(IN REFIT_VOLUME *Volume) {
+   if (!CacheActive || (Volume->RootDir == NULL))
+      return;
+
+   Recording = AllocateZeroPool(sizeof(SCAN_CACHE_VOLUME));
+   if (Recording != NULL) {
+      Recording->Key = GetVolumeKey(Volume);
+      Recording->Uncacheable = !IsCacheableString(Recording->Key);
+      RecordingRootDir = Volume->RootDir;
+   } // if
+} // VOID ScanCacheStartVolume()
+
+// Records the current stamp of a file or directory (relative to the root
+// of the volume being recorded) whose contents affect the scan results.
+VOID ScanCacheStamp(IN CHAR16 *Path) {
+   if ((Recording == NULL) || (Path == NULL))
+      return;
+
+   if (!IsCacheableString(Path))
+      Recording->Uncacheable = TRUE;
+   else
+      AddStamp(Recording, Path, GetStamp(RecordingRootDir, Path));
+} // VOID ScanCacheStamp()
+
+// Records a loader found on the volume being recorded, along with the
+// results of probing for its icon and (if IsLinux) its options. The loader
+// file itself and any Linux options file next to it are stamped too.
+VOID ScanCacheAddLoader(IN CHAR16 *LoaderPath, IN CHAR16 *Title, IN BOOLEAN HasIcon,
+                        IN CHAR16 *LoadOptions, IN BOOLEAN IsLinux) {
+   CHAR16  *Path, *OptionsFileName;
+   UINTN   i = 0;
+
+   if (Recording == NULL)
+      return;
+
+   if (!IsCacheableString(Title) || !IsCacheableString(LoadOptions))
+      Recording->Uncacheable = TRUE;
+   AddLoader(Recording, LoaderPath, Title, HasIcon, LoadOptions);
+   ScanCacheStamp(LoaderPath);
+   if (IsLinux) {
+      while ((OptionsFileName = FindCommaDelimited(LINUX_OPTIONS_FILENAMES, i++)) != NULL) {
+         Path = FindPath(LoaderPath);
+         MergeStrings(&Path, OptionsFileName, L'\\');
+         ScanCacheStamp(Path);
+         FreePool(Path);
+         FreePool(OptionsFileName);
+      } // while
+   } // if
+} // VOID ScanCacheAddLoader()
+
+// Finishes recording the current volume.
+VOID ScanCacheEndVolume(VOID) {
+   if (Recording == NULL)
+      return;
+
+   if (Recording->Uncacheable)
+      FreeScanCacheVolume(Recording);
+   else
+      AddListElement((VOID ***) &NewVolumes, &NewVolumeCount, Recording);
+   Recording = NULL;
+   CacheChanged = TRUE;
+} // VOID ScanCacheEndVolume()
+
+// Appends a line to the cache file text, and frees the line.
+static VOID AppendCacheLine(IN OUT CHAR16 **Text, IN CHAR16 *Line) {
+   MergeStrings(Text, Line, L'\n');
+   FreePool(Line);
+} // static VOID AppendCacheLine()
+
+// Writes the records of the volumes that were scanned or reused since
+// ScanCacheBegin() to the cache file, if anything has changed.
+VOID ScanCacheSave(VOID) {
+   SCAN_CACHE_VOLUME  *CacheVolume;
+   SCAN_CACHE_LOADER  *Loader;
+   CHAR16             *Text = NULL;
+   UINTN              i, j, Flags;
+
+   for (i = 0; i < OldVolumeCount; i++) {
+      if (OldVolumes[i] != NULL)
+         CacheChanged = TRUE;   // a volume that's gone (or wasn't scanned)
+   } // for
+   if (!CacheActive || !CacheChanged)
+      return;
+
+   AppendCacheLine(&Text, PoolPrint(L"refind_scan_cache %s \"%s\"", SCAN_CACHE_VERSION, CacheConfigKey));
+   for (i = 0; i < NewVolumeCount; i++) {
+      CacheVolume = NewVolumes[i];
+      AppendCacheLine(&Text, PoolPrint(L"volume \"%s\"", CacheVolume->Key));
+      for (j = 0; j < CacheVolume->StampCount; j++) {
+         AppendCacheLine(&Text, PoolPrint(L"stamp \"%s\" \"%s\"", CacheVolume->Stamps[j]->Path,
+                                          CacheVolume->Stamps[j]->Stamp));
+      } // for
+      for (j = 0; j < CacheVolume->LoaderCount; j++) {
+         Loader = CacheVolume->Loaders[j];
+         Flags = ((Loader->Title != NULL) ? SCAN_CACHE_HAS_TITLE : 0) |
+                 (Loader->HasIcon ? SCAN_CACHE_HAS_ICON : 0) |
+                 ((Loader->LoadOptions != NULL) ? SCAN_CACHE_HAS_OPTIONS : 0);
+         AppendCacheLine(&Text, PoolPrint(L"loader \"%s\" \"%s\" %d \"%s\"", Loader->LoaderPath,
+                                          (Loader->Title != NULL) ? Loader->Title : L"", Flags,
+                                          (Loader->LoadOptions != NULL) ? Loader->LoadOptions : L""));
+      } // for
+   } // for
+   MergeStrings(&Text, L"", L'\n');
+   if (Text == NULL)
+      return;
+
+   if (!EFI_ERROR(SaveTextFile(SelfDir, SCAN_CACHE_FILE_NAME, Text, TRUE)))
+      CacheChanged = FALSE;
+   FreePool(Text);
+} // VOID ScanCacheSave()
+
+/* EOF */
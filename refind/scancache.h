@@ -0,0 +1,48 @@
+/*
+ * refind/scancache.h
+ * Persistent boot loader scan cache header file
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __SCANCACHE_H_
+#define __SCANCACHE_H_
+
+#include "efi.h"
+#include "global.h"
+
+// What the scan found out about one boot loader, apart from what
+// SetLoaderDefaults() works out from its path alone.
+typedef struct {
+   CHAR16   *LoaderPath;
+   CHAR16   *Title;        // as passed to AddLoaderEntry(); NULL for the path
+   BOOLEAN  HasIcon;       // a .icns file named after the loader exists
+   CHAR16   *LoadOptions;  // Linux kernel options; NULL if none were found
+} SCAN_CACHE_LOADER;
+
+VOID ScanCacheBegin(IN CHAR16 *ConfigKey, IN BOOLEAN Reuse);
+BOOLEAN ScanCacheLookup(IN REFIT_VOLUME *Volume, OUT UINTN *LoaderCount, OUT SCAN_CACHE_LOADER ***Loaders);
+VOID ScanCacheStartVolume(IN REFIT_VOLUME *Volume);
+VOID ScanCacheStamp(IN CHAR16 *Path);
+VOID ScanCacheAddLoader(IN CHAR16 *LoaderPath, IN CHAR16 *Title, IN BOOLEAN HasIcon,
+                        IN CHAR16 *LoadOptions, IN BOOLEAN IsLinux);
+VOID ScanCacheEndVolume(VOID);
+VOID ScanCacheSave(VOID);
+
+#endif
+
+/* EOF */
@@ -40,7 +40,8 @@
 #include "libegint.h"
 #include "refit_call_wrapper.h"
 
-#include "egemb_refind_banner.h"
+// generated from ../include/egemb_refind_banner.h by mkegemb
+#include "egemb_refind_banner_bgra.h"
 
 // Console defines and variables
 
@@ -193,6 +194,7 @@ VOID FinishExternalScreen(VOID)
 {
     // make sure we clean up later
     GraphicsScreenDirty = TRUE;
+    egInvalidateScreen();
 
     if (haveError) {
         SwitchToText(FALSE);
@@ -217,6 +219,9 @@ static VOID DrawScreenHeader(IN CHAR16 *Title)
 {
     UINTN y;
 
+    // the console output below may land on the graphics screen
+    egInvalidateScreen();
+
     // clear to black background
     refit_call2_wrapper(ST->ConOut->SetAttribute, ST->ConOut, ATTR_BASIC);
     refit_call1_wrapper(ST->ConOut->ClearScreen, ST->ConOut);
@@ -423,7 +428,9 @@ VOID BltImageAlpha(IN EG_IMAGE *Image, IN UINTN XPos, IN UINTN YPos, IN EG_PIXEL
 //     GraphicsScreenDirty = TRUE;
 // }
 
-VOID BltImageCompositeBadge(IN EG_IMAGE *BaseImage, IN EG_IMAGE *TopImage, IN EG_IMAGE *BadgeImage, IN UINTN XPos, IN UINTN YPos)
+// Returns a copy of BaseImage with TopImage centered on it and BadgeImage
+// in the lower-right corner of TopImage, or NULL if BaseImage is NULL.
+EG_IMAGE * ComposeImageWithBadge(IN EG_IMAGE *BaseImage, IN EG_IMAGE *TopImage, IN EG_IMAGE *BadgeImage)
 {
      UINTN TotalWidth, TotalHeight, CompWidth = 0, CompHeight = 0, OffsetX = 0, OffsetY = 0;
      EG_IMAGE *CompImage = NULL;
@@ -455,6 +462,17 @@ VOID BltImageCompositeBadge(IN EG_IMAGE *BaseImage, IN EG_IMAGE *TopImage, IN EG
          egComposeImage(CompImage, BadgeImage, OffsetX, OffsetY);
      }
 
+     return CompImage;
+} // EG_IMAGE * ComposeImageWithBadge()
+
+VOID BltImageCompositeBadge(IN EG_IMAGE *BaseImage, IN EG_IMAGE *TopImage, IN EG_IMAGE *BadgeImage, IN UINTN XPos, IN UINTN YPos)
+{
+     EG_IMAGE *CompImage;
+
+     CompImage = ComposeImageWithBadge(BaseImage, TopImage, BadgeImage);
+     if (CompImage == NULL)
+         return;
+
      // blit to screen and clean up
      egDrawImage(CompImage, XPos, YPos);
      egFreeImage(CompImage);
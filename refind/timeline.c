@@ -0,0 +1,210 @@
+/*
+ * refind/timeline.c
+ * Timeline of boot phases, for finding out where start-up time goes
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+// efi_main() and the scanning code mark the start and end of each phase of
+// start-up with TimelineBegin() and TimelineEnd(). The times come from
+// ReadTimestampCounter(), and are converted to milliseconds with
+// TimestampTicksPerMs(), which calibrates the counter against BS->Stall().
+// Phases nest, so (for instance) the scan of each volume shows up inside
+// the scan pass that found it.
+//
+// The About screen lists the phases. With log_timeline set in refind.conf,
+// they're also written to refind_timeline.log in rEFInd's directory once the
+// main menu has been left, as ASCII lines of the form
+//   <start ms> <duration ms> <name>
+// with times counted from rEFInd's start and names indented by nesting level.
+
+#include "global.h"
+#include "lib.h"
+#include "menu.h"
+#include "timeline.h"
+#include "refit_call_wrapper.h"
+#include "../libeg/libeg.h"
+
+#define TIMELINE_FILE_NAME     L"refind_timeline.log"
+#define TIMELINE_MAX_SPANS     (128)
+
+// the number of spans the About screen shows; the log has them all
+#define TIMELINE_MAX_INFO_LINES (24)
+
+typedef struct {
+   CHAR16   *Name;
+   UINT64   Start;
+   UINT64   End;     // 0 while the span is open
+   UINTN    Depth;
+} TIMELINE_SPAN;
+
+static TIMELINE_SPAN Spans[TIMELINE_MAX_SPANS];
+static UINTN         SpanCount = 0;
+static UINTN         OpenSpans = 0;
+static UINTN         DroppedSpans = 0;
+static UINTN         SavedSpanCount = 0;
+static UINT64        TimelineOrigin = 0;
+
+// Sets the time that the other times are counted from.
+VOID TimelineStart(IN UINT64 Origin) {
+   TimelineOrigin = Origin;
+} // VOID TimelineStart()
+
+static UINTN AddSpan(IN CHAR16 *Name, IN UINT64 Start, IN UINT64 End, IN UINTN Depth) {
+   if (Name == NULL || SpanCount >= TIMELINE_MAX_SPANS) {
+      DroppedSpans++;
+      if (Name != NULL)
+         FreePool(Name);
+      return TIMELINE_NO_SPAN;
+   }
+   Spans[SpanCount].Name = Name;
+   Spans[SpanCount].Start = Start;
+   Spans[SpanCount].End = End;
+   Spans[SpanCount].Depth = Depth;
+   return SpanCount++;
+} // static UINTN AddSpan()
+
+// Starts a span called Name (followed by Detail, if given), nested within any
+// spans that are still open. Returns a value to pass to TimelineEnd().
+UINTN TimelineBegin(IN CHAR16 *Name, IN CHAR16 *Detail OPTIONAL) {
+   UINTN Span;
+
+   Span = AddSpan((Detail != NULL) ? PoolPrint(L"%s %s", Name, Detail) : StrDuplicate(Name),
+                  ReadTimestampCounter(), 0, OpenSpans);
+   OpenSpans++;
+   return Span;
+} // UINTN TimelineBegin()
+
+VOID TimelineEnd(IN UINTN Span) {
+   if (OpenSpans > 0)
+      OpenSpans--;
+   if (Span < SpanCount)
+      Spans[Span].End = ReadTimestampCounter();
+} // VOID TimelineEnd()
+
+// Records a top-level span whose times were taken elsewhere.
+VOID TimelineAddSpan(IN CHAR16 *Name, IN UINT64 Start, IN UINT64 End) {
+   if (Start != 0 && End >= Start)
+      AddSpan(StrDuplicate(Name), Start, End, 0);
+} // VOID TimelineAddSpan()
+
+// Returns the span indices in order of start time. Spans that start at the
+// same time stay in the order they were begun, so parents precede children.
+static UINTN * SortedSpans(VOID) {
+   UINTN *Order;
+   UINTN i, j, Index;
+
+   Order = AllocatePool((SpanCount + 1) * sizeof(UINTN));
+   if (Order == NULL)
+      return NULL;
+   for (i = 0; i < SpanCount; i++) {
+      Index = i;
+      for (j = i; j > 0 && Spans[Order[j - 1]].Start > Spans[Index].Start; j--)
+         Order[j] = Order[j - 1];
+      Order[j] = Index;
+   } // for
+   return Order;
+} // static UINTN * SortedSpans()
+
+// Returns Ticks in thousandths of a millisecond.
+static UINT64 TicksToUs(IN UINT64 Ticks) {
+   UINT64 TicksPerMs = TimestampTicksPerMs();
+
+   return (TicksPerMs > 0) ? (Ticks * 1000) / TicksPerMs : 0;
+} // static UINT64 TicksToUs()
+
+// Returns a line describing Span; the caller must free it.
+static CHAR16 * DescribeSpan(IN TIMELINE_SPAN *Span, IN BOOLEAN Compact) {
+   UINT64 Start, Duration;
+   CHAR16 Indent[2 * 8 + 1];
+   UINTN  i;
+
+   Start = TicksToUs((Span->Start > TimelineOrigin) ? Span->Start - TimelineOrigin : 0);
+   Duration = TicksToUs((Span->End > Span->Start) ? Span->End - Span->Start : 0);
+   for (i = 0; i < 2 * Span->Depth && i < 2 * 8; i++)
+      Indent[i] = L' ';
+   Indent[i] = 0;
+   if (Compact)
+      return PoolPrint(L"%ld.%03ld %ld.%03ld %s%s", Start / 1000, Start % 1000, Duration / 1000, Duration % 1000,
+                       Indent, Span->Name);
+   if (Span->End == 0)
+      return PoolPrint(L" %s%s: started at %ld ms, still running", Indent, Span->Name, Start / 1000);
+   return PoolPrint(L" %s%s: %ld.%03ld ms, at %ld ms", Indent, Span->Name, Duration / 1000, Duration % 1000,
+                    Start / 1000);
+} // static CHAR16 * DescribeSpan()
+
+// Adds a line for each span (up to a limit) to Screen's information lines.
+// The lines are allocated from the pool, so the caller can free them.
+VOID AddTimelineInfoLines(IN REFIT_MENU_SCREEN *Screen) {
+   UINTN *Order, i;
+
+   if (SpanCount == 0 || TimestampTicksPerMs() == 0) {
+      AddMenuInfoLine(Screen, StrDuplicate(L"No timing information is available on this computer."));
+      return;
+   }
+   Order = SortedSpans();
+   if (Order == NULL)
+      return;
+   for (i = 0; i < SpanCount && i < TIMELINE_MAX_INFO_LINES; i++)
+      AddMenuInfoLine(Screen, DescribeSpan(&Spans[Order[i]], FALSE));
+   if (SpanCount > TIMELINE_MAX_INFO_LINES || DroppedSpans > 0)
+      AddMenuInfoLine(Screen, PoolPrint(L" (%d more not shown)",
+                      SpanCount - i + DroppedSpans));
+   FreePool(Order);
+} // VOID AddTimelineInfoLines()
+
+// Writes the timeline to the log file, if that's enabled and anything has
+// been added to it since the last call.
+VOID TimelineSave(VOID) {
+   CHAR16           *Text = NULL, *Line;
+   UINTN            *Order, i;
+
+   if (!GlobalConfig.LogTimeline || SpanCount == SavedSpanCount || TimestampTicksPerMs() == 0)
+      return;
+   Order = SortedSpans();
+   if (Order == NULL)
+      return;
+   for (i = 0; i <= SpanCount; i++) {
+      if (i == 0)
+         Line = PoolPrint(L"# rEFInd start-up timeline: start ms, duration ms, phase (%ld ticks/ms)",
+                          TimestampTicksPerMs());
+      else
+         Line = DescribeSpan(&Spans[Order[i - 1]], TRUE);
+      if (Line != NULL) {
+         MergeStrings(&Text, Line, (Text != NULL) ? L'\n' : 0);
+         FreePool(Line);
+      }
+   } // for
+   if (DroppedSpans > 0) {
+      Line = PoolPrint(L"# %d more not recorded", DroppedSpans);
+      if (Line != NULL) {
+         MergeStrings(&Text, Line, L'\n');
+         FreePool(Line);
+      }
+   }
+   MergeStrings(&Text, L"", L'\n');
+   FreePool(Order);
+   if (Text == NULL)
+      return;
+
+   // names are ASCII, so the log is too
+   if (!EFI_ERROR(SaveTextFile(SelfDir, TIMELINE_FILE_NAME, Text, FALSE)))
+      SavedSpanCount = SpanCount;
+   FreePool(Text);
+} // VOID TimelineSave()
+
+/* EOF */
@@ -0,0 +1,40 @@
+/*
+ * refind/timeline.h
+ * Boot phase timeline header file
+ *
+ * Copyright (c) 2012 Roderick W. Smith
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#ifndef __TIMELINE_H_
+#define __TIMELINE_H_
+
+#include "efi.h"
+#include "global.h"
+
+// returned by TimelineBegin() when the timeline is full
+#define TIMELINE_NO_SPAN (~((UINTN) 0))
+
+VOID TimelineStart(IN UINT64 Origin);
+UINTN TimelineBegin(IN CHAR16 *Name, IN CHAR16 *Detail OPTIONAL);
+VOID TimelineEnd(IN UINTN Span);
+VOID TimelineAddSpan(IN CHAR16 *Name, IN UINT64 Start, IN UINT64 End);
+VOID TimelineSave(VOID);
+VOID AddTimelineInfoLines(IN REFIT_MENU_SCREEN *Screen);
+
+#endif
+
+/* EOF */